@@ -0,0 +1,9 @@
+<Wait100>
+10 let n=0
+15 let s=0
+20 for i=1 to 500
+30 let s=s-i/3-i/7
+40 next i
+50 let n=n-1
+70 goto 20
+run
@@ -0,0 +1,12 @@
+<Wait100>
+10 let n=0
+20 for j=1 to 100
+30 gosub 100
+40 next j
+50 let n=n-1
+70 goto 20
+100 for k=1 to 10
+110 let m=j-k
+120 next k
+130 return
+run
@@ -11,37 +11,37 @@
 /**     changes to this file.                               **/
 /*************************************************************/
 
-case JR_NZ:   if(R->AF.B.l&Z_FLAG) R->PC.W++; else { ELAPSE(5);M_JR; } break;
-case JR_NC:   if(R->AF.B.l&C_FLAG) R->PC.W++; else { ELAPSE(5);M_JR; } break;
-case JR_Z:    if(R->AF.B.l&Z_FLAG) { ELAPSE(5);M_JR; } else R->PC.W++; break;
-case JR_C:    if(R->AF.B.l&C_FLAG) { ELAPSE(5);M_JR; } else R->PC.W++; break;
-
-case JP_NZ:   if(R->AF.B.l&Z_FLAG) R->PC.W+=2; else { M_JP; } break;
-case JP_NC:   if(R->AF.B.l&C_FLAG) R->PC.W+=2; else { M_JP; } break;
-case JP_PO:   if(R->AF.B.l&P_FLAG) R->PC.W+=2; else { M_JP; } break;
-case JP_P:    if(R->AF.B.l&S_FLAG) R->PC.W+=2; else { M_JP; } break;
-case JP_Z:    if(R->AF.B.l&Z_FLAG) { M_JP; } else R->PC.W+=2; break;
-case JP_C:    if(R->AF.B.l&C_FLAG) { M_JP; } else R->PC.W+=2; break;
-case JP_PE:   if(R->AF.B.l&P_FLAG) { M_JP; } else R->PC.W+=2; break;
-case JP_M:    if(R->AF.B.l&S_FLAG) { M_JP; } else R->PC.W+=2; break;
-
-case RET_NZ:  if(!(R->AF.B.l&Z_FLAG)) { ELAPSE(6);M_RET; } break;
-case RET_NC:  if(!(R->AF.B.l&C_FLAG)) { ELAPSE(6);M_RET; } break;
-case RET_PO:  if(!(R->AF.B.l&P_FLAG)) { ELAPSE(6);M_RET; } break;
-case RET_P:   if(!(R->AF.B.l&S_FLAG)) { ELAPSE(6);M_RET; } break;
-case RET_Z:   if(R->AF.B.l&Z_FLAG)    { ELAPSE(6);M_RET; } break;
-case RET_C:   if(R->AF.B.l&C_FLAG)    { ELAPSE(6);M_RET; } break;
-case RET_PE:  if(R->AF.B.l&P_FLAG)    { ELAPSE(6);M_RET; } break;
-case RET_M:   if(R->AF.B.l&S_FLAG)    { ELAPSE(6);M_RET; } break;
-
-case CALL_NZ: if(R->AF.B.l&Z_FLAG) R->PC.W+=2; else { ELAPSE(7);M_CALL; } break;
-case CALL_NC: if(R->AF.B.l&C_FLAG) R->PC.W+=2; else { ELAPSE(7);M_CALL; } break;
-case CALL_PO: if(R->AF.B.l&P_FLAG) R->PC.W+=2; else { ELAPSE(7);M_CALL; } break;
-case CALL_P:  if(R->AF.B.l&S_FLAG) R->PC.W+=2; else { ELAPSE(7);M_CALL; } break;
-case CALL_Z:  if(R->AF.B.l&Z_FLAG) { ELAPSE(7);M_CALL; } else R->PC.W+=2; break;
-case CALL_C:  if(R->AF.B.l&C_FLAG) { ELAPSE(7);M_CALL; } else R->PC.W+=2; break;
-case CALL_PE: if(R->AF.B.l&P_FLAG) { ELAPSE(7);M_CALL; } else R->PC.W+=2; break;
-case CALL_M:  if(R->AF.B.l&S_FLAG) { ELAPSE(7);M_CALL; } else R->PC.W+=2; break;
+case JR_NZ:   if(F_Z) R->PC.W++; else { ELAPSE(5);M_JR; } break;
+case JR_NC:   if(F_C) R->PC.W++; else { ELAPSE(5);M_JR; } break;
+case JR_Z:    if(F_Z) { ELAPSE(5);M_JR; } else R->PC.W++; break;
+case JR_C:    if(F_C) { ELAPSE(5);M_JR; } else R->PC.W++; break;
+
+case JP_NZ:   if(F_Z) R->PC.W+=2; else { M_JP; } break;
+case JP_NC:   if(F_C) R->PC.W+=2; else { M_JP; } break;
+case JP_PO:   if(F_P) R->PC.W+=2; else { M_JP; } break;
+case JP_P:    if(F_S) R->PC.W+=2; else { M_JP; } break;
+case JP_Z:    if(F_Z) { M_JP; } else R->PC.W+=2; break;
+case JP_C:    if(F_C) { M_JP; } else R->PC.W+=2; break;
+case JP_PE:   if(F_P) { M_JP; } else R->PC.W+=2; break;
+case JP_M:    if(F_S) { M_JP; } else R->PC.W+=2; break;
+
+case RET_NZ:  if(!F_Z) { ELAPSE(6);M_RET; } break;
+case RET_NC:  if(!F_C) { ELAPSE(6);M_RET; } break;
+case RET_PO:  if(!F_P) { ELAPSE(6);M_RET; } break;
+case RET_P:   if(!F_S) { ELAPSE(6);M_RET; } break;
+case RET_Z:   if(F_Z)    { ELAPSE(6);M_RET; } break;
+case RET_C:   if(F_C)    { ELAPSE(6);M_RET; } break;
+case RET_PE:  if(F_P)    { ELAPSE(6);M_RET; } break;
+case RET_M:   if(F_S)    { ELAPSE(6);M_RET; } break;
+
+case CALL_NZ: if(F_Z) R->PC.W+=2; else { ELAPSE(7);M_CALL; } break;
+case CALL_NC: if(F_C) R->PC.W+=2; else { ELAPSE(7);M_CALL; } break;
+case CALL_PO: if(F_P) R->PC.W+=2; else { ELAPSE(7);M_CALL; } break;
+case CALL_P:  if(F_S) R->PC.W+=2; else { ELAPSE(7);M_CALL; } break;
+case CALL_Z:  if(F_Z) { ELAPSE(7);M_CALL; } else R->PC.W+=2; break;
+case CALL_C:  if(F_C) { ELAPSE(7);M_CALL; } else R->PC.W+=2; break;
+case CALL_PE: if(F_P) { ELAPSE(7);M_CALL; } else R->PC.W+=2; break;
+case CALL_M:  if(F_S) { ELAPSE(7);M_CALL; } else R->PC.W+=2; break;
 
 case ADD_B:    M_ADD(R->BC.B.h);break;
 case ADD_C:    M_ADD(R->BC.B.l);break;
@@ -51,7 +51,7 @@ case ADD_H:    M_ADD(R->HL.B.h);break;
 case ADD_L:    M_ADD(R->HL.B.l);break;
 case ADD_A:    M_ADD(R->AF.B.h);break;
 case ADD_xHL:  I=RdZ80(R->HL.W);M_ADD(I);break;
-case ADD_BYTE: I=RdZ80(R->PC.W++);M_ADD(I);break;
+case ADD_BYTE: I=OpZ80(R->PC.W++);M_ADD(I);break;
 
 case SUB_B:    M_SUB(R->BC.B.h);break;
 case SUB_C:    M_SUB(R->BC.B.l);break;
@@ -59,9 +59,9 @@ case SUB_D:    M_SUB(R->DE.B.h);break;
 case SUB_E:    M_SUB(R->DE.B.l);break;
 case SUB_H:    M_SUB(R->HL.B.h);break;
 case SUB_L:    M_SUB(R->HL.B.l);break;
-case SUB_A:    R->AF.B.h=0;R->AF.B.l=N_FLAG|Z_FLAG;break;
+case SUB_A:    F_SET;R->AF.B.h=0;R->AF.B.l=N_FLAG|Z_FLAG;break;
 case SUB_xHL:  I=RdZ80(R->HL.W);M_SUB(I);break;
-case SUB_BYTE: I=RdZ80(R->PC.W++);M_SUB(I);break;
+case SUB_BYTE: I=OpZ80(R->PC.W++);M_SUB(I);break;
 
 case AND_B:    M_AND(R->BC.B.h);break;
 case AND_C:    M_AND(R->BC.B.l);break;
@@ -71,7 +71,7 @@ case AND_H:    M_AND(R->HL.B.h);break;
 case AND_L:    M_AND(R->HL.B.l);break;
 case AND_A:    M_AND(R->AF.B.h);break;
 case AND_xHL:  I=RdZ80(R->HL.W);M_AND(I);break;
-case AND_BYTE: I=RdZ80(R->PC.W++);M_AND(I);break;
+case AND_BYTE: I=OpZ80(R->PC.W++);M_AND(I);break;
 
 case OR_B:     M_OR(R->BC.B.h);break;
 case OR_C:     M_OR(R->BC.B.l);break;
@@ -81,7 +81,7 @@ case OR_H:     M_OR(R->HL.B.h);break;
 case OR_L:     M_OR(R->HL.B.l);break;
 case OR_A:     M_OR(R->AF.B.h);break;
 case OR_xHL:   I=RdZ80(R->HL.W);M_OR(I);break;
-case OR_BYTE:  I=RdZ80(R->PC.W++);M_OR(I);break;
+case OR_BYTE:  I=OpZ80(R->PC.W++);M_OR(I);break;
 
 case ADC_B:    M_ADC(R->BC.B.h);break;
 case ADC_C:    M_ADC(R->BC.B.l);break;
@@ -91,7 +91,7 @@ case ADC_H:    M_ADC(R->HL.B.h);break;
 case ADC_L:    M_ADC(R->HL.B.l);break;
 case ADC_A:    M_ADC(R->AF.B.h);break;
 case ADC_xHL:  I=RdZ80(R->HL.W);M_ADC(I);break;
-case ADC_BYTE: I=RdZ80(R->PC.W++);M_ADC(I);break;
+case ADC_BYTE: I=OpZ80(R->PC.W++);M_ADC(I);break;
 
 case SBC_B:    M_SBC(R->BC.B.h);break;
 case SBC_C:    M_SBC(R->BC.B.l);break;
@@ -101,7 +101,7 @@ case SBC_H:    M_SBC(R->HL.B.h);break;
 case SBC_L:    M_SBC(R->HL.B.l);break;
 case SBC_A:    M_SBC(R->AF.B.h);break;
 case SBC_xHL:  I=RdZ80(R->HL.W);M_SBC(I);break;
-case SBC_BYTE: I=RdZ80(R->PC.W++);M_SBC(I);break;
+case SBC_BYTE: I=OpZ80(R->PC.W++);M_SBC(I);break;
 
 case XOR_B:    M_XOR(R->BC.B.h);break;
 case XOR_C:    M_XOR(R->BC.B.l);break;
@@ -109,9 +109,9 @@ case XOR_D:    M_XOR(R->DE.B.h);break;
 case XOR_E:    M_XOR(R->DE.B.l);break;
 case XOR_H:    M_XOR(R->HL.B.h);break;
 case XOR_L:    M_XOR(R->HL.B.l);break;
-case XOR_A:    R->AF.B.h=0;R->AF.B.l=P_FLAG|Z_FLAG;break;
+case XOR_A:    F_SET;R->AF.B.h=0;R->AF.B.l=P_FLAG|Z_FLAG;break;
 case XOR_xHL:  I=RdZ80(R->HL.W);M_XOR(I);break;
-case XOR_BYTE: I=RdZ80(R->PC.W++);M_XOR(I);break;
+case XOR_BYTE: I=OpZ80(R->PC.W++);M_XOR(I);break;
 
 case CP_B:     M_CP(R->BC.B.h);break;
 case CP_C:     M_CP(R->BC.B.l);break;
@@ -119,9 +119,9 @@ case CP_D:     M_CP(R->DE.B.h);break;
 case CP_E:     M_CP(R->DE.B.l);break;
 case CP_H:     M_CP(R->HL.B.h);break;
 case CP_L:     M_CP(R->HL.B.l);break;
-case CP_A:     R->AF.B.l=N_FLAG|Z_FLAG;break;
+case CP_A:     F_SET;R->AF.B.l=N_FLAG|Z_FLAG;break;
 case CP_xHL:   I=RdZ80(R->HL.W);M_CP(I);break;
-case CP_BYTE:  I=RdZ80(R->PC.W++);M_CP(I);break;
+case CP_BYTE:  I=OpZ80(R->PC.W++);M_CP(I);break;
                
 case LD_BC_WORD: M_LDWORD(BC);break;
 case LD_DE_WORD: M_LDWORD(DE);break;
@@ -167,21 +167,25 @@ case INC_A:    M_INC(R->AF.B.h);break;
 case INC_xHL:  I=RdZ80(R->HL.W);M_INC(I);WrZ80(R->HL.W,I);break;
 
 case RLCA:
+  F_SYNC;
   I=R->AF.B.h&0x80? C_FLAG:0;
   R->AF.B.h=(R->AF.B.h<<1)|I;
   R->AF.B.l=(R->AF.B.l&~(C_FLAG|N_FLAG|H_FLAG))|I;
   break;
 case RLA:
+  F_SYNC;
   I=R->AF.B.h&0x80? C_FLAG:0;
   R->AF.B.h=(R->AF.B.h<<1)|(R->AF.B.l&C_FLAG);
   R->AF.B.l=(R->AF.B.l&~(C_FLAG|N_FLAG|H_FLAG))|I;
   break;
 case RRCA:
+  F_SYNC;
   I=R->AF.B.h&0x01;
   R->AF.B.h=(R->AF.B.h>>1)|(I? 0x80:0);
   R->AF.B.l=(R->AF.B.l&~(C_FLAG|N_FLAG|H_FLAG))|I; 
   break;
 case RRA:
+  F_SYNC;
   I=R->AF.B.h&0x01;
   R->AF.B.h=(R->AF.B.h>>1)|(R->AF.B.l&C_FLAG? 0x80:0);
   R->AF.B.l=(R->AF.B.l&~(C_FLAG|N_FLAG|H_FLAG))|I;
@@ -199,12 +203,12 @@ case RST38:    M_RST(0x0038);break;
 case PUSH_BC:  M_PUSH(BC);break;
 case PUSH_DE:  M_PUSH(DE);break;
 case PUSH_HL:  M_PUSH(HL);break;
-case PUSH_AF:  M_PUSH(AF);break;
+case PUSH_AF:  F_SYNC;M_PUSH(AF);break;
 
 case POP_BC:   M_POP(BC);break;
 case POP_DE:   M_POP(DE);break;
 case POP_HL:   M_POP(HL);break;
-case POP_AF:   M_POP(AF);break;
+case POP_AF:   F_SET;M_POP(AF);break;
 
 /* @@@AK 8T is accounted for, but if we jump its 13T */
 case DJNZ: if(--R->BC.B.h) { ELAPSE(5);M_JR; } else R->PC.W++;break;
@@ -212,13 +216,13 @@ case JP:   M_JP;break;
 case JR:   M_JR;break;
 case CALL: M_CALL;break;
 case RET:  M_RET;break;
-case SCF:  S(C_FLAG);R(N_FLAG|H_FLAG);break;
-case CPL:  R->AF.B.h=~R->AF.B.h;S(N_FLAG|H_FLAG);break;
+case SCF:  F_SYNC;S(C_FLAG);R(N_FLAG|H_FLAG);break;
+case CPL:  F_SYNC;R->AF.B.h=~R->AF.B.h;S(N_FLAG|H_FLAG);break;
 case NOP:  break;
 /* @@@AK, full word IO address */
-case OUTA: OutZ80(RdZ80(R->PC.W++) |(R->AF.B.h<<8) ,R->AF.B.h);break;
+case OUTA: OutZ80(OpZ80(R->PC.W++) |(R->AF.B.h<<8) ,R->AF.B.h);break;
 /* @@@AK, full word IO address */
-case INA:  R->AF.B.h=InZ80(RdZ80(R->PC.W++) |(R->AF.B.h<<8) );break;
+case INA:  R->AF.B.h=InZ80(OpZ80(R->PC.W++) |(R->AF.B.h<<8) );break;
 // Do not skip timing on HALT instruction
 case HALT: R->PC.W--;R->IFF|=0x80;/*R->ICount=0;*/break;
 
@@ -241,6 +245,7 @@ case EI:
   break;
 
 case CCF:
+  F_SYNC;
   R->AF.B.l^=C_FLAG;R(N_FLAG|H_FLAG);
   R->AF.B.l|=R->AF.B.l&C_FLAG? 0:H_FLAG;
   break;
@@ -252,7 +257,7 @@ case EXX:
   break;
 
 case EX_DE_HL: J.W=R->DE.W;R->DE.W=R->HL.W;R->HL.W=J.W;break;
-case EX_AF_AF: J.W=R->AF.W;R->AF.W=R->AF1.W;R->AF1.W=J.W;break;  
+case EX_AF_AF: F_SYNC;J.W=R->AF.W;R->AF.W=R->AF1.W;R->AF1.W=J.W;break;  
   
 case LD_B_B:   R->BC.B.h=R->BC.B.h;break;
 case LD_C_B:   R->BC.B.l=R->BC.B.h;break;
@@ -328,38 +333,38 @@ case LD_H_xHL:    R->HL.B.h=RdZ80(R->HL.W);break;
 case LD_L_xHL:    R->HL.B.l=RdZ80(R->HL.W);break;
 case LD_A_xHL:    R->AF.B.h=RdZ80(R->HL.W);break;
 
-case LD_B_BYTE:   R->BC.B.h=RdZ80(R->PC.W++);break;
-case LD_C_BYTE:   R->BC.B.l=RdZ80(R->PC.W++);break;
-case LD_D_BYTE:   R->DE.B.h=RdZ80(R->PC.W++);break;
-case LD_E_BYTE:   R->DE.B.l=RdZ80(R->PC.W++);break;
-case LD_H_BYTE:   R->HL.B.h=RdZ80(R->PC.W++);break;
-case LD_L_BYTE:   R->HL.B.l=RdZ80(R->PC.W++);break;
-case LD_A_BYTE:   R->AF.B.h=RdZ80(R->PC.W++);break;
-case LD_xHL_BYTE: WrZ80(R->HL.W,RdZ80(R->PC.W++));break;
+case LD_B_BYTE:   R->BC.B.h=OpZ80(R->PC.W++);break;
+case LD_C_BYTE:   R->BC.B.l=OpZ80(R->PC.W++);break;
+case LD_D_BYTE:   R->DE.B.h=OpZ80(R->PC.W++);break;
+case LD_E_BYTE:   R->DE.B.l=OpZ80(R->PC.W++);break;
+case LD_H_BYTE:   R->HL.B.h=OpZ80(R->PC.W++);break;
+case LD_L_BYTE:   R->HL.B.l=OpZ80(R->PC.W++);break;
+case LD_A_BYTE:   R->AF.B.h=OpZ80(R->PC.W++);break;
+case LD_xHL_BYTE: WrZ80(R->HL.W,OpZ80(R->PC.W++));break;
 
 case LD_xWORD_HL:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++);
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++);
   WrZ80(J.W++,R->HL.B.l);
   WrZ80(J.W,R->HL.B.h);
   break;
 
 case LD_HL_xWORD:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++);
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++);
   R->HL.B.l=RdZ80(J.W++);
   R->HL.B.h=RdZ80(J.W);
   break;
 
 case LD_A_xWORD:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++); 
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++); 
   R->AF.B.h=RdZ80(J.W);
   break;
 
 case LD_xWORD_A:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++);
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++);
   WrZ80(J.W,R->AF.B.h);
   break;
 
@@ -370,6 +375,7 @@ case EX_HL_xSP:
   break;
 
 case DAA:
+  F_SYNC;
   J.W=R->AF.B.h;
   if(R->AF.B.l&C_FLAG) J.W|=256;
   if(R->AF.B.l&H_FLAG) J.W|=512;
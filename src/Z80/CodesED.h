@@ -26,51 +26,51 @@ case SBC_HL_HL: M_SBCW(HL);break;
 case SBC_HL_SP: M_SBCW(SP);break;
 
 case LD_xWORDe_HL:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++);
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++);
   WrZ80(J.W++,R->HL.B.l);
   WrZ80(J.W,R->HL.B.h);
   break;
 case LD_xWORDe_DE:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++);
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++);
   WrZ80(J.W++,R->DE.B.l);
   WrZ80(J.W,R->DE.B.h);
   break;
 case LD_xWORDe_BC:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++);
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++);
   WrZ80(J.W++,R->BC.B.l);
   WrZ80(J.W,R->BC.B.h);
   break;
 case LD_xWORDe_SP:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++);
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++);
   WrZ80(J.W++,R->SP.B.l);
   WrZ80(J.W,R->SP.B.h);
   break;
 
 case LD_HL_xWORDe:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++);
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++);
   R->HL.B.l=RdZ80(J.W++);
   R->HL.B.h=RdZ80(J.W);
   break;
 case LD_DE_xWORDe:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++);
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++);
   R->DE.B.l=RdZ80(J.W++);
   R->DE.B.h=RdZ80(J.W);
   break;
 case LD_BC_xWORDe:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++);
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++);
   R->BC.B.l=RdZ80(J.W++);
   R->BC.B.h=RdZ80(J.W);
   break;
 case LD_SP_xWORDe:
-  J.B.l=RdZ80(R->PC.W++);
-  J.B.h=RdZ80(R->PC.W++);
+  J.B.l=OpZ80(R->PC.W++);
+  J.B.h=OpZ80(R->PC.W++);
   R->SP.B.l=RdZ80(J.W++);
   R->SP.B.h=RdZ80(J.W);
   break;
@@ -0,0 +1,22 @@
+/** Z80: portable Z80 emulator *******************************/
+/**                                                         **/
+/**                         CodesOp.h                       **/
+/**                                                         **/
+/** This file defines the threaded handler for one opcode   **/
+/** of the main table, given by Z80_OP_HI and Z80_OP_LO.    **/
+/** The opcode is a constant, so the compiler reduces the   **/
+/** switch to the one case taken from Codes.h. Each handler **/
+/** ends with its own dispatch of the next opcode. It is    **/
+/** included from CodesRow.h when Z80_THREADED is defined.  **/
+/*************************************************************/
+
+Z80_OPLBL(Z80_OP_HI,Z80_OP_LO):
+  switch((Z80_OP_HI<<4)|Z80_OP_LO)
+  {
+#include "Codes.h"
+    case PFX_CB: CodesCB(R);break;
+    case PFX_ED: CodesED(R);break;
+    case PFX_FD: CodesFD(R);break;
+    case PFX_DD: CodesDD(R);break;
+  }
+  Z80_NEXT;
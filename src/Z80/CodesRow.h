@@ -0,0 +1,57 @@
+/** Z80: portable Z80 emulator *******************************/
+/**                                                         **/
+/**                         CodesRow.h                      **/
+/**                                                         **/
+/** This file defines the handlers for the sixteen opcodes  **/
+/** with high nibble Z80_OP_HI. It is included from Z80.c   **/
+/** when Z80_THREADED is defined.                           **/
+/*************************************************************/
+
+#define Z80_OP_LO 0
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 1
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 2
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 3
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 4
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 5
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 6
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 7
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 8
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 9
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 10
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 11
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 12
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 13
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 14
+#include "CodesOp.h"
+#undef Z80_OP_LO
+#define Z80_OP_LO 15
+#include "CodesOp.h"
+#undef Z80_OP_LO
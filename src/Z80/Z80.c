@@ -19,9 +19,105 @@
 #include "diag.h"
 #include "Z80.h"
 #include "Tables.h"
+#include "mem.h"
 //#include <stdio.h>
 //#include <Profiler.h>
 
+/** Memory Access ********************************************/
+/** Ordinary reads and writes go straight through the page  **/
+/** tables in mem.h, only calling WrZ80() where the write   **/
+/** needs special handling.                                 **/
+/*************************************************************/
+#define RdZ80(A)     mem_z80_rd(A)
+#define WrZ80(A,V)   mem_z80_wr(A,V)
+
+/** Wait States **********************************************/
+/** Z80Wait.c compiles this file again with Z80_WAITS, to   **/
+/** give Z80RunWait(). That copy charges R->Waits on every  **/
+/** memory access, M1 cycle and I/O access. The functions   **/
+/** which don't run code are only built the first time.     **/
+/*************************************************************/
+#ifdef Z80_WAITS
+static inline byte RdZ80Wait(Z80 *R,word A)
+{
+  ELAPSE(R->Waits->Mem[A>>13]);
+  return(mem_z80_rd(A));
+}
+
+static inline void WrZ80Wait(Z80 *R,word A,byte V)
+{
+  ELAPSE(R->Waits->Mem[A>>13]);
+  mem_z80_wr(A,V);
+}
+
+static inline byte InZ80Wait(Z80 *R,word P)
+{
+  ELAPSE(R->Waits->IO[P&0xFF]);
+  return(InZ80(P));
+}
+
+static inline void OutZ80Wait(Z80 *R,word P,byte V)
+{
+  ELAPSE(R->Waits->IO[P&0xFF]);
+  OutZ80(P,V);
+}
+
+#undef RdZ80
+#undef WrZ80
+#define RdZ80(A)     RdZ80Wait(R,A)
+#define WrZ80(A,V)   WrZ80Wait(R,A,V)
+#define InZ80(P)     InZ80Wait(R,P)
+#define OutZ80(P,V)  OutZ80Wait(R,P,V)
+#define M1WAIT       ELAPSE(R->Waits->M1)
+#define Z80Run       Z80RunWait
+#else
+#define M1WAIT
+#endif
+
+/** Opcode Fetch *********************************************/
+/** OpZ80() reads opcodes and the operands which follow     **/
+/** them. With Z80_FETCH_CACHE, it reads through a pointer  **/
+/** to the 8KB page of the last fetch, only looking at      **/
+/** mem_read[] again when PC leaves that page. The pointer  **/
+/** is dropped wherever the memory map may change: at each  **/
+/** Z80Step() (so a run on one pointer lasts at most until  **/
+/** IStepNext) and LoopZ80(), after I/O and PatchZ80(), and **/
+/** on writes which go through WrZ80(). Z80RunWait() always **/
+/** uses RdZ80().                                           **/
+/*************************************************************/
+#if defined(Z80_FETCH_CACHE) && !defined(Z80_WAITS)
+#ifdef SMALL_MEM
+#error Z80_FETCH_CACHE needs every page of mem_read[] present
+#endif
+#define FETCH_FLUSH  R->FetchPage=Z80_NO_PAGE
+
+static inline byte OpZ80Cache(Z80 *R,word A)
+{
+  if((A>>13)!=R->FetchPage)
+  {
+    R->FetchPage=A>>13;
+    R->FetchBase=mem_read[A>>13];
+  }
+  return(R->FetchBase[A&0x1FFF]);
+}
+
+static inline void WrZ80Cache(Z80 *R,word A,byte V)
+{
+  if(mem_z80_write[A>>13]==NULL) FETCH_FLUSH;
+  mem_z80_wr(A,V);
+}
+
+#undef WrZ80
+#define OpZ80(A)     OpZ80Cache(R,A)
+#define WrZ80(A,V)   WrZ80Cache(R,A,V)
+#define InZ80(P)     (FETCH_FLUSH,InZ80(P))
+#define OutZ80(P,V)  (OutZ80(P,V),FETCH_FLUSH)
+#define PatchZ80(Rg) (PatchZ80(Rg),FETCH_FLUSH)
+#else
+#define FETCH_FLUSH
+#define OpZ80(A)     RdZ80(A)
+#endif
+
 /** INLINE ***************************************************/
 /** Different compilers inline C functions differently.     **/
 /*************************************************************/
@@ -89,19 +185,19 @@
   WrZ80(--R->SP.W,R->Rg.B.h);WrZ80(--R->SP.W,R->Rg.B.l)
 
 #define M_CALL         \
-  J.B.l=RdZ80(R->PC.W++);J.B.h=RdZ80(R->PC.W++);         \
+  J.B.l=OpZ80(R->PC.W++);J.B.h=OpZ80(R->PC.W++);         \
   WrZ80(--R->SP.W,R->PC.B.h);WrZ80(--R->SP.W,R->PC.B.l); \
   R->PC.W=J.W
 
-#define M_JP  J.B.l=RdZ80(R->PC.W++);J.B.h=RdZ80(R->PC.W);R->PC.W=J.W
-#define M_JR  R->PC.W+=(offset)RdZ80(R->PC.W)+1
+#define M_JP  J.B.l=OpZ80(R->PC.W++);J.B.h=OpZ80(R->PC.W);R->PC.W=J.W
+#define M_JR  R->PC.W+=(offset)OpZ80(R->PC.W)+1
 #define M_RET R->PC.B.l=RdZ80(R->SP.W++);R->PC.B.h=RdZ80(R->SP.W++)
 
 #define M_RST(Ad)      \
   WrZ80(--R->SP.W,R->PC.B.h);WrZ80(--R->SP.W,R->PC.B.l);R->PC.W=Ad
 
 #define M_LDWORD(Rg)   \
-  R->Rg.B.l=RdZ80(R->PC.W++);R->Rg.B.h=RdZ80(R->PC.W++)
+  R->Rg.B.l=OpZ80(R->PC.W++);R->Rg.B.h=OpZ80(R->PC.W++)
 
 #define M_ADD(Rg)      \
   J.W=R->AF.B.h+Rg;     \
@@ -187,6 +283,80 @@
     (J.W? 0:Z_FLAG)|(J.B.h&S_FLAG);                            \
   R->HL.W=J.W
 
+/** Lazy flags ***********************************************/
+/** With Z80_LAZY_FLAGS, the ALU operations of the main     **/
+/** table just note their operands and result, and F is     **/
+/** only worked out (by FlagsZ80) when something needs it.  **/
+/** Conditional jumps, calls and returns test Z, C and S    **/
+/** straight from the result. F is always made valid before **/
+/** a prefixed instruction, so none of CodesCB.h, CodesED.h **/
+/** CodesXX.h or CodesXCB.h need to know about this.        **/
+/*************************************************************/
+#ifdef Z80_LAZY_FLAGS
+
+#define LF_ADD  1  /* Also ADC, carry in is in FlagR */
+#define LF_SUB  2  /* Also SBC and CP                */
+#define LF_AND  3
+#define LF_OR   4  /* Also XOR                       */
+#define LF_INC  5  /* Old carry is in bit 8 of FlagR */
+#define LF_DEC  6
+
+#define F_SYNC  if(R->FlagOp) FlagsZ80(R)
+#define F_SET   R->FlagOp=0
+#define F_CARRY (R->FlagOp? (R->FlagR>>8)&C_FLAG:R->AF.B.l&C_FLAG)
+#define F_Z     (R->FlagOp? !(R->FlagR&0xFF):R->AF.B.l&Z_FLAG)
+#define F_C     F_CARRY
+#define F_S     (R->FlagOp? R->FlagR&0x80:R->AF.B.l&S_FLAG)
+#define F_P     ((R->FlagOp? FlagsZ80(R):(void)0),R->AF.B.l&P_FLAG)
+
+#define M_LAZY(Op,Rg,Res) \
+  R->FlagOp=Op;R->FlagA=R->AF.B.h;R->FlagB=Rg;R->FlagR=Res
+
+#undef M_ADD
+#define M_ADD(Rg) M_LAZY(LF_ADD,Rg,R->AF.B.h+Rg);R->AF.B.h=R->FlagR
+#undef M_SUB
+#define M_SUB(Rg) M_LAZY(LF_SUB,Rg,R->AF.B.h-Rg);R->AF.B.h=R->FlagR
+#undef M_ADC
+#define M_ADC(Rg) \
+  J.W=R->AF.B.h+Rg+F_CARRY;M_LAZY(LF_ADD,Rg,J.W);R->AF.B.h=J.B.l
+#undef M_SBC
+#define M_SBC(Rg) \
+  J.W=R->AF.B.h-Rg-F_CARRY;M_LAZY(LF_SUB,Rg,J.W);R->AF.B.h=J.B.l
+#undef M_CP
+#define M_CP(Rg)  M_LAZY(LF_SUB,Rg,R->AF.B.h-Rg)
+#undef M_AND
+#define M_AND(Rg) R->AF.B.h&=Rg;R->FlagOp=LF_AND;R->FlagR=R->AF.B.h
+#undef M_OR
+#define M_OR(Rg)  R->AF.B.h|=Rg;R->FlagOp=LF_OR;R->FlagR=R->AF.B.h
+#undef M_XOR
+#define M_XOR(Rg) R->AF.B.h^=Rg;R->FlagOp=LF_OR;R->FlagR=R->AF.B.h
+#undef M_INC
+#define M_INC(Rg) \
+  R->FlagR=(F_CARRY<<8)|(byte)(++Rg);R->FlagOp=LF_INC
+#undef M_DEC
+#define M_DEC(Rg) \
+  R->FlagR=(F_CARRY<<8)|(byte)(--Rg);R->FlagOp=LF_DEC
+#undef M_ADDW
+#define M_ADDW(Rg1,Rg2) \
+  F_SYNC;               \
+  J.W=(R->Rg1.W+R->Rg2.W)&0xFFFF;                        \
+  R->AF.B.l=                                             \
+    (R->AF.B.l&~(H_FLAG|N_FLAG|C_FLAG))|                 \
+    ((R->Rg1.W^R->Rg2.W^J.W)&0x1000? H_FLAG:0)|          \
+    (((long)R->Rg1.W+(long)R->Rg2.W)&0x10000? C_FLAG:0); \
+  R->Rg1.W=J.W
+
+#else
+
+#define F_SYNC
+#define F_SET
+#define F_Z     (R->AF.B.l&Z_FLAG)
+#define F_C     (R->AF.B.l&C_FLAG)
+#define F_S     (R->AF.B.l&S_FLAG)
+#define F_P     (R->AF.B.l&P_FLAG)
+
+#endif
+
 enum Codes
 {
   NOP,LD_BC_WORD,LD_xBC_A,INC_BC,INC_B,DEC_B,LD_B_BYTE,RLCA,
@@ -299,8 +469,9 @@ static void CodesCB( Z80 *R)
 {
    byte I;
 
-  I=RdZ80(R->PC.W++);
-  ELAPSE(CyclesCB[I]);
+  F_SYNC;
+  I=OpZ80(R->PC.W++);
+  ELAPSE(CyclesCB[I]);M1WAIT;
   switch(I)
   {
 #include "CodesCB.h"
@@ -319,8 +490,8 @@ static void CodesDDCB( Z80 *R)
    byte I;
 
 #define XX IX    
-  J.W=R->XX.W+(offset)RdZ80(R->PC.W++);
-  I=RdZ80(R->PC.W++);
+  J.W=R->XX.W+(offset)OpZ80(R->PC.W++);
+  I=OpZ80(R->PC.W++);
   ELAPSE(CyclesXXCB[I]);
   switch(I)
   {
@@ -341,8 +512,8 @@ static void CodesFDCB( Z80 *R)
    byte I;
 
 #define XX IY
-  J.W=R->XX.W+(offset)RdZ80(R->PC.W++);
-  I=RdZ80(R->PC.W++);
+  J.W=R->XX.W+(offset)OpZ80(R->PC.W++);
+  I=OpZ80(R->PC.W++);
   ELAPSE(CyclesXXCB[I]);
   switch(I)
   {
@@ -362,8 +533,9 @@ static void CodesED( Z80 *R)
    byte I;
    pair J;
 
-  I=RdZ80(R->PC.W++);
-  ELAPSE(CyclesED[I]);
+  F_SYNC;
+  I=OpZ80(R->PC.W++);
+  ELAPSE(CyclesED[I]);M1WAIT;
   switch(I)
   {
 #include "CodesED.h"
@@ -383,9 +555,10 @@ static void CodesDD( Z80 *R)
    byte I;
    pair J;
 
+  F_SYNC;
 #define XX IX
-  I=RdZ80(R->PC.W++);
-  ELAPSE(CyclesXX[I]);
+  I=OpZ80(R->PC.W++);
+  ELAPSE(CyclesXX[I]);M1WAIT;
   switch(I)
   {
 #include "CodesXX.h"
@@ -419,9 +592,10 @@ static void CodesFD( Z80 *R)
    byte I;
    pair J;
 
+  F_SYNC;
 #define XX IY
-  I=RdZ80(R->PC.W++);
-  ELAPSE(CyclesXX[I]);
+  I=OpZ80(R->PC.W++);
+  ELAPSE(CyclesXX[I]);M1WAIT;
   switch(I)
   {
 #include "CodesXX.h"
@@ -449,6 +623,7 @@ static void CodesFD( Z80 *R)
 #undef XX
 }
 
+#ifndef Z80_WAITS
 /** ResetZ80() ***********************************************/
 /** This function can be used to reset the register struct  **/
 /** before starting execution with Z80(). It sets the       **/
@@ -468,7 +643,60 @@ void ResetZ80(Z80 *R)
 #ifdef SUPPORT_ELAPSE
   R->IElapsed = 0;
 #endif
+#ifdef SUPPORT_ELAPSED
+  R->IStepNext = 0;
+#endif
+#ifdef Z80_LAZY_FLAGS
+  R->FlagOp = 0;
+#endif
+#ifdef Z80_FETCH_CACHE
+  R->FetchPage = Z80_NO_PAGE;
+#endif
+}
+
+#ifdef Z80_LAZY_FLAGS
+/** FlagsZ80() ***********************************************/
+/** Work out F from the last ALU operation, exactly as the  **/
+/** M_ macros without Z80_LAZY_FLAGS would have done.       **/
+/*************************************************************/
+void FlagsZ80(Z80 *R)
+{
+  byte A=R->FlagA,B=R->FlagB,Rs=(byte)R->FlagR;
+
+  switch(R->FlagOp)
+  {
+    case LF_ADD:
+      R->AF.B.l=
+        (~(A^B)&(B^Rs)&0x80? V_FLAG:0)|
+        ((R->FlagR>>8)&C_FLAG)|ZSTable[Rs]|
+        ((A^B^Rs)&H_FLAG);
+      break;
+    case LF_SUB:
+      R->AF.B.l=
+        ((A^B)&(A^Rs)&0x80? V_FLAG:0)|
+        N_FLAG|((R->FlagR>>8)&C_FLAG)|ZSTable[Rs]|
+        ((A^B^Rs)&H_FLAG);
+      break;
+    case LF_AND:
+      R->AF.B.l=H_FLAG|PZSTable[Rs];
+      break;
+    case LF_OR:
+      R->AF.B.l=PZSTable[Rs];
+      break;
+    case LF_INC:
+      R->AF.B.l=
+        ((R->FlagR>>8)&C_FLAG)|ZSTable[Rs]|
+        (Rs==0x80? V_FLAG:0)|(Rs&0x0F? 0:H_FLAG);
+      break;
+    case LF_DEC:
+      R->AF.B.l=
+        N_FLAG|((R->FlagR>>8)&C_FLAG)|ZSTable[Rs]|
+        (Rs==0x7F? V_FLAG:0)|((Rs&0x0F)==0x0F? H_FLAG:0);
+      break;
+  }
+  R->FlagOp=0;
 }
+#endif
 
 /** ExecZ80() ************************************************/
 /** This function will execute a single Z80 opcode. It will **/
@@ -479,7 +707,8 @@ word ExecZ80(Z80 *R)
    byte I;
    pair J;
 
-  I=RdZ80(R->PC.W++);
+  FETCH_FLUSH;
+  I=OpZ80(R->PC.W++);
   ELAPSE(Cycles[I]);
   switch(I)
   {
@@ -540,6 +769,7 @@ word RunZ80(Z80 *R)
    byte I;
    pair J;
 
+  FETCH_FLUSH;
   for(;;)
   {
 #ifdef Z80_DEBUG
@@ -547,10 +777,13 @@ word RunZ80(Z80 *R)
     if(R->PC.W==R->Trap) R->Trace=1;
     /* Call single-step debugger, exit if requested */
     if(R->Trace)
+    {
       if(!DebugZ80(R)) return(R->PC.W);
+      FETCH_FLUSH;
+    }
 #endif
 
-    I=RdZ80(R->PC.W++);
+    I=OpZ80(R->PC.W++);
     ELAPSE(Cycles[I]);
     switch(I)
     {
@@ -575,9 +808,11 @@ word RunZ80(Z80 *R)
       }
       else
       {
+        F_SYNC;                  /* LoopZ80 may look at F    */
         J.W=LoopZ80(R);          /* Call periodic handler    */
         R->ICntLast += R->IPeriod - R->ICount;
         R->ICount=R->IPeriod;    /* Reset the cycle counter  */
+        FETCH_FLUSH;             /* It may change the map    */
       }
 
       if(J.W==INT_QUIT) return(R->PC.W); /* Exit if INT_QUIT */
@@ -608,106 +843,86 @@ void Z80Int (Z80 *R)
 	{
 	R->IntCont	|=	ICF_INT;
 	}
+#endif /* Z80_WAITS */
 
-/** Z80Run() *************************************************/
-/** Equivalent of the RunZ80 routine, but implementing      **/
-/** cycle accurate interrupts                               **/
+/** Z80Events() **********************************************/
+/** Called by Z80Run() after an instruction which has left  **/
+/** the cycle counter expired, an interrupt requested or    **/
+/** interrupts about to be enabled. Kept out of line so the **/
+/** common path through Z80Run() stays short. Returns FALSE **/
+/** if LoopZ80() has requested INT_QUIT.                    **/
 /*************************************************************/
-word Z80Run (Z80 *R)
+static BOOLEAN Z80Events (Z80 *R)
 	{
-	byte I;
 	pair J;
-	unsigned int uStep;
 
-	while (1)
+	/* If cycle counter expired... */    
+	if ( R->ICount <= 0 )
 		{
-		/* Save current count */
-		R->ICntLast = R->ICount;
-
-		/* Execute Instruction */
-#ifdef Z80_DEBUG
-		/* Turn tracing on when reached trap address */
-		if ( R->PC.W == R->Trap ) R->Trace = 1;
-		/* Call single-step debugger, exit if requested */
-		if ( R->Trace )
-			if ( ! DebugZ80 (R) ) return (R->PC.W);
-#endif
-
-		I=RdZ80(R->PC.W++);
-		ELAPSE(Cycles[I]);
-		switch(I)
-			{
-#include "Codes.h"
-			case PFX_CB: CodesCB(R);break;
-			case PFX_ED: CodesED(R);break;
-			case PFX_FD: CodesFD(R);break;
-			case PFX_DD: CodesDD(R);break;
-			}
- 
-		/* If cycle counter expired... */    
-		if ( R->ICount <= 0 )
-			{
             // diag_message (DIAG_INIT, "Calling LoopZ80");
-			J.W = LoopZ80(R);        /* Call periodic handler    */
+		F_SYNC;                  /* LoopZ80 may look at F    */
+		J.W = LoopZ80(R);        /* Call periodic handler    */
+		FETCH_FLUSH;             /* It may change the map    */
             if ( J.W != INT_NONE ) diag_message (DIAG_Z80_INTERRUPTS, "LoopZ80 = %04X", J.W);
             // J.W = INT_QUIT;
             R->ICntLast += R->IPeriod - R->ICount;
-			R->ICount = R->IPeriod;  /* Reset the cycle counter  */
-			if ( J.W == INT_QUIT ) break; /* Exit if INT_QUIT */
-			else if ( J.W == INT_NMI ) R->IntCont |= ICF_NMI;
-			if ( J.W != INT_NONE )
-				{
-				R->IRequest = J.W;
-				R->IntCont |= ICF_LOOP;
-				}
+		R->ICount = R->IPeriod;  /* Reset the cycle counter  */
+		if ( J.W == INT_QUIT ) return FALSE; /* Exit if INT_QUIT */
+		else if ( J.W == INT_NMI ) R->IntCont |= ICF_NMI;
+		if ( J.W != INT_NONE )
+			{
+			R->IRequest = J.W;
+			R->IntCont |= ICF_LOOP;
 			}
+		}
 
-		/* Interrupt processing */
-		if ( R->IntCont & ICF_NMI )
-			{
+	/* Interrupt processing */
+	if ( R->IntCont & ICF_NMI )
+		{
             diag_message (DIAG_Z80_INTERRUPTS, "Execute NMI");
-			/* Clear interrupt request */
-			R->IntCont &= ~ ICF_NMI;
-			/* Exit Halt state */
-			if ( R->IFF & IFF_HALT )
-				{
-				R->PC.W++;
-				R->IFF &= ~ IFF_HALT;
-				}
-			/* Save program counter */
-			M_PUSH(PC);
-			/* Disable interrupts and save previous state */
-			R->IFF = ( R->IFF & ( ~ ( IFF_IEN | IFF_IEN2 ) ) ) | ( ( R->IFF & IFF_IEN ) << 6 );
-			/* Jump to interrupt routine */
-			R->PC.W = INT_NMI;
-			/* Assume same number of cycles as a RST */
-			ELAPSE(Cycles[RST00]);
+		/* Clear interrupt request */
+		R->IntCont &= ~ ICF_NMI;
+		/* Exit Halt state */
+		if ( R->IFF & IFF_HALT )
+			{
+			R->PC.W++;
+			R->IFF &= ~ IFF_HALT;
 			}
-		else if ( R->IFF & IFF_IEN )
+		/* Save program counter */
+		M_PUSH(PC);
+		/* Disable interrupts and save previous state */
+		R->IFF = ( R->IFF & ( ~ ( IFF_IEN | IFF_IEN2 ) ) ) | ( ( R->IFF & IFF_IEN ) << 6 );
+		/* Jump to interrupt routine */
+		R->PC.W = INT_NMI;
+		/* Assume same number of cycles as a RST */
+		ELAPSE(Cycles[RST00]);
+		}
+	else if ( R->IFF & IFF_IEN )
+		{
+		if ( R->IntCont & ( ICF_INT | ICF_LOOP ) )
 			{
-			if ( R->IntCont & ( ICF_INT | ICF_LOOP ) )
-				{
                 diag_message (DIAG_Z80_INTERRUPTS, "IntCont = 0x%02X", R->IntCont);
-				/* Clear interrupt request and acknowledge interrupt */
-				word Vector;
-				BOOLEAN bInt = FALSE;
-				if ( R->IntCont & ICF_INT )
-					{
-					R->IntCont &= ~ ICF_INT;
-					bInt = Z80IntAck (R, &Vector);
+			/* Clear interrupt request and acknowledge interrupt */
+			word Vector;
+			BOOLEAN bInt = FALSE;
+			if ( R->IntCont & ICF_INT )
+				{
+				R->IntCont &= ~ ICF_INT;
+				bInt = Z80IntAck (R, &Vector);
+				FETCH_FLUSH;
                     if ( bInt ) diag_message (DIAG_Z80_INTERRUPTS, "External vector = 0x%02X", Vector);
-					}
-				else
-					{
-					R->IntCont &= ~ ICF_LOOP;
-					Vector = R->IRequest;
-					bInt = Vector < INT_QUIT;
+				}
+			else
+				{
+				R->IntCont &= ~ ICF_LOOP;
+				Vector = R->IRequest;
+				bInt = Vector < INT_QUIT;
                     if ( bInt ) diag_message (DIAG_Z80_INTERRUPTS, "Loop vector = 0x%02X", Vector);
                     else diag_message (DIAG_Z80_INTERRUPTS, "Quit request");
-					}
-				/* Switch to interrupt service routine */
-				if ( bInt )
-				    {
+				}
+			/* Switch to interrupt service routine */
+			if ( bInt )
+			    {
                     /* Exit Halt state */
                     if ( R->IFF & IFF_HALT )
                         {
@@ -743,19 +958,190 @@ word Z80Run (Z80 *R)
                         }
                     /* Assume same number of cycles as a RST for the branch */
                     ELAPSE(Cycles[RST00]);
-				    }
-				}
-			}			
+			    }
+			}
+		}			
 
-		/* Enable interrupts for the instruction following EI */
-		if ( R->IFF & IFF_IENX )
+	/* Enable interrupts for the instruction following EI */
+	if ( R->IFF & IFF_IENX )
+		{
+		R->IFF = ( R->IFF & ( ~ IFF_IENX ) ) | IFF_IEN;
+		}
+
+	return TRUE;
+	}
+
+#define Z80_EVENTS(R) \
+	( ( (R)->ICount <= 0 ) || (R)->IntCont || ( (R)->IFF & IFF_IENX ) )
+
+/* Only update the hardware when it has asked to be, passing all the
+   clock cycles since it was last updated */
+#define Z80_STEP(R) \
+	do { \
+		if ( (R)->IElapsed >= (R)->IStepNext ) \
+			{ \
+			Z80Step (R, (unsigned int) ( (R)->IElapsed - (R)->IStepLast )); \
+			(R)->IStepLast = (R)->IElapsed; \
+			FETCH_FLUSH; \
+			} \
+	} while (0)
+
+#ifdef Z80_THREADED
+/** Threaded dispatch ****************************************/
+/** When Z80_THREADED is defined (GCC or Clang only) the    **/
+/** main opcode table is dispatched by computed goto. Each  **/
+/** opcode handler is built from Codes.h and ends with its  **/
+/** own fetch and dispatch of the next opcode, giving the   **/
+/** host branch predictor one indirect jump per opcode      **/
+/** rather than one for the whole switch. Behaviour and     **/
+/** timing are identical to the switch version.             **/
+/*************************************************************/
+#ifndef __GNUC__
+#error Z80_THREADED requires computed goto support
+#endif
+
+#define Z80_OPLBL_(Hi,Lo) Op_##Hi##_##Lo
+#define Z80_OPLBL(Hi,Lo)  Z80_OPLBL_(Hi,Lo)
+#define Z80_OPROW(Hi) \
+	&&Op_##Hi##_0, &&Op_##Hi##_1, &&Op_##Hi##_2, &&Op_##Hi##_3,   \
+	&&Op_##Hi##_4, &&Op_##Hi##_5, &&Op_##Hi##_6, &&Op_##Hi##_7,   \
+	&&Op_##Hi##_8, &&Op_##Hi##_9, &&Op_##Hi##_10,&&Op_##Hi##_11,  \
+	&&Op_##Hi##_12,&&Op_##Hi##_13,&&Op_##Hi##_14,&&Op_##Hi##_15
+
+#ifdef Z80_DEBUG
+#define Z80_TRACE \
+	do { \
+		if ( R->PC.W == R->Trap ) R->Trace = 1; \
+		if ( R->Trace ) \
+			{ \
+			if ( ! DebugZ80 (R) ) return (R->PC.W); \
+			FETCH_FLUSH; \
+			} \
+	} while (0)
+#else
+#define Z80_TRACE do { } while (0)
+#endif
+
+#define Z80_NEXT \
+	do { \
+		if ( Z80_EVENTS(R) ) \
+			if ( ! Z80Events (R) ) return (R->PC.W); \
+		Z80_STEP(R); \
+		R->ICntLast = R->ICount; \
+		Z80_TRACE; \
+		I=OpZ80(R->PC.W++); \
+		ELAPSE(Cycles[I]); \
+		M1WAIT; \
+		goto *OpLabels[I]; \
+	} while (0)
+#endif
+
+/** Z80Run() *************************************************/
+/** Equivalent of the RunZ80 routine, but implementing      **/
+/** cycle accurate interrupts                               **/
+/*************************************************************/
+word Z80Run (Z80 *R)
+	{
+	byte I;
+	pair J;
+#ifdef Z80_THREADED
+	static const void * const OpLabels[256] =
+		{
+		Z80_OPROW(0), Z80_OPROW(1), Z80_OPROW(2), Z80_OPROW(3),
+		Z80_OPROW(4), Z80_OPROW(5), Z80_OPROW(6), Z80_OPROW(7),
+		Z80_OPROW(8), Z80_OPROW(9), Z80_OPROW(10),Z80_OPROW(11),
+		Z80_OPROW(12),Z80_OPROW(13),Z80_OPROW(14),Z80_OPROW(15)
+		};
+#endif
+
+	FETCH_FLUSH;
+	while (1)
+		{
+		/* Save current count */
+		R->ICntLast = R->ICount;
+
+		/* Execute Instruction */
+#ifdef Z80_DEBUG
+		/* Turn tracing on when reached trap address */
+		if ( R->PC.W == R->Trap ) R->Trace = 1;
+		/* Call single-step debugger, exit if requested */
+		if ( R->Trace )
 			{
-			R->IFF = ( R->IFF & ( ~ IFF_IENX ) ) | IFF_IEN;
+			if ( ! DebugZ80 (R) ) return (R->PC.W);
+			FETCH_FLUSH;
 			}
+#endif
+
+		I=OpZ80(R->PC.W++);
+		ELAPSE(Cycles[I]);
+		M1WAIT;
+#ifdef Z80_THREADED
+		goto *OpLabels[I];
+#define Z80_OP_HI 0
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 1
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 2
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 3
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 4
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 5
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 6
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 7
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 8
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 9
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 10
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 11
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 12
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 13
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 14
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#define Z80_OP_HI 15
+#include "CodesRow.h"
+#undef Z80_OP_HI
+#else
+		switch(I)
+			{
+#include "Codes.h"
+			case PFX_CB: CodesCB(R);break;
+			case PFX_ED: CodesED(R);break;
+			case PFX_FD: CodesFD(R);break;
+			case PFX_DD: CodesDD(R);break;
+			}
+#endif
+
+		/* Cycle counter expiry and interrupt processing */
+		if ( Z80_EVENTS(R) )
+			if ( ! Z80Events (R) ) break;
 
-		/* Update clock, ICount counts downwards */
-		uStep = R->ICntLast - R->ICount;
-		Z80Step (R, uStep);
+		/* Update clock */
+		Z80_STEP(R);
 		}
 
 	/* Execution stopped */
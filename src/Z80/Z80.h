@@ -103,6 +103,19 @@ typedef union
   word W;
 } pair;
 
+/** Z80Waits *************************************************/
+/** Wait states added to the cycle tables by Z80RunWait().  **/
+/** M1 is charged on each opcode fetch (twice for prefixed  **/
+/** opcodes), Mem[] on each memory access by 8K page, and   **/
+/** IO[] on each I/O access by the low byte of the port.    **/
+/*************************************************************/
+typedef struct
+{
+  byte M1;            /* Extra cycles per M1 cycle           */
+  byte Mem[8];        /* Extra cycles per access, by page    */
+  byte IO[256];       /* Extra cycles per access, by port    */
+} Z80Waits;
+
 typedef struct
 {
   pair AF,BC,DE,HL,IX,IY,PC,SP;       /* Main registers      */
@@ -119,11 +132,25 @@ typedef struct
   word Trap;          /* Set Trap to address to trace from   */
   byte Trace;         /* Set Trace=1 to start tracing        */
   byte IntCont;       /* Interrupt control flags             */
+  Z80Waits *Waits;    /* Only used by Z80RunWait()           */
 #ifdef SUPPORT_ELAPSED
   unsigned long long IElapsed;
+  unsigned long long IStepLast; /* IElapsed at last Z80Step()   */
+  unsigned long long IStepNext; /* Z80Step() due at this time   */
+#endif
+#ifdef Z80_FETCH_CACHE
+  const byte *FetchBase; /* mem_read[] page of the last fetch */
+  int FetchPage;         /* Its number, or Z80_NO_PAGE         */
+#endif
+#ifdef Z80_LAZY_FLAGS
+  byte FlagOp;        /* Last ALU operation, 0 if F is valid */
+  byte FlagA,FlagB;   /* Its operands                        */
+  word FlagR;         /* Its result, carry out in bit 8      */
 #endif
 } Z80;
 
+#define Z80_NO_PAGE -1
+
 #ifdef SUPPORT_ELAPSED
 #define	ELAPSE(t) do { R->ICount-=(t); R->IElapsed+=(t); }while(0)
 #else
@@ -143,6 +170,17 @@ void ResetZ80( Z80 *R);
 /*************************************************************/
 word ExecZ80( Z80 *R);
 
+/** FlagsZ80() ***********************************************/
+/** With Z80_LAZY_FLAGS, the F register is only worked out  **/
+/** when an instruction needs it. Call this before reading  **/
+/** or changing F (or AF) from outside the emulation.       **/
+/*************************************************************/
+#ifdef Z80_LAZY_FLAGS
+void FlagsZ80( Z80 *R);
+#else
+#define FlagsZ80(R)
+#endif
+
 /** IntZ80() *************************************************/
 /** This function will generate interrupt of given vector.  **/
 /*************************************************************/
@@ -160,6 +198,7 @@ word RunZ80( Z80 *R);
 /** They allow to control memory access.                    **/
 /************************************ TO BE WRITTEN BY USER **/
 /* @@@AK, removed inlines */
+/* The core now uses the inline versions in mem.h where it can */
 void WrZ80( word Addr, byte Value);
 byte RdZ80( word Addr);
 
@@ -225,8 +264,10 @@ void Z80Int (Z80 *R);
 BOOLEAN Z80IntAck (Z80 *R, word *pvec);
 
 /** Z80Step() ************************************************/
-/** Called at the end of every Z80 instruction to update    **/
-/** hardware emulation.                                     **/
+/** Called at the end of a Z80 instruction to update        **/
+/** hardware emulation, once IElapsed has reached IStepNext.**/
+/** Set IStepNext to the time of the next hardware event;   **/
+/** leaving it at 0 gives a call after every instruction.   **/
 /** Second parameter is the number of clock cycles since    **/
 /** the previous call.                                      **/
 /************************************ TO BE WRITTEN BY USER **/
@@ -239,3 +280,10 @@ void Z80Step (Z80 *R, unsigned int uStep);
 /** latency is acceptable.                                  **/
 /*************************************************************/
 word Z80Run (Z80 *R);
+
+/** Z80RunWait() *********************************************/
+/** As Z80Run(), but also charging the wait states given by **/
+/** R->Waits. This is a second copy of the emulation, built **/
+/** from Z80Wait.c, so that Z80Run() pays nothing for it.   **/
+/*************************************************************/
+word Z80RunWait (Z80 *R);
@@ -0,0 +1,10 @@
+/** Z80: portable Z80 emulator *******************************/
+/**                                                         **/
+/**                         Z80Wait.c                       **/
+/**                                                         **/
+/** Z80.c again, charging wait states, to give Z80RunWait() **/
+/** (see Z80Waits in Z80.h).                                **/
+/*************************************************************/
+
+#define Z80_WAITS
+#include "Z80.c"
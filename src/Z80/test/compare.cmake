@@ -0,0 +1,27 @@
+cmake_minimum_required(VERSION 3.12)
+
+# Runs REF and EXE with the same ARGS, failing if the output differs.
+# Reports the first line which differs.
+execute_process(COMMAND ${REF} ${ARGS} OUTPUT_VARIABLE ref RESULT_VARIABLE ref_rc)
+execute_process(COMMAND ${EXE} ${ARGS} OUTPUT_VARIABLE out RESULT_VARIABLE out_rc)
+if(NOT ref_rc EQUAL 0 OR NOT out_rc EQUAL 0)
+  message(FATAL_ERROR "${REF} gave ${ref_rc}, ${EXE} gave ${out_rc}")
+endif()
+if(ref STREQUAL "")
+  message(FATAL_ERROR "${REF} gave no output")
+endif()
+if(NOT out STREQUAL ref)
+  string(REPLACE "\n" ";" ref_lines "${ref}")
+  string(REPLACE "\n" ";" out_lines "${out}")
+  foreach(ref_line ${ref_lines})
+    if(NOT out_lines)
+      message(FATAL_ERROR "expected: ${ref_line}\ngot: end of output")
+    endif()
+    list(GET out_lines 0 out_line)
+    list(REMOVE_AT out_lines 0)
+    if(NOT out_line STREQUAL ref_line)
+      message(FATAL_ERROR "expected: ${ref_line}\ngot: ${out_line}")
+    endif()
+  endforeach()
+  message(FATAL_ERROR "output differs")
+endif()
@@ -0,0 +1,559 @@
+/*
+
+z80test.c - Differential test and benchmark of the Z80 core build options
+
+The core is built once per combination of options (see CMakeLists.txt),
+each time with this harness in place of the rest of MEMU. Every mode
+prints one line per case, giving a hash of everything the core did, so
+each build can be compared with the plain switch build:
+
+  z80test random n       runs n random memory images, with interrupts,
+                         NMIs, irregular Z80Step scheduling, a ROM page
+                         written through WrZ80, and changes to the map
+  z80test zbench file    runs a CP/M .COM file (ZBENCH.COM) to its end
+  z80test flags          runs each ALU, rotate and shift instruction once
+                         for every operand and carry, giving a hash of the
+                         results and of F as given by FlagsZ80
+  z80test bench file n   runs the .COM file n times, reporting the speed
+
+The hashes cover the registers at every LoopZ80 and Z80Step call, the
+T-states, every I/O access and WrZ80 call, the BDOS output, and the final
+memory and dirty bits.
+
+*/
+
+/*...sincludes:0:*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Z80.h"
+#include "mem.h"
+#include "diag.h"
+/*...e*/
+
+/*...svars:0:*/
+#define	MODE_RANDOM  0
+#define	MODE_CPM     1
+#define	MODE_FLAGS   2
+
+static int mode;
+static byte ram[0x10000];
+static byte rom[2][0x2000];
+static byte dirty[8];
+static int rom_page;
+static int rom_sel;
+static BOOLEAN swapped;
+static unsigned long long hash;
+static unsigned long long rnd;
+static unsigned int n_loops;
+static unsigned int max_loops;
+static BOOLEAN cpm_done;
+#define	L_OUTPUT 200
+static char cpm_output[L_OUTPUT+1];
+static int n_output;
+
+THREAD_LOCAL const byte *mem_read[8];
+THREAD_LOCAL byte *mem_z80_write[8];
+THREAD_LOCAL byte *mem_z80_dirty[8];
+/*...e*/
+
+/*...shash_byte:0:*/
+/* FNV-1a */
+static void hash_byte(byte b)
+	{
+	hash = ( hash ^ b ) * 0x100000001b3ULL;
+	}
+
+static void hash_word(unsigned long long w, int n)
+	{
+	while ( n-- > 0 )
+		{
+		hash_byte((byte) w);
+		w >>= 8;
+		}
+	}
+/*...e*/
+/*...shash_regs:0:*/
+static void hash_regs(Z80 *R)
+	{
+	FlagsZ80(R);
+	hash_word(R->AF.W, 2);
+	hash_word(R->BC.W, 2);
+	hash_word(R->DE.W, 2);
+	hash_word(R->HL.W, 2);
+	hash_word(R->IX.W, 2);
+	hash_word(R->IY.W, 2);
+	hash_word(R->PC.W, 2);
+	hash_word(R->SP.W, 2);
+	hash_word(R->AF1.W, 2);
+	hash_word(R->BC1.W, 2);
+	hash_word(R->DE1.W, 2);
+	hash_word(R->HL1.W, 2);
+	hash_byte(R->IFF);
+	hash_byte(R->I);
+	hash_byte(R->IntCont);
+	hash_word((unsigned int) R->ICount, 4);
+	hash_word(R->IElapsed, 8);
+	}
+/*...e*/
+/*...snext_rnd:0:*/
+/* xorshift64, so every host gives the same images */
+static unsigned int next_rnd(void)
+	{
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 7;
+	rnd ^= rnd << 17;
+	return (unsigned int) ( rnd >> 32 );
+	}
+/*...e*/
+
+/*...sMEMU interface:0:*/
+/*...smap_pages:0:*/
+/* Fills in the page tables. Page rom_page (if not -1) reads rom[rom_sel]
+   and ignores writes, and swapped exchanges the RAM of pages 6 and 7 */
+static void map_pages(void)
+	{
+	int i;
+	for ( i = 0; i < 8; ++i )
+		{
+		int page = ( swapped && i >= 6 ) ? 13 - i : i;
+		mem_read[i] = ( i == rom_page ) ? rom[rom_sel] : &ram[page << 13];
+		mem_z80_write[i] = ( i == rom_page ) ? NULL : &ram[page << 13];
+		mem_z80_dirty[i] = &dirty[page];
+		}
+	}
+/*...e*/
+
+/* Only called for the ROM page, where, as in the MTX RELCPMH=0 mode,
+   the write selects the ROM to be read */
+void WrZ80(word addr, byte value)
+	{
+	hash_byte(0xff);
+	hash_word(addr, 2);
+	hash_byte(value);
+	rom_sel = value & 1;
+	map_pages();
+	}
+
+byte RdZ80(word addr)
+	{
+	return ram[addr];
+	}
+
+/* In the random images, port 0 changes the map, as the MTX IOBYTE does */
+void OutZ80(word port, byte value)
+	{
+	hash_word(port, 2);
+	hash_byte(value);
+	if ( mode == MODE_RANDOM && ( port & 0xff ) == 0 )
+		{
+		swapped = value & 1;
+		map_pages();
+		}
+	}
+
+byte InZ80(word port)
+	{
+	hash_word(port, 2);
+	return (byte) ( port ^ ( port >> 8 ) ^ 0x5a );
+	}
+
+/* In CP/M mode, ED FE at 0000 ends the run, and at 0005 is the BDOS,
+   giving function 2 (print E) and function 9 (print the string at DE) */
+void PatchZ80(Z80 *R)
+	{
+	if ( mode != MODE_CPM )
+		return;
+	if ( R->PC.W == 0x0002 )
+		cpm_done = TRUE;
+	else if ( R->PC.W == 0x0007 )
+		{
+		word addr = R->DE.W;
+		switch ( R->BC.B.l )
+			{
+			case 2:
+				if ( n_output < L_OUTPUT )
+					cpm_output[n_output++] = (char) R->DE.B.l;
+				break;
+			case 9:
+				while ( ram[addr] != '$' && n_output < L_OUTPUT )
+					cpm_output[n_output++] = (char) ram[addr++];
+				break;
+			}
+		}
+	}
+
+void RetiZ80(Z80 *R)
+	{
+	hash_byte(0xed);
+	hash_word(R->PC.W, 2);
+	}
+
+word LoopZ80(Z80 *R)
+	{
+	if ( mode == MODE_FLAGS )
+		return INT_QUIT;
+	hash_regs(R);
+	if ( mode == MODE_CPM )
+		return cpm_done ? INT_QUIT : INT_NONE;
+	if ( ++n_loops >= max_loops )
+		return INT_QUIT;
+	/* As loading a saved state would */
+	if ( n_loops % 11 == 0 )
+		{
+		swapped = !swapped;
+		map_pages();
+		}
+	if ( n_loops % 13 == 0 )
+		return INT_NMI;
+	if ( n_loops % 7 == 0 )
+		Z80Int(R);
+	if ( n_loops % 5 == 0 )
+		return INT_IRQ;
+	return INT_NONE;
+	}
+
+BOOLEAN Z80IntAck(Z80 *R, word *pvec)
+	{
+	*pvec = 0xe7;
+	return TRUE;
+	}
+
+/* Asks for the next call after an irregular number of T-states */
+void Z80Step(Z80 *R, unsigned int uStep)
+	{
+	hash_word(uStep, 4);
+	hash_regs(R);
+	R->IStepNext = R->IElapsed + 1 + next_rnd() % 400;
+	}
+
+void diag_message(unsigned int flag, const char *fmt, ...)
+	{
+	}
+/*...e*/
+
+/*...sinit_z80:0:*/
+/* All pages are RAM, except page, unless that is -1 */
+static void init_z80(Z80 *R, int period, int page)
+	{
+	rom_page = page;
+	rom_sel = 0;
+	swapped = FALSE;
+	memset(dirty, 0, sizeof(dirty));
+	map_pages();
+	memset(R, 0, sizeof(*R));
+	R->IPeriod = period;
+	ResetZ80(R);
+	R->IElapsed = 0;
+	R->IStepLast = 0;
+	n_loops = 0;
+	}
+/*...e*/
+/*...srun_random:0:*/
+static void run_random(int n)
+	{
+	Z80 z, *R = &z;
+	int seed, i;
+	for ( seed = 1; seed <= n; ++seed )
+		{
+		rnd = 0x9e3779b97f4a7c15ULL * seed;
+		for ( i = 0; i < 0x10000; ++i )
+			ram[i] = (byte) next_rnd();
+		for ( i = 0; i < 0x2000; ++i )
+			{
+			rom[0][i] = (byte) next_rnd();
+			rom[1][i] = (byte) next_rnd();
+			}
+		init_z80(R, 500 + next_rnd() % 2000, seed % 9 - 1);
+		R->AF.W = (word) next_rnd();
+		R->BC.W = (word) next_rnd();
+		R->DE.W = (word) next_rnd();
+		R->HL.W = (word) next_rnd();
+		R->IX.W = (word) next_rnd();
+		R->IY.W = (word) next_rnd();
+		R->SP.W = (word) next_rnd();
+		R->PC.W = (word) next_rnd();
+		R->I = (byte) next_rnd();
+		R->IFF = (byte) ( next_rnd() & ( IFF_IEN | IFF_IMODE ) );
+		R->IStepNext = next_rnd() % 400;
+		max_loops = 300;
+		hash = 0xcbf29ce484222325ULL;
+		Z80Run(R);
+		hash_regs(R);
+		for ( i = 0; i < 0x10000; ++i )
+			hash_byte(ram[i]);
+		for ( i = 0; i < 8; ++i )
+			hash_byte(dirty[i]);
+		hash_byte(rom_sel);
+		hash_byte(swapped);
+		printf("random %d %016llx\n", seed, hash);
+		}
+	}
+/*...e*/
+/*...srun_cpm:0:*/
+static BOOLEAN load_com(const char *fn)
+	{
+	FILE *fp;
+	memset(ram, 0, sizeof(ram));
+	if ( (fp = fopen(fn, "rb")) == NULL )
+		{
+		fprintf(stderr, "z80test: can't open %s\n", fn);
+		return FALSE;
+		}
+	fread(&ram[0x0100], 1, 0xfe00, fp);
+	fclose(fp);
+	/* Warm boot and BDOS entry */
+	ram[0x0000] = 0xed; ram[0x0001] = 0xfe; ram[0x0002] = 0x76;
+	ram[0x0005] = 0xed; ram[0x0006] = 0xfe; ram[0x0007] = 0xc9;
+	return TRUE;
+	}
+
+/* Returns the T-states taken. Without steps, Z80Step is never called */
+static unsigned long long run_cpm(Z80 *R, BOOLEAN steps)
+	{
+	init_z80(R, 10000, -1);
+	R->PC.W = 0x0100;
+	R->SP.W = 0xfe00;
+	rnd = 1;
+	R->IStepNext = steps ? 0 : ~0ULL;
+	cpm_done = FALSE;
+	n_output = 0;
+	hash = 0xcbf29ce484222325ULL;
+	Z80Run(R);
+	return R->IElapsed;
+	}
+/*...e*/
+/*...srun_flags:0:*/
+#define	OPND_NONE    0	/* Only A and F, which takes every value */
+#define	OPND_REG     1	/* B, C, D, E, H and L */
+#define	OPND_HL      2	/* (HL) */
+#define	OPND_IMM     3	/* Immediate */
+#define	OPND_IX      4	/* IXh and IXl */
+#define	OPND_IXD     5	/* (IX+d) */
+#define	OPND_WORD    6	/* HL and BC, DE or SP */
+
+#define	OPND_ADDR    0x8000
+
+typedef struct
+	{
+	byte code[4];
+	int len;
+	int opnd;
+	} FLAGS_OP;
+
+#define	MAX_FLAGS_OPS 400
+static FLAGS_OP flags_ops[MAX_FLAGS_OPS];
+static int n_flags_ops;
+
+static void add_flags_op(int opnd, int len, byte b0, byte b1, byte b2, byte b3)
+	{
+	FLAGS_OP *op = &flags_ops[n_flags_ops++];
+	op->code[0] = b0;
+	op->code[1] = b1;
+	op->code[2] = b2;
+	op->code[3] = b3;
+	op->len = len;
+	op->opnd = opnd;
+	}
+
+/* The operand of an instruction with register field r */
+static int reg_opnd(int r)
+	{
+	return ( r == 6 ) ? OPND_HL : OPND_REG;
+	}
+
+static void make_flags_ops(void)
+	{
+	static const byte a_ops[] = { 0x07, 0x0f, 0x17, 0x1f, 0x27, 0x2f, 0x37, 0x3f };
+	int i;
+	n_flags_ops = 0;
+	/* ADD, ADC, SUB, SBC, AND, XOR, OR and CP */
+	for ( i = 0x80; i < 0xc0; ++i )
+		add_flags_op(reg_opnd(i & 7), 1, i, 0, 0, 0);
+	for ( i = 0xc6; i < 0x100; i += 8 )
+		add_flags_op(OPND_IMM, 1, i, 0, 0, 0);
+	for ( i = 0; i < 8; ++i )
+		{
+		add_flags_op(OPND_IX, 2, 0xdd, 0x84 | ( i << 3 ), 0, 0);
+		add_flags_op(OPND_IX, 2, 0xdd, 0x85 | ( i << 3 ), 0, 0);
+		add_flags_op(OPND_IXD, 2, 0xdd, 0x86 | ( i << 3 ), 0, 0);
+		}
+	/* INC and DEC */
+	for ( i = 0; i < 8; ++i )
+		{
+		add_flags_op(reg_opnd(i), 1, 0x04 | ( i << 3 ), 0, 0, 0);
+		add_flags_op(reg_opnd(i), 1, 0x05 | ( i << 3 ), 0, 0, 0);
+		}
+	add_flags_op(OPND_IX, 2, 0xdd, 0x24, 0, 0);
+	add_flags_op(OPND_IX, 2, 0xdd, 0x25, 0, 0);
+	add_flags_op(OPND_IX, 2, 0xdd, 0x2c, 0, 0);
+	add_flags_op(OPND_IX, 2, 0xdd, 0x2d, 0, 0);
+	add_flags_op(OPND_IXD, 2, 0xdd, 0x34, 0, 0);
+	add_flags_op(OPND_IXD, 2, 0xdd, 0x35, 0, 0);
+	/* RLCA, RRCA, RLA, RRA, DAA, CPL, SCF, CCF and NEG */
+	for ( i = 0; i < sizeof(a_ops); ++i )
+		add_flags_op(OPND_NONE, 1, a_ops[i], 0, 0, 0);
+	add_flags_op(OPND_NONE, 2, 0xed, 0x44, 0, 0);
+	/* 16 bit ADD, ADC and SBC */
+	for ( i = 0; i < 4; ++i )
+		{
+		add_flags_op(OPND_WORD, 1, 0x09 | ( i << 4 ), 0, 0, 0);
+		add_flags_op(OPND_WORD, 2, 0xed, 0x4a | ( i << 4 ), 0, 0);
+		add_flags_op(OPND_WORD, 2, 0xed, 0x42 | ( i << 4 ), 0, 0);
+		}
+	/* CB rotates, shifts and BIT */
+	for ( i = 0; i < 0x80; ++i )
+		add_flags_op(reg_opnd(i & 7), 2, 0xcb, i, 0, 0);
+	for ( i = 0x06; i < 0x80; i += 8 )
+		add_flags_op(OPND_IXD, 4, 0xdd, 0xcb, 0, i);
+	}
+
+static void run_flags(void)
+	{
+	Z80 z, *R = &z;
+	int i, a, b, f, n_b, n_f;
+	memset(ram, 0, sizeof(ram));
+	init_z80(R, 10000, -1);
+	R->IStepNext = ~0ULL;
+	make_flags_ops();
+	for ( i = 0; i < n_flags_ops; ++i )
+		{
+		const FLAGS_OP *op = &flags_ops[i];
+		word code = 0x0100;
+		memcpy(&ram[code], op->code, op->len);
+		/* (IX+d) has d after the opcode, or before it after CB */
+		if ( op->opnd == OPND_IXD )
+			ram[code + 2] = 0x10;
+		n_b = ( op->opnd == OPND_NONE ) ? 1 : 256;
+		n_f = ( op->opnd == OPND_NONE ) ? 256 : 2;
+		hash = 0xcbf29ce484222325ULL;
+		for ( a = 0; a < 256; ++a )
+			for ( b = 0; b < n_b; ++b )
+				for ( f = 0; f < n_f; ++f )
+					{
+					R->AF.B.h = a;
+					/* Without a full range, carry clear and set */
+					R->AF.B.l = ( n_f == 256 ) ? f : ( f ? 0xff : 0x00 );
+					R->BC.B.h = R->BC.B.l = b;
+					R->DE.B.h = R->DE.B.l = b;
+					R->HL.B.h = R->HL.B.l = b;
+					R->IX.B.h = R->IX.B.l = b;
+					R->SP.W = 0xf000;
+					switch ( op->opnd )
+						{
+						case OPND_HL:
+							R->HL.W = OPND_ADDR;
+							ram[OPND_ADDR] = b;
+							break;
+						case OPND_IMM:
+							ram[code + op->len] = b;
+							break;
+						case OPND_IXD:
+							R->IX.W = OPND_ADDR - 0x10;
+							ram[OPND_ADDR] = b;
+							break;
+						case OPND_WORD:
+							R->HL.W = ( a << 8 ) | b;
+							R->BC.W = ( b << 8 ) | a;
+							R->DE.W = R->BC.W ^ 0xffff;
+							R->SP.W = R->HL.W ^ 0x00ff;
+							break;
+						}
+					R->PC.W = code;
+					R->ICount = 1;
+#ifdef Z80_LAZY_FLAGS
+					R->FlagOp = 0;
+#endif
+					Z80Run(R);
+					FlagsZ80(R);
+					hash_word(R->AF.W, 2);
+					hash_word(R->BC.W, 2);
+					hash_word(R->DE.W, 2);
+					hash_word(R->HL.W, 2);
+					hash_word(R->IX.W, 2);
+					hash_word(R->SP.W, 2);
+					hash_byte(ram[OPND_ADDR]);
+					}
+		printf("flags %02x", op->code[0]);
+		for ( a = 1; a < op->len; ++a )
+			printf("%02x", op->code[a]);
+		printf(" %016llx\n", hash);
+		}
+	}
+/*...e*/
+/*...sbench_cpm:0:*/
+static double wall_secs(void)
+	{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+	}
+
+static void bench_cpm(const char *fn, int n)
+	{
+	Z80 z;
+	unsigned long long clocks = 0;
+	double start = wall_secs();
+	int i;
+	for ( i = 0; i < n; ++i )
+		{
+		load_com(fn);
+		clocks += run_cpm(&z, FALSE);
+		}
+	start = wall_secs() - start;
+	printf("%s: %llu T-states in %.3f s, %.2f MHz\n",
+		Z80_TEST_CORE, clocks, start, clocks / start / 1e6);
+	}
+/*...e*/
+
+/*...smain:0:*/
+static void usage(void)
+	{
+	fprintf(stderr, "usage: z80test random n\n");
+	fprintf(stderr, "       z80test zbench file\n");
+	fprintf(stderr, "       z80test flags\n");
+	fprintf(stderr, "       z80test bench file n\n");
+	exit(1);
+	}
+
+int main(int argc, const char *argv[])
+	{
+	if ( argc == 3 && !strcmp(argv[1], "random") )
+		{
+		mode = MODE_RANDOM;
+		run_random(atoi(argv[2]));
+		}
+	else if ( argc == 3 && !strcmp(argv[1], "zbench") )
+		{
+		Z80 z;
+		unsigned long long clocks;
+		int i;
+		mode = MODE_CPM;
+		if ( !load_com(argv[2]) )
+			return 1;
+		clocks = run_cpm(&z, TRUE);
+		hash_regs(&z);
+		for ( i = 0; i < 0x10000; ++i )
+			hash_byte(ram[i]);
+		cpm_output[n_output] = '\0';
+		printf("zbench %llu %016llx %s", clocks, hash, cpm_output);
+		}
+	else if ( argc == 2 && !strcmp(argv[1], "flags") )
+		{
+		mode = MODE_FLAGS;
+		run_flags();
+		}
+	else if ( argc == 4 && !strcmp(argv[1], "bench") )
+		{
+		mode = MODE_CPM;
+		if ( !load_com(argv[2]) )
+			return 1;
+		bench_cpm(argv[2], atoi(argv[3]));
+		}
+	else
+		usage();
+	return 0;
+	}
+/*...e*/
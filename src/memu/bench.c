@@ -0,0 +1,142 @@
+/*
+
+bench.c - Machine readable performance report
+
+DebugZ80 counts the Z80 instructions while bench_on, and idle_forward
+adds those in the passes of an idle loop it skips. Where the host
+allows it (Linux perf events), the host instructions executed by the
+emulation are counted too, giving the cost of each Z80 instruction.
+
+*/
+
+/*...sincludes:0:*/
+#include "ff_stdio.h"
+#include <string.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "types.h"
+#include "diag.h"
+#include "common.h"
+#include "memu.h"
+#include "bench.h"
+
+/*...vtypes\46\h:0:*/
+/*...vdiag\46\h:0:*/
+/*...vcommon\46\h:0:*/
+/*...vmemu\46\h:0:*/
+/*...vbench\46\h:0:*/
+/*...e*/
+
+/*...svars:0:*/
+THREAD_LOCAL BOOLEAN bench_on = FALSE;
+THREAD_LOCAL unsigned long long bench_instructions = 0;
+
+#ifndef SMALL_MEM
+#define	L_ARGS	500
+static THREAD_LOCAL const char *bench_fn;
+static THREAD_LOCAL char bench_args[L_ARGS+1];
+static THREAD_LOCAL long long bench_start;
+static THREAD_LOCAL unsigned long long bench_start_clocks;
+#ifdef __linux__
+static THREAD_LOCAL int bench_fd = -1;
+#endif
+#endif
+/*...e*/
+
+#ifndef SMALL_MEM
+/*...sbench_quote:0:*/
+/* Append s to bench_args, escaped as needed for a JSON string */
+static void bench_quote(const char *s)
+	{
+	size_t n = strlen(bench_args);
+	for ( ; *s != '\0' && n < L_ARGS - 1; ++s )
+		{
+		if ( *s == '"' || *s == '\\' )
+			bench_args[n++] = '\\';
+		bench_args[n++] = ( *s >= ' ' ) ? *s : ' ';
+		}
+	bench_args[n] = '\0';
+	}
+/*...e*/
+
+/*...sbench_init:0:*/
+/* Start timing now, describing the run by its command line */
+void bench_init(const char *fn, int argc, const char *argv[])
+	{
+	int i;
+	bench_fn = fn;
+	bench_args[0] = '\0';
+	for ( i = 1; i < argc; ++i )
+		{
+		if ( i > 1 )
+			bench_quote(" ");
+		bench_quote(argv[i]);
+		}
+#ifdef __linux__
+		{
+		struct perf_event_attr pe;
+		memset(&pe, 0, sizeof(pe));
+		pe.type = PERF_TYPE_HARDWARE;
+		pe.size = sizeof(pe);
+		pe.config = PERF_COUNT_HW_INSTRUCTIONS;
+		pe.exclude_kernel = 1;
+		pe.exclude_hv = 1;
+		bench_fd = (int) syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+		if ( bench_fd < 0 )
+			diag_message(DIAG_INIT, "bench: host instructions can't be counted");
+		}
+#endif
+	bench_instructions = 0;
+	bench_start = get_micros();
+	bench_start_clocks = get_Z80_clocks();
+	bench_on = TRUE;
+	}
+/*...e*/
+/*...sbench_term:0:*/
+/* Append the report for the run */
+void bench_term(void)
+	{
+	unsigned long long elapsed = get_Z80_clocks() - bench_start_clocks;
+	long long host = -1;
+	double wall;
+	FILE *fp;
+	if ( ! bench_on )
+		return;
+	bench_on = FALSE;
+	wall = (double) ( get_micros() - bench_start ) / 1000000.0;
+#ifdef __linux__
+	if ( bench_fd >= 0 )
+		{
+		if ( read(bench_fd, &host, sizeof(host)) != sizeof(host) )
+			host = -1;
+		close(bench_fd);
+		bench_fd = -1;
+		}
+#endif
+	if ( (fp = fopen(bench_fn, "a")) == NULL )
+		{
+		diag_message(DIAG_ALWAYS, "can't append to benchmark file %s", bench_fn);
+		return;
+		}
+	fprintf(fp, "{\"args\": \"%s\", \"wall_s\": %.3f, \"t_states\": %llu, \"z80_instructions\": %llu, \"emulated_mhz\": %.2f, \"ns_per_z80\": %.2f",
+		bench_args,
+		wall,
+		elapsed,
+		bench_instructions,
+		( wall > 0.0 ) ? (double) elapsed / wall / 1000000.0 : 0.0,
+		( bench_instructions > 0 ) ? wall * 1000000000.0 / (double) bench_instructions : 0.0);
+	if ( host >= 0 && bench_instructions > 0 )
+		fprintf(fp, ", \"host_instructions\": %lld, \"host_per_z80\": %.2f}\n",
+			host,
+			(double) host / (double) bench_instructions);
+	else
+		fprintf(fp, ", \"host_instructions\": null, \"host_per_z80\": null}\n");
+	fclose(fp);
+	}
+/*...e*/
+#endif
@@ -0,0 +1,30 @@
+/*
+
+bench.h - Machine readable performance report
+
+With -bench file, a line of JSON describing the run is appended to the
+file when MEMU terminates, to allow the speed of the emulation to be
+compared between builds.
+
+*/
+
+#ifndef BENCH_H
+#define	BENCH_H
+
+/*...sincludes:0:*/
+#include "types.h"
+
+/*...vtypes\46\h:0:*/
+/*...e*/
+
+extern THREAD_LOCAL BOOLEAN bench_on;
+extern THREAD_LOCAL unsigned long long bench_instructions;
+
+#ifdef SMALL_MEM
+#define bench_term()
+#else
+extern void bench_init(const char *fn, int argc, const char *argv[]);
+extern void bench_term(void);
+#endif
+
+#endif
@@ -26,11 +26,11 @@
 #define CTL_AMODE   0x60
 #define CTL_ACTIVE  0x80
 
-static byte data_a;
-static byte data_b;
-static byte data_c;
-static byte last_c;
-static byte ctl;
+static THREAD_LOCAL byte data_a;
+static THREAD_LOCAL byte data_b;
+static THREAD_LOCAL byte data_c;
+static THREAD_LOCAL byte last_c;
+static THREAD_LOCAL byte ctl;
 
 void cfx_out (word port, byte value)
     {
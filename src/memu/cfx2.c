@@ -48,24 +48,24 @@
 #define ERR_ABRT        0x04    // Aborted due to invalid command or other error
 #define ERR_AMNF        0x01    // Address mark not found
 
-static char *psImage[NCF_CARD * NCF_PART] =
+static THREAD_LOCAL char *psImage[NCF_CARD * NCF_PART] =
     { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
-static FILE *pfImage[NCF_CARD * NCF_PART] =
+static THREAD_LOCAL FILE *pfImage[NCF_CARD * NCF_PART] =
     { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
-static unsigned int lba = 0;
-static unsigned int part = 0;
-static unsigned int addr = 0;
-static unsigned int count = 0;
-static byte sector[LEN_SECTOR];
-static byte feature = 0;
-static byte command = 0;
-static byte status = 0;
-static byte cferr = 0;
-static byte lbatop = 0;
-static unsigned int nCFPart[NCF_CARD] = { NCF_PART, NCF_PART };
-static long long nCFSize[NCF_CARD];
-static BOOLEAN b16bit = TRUE;
-static byte hidata = 0;
+static THREAD_LOCAL unsigned int lba = 0;
+static THREAD_LOCAL unsigned int part = 0;
+static THREAD_LOCAL unsigned int addr = 0;
+static THREAD_LOCAL unsigned int count = 0;
+static THREAD_LOCAL byte sector[LEN_SECTOR];
+static THREAD_LOCAL byte feature = 0;
+static THREAD_LOCAL byte command = 0;
+static THREAD_LOCAL byte status = 0;
+static THREAD_LOCAL byte cferr = 0;
+static THREAD_LOCAL byte lbatop = 0;
+static THREAD_LOCAL unsigned int nCFPart[NCF_CARD] = { NCF_PART, NCF_PART };
+static THREAD_LOCAL long long nCFSize[NCF_CARD];
+static THREAD_LOCAL BOOLEAN b16bit = TRUE;
+static THREAD_LOCAL byte hidata = 0;
 
 const char *cfx_cmd_name (int iCmd)
     {
@@ -530,6 +530,48 @@ void cfx2_init (void)
     b16bit = TRUE;
     }
 
+#ifndef SMALL_MEM
+// The CFX-II part of a save-state (see state.c). The images come from the
+// configuration, only the position within the current partition is saved.
+void cfx2_save_state (STATE *st)
+    {
+    long pos = ( pfImage[part] != NULL ) ? ftell (pfImage[part]) : -1L;
+    state_put_int (st, lba);
+    state_put_int (st, part);
+    state_put_int (st, addr);
+    state_put_int (st, count);
+    state_put_block (st, sector, LEN_SECTOR);
+    state_put_byte (st, feature);
+    state_put_byte (st, command);
+    state_put_byte (st, status);
+    state_put_byte (st, cferr);
+    state_put_byte (st, lbatop);
+    state_put_byte (st, (byte) b16bit);
+    state_put_byte (st, hidata);
+    state_put_int (st, (unsigned int) pos);
+    }
+
+void cfx2_load_state (STATE *st, int version)
+    {
+    long pos;
+    lba = state_get_int (st);
+    part = state_get_int (st) % ( NCF_CARD * NCF_PART );
+    addr = state_get_int (st) % LEN_SECTOR;
+    count = state_get_int (st);
+    state_get_block (st, sector, LEN_SECTOR);
+    feature = state_get_byte (st);
+    command = state_get_byte (st);
+    status = state_get_byte (st);
+    cferr = state_get_byte (st);
+    lbatop = state_get_byte (st);
+    b16bit = state_get_byte (st);
+    hidata = state_get_byte (st);
+    pos = (int) state_get_int (st);
+    if ( pfImage[part] != NULL && pos >= 0 )
+        fseek (pfImage[part], pos, SEEK_SET);
+    }
+#endif
+
 void cfx2_term (void)
     {
     for ( part = 0; part < NCF_CARD * NCF_PART; ++part )
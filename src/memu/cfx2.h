@@ -16,6 +16,10 @@
 #define CARD_BITS       1                   // Number of bits in card selection
 #define NCF_CARD        ( 1 << CARD_BITS )  // Two cards (primary and secondary)
 
+#ifndef SMALL_MEM
+#include "state.h"
+#endif
+
 #ifdef __cplusplus
 extern "C"
     {
@@ -29,6 +33,10 @@ extern "C"
     byte cfx2_in (word port);
     void cfx2_init (void);
     void cfx2_term (void);
+#ifndef SMALL_MEM
+    void cfx2_save_state (STATE *st);
+    void cfx2_load_state (STATE *st, int version);
+#endif
 
 #ifdef __cplusplus
     }
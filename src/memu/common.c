@@ -38,6 +38,8 @@
 #include "sdxfdc.h"
 #include "tape.h"
 #include "printer.h"
+#include "trace.h"
+#include "bench.h"
 #ifdef HAVE_CFX2
 #include "memu.h"
 #include "cfx2.h"
@@ -51,10 +53,15 @@
 #include "spec.h"
 #include "ui.h"
 #include "vdeb.h"
+#include "rewind.h"
+#include "replay.h"
 #endif
 #include "dirmap.h"
+#ifdef MEMU_MULTI
+#include "machine.h"
+#endif
 
-static BOOLEAN bFatal = FALSE;
+static THREAD_LOCAL BOOLEAN bFatal = FALSE;
 
 /*...vdiag\46\h:0:*/
 /*...vcommon\46\h:0:*/
@@ -69,6 +76,8 @@ static BOOLEAN bFatal = FALSE;
 /*...vsid\46\h:0:*/
 /*...vspec\46\h:0:*/
 /*...vprinter\46\h:0:*/
+/*...vtrace\46\h:0:*/
+/*...vbench\46\h:0:*/
 /*...vui\46\h:0:*/
 /*...e*/
 
@@ -81,7 +90,7 @@ extern void ALT_EXIT(int reason);
 #endif
 
 #ifdef WIN32
-static BOOLEAN fine = FALSE;
+static THREAD_LOCAL BOOLEAN fine = FALSE;
 #endif
 /*...sterminate:0:*/
 void terminate(const char *reason)
@@ -90,7 +99,15 @@ void terminate(const char *reason)
     if ( fine )
         timeEndPeriod(1);
 #endif
+    diag_message (DIAG_INIT, "bench_term");
+    bench_term();
+    diag_message (DIAG_INIT, "trace_term");
+    trace_term();
 #ifndef SMALL_MEM
+    diag_message (DIAG_INIT, "replay_term");
+    replay_term();
+    diag_message (DIAG_INIT, "rewind_term");
+    rewind_term();
     diag_message (DIAG_INIT, "vdeb_term");
     vdeb_term();
     diag_message (DIAG_INIT, "ui_term");
@@ -142,13 +159,14 @@ void terminate(const char *reason)
     diag_message (DIAG_INIT, "vid_term");
     vid_term();
     win_term();
+    mem_term();
     // diag_message (DIAG_ALWAYS, "Terminate: %s", reason);
     if ( bFatal )
         {
         fprintf (stderr, "%s\n", reason);
         // fflush (stderr);
         }
-    else
+    else if ( reason != NULL )
         {
         fprintf (stderr, "Terminate: %s\n", reason);
         }
@@ -161,6 +179,8 @@ void terminate(const char *reason)
     // diag_message (DIAG_INIT, "exit");
 #if defined(ALT_EXIT)
     ALT_EXIT(0);
+#elif defined(MEMU_MULTI)
+    machine_exit(bFatal ? 1 : 0);
 #else
     exit(0);
 #endif
@@ -181,7 +201,11 @@ void fatal(const char *fmt, ...)
         win_term ();
         fprintf(stderr, "Second error: %s\n", s+7);
         fflush (stderr);
+#ifdef MEMU_MULTI
+        machine_exit (1);
+#else
         exit (1);
+#endif
         }
     bFatal = TRUE;
     terminate (s);
@@ -124,37 +124,37 @@
 #define INIT_NFILE          20
 #define MAX_PATH            260
 
-static WIN * cfg_win    =   NULL;
-static const char *  config_fn  =   NULL;
-static const char *  disk_dir   =   NULL;
-static int     rom_enable   =   0xff;
-static BOOLEAN bCfgRedraw   =   TRUE;
-static int     iCfgOld      =   0;
-static int     iCfgCur      =   0;
-static int     iCfgSel      =   0;
-static BOOLEAN bCfgRemap    =   FALSE;
+static THREAD_LOCAL WIN * cfg_win    =   NULL;
+static THREAD_LOCAL const char *  config_fn  =   NULL;
+static THREAD_LOCAL const char *  disk_dir   =   NULL;
+static THREAD_LOCAL int     rom_enable   =   0xff;
+static THREAD_LOCAL BOOLEAN bCfgRedraw   =   TRUE;
+static THREAD_LOCAL int     iCfgOld      =   0;
+static THREAD_LOCAL int     iCfgCur      =   0;
+static THREAD_LOCAL int     iCfgSel      =   0;
+static THREAD_LOCAL BOOLEAN bCfgRemap    =   FALSE;
 // static BOOLEAN bCfgNode     =   FALSE;
-static BOOLEAN bCfgSound    =   FALSE;
-static int     iSelKbdN     =   0;
-static int     iSelTopt     =   0;
-static BOOLEAN bTapeAudio   =   FALSE;
-static BOOLEAN bTapeOver    =   FALSE;
-static const char *  psCfgTape    =   NULL;
-static const char *  psCurTape    =   NULL;
-static const char *  psTapeOut    =   NULL;
-static int     iSelDropt    =   0;
+static THREAD_LOCAL BOOLEAN bCfgSound    =   FALSE;
+static THREAD_LOCAL int     iSelKbdN     =   0;
+static THREAD_LOCAL int     iSelTopt     =   0;
+static THREAD_LOCAL BOOLEAN bTapeAudio   =   FALSE;
+static THREAD_LOCAL BOOLEAN bTapeOver    =   FALSE;
+static THREAD_LOCAL const char *  psCfgTape    =   NULL;
+static THREAD_LOCAL const char *  psCurTape    =   NULL;
+static THREAD_LOCAL const char *  psTapeOut    =   NULL;
+static THREAD_LOCAL int     iSelDropt    =   0;
 #ifdef HAVE_SID
-static int     iSidEmu      =   0;
+static THREAD_LOCAL int     iSidEmu      =   0;
 #endif
-static BOOLEAN bFstInit     =   TRUE;
-static const char *  psCfgDir[NUM_DRIVES];
-static const char *  psCfgDrive[NUM_DRIVES];
+static THREAD_LOCAL BOOLEAN bFstInit     =   TRUE;
+static THREAD_LOCAL const char *  psCfgDir[NUM_DRIVES];
+static THREAD_LOCAL const char *  psCfgDrive[NUM_DRIVES];
 // Used to track names allocated with strdup. NULL for names from argv
 static const char *  psCurDrive[NUM_DRIVES];
-static BOOLEAN bNoApply     =   FALSE;
-static int     iCfgExit     =   0;
-static BOOLEAN bCfgExit     =   FALSE;
-static int     iRowHelp     =   ROW_HELP;
+static THREAD_LOCAL BOOLEAN bNoApply     =   FALSE;
+static THREAD_LOCAL int     iCfgExit     =   0;
+static THREAD_LOCAL BOOLEAN bCfgExit     =   FALSE;
+static THREAD_LOCAL int     iRowHelp     =   ROW_HELP;
 
 //  Test for entering config mode
 BOOLEAN test_cfg_key (int wk)
@@ -218,7 +218,7 @@ static void row_cfg_draw (int info, int iState)
 #if defined(HAVE_MFX)
 /*                                     1         2         3         4         5         6         7
                              01234567890123456789012345678901234567890123456789012345678901234567890123456789 */
-    static char sCfg[]   =  " [ ] MTX500   [ ] MTX512   [ ] SDX      [ ] CPM MONO [ ] CPM COLR [ ] MFX    ";
+    static THREAD_LOCAL char sCfg[]   =  " [ ] MTX500   [ ] MTX512   [ ] SDX      [ ] CPM MONO [ ] CPM COLR [ ] MFX    ";
     int nSelWth = 13;
     sCfg[ 2] =  ( iCfgCur == CFG_MTX500     ) ? '*' : ' ';
     sCfg[15] =  ( iCfgCur == CFG_MTX512     ) ? '*' : ' ';
@@ -229,7 +229,7 @@ static void row_cfg_draw (int info, int iState)
 #elif defined(HAVE_CFX2)
 /*                                     1         2         3         4         5         6         7
                              01234567890123456789012345678901234567890123456789012345678901234567890123456789 */
-    static char sCfg[]   =  " [ ] MTX500   [ ] MTX512   [ ] SDX      [ ] CPM MONO [ ] CPM COLR [ ] CFX-II ";
+    static THREAD_LOCAL char sCfg[]   =  " [ ] MTX500   [ ] MTX512   [ ] SDX      [ ] CPM MONO [ ] CPM COLR [ ] CFX-II ";
     int nSelWth = 13;
     sCfg[ 2] =  ( iCfgCur == CFG_MTX500     ) ? '*' : ' ';
     sCfg[15] =  ( iCfgCur == CFG_MTX512     ) ? '*' : ' ';
@@ -238,7 +238,7 @@ static void row_cfg_draw (int info, int iState)
     sCfg[54] =  ( iCfgCur == CFG_CPM_COLOUR ) ? '*' : ' ';
     sCfg[67] =  ( iCfgCur == CFG_CFX2       ) ? '*' : ' ';
 #else
-    static char sCfg[]   =  " [ ] MTX500     [ ] MTX512     [ ] SDX        [ ] CPM MONO   [ ] CPM COLOUR ";
+    static THREAD_LOCAL char sCfg[]   =  " [ ] MTX500     [ ] MTX512     [ ] SDX        [ ] CPM MONO   [ ] CPM COLOUR ";
     int nSelWth = 15;
     sCfg[ 2] =  ( iCfgCur == CFG_MTX500     ) ? '*' : ' ';
     sCfg[17] =  ( iCfgCur == CFG_MTX512     ) ? '*' : ' ';
@@ -289,10 +289,10 @@ static BOOLEAN row_cfg_key (int info, int wk)
 //  Display keyboard map selection
 static void row_kbd_draw (int info, int iState)
     {
-    static char sNomap[] =  " [ ] Normal   ";
-    static char sRemap[] =  " [ ] Remapped ";
-    static char sNoSnd[] =  " [ ] No  ";
-    static char sSound[] =  " [ ] Yes ";
+    static THREAD_LOCAL char sNomap[] =  " [ ] Normal   ";
+    static THREAD_LOCAL char sRemap[] =  " [ ] Remapped ";
+    static THREAD_LOCAL char sNoSnd[] =  " [ ] No  ";
+    static THREAD_LOCAL char sSound[] =  " [ ] Yes ";
     static const char *psHelp[] = {
         "<Space> to select: Keys match MTX keyboard - Not always PC key symbols",
         "<Space> to select: Multiple keyboard modes - More closely match PC keys symbols",
@@ -379,8 +379,8 @@ static BOOLEAN row_kbd_key (int info, int wk)
 //  Display tape option selection
 static void row_topt_draw (int info, int iState)
     {
-    static char sNo[]   =  " [ ] No  ";
-    static char sYes[]  =  " [ ] Yes ";
+    static THREAD_LOCAL char sNo[]   =  " [ ] No  ";
+    static THREAD_LOCAL char sYes[]  =  " [ ] Yes ";
     static const char *psHelp[] = {   "<Space> to select: Fast. \".mtx\" files only",
                                       "<Space> to select: Slow. \".mtx\" and \".wav\" files",
                                       "<Space> to select: Protects existing tape files",
@@ -788,8 +788,8 @@ static void cfg_clear_sid (void)
 
 static void row_dropt_draw (int info, int iState)
     {
-    static char sNo[]   =  " [ ] No  ";
-    static char sYes[]  =  " [ ] Yes ";
+    static THREAD_LOCAL char sNo[]   =  " [ ] No  ";
+    static THREAD_LOCAL char sYes[]  =  " [ ] Yes ";
     static const char *psHelp[] = {   "<Space> to select: SiDiscs limited to 8MB",
                                       "<Space> to select: Huge SiDiscs for HexTrain",
                                       "<Space> to select: SiDisc contents lost on exit",
@@ -1444,6 +1444,7 @@ static void cfg_save (const char *psConfig)
                     }
                 }
             if ( cfg.vid_emu & VIDEMU_WIN_HW_PALETTE ) fprintf (pfil, "-vid-win-hw-palette\n");
+            if ( cfg.vid_emu & VIDEMU_WIN_SCANLINE ) fprintf (pfil, "-vid-scanline\n");
             if ( cfg.screen_refresh == 60 ) fprintf (pfil, "-vid-ntsc\n");
             }
         if ( cfg.snd_emu & SNDEMU_PORTAUDIO )
@@ -1872,7 +1873,7 @@ static BOOLEAN row_focus_tout (int info)
     return bTapeAudio;
     }
 
-struct  s_cfg_ui
+THREAD_LOCAL struct  s_cfg_ui
     {
     void (*draw) (int,int);
     BOOLEAN (*key) (int,int);
@@ -65,16 +65,16 @@ and also keyboard and screen related low level driver calls.
            01  CONSOLE=TTY:   */
 #define	IOBYTE 0xbc
 
-static BOOLEAN cpm_inited = FALSE;
-static BOOLEAN cpm_inited_sdx = FALSE;
-static BOOLEAN cpm_inited_fdxb = FALSE;
+static THREAD_LOCAL BOOLEAN cpm_inited = FALSE;
+static THREAD_LOCAL BOOLEAN cpm_inited_sdx = FALSE;
+static THREAD_LOCAL BOOLEAN cpm_inited_fdxb = FALSE;
 #define	DRIVE_PREFIX_LEN 500
-static char *drive_a = NULL;
-static BOOLEAN invert_case = FALSE;
-static word dma_addr = 0x0080;
-static const char *force_fn = NULL;
+static THREAD_LOCAL char *drive_a = NULL;
+static THREAD_LOCAL BOOLEAN invert_case = FALSE;
+static THREAD_LOCAL word dma_addr = 0x0080;
+static THREAD_LOCAL const char *force_fn = NULL;
 
-static BOOLEAN cpm_open_hack = FALSE;
+static THREAD_LOCAL BOOLEAN cpm_open_hack = FALSE;
 
 #define	CPM_DPB_ADDR     0xff80
 #define	CPM_DPB_ADDR_SDX 0xd800
@@ -343,7 +343,7 @@ struct _OPENFILE
 	word addr;
 	FILE *fp;
 	};
-static OPENFILE *openfiles = NULL;
+static THREAD_LOCAL OPENFILE *openfiles = NULL;
 /*...sopenfile_find:0:*/
 static OPENFILE *openfile_find(word addr)
 	{
@@ -394,8 +394,8 @@ struct _MATCH
 	char tn[FCB_Tn_LEN];
 	};
 
-static MATCH *search_matches = NULL;
-static word search_fcb_addr = 0;
+static THREAD_LOCAL MATCH *search_matches = NULL;
+static THREAD_LOCAL word search_fcb_addr = 0;
 
 /*...ssearch_clear:0:*/
 /* Discard whats left of the snapshot of files visible to CP/M */
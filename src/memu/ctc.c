@@ -49,12 +49,13 @@ typedef struct
 
 #define	N_CHANNELS 4
 
-static CHANNEL ctc_channels[N_CHANNELS];
-static byte ctc_int_vector; /* bits 7-3 inclusive */
+static THREAD_LOCAL CHANNEL ctc_channels[N_CHANNELS];
+static THREAD_LOCAL byte ctc_int_vector; /* bits 7-3 inclusive */
+static THREAD_LOCAL int ctc_cnt13;       /* System clocks towards next channel 1 & 2 count */
 
-static int	nInt = 0;
-static int  nIUS = 0;
-static int	nReti = 0;
+static THREAD_LOCAL int	nInt = 0;
+static THREAD_LOCAL int  nIUS = 0;
+static THREAD_LOCAL int	nReti = 0;
 
 void ctc_stats (void)
 	{
@@ -83,6 +84,46 @@ void ctc_init(void)
 	}
 /*...e*/
 
+#ifndef SMALL_MEM
+/*...sctc_save_state:0:*/
+/* The CTC part of a save-state (see state.c) */
+void ctc_save_state(STATE *st)
+	{
+	int i;
+	state_put_byte(st, ctc_int_vector);
+	state_put_int(st, (unsigned int) ctc_cnt13);
+	for ( i = 0; i < N_CHANNELS; i++ )
+		{
+		const CHANNEL *c = &(ctc_channels[i]);
+		state_put_byte(st, c->control);
+		state_put_byte(st, c->prescaler);
+		state_put_byte(st, c->constant);
+		state_put_byte(st, c->counter);
+		state_put_byte(st, (byte) c->run);
+		state_put_byte(st, (byte) c->is);
+		}
+	}
+/*...e*/
+/*...sctc_load_state:0:*/
+void ctc_load_state(STATE *st, int version)
+	{
+	int i;
+	ctc_int_vector = state_get_byte(st);
+	ctc_cnt13 = (int) state_get_int(st);
+	for ( i = 0; i < N_CHANNELS; i++ )
+		{
+		CHANNEL *c = &(ctc_channels[i]);
+		c->control   = state_get_byte(st);
+		c->prescaler = state_get_byte(st);
+		c->constant  = state_get_byte(st);
+		c->counter   = state_get_byte(st);
+		c->run       = state_get_byte(st);
+		c->is        = state_get_byte(st);
+		}
+	}
+/*...e*/
+#endif
+
 // Raise an interupt on Z80 unless there is already a higher priority one in progress.
 void ctc_int (void)
     {
@@ -291,9 +332,8 @@ void ctc_trigger(int channel)
 
 void ctc_advance (int adv)
 	{
-    static int cnt13;
     int channel;
-    cnt13 += adv;
+    ctc_cnt13 += adv;
     for ( channel = 0; channel < N_CHANNELS; ++channel )
         {
         CHANNEL *c = &(ctc_channels[channel]);
@@ -350,7 +390,7 @@ void ctc_advance (int adv)
                 }
             else if ( ( channel == 1 ) || ( channel == 2 ) )
                 {
-                int clks = cnt13 / 13;
+                int clks = ctc_cnt13 / 13;
                 int cntr = ( c->counter == 0 ) ? 0x100 : c->counter;
                 int cons = ( c->constant == 0 ) ? 0x100 : c->constant;
                 while ( clks > 0 )
@@ -378,7 +418,42 @@ void ctc_advance (int adv)
                 }
             }
         }
-    cnt13 %= 13;
+    ctc_cnt13 %= 13;
+	}
+/*...e*/
+/*...sctc_next:0:*/
+/* System clocks until the CTC could next raise an interrupt by itself.
+   ctc_advance may be called for up to this many clocks at once and give
+   the same result as advancing one instruction at a time. Counts which
+   cannot interrupt are left to catch up when next advanced. */
+
+int ctc_next (int limit)
+	{
+    int channel;
+    int next = limit;
+    for ( channel = 0; channel < N_CHANNELS; ++channel )
+        {
+        CHANNEL *c = &(ctc_channels[channel]);
+        int cntr = ( c->counter == 0 ) ? 0x100 : c->counter;
+        int clks;
+        if ( (c->control & (CC_CONSTANT|CC_RESET)) != 0 ) continue;
+        if ( (c->control & CC_COUNTER_MODE) == 0 )
+            {
+            /* Timer starts on the next advance, whatever its length */
+            if ( ! c->run ) return 0;
+            if ( ( (c->control & CC_INTERRUPT) == 0 ) || ( c->is != isNone ) ) continue;
+            clks = ( c->prescaler == 0 ) ? 0x100 : c->prescaler;
+            clks += ( cntr - 1 ) * ( ( c->control & CC_PRESCALER_256 ) ? 0x100 : 16 );
+            }
+        else if ( ( channel == 1 ) || ( channel == 2 ) )
+            {
+            if ( ( (c->control & CC_INTERRUPT) == 0 ) || ( c->is != isNone ) ) continue;
+            clks = 13 * cntr - ctc_cnt13;
+            }
+        else continue;
+        if ( clks < next ) next = clks;
+        }
+    return next;
 	}
 /*...e*/
 
@@ -21,11 +21,17 @@ extern void ctc_out(int channel, byte value);
 extern void ctc_reload(int channel);
 extern void ctc_trigger(int channel);
 extern void ctc_advance(int adv);
+extern int ctc_next(int limit);
 extern BOOLEAN ctc_int_pending(void);
 extern BOOLEAN ctc_int_ack(word *);
 extern byte ctc_get_int_vector(void);
 extern BOOLEAN ctc_reti (void);
 extern double ctc_freq (int channel);
 extern void ctc_stats (void);
+#ifndef SMALL_MEM
+#include "state.h"
+extern void ctc_save_state(STATE *st);
+extern void ctc_load_state(STATE *st, int version);
+#endif
 
 #endif
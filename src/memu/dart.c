@@ -21,6 +21,7 @@ Contributed by Bill Brendling.
 #include "common.h"
 #include "diag.h"
 #include "dirmap.h"
+#include "replay.h"
 
 #define	 NUM_CH				  2		// Number of DART channels
 
@@ -114,12 +115,12 @@ Contributed by Bill Brendling.
 #define	 CH1_TX_EMPTY		  ( CH1_FLAG >> INT_TX_EMPTY )
 #define	 CH1_EXT_CHG		  ( CH1_FLAG >> INT_EXT_CHG )
 
-static	 byte  ivec = 0;		  // Interrupt vector
-static	 int   iflags = 0;		  // Interrupt flags
-static	 int   ius = 0;		  // Interrupt under service flags
-static	 int   iflags_old = -1;
-static	 int   ius_old = -1;
-static struct
+static	 THREAD_LOCAL byte  ivec = 0;		  // Interrupt vector
+static	 THREAD_LOCAL int   iflags = 0;		  // Interrupt flags
+static	 THREAD_LOCAL int   ius = 0;		  // Interrupt under service flags
+static	 THREAD_LOCAL int   iflags_old = -1;
+static	 THREAD_LOCAL int   ius_old = -1;
+static THREAD_LOCAL struct
 	{
 	struct termios  config;	  // For configuration of Linux hardware serial port
 	int		fdIn;			  // Input file descriptor
@@ -145,7 +146,7 @@ static struct
 
 static char *psInt[] = { "RX_Special", "RX_Avail", "TX_Empty", "Ext_Change" };
 
-static struct pkt_data
+static THREAD_LOCAL struct pkt_data
 	{
 	char sType[20];
 	byte data[256];
@@ -164,14 +165,14 @@ static struct pkt_data
 	int	 nErr;
 	} pkt_tx, pkt_rx;
 
-static int  nIUS		=  0;
-static int	nRETI		=  0;
-static int	nInt0_Spec	=  0;
-static int	nInt0_RX	=  0;
-static int	nInt0_TX	=  0;
-static int	nInt0_Chg	=  0;
-static int	nCha0_Rd    =  0;
-static int  nCha0_Wr    =  0;
+static THREAD_LOCAL int  nIUS		=  0;
+static THREAD_LOCAL int	nRETI		=  0;
+static THREAD_LOCAL int	nInt0_Spec	=  0;
+static THREAD_LOCAL int	nInt0_RX	=  0;
+static THREAD_LOCAL int	nInt0_TX	=  0;
+static THREAD_LOCAL int	nInt0_Chg	=  0;
+static THREAD_LOCAL int	nCha0_Rd    =  0;
+static THREAD_LOCAL int  nCha0_Wr    =  0;
 
 static void pkt_init (struct pkt_data *pkt, char *psType)
 	{
@@ -541,6 +542,17 @@ static void dart_pump (int cycles)
 		{
 		// diag_message (DIAG_DART_CFG, "Entered dart_pump for channel %d: fdIn = %d, fdOut = %d",
 		// 	ch, channel[ch].fdIn, channel[ch].fdOut);
+#ifndef SMALL_MEM
+		if ( ( replay_mode == REPLAY_PLAY )
+			&& ( channel[ch].wr3 & WR3_RX_ENABLE )
+			&& ( ! ( channel[ch].rr0 & RR0_RX_AVAILABLE ) ) )
+			{
+			// Received bytes come from the recording instead
+			if ( replay_byte (REPLAY_DART, ch, &value) )
+				dart_rx (ch, value);
+			}
+		else
+#endif
 		if ( ( channel[ch].wr3 & WR3_RX_ENABLE )
 			&& ( ! ( channel[ch].rr0 & RR0_RX_AVAILABLE ) )
 			&& ( channel[ch].fdIn >= 0 ) )
@@ -550,6 +562,9 @@ static void dart_pump (int cycles)
 			// diag_message (DIAG_DART_HW,"status = %d   errno = %d", status, errno);
 			if ( status == 1 )
 				{
+#ifndef SMALL_MEM
+				replay_note (REPLAY_DART, ch, value);
+#endif
 				dart_rx (ch, value);
 				}
 			else if ( ( status == -1 ) && ( errno != EAGAIN ) && ( errno != EWOULDBLOCK ) )
@@ -1044,6 +1059,64 @@ int dart_int_pending (int cycles)
 	return	ipend;
 	}
 
+#ifndef SMALL_MEM
+/* The DART part of a save-state (see state.c).
+   The host ends of the channels come from the configuration. */
+void dart_save_state (STATE *st)
+	{
+	int ch;
+	state_put_byte (st, ivec);
+	state_put_int (st, (unsigned int) iflags);
+	state_put_int (st, (unsigned int) ius);
+	for ( ch = 0; ch < NUM_CH; ++ch )
+		{
+		state_put_byte (st, (byte) channel[ch].reg);
+		state_put_byte (st, (byte) channel[ch].rxint);
+		state_put_byte (st, channel[ch].wr1);
+		state_put_byte (st, channel[ch].wr3);
+		state_put_byte (st, channel[ch].wr4);
+		state_put_byte (st, channel[ch].wr5);
+		state_put_byte (st, channel[ch].rr0);
+		state_put_byte (st, channel[ch].rr1);
+		state_put_byte (st, channel[ch].rx);
+		state_put_byte (st, channel[ch].mlst);
+		state_put_byte (st, (byte) channel[ch].stchg);
+		state_put_byte (st, channel[ch].txbuf);
+		state_put_byte (st, (byte) channel[ch].txfull);
+		state_put_int (st, (unsigned int) channel[ch].txcyc);
+		state_put_int (st, (unsigned int) channel[ch].txtim);
+		}
+	}
+
+void dart_load_state (STATE *st, int version)
+	{
+	int ch;
+	ivec = state_get_byte (st);
+	iflags = (int) state_get_int (st);
+	ius = (int) state_get_int (st);
+	for ( ch = 0; ch < NUM_CH; ++ch )
+		{
+		channel[ch].reg = state_get_byte (st) & 0x07;
+		channel[ch].rxint = state_get_byte (st);
+		channel[ch].wr1 = state_get_byte (st);
+		channel[ch].wr3 = state_get_byte (st);
+		channel[ch].wr4 = state_get_byte (st);
+		channel[ch].wr5 = state_get_byte (st);
+		channel[ch].rr0 = state_get_byte (st);
+		channel[ch].rr1 = state_get_byte (st);
+		channel[ch].rx = state_get_byte (st);
+		channel[ch].mlst = state_get_byte (st);
+		channel[ch].stchg = state_get_byte (st);
+		channel[ch].txbuf = state_get_byte (st);
+		channel[ch].txfull = state_get_byte (st);
+		channel[ch].txcyc = (int) state_get_int (st);
+		channel[ch].txtim = (int) state_get_int (st);
+		}
+	iflags_old = -1;
+	ius_old = -1;
+	}
+#endif
+
 void dart_init (void)
 	{
 	memset (&channel, 0, sizeof (channel));
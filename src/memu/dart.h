@@ -20,5 +20,10 @@ extern void dart_write (int ch, const char *psFile);
 extern void dart_serial (int ch, const char *psDev);
 extern void dart_init (void);
 extern void dart_term (void);
+#ifndef SMALL_MEM
+#include "state.h"
+extern void dart_save_state (STATE *st);
+extern void dart_load_state (STATE *st, int version);
+#endif
 
 #endif
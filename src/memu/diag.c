@@ -30,20 +30,20 @@ diag.c - Diagnostic code
 /*...e*/
 
 /*...svars:0:*/
-unsigned int diag_methods = 0;
-BOOLEAN diag_flags[DIAG_COUNT];
-static const char *diag_file_fn = "memu.log";
+THREAD_LOCAL unsigned int diag_methods = 0;
+THREAD_LOCAL BOOLEAN diag_flags[DIAG_COUNT];
+static THREAD_LOCAL const char *diag_file_fn = "memu.log";
 
 #ifndef SMALL_MEM
-static const char *diag_ring_fn = "memu.ring";
+static THREAD_LOCAL const char *diag_ring_fn = "memu.ring";
 #define	RING_SIZE 0x10000
-static int produce = 0, consume = 0;
-static char *ring[RING_SIZE];
+static THREAD_LOCAL int produce = 0, consume = 0;
+static THREAD_LOCAL char *ring[RING_SIZE];
 #endif
 
 #define CLOG_SIZE   255
-static char sChipLog[CLOG_SIZE+2];
-static int nCLog = 0;
+static THREAD_LOCAL char sChipLog[CLOG_SIZE+2];
+static THREAD_LOCAL int nCLog = 0;
 /*...e*/
 
 /*...smethodvals:0:*/
@@ -273,7 +273,7 @@ void diag_message(unsigned int flag, const char *fmt, ...)
 
 void diag_out (word port, byte value)
     {
-    static BOOLEAN bEnable = TRUE;
+    static THREAD_LOCAL BOOLEAN bEnable = TRUE;
     BOOLEAN bFlush = FALSE;
     switch (port & 0xFF)
         {
@@ -321,11 +321,14 @@ void diag_control(int c)
 		case 'b': diag_flags[DIAG_MEM_IOBYTE       ] ^= TRUE; break;
      LM(case 'd': diag_flags[DIAG_ACT_MEM_DUMP     ]  = TRUE; break;)
 //      case 'e': snd_query (); break;
+     LM(case 'e': diag_flags[DIAG_ACT_REWIND       ]  = TRUE; break;)
 		case 'f': diag_flags[DIAG_CPM_BDOS_FILE    ] ^= TRUE; break;
+		case 'g': diag_flags[DIAG_ACT_TRACE_DUMP   ]  = TRUE; break;
 #ifdef HAVE_VDEB
         case 'h': vdeb_break (); break;
 #endif
 		case 'i': diag_flags[DIAG_Z80_INTERRUPTS   ] ^= TRUE; break;
+     LM(case 'j': diag_flags[DIAG_ACT_STATE_SAVE   ]  = TRUE; break;)
 		case 'k': diag_flags[DIAG_KBD_SENSE        ] ^= TRUE; break;
      LM(case 'l': diag_flags[DIAG_ACT_SNA_LOAD     ]  = TRUE; break;)
 		case 'm': diag_flags[DIAG_SPEED            ] ^= TRUE; break;
@@ -336,6 +339,7 @@ void diag_control(int c)
      LM(case 'r': diag_flags[DIAG_ACT_Z80_REGS	   ]  = TRUE; break;)
 	 LM(case 's': diag_flags[DIAG_ACT_SNA_SAVE	   ]  = TRUE; break;)
 	 LM(case 't': diag_flags[DIAG_ACT_TAP_REWIND   ]  = TRUE; break;)
+	 LM(case 'u': diag_flags[DIAG_ACT_STATE_LOAD   ]  = TRUE; break;)
 	 LM(case 'v': diag_flags[DIAG_ACT_VID_REGS	   ]  = TRUE; break;)
 	 LM(case 'w': diag_flags[DIAG_ACT_VID_SNAPSHOT ]  = TRUE; break;)
 	 LM(case 'x': diag_flags[DIAG_VID_AUTO_SNAPSHOT] ^= TRUE; break;)
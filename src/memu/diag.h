@@ -131,12 +131,16 @@ enum DIAGS {
     DIAG_ACT_VID_SNAPSHOT,
     DIAG_VID_AUTO_SNAPSHOT,
     DIAG_ACT_VID_DUMP,
+    DIAG_ACT_TRACE_DUMP,
+    DIAG_ACT_STATE_SAVE,
+    DIAG_ACT_STATE_LOAD,
+    DIAG_ACT_REWIND,
     DIAG_COUNT
     };
 
-extern unsigned int diag_methods;
+extern THREAD_LOCAL unsigned int diag_methods;
 extern unsigned int diag_method_of(const char *s);
-extern BOOLEAN diag_flags[DIAG_COUNT];
+extern THREAD_LOCAL BOOLEAN diag_flags[DIAG_COUNT];
 extern BOOLEAN diag_flag_of(const char *s);
 extern void diag_message(unsigned int flag, const char *fmt, ...);
 extern void diag_out(word port, byte value);
@@ -7,9 +7,9 @@
 #include "common.h"
 #include "dirmap.h"
 
-static const char *rootdir[pmapCount] = {NULL};
-static char *psNewMap = NULL;
-static int nNewLen = 0;
+static THREAD_LOCAL const char *rootdir[pmapCount] = {NULL};
+static THREAD_LOCAL char *psNewMap = NULL;
+static THREAD_LOCAL int nNewLen = 0;
 
 void PMapRootDir (PMapMode pmap, const char *psDir, BOOLEAN bCopy)
     {
@@ -18,6 +18,11 @@ void PMapRootDir (PMapMode pmap, const char *psDir, BOOLEAN bCopy)
     else rootdir[pmap] = psDir;
     }
 
+const char *PMapRoot (PMapMode pmap)
+    {
+    return rootdir[pmap];
+    }
+
 static PMapMode PMapClass (const char *psPath)
     {
     if ( psPath == NULL )
@@ -116,8 +121,8 @@ typedef struct s_mapping
     const char *        *psMapped;
     } PMapping;
 
-static PMapping first[pmapCount] = {NULL};
-static PMapping second[pmapCount] = {NULL};
+static THREAD_LOCAL PMapping first[pmapCount] = {NULL};
+static THREAD_LOCAL PMapping second[pmapCount] = {NULL};
 
 static const char *PMapFind (PMapMode pmap, const char *psPath)
     {
@@ -9,11 +9,13 @@
 typedef enum {pmapNone = -1, pmapCfg, pmapExe, pmapHome, pmapWork, pmapCount} PMapMode;
 
 void PMapRootDir (PMapMode pmap, const char *psDir, BOOLEAN bCopy);
+const char *PMapRoot (PMapMode pmap);
 const char *PMapPath (const char *psPath);
 const char *PMapMapped (const char *psPath);
 
 #else
 #define PMapRootDir(x, y, z)
+#define PMapRoot(x)     NULL
 #define PMapPath(x)     x
 #define PMapMapped(x)   x
 
@@ -26,13 +26,13 @@ differently to the way its done in Z80.c.
 /*...e*/
 
 /*...svars:0:*/
-BOOLEAN use_syms           = TRUE;
-BOOLEAN show_opcode        = TRUE;
-BOOLEAN dis_show_ill       = TRUE;
-BOOLEAN dis_mtx_exts       = TRUE;
+THREAD_LOCAL BOOLEAN use_syms           = TRUE;
+THREAD_LOCAL BOOLEAN show_opcode        = TRUE;
+THREAD_LOCAL BOOLEAN dis_show_ill       = TRUE;
+THREAD_LOCAL BOOLEAN dis_mtx_exts       = TRUE;
 
 typedef BOOLEAN (*DISFN)(byte op, word * a, char *s);
-static DISFN disfn_table[0x100];
+static THREAD_LOCAL DISFN disfn_table[0x100];
 
 #define	IX_PREFIX       0x01	/* Will be removed if used */
 #define	IY_PREFIX       0x02	/* Will be removed if used */
@@ -41,8 +41,8 @@ static DISFN disfn_table[0x100];
 #define	ILL_SHROT       0x20	/* Unknown shift/rotate type */
 #define	ILL_USE_HL_FORM 0x40	/* Use a different opcode */
 #define	ILL_2_MEM_OP    0x80	/* 2 memory operands (not allowed) */
-static byte state;		/* Internal state */
-static byte disp;		/* Valid if D_FETCHED */
+static THREAD_LOCAL byte state;		/* Internal state */
+static THREAD_LOCAL byte disp;		/* Valid if D_FETCHED */
 /*...e*/
 
 /*...sread8:0:*/
@@ -13,10 +13,10 @@ dis.h - Z80 Disassembler
 /*...vtypes\46\h:0:*/
 /*...e*/
 
-extern BOOLEAN use_syms;
-extern BOOLEAN show_opcode;
-extern BOOLEAN dis_show_ill;
-extern BOOLEAN dis_mtx_exts;
+extern THREAD_LOCAL BOOLEAN use_syms;
+extern THREAD_LOCAL BOOLEAN show_opcode;
+extern THREAD_LOCAL BOOLEAN dis_show_ill;
+extern THREAD_LOCAL BOOLEAN dis_mtx_exts;
 
 extern void dis_init(void);
 extern BOOLEAN dis_instruction(word *a, char *s);
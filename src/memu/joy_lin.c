@@ -31,21 +31,21 @@ http://atrey.karlin.mff.cuni.cz/~vojtech/joystick/
 /*...e*/
 
 /*...svars:0:*/
-static int joy_emu = 0;
-static const char *joy_buttons = "<LEFT><RIGHT><UP><DOWN><HOME> ";
-static int joy_central = 0; /* Its as if Linux driver is already doing this */
+static THREAD_LOCAL int joy_emu = 0;
+static THREAD_LOCAL const char *joy_buttons = "<LEFT><RIGHT><UP><DOWN><HOME> ";
+static THREAD_LOCAL int joy_central = 0; /* Its as if Linux driver is already doing this */
 
 #ifdef HAVE_JOY
 
-static int joy_fd;
+static THREAD_LOCAL int joy_fd;
 #define MAX_AXES    8
 // static int joy_left_row , joy_left_bitpos;
 // static int joy_right_row, joy_right_bitpos;
-static int joy_up_row[MAX_AXES]   , joy_up_bitpos[MAX_AXES];
-static int joy_down_row[MAX_AXES] , joy_down_bitpos[MAX_AXES];
+static THREAD_LOCAL int joy_up_row[MAX_AXES]   , joy_up_bitpos[MAX_AXES];
+static THREAD_LOCAL int joy_down_row[MAX_AXES] , joy_down_bitpos[MAX_AXES];
 #define	MAX_BUTTONS 16
-static int joy_n_buttons;
-static int joy_buttons_row[MAX_BUTTONS], joy_buttons_bitpos[MAX_BUTTONS];
+static THREAD_LOCAL int joy_n_buttons;
+static THREAD_LOCAL int joy_buttons_row[MAX_BUTTONS], joy_buttons_bitpos[MAX_BUTTONS];
 
 #endif
 /*...e*/
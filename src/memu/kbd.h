@@ -110,6 +110,12 @@ extern void kbd_grid_release(int row, int bitpos);
 extern void kbd_out5(byte val);
 extern byte kbd_in5(void);
 extern byte kbd_in6(void);
+#ifndef SMALL_MEM
+#include "state.h"
+extern void kbd_save_state(STATE *st);
+extern void kbd_load_state(STATE *st, int version);
+extern void kbd_replay_sense(BOOLEAN joy, int drive, word sense);
+#endif
 
 extern void kbd_apply_remap(void);
 extern void kbd_apply_unmap(void);
@@ -128,7 +134,7 @@ extern void kbd_set_alternate (const char *psFile);
 
 extern char * ListModifiers (void);
 
-extern BOOLEAN kbd_diag;
-extern int kbd_mods;
+extern THREAD_LOCAL BOOLEAN kbd_diag;
+extern THREAD_LOCAL int kbd_mods;
 
 #endif
@@ -9,6 +9,7 @@
 #include "win.h"
 #include "kbd.h"
 #include "vdeb.h"
+#include "replay.h"
 #ifndef WIN32
 #include <unistd.h>
 #endif
@@ -50,7 +51,7 @@ struct s_keyinfo
 
 /* The following entries must be in iKey order - bisection search is used */
 
-static struct s_keyinfo keyinfo[] =
+static THREAD_LOCAL struct s_keyinfo keyinfo[] =
     {
     {WK_BackSpace,      {0x18,0x18,0x18,0x18,0x18,0x18,0x18,0x18},NKEY,NKEY}, // 0x08 - Backspace
     {WK_Tab,            {0x28,0x28,0x28,0x28,0x28,0x28,0x28,0x28},NKEY,NKEY}, // 0x09 - Keyboard Tab
@@ -156,31 +157,31 @@ static struct s_keyinfo keyinfo[] =
     {WK_Mac_Cmd_R,      {NKEY,NKEY,NKEY,NKEY,NKEY,NKEY,NKEY,NKEY},NKEY,NKEY}  // 0x144 - Right Meta
     };
 
-static struct
+static THREAD_LOCAL struct
     {
     word    wk;
     BOOLEAN    bDown;
     } alt_toggle[NUM_ALT_TOGGLE];
-static int n_alt_toggle = 0;
-static BOOLEAN bToggle = FALSE;
+static THREAD_LOCAL int n_alt_toggle = 0;
+static THREAD_LOCAL BOOLEAN bToggle = FALSE;
 
-static int kbd_emu = 0;
-static int kbd_mode = 0;
-int kbd_mods = 0;
+static THREAD_LOCAL int kbd_emu = 0;
+static THREAD_LOCAL int kbd_mode = 0;
+THREAD_LOCAL int kbd_mods = 0;
 
-static int kbd_drive;
-static word kbd_sense[8];
+static THREAD_LOCAL int kbd_drive;
+static THREAD_LOCAL word kbd_sense[8];
 #ifdef HAVE_JOY
 #include "joy.h"
-static word kbd_sense_joy[8];
+static THREAD_LOCAL word kbd_sense_joy[8];
 #endif
 
-static byte rst_keys = 0;
-BOOLEAN kbd_diag = FALSE;
+static THREAD_LOCAL byte rst_keys = 0;
+THREAD_LOCAL BOOLEAN kbd_diag = FALSE;
 
 #define LEN_LOG   80
-static char sLogType[LEN_LOG+1];
-static int nLogType = 0;
+static THREAD_LOCAL char sLogType[LEN_LOG+1];
+static THREAD_LOCAL int nLogType = 0;
 
 static void kbd_log (int key)
     {
@@ -287,6 +288,44 @@ void kbd_mod_keyrelease (int wk)
     else if ( wk == WK_Mac_Cmd_R )  kbd_mods &= ~ MKY_RALT;
     }
 
+/*...skbd_set_sense:0:*/
+/* The host keyboard and joystick change the matrix through here, so that
+   the changes are recorded, or ignored when a recording is replayed. */
+static void kbd_set_sense (int drive, word sense)
+    {
+#ifndef SMALL_MEM
+    if ( replay_mode == REPLAY_PLAY ) return;
+    replay_note (REPLAY_KBD, drive, sense);
+#endif
+    kbd_sense[drive] = sense;
+    }
+
+#ifdef HAVE_JOY
+static void kbd_set_sense_joy (int row, word sense)
+    {
+#ifndef SMALL_MEM
+    if ( replay_mode == REPLAY_PLAY ) return;
+    replay_note (REPLAY_JOY, row, sense);
+#endif
+    kbd_sense_joy[row] = sense;
+    }
+#endif
+
+#ifndef SMALL_MEM
+void kbd_replay_sense (BOOLEAN joy, int drive, word sense)
+    {
+    drive &= 7;
+    if ( ! joy )
+        kbd_sense[drive] = sense;
+#ifdef HAVE_JOY
+    else
+        kbd_sense_joy[drive] = sense;
+#endif
+    diag_message (DIAG_KBD_WIN_KEY, "replayed kbd_sense%s[%d] = 0x%03X", joy ? "_joy" : "", drive, sense);
+    }
+#endif
+/*...e*/
+
 #ifdef ALT_KEYPRESS
 extern BOOLEAN ALT_KEYPRESS (WIN *win, int wk);
 #endif
@@ -371,7 +410,7 @@ void kbd_win_keypress (WIN *win, int wk)
             {
             word sense = 1 << ( kscan & 0x0F );
             int drive = kscan >> 4;
-            kbd_sense[drive] &= ~ sense;
+            kbd_set_sense (drive, kbd_sense[drive] & ~ sense);
             diag_message (DIAG_KBD_WIN_KEY, "kbd_sense[%d] = 0x%03X", drive, kbd_sense[drive]);
             kbd_log (wk);
             break;
@@ -418,8 +457,15 @@ void kbd_win_keyrelease(WIN *win, int wk)
                 break;
             case RST1:
             case RST2:
+#ifndef SMALL_MEM
+                if (( rst_keys == 0x03 ) && ( replay_mode != REPLAY_PLAY ))
+#else
                 if ( rst_keys == 0x03 )
+#endif
                     {
+#ifndef SMALL_MEM
+                    replay_note (REPLAY_RESET, 0, 0);
+#endif
                     // Allow time to press keys for CFX mode selection
                     memu_reset ();
                     // sleep (2);
@@ -434,7 +480,7 @@ void kbd_win_keyrelease(WIN *win, int wk)
             {
             word sense = 1 << ( kscan & 0x0F );
             int drive = kscan >> 4;
-            kbd_sense[drive] |= sense;
+            kbd_set_sense (drive, kbd_sense[drive] | sense);
             diag_message (DIAG_KBD_WIN_KEY, "kbd_sense[%d] = 0x%03X", drive, kbd_sense[drive]);
             break;
             }
@@ -447,14 +493,14 @@ void kbd_win_keyrelease(WIN *win, int wk)
 void kbd_grid_press(int row, int bitpos)
     {
     // kbd_sense_joy[row] &= ~(1<<bitpos);
-    kbd_sense_joy[row] &= ~bitpos;
+    kbd_set_sense_joy (row, kbd_sense_joy[row] & ~bitpos);
     }
 /*...e*/
 /*...skbd_grid_release:0:*/
 void kbd_grid_release(int row, int bitpos)
     {
     // kbd_sense_joy[row] |= (1<<bitpos);
-    kbd_sense_joy[row] |= bitpos;
+    kbd_set_sense_joy (row, kbd_sense_joy[row] | bitpos);
     }
 /*...e*/
 BOOLEAN kbd_grid_test(int row, int bitpos)
@@ -477,8 +523,8 @@ static struct st_joykey
         {WK_Return, 5, 0x40},
         {WK_Escape, 1, 0x01}
         };
-static int jk_last = -1;
-static long long ms_last = 0;
+static THREAD_LOCAL int jk_last = -1;
+static THREAD_LOCAL long long ms_last = 0;
 #define JOY_REPEAT  250     // Repeat interval for joystick buttons in ms.
 
 int joy_key (void)
@@ -517,6 +563,22 @@ void kbd_out5(byte val)
     kbd_drive = val;
     }
 /*...e*/
+#ifndef SMALL_MEM
+/*...skbd_save_state:0:*/
+/* The keyboard part of a save-state (see state.c).
+   Which keys are pressed is left to the host keyboard. */
+void kbd_save_state(STATE *st)
+    {
+    state_put_byte(st, (byte) kbd_drive);
+    }
+/*...e*/
+/*...skbd_load_state:0:*/
+void kbd_load_state(STATE *st, int version)
+    {
+    kbd_drive = state_get_byte(st);
+    }
+/*...e*/
+#endif
 /*...skbd_in5:0:*/
 /* "Sense1" */
 #ifdef ALT_KBD_SENSE1
@@ -703,8 +765,8 @@ struct _QKE
     void *ptr;
     };
 
-static QKE *kbd_qke_first = NULL;
-static QKE *kbd_qke_last  = NULL;
+static THREAD_LOCAL QKE *kbd_qke_first = NULL;
+static THREAD_LOCAL QKE *kbd_qke_last  = NULL;
 
 static void kbd_qke_enqueue (BOOLEAN bFront, int action, int value, void *ptr)
     {
@@ -746,16 +808,16 @@ static void kbd_qke_dequeue (void)
    <Wait200><AutoShift>dir A:<RET>
 */
 
-static BOOLEAN kbd_do_press      = TRUE;
-static BOOLEAN kbd_do_release    = TRUE;
-static int     kbd_time_press    = 1;
-static int     kbd_time_release  = 1;
-static BOOLEAN kbd_do_auto_shift = TRUE;
+static THREAD_LOCAL BOOLEAN kbd_do_press      = TRUE;
+static THREAD_LOCAL BOOLEAN kbd_do_release    = TRUE;
+static THREAD_LOCAL int     kbd_time_press    = 1;
+static THREAD_LOCAL int     kbd_time_release  = 1;
+static THREAD_LOCAL BOOLEAN kbd_do_auto_shift = TRUE;
 #define SS_UNKNOWN   0
 #define SS_SHIFTED   1
 #define SS_UNSHIFTED 2
-static int     kbd_shift_state = SS_UNKNOWN;
-static int     kbd_time_return = 25;
+static THREAD_LOCAL int     kbd_shift_state = SS_UNKNOWN;
+static THREAD_LOCAL int     kbd_time_return = 25;
 
 static void kbd_string_events (const char **p)
     {
@@ -869,7 +931,7 @@ static void kbd_string_events (const char **p)
     }
 
 #define L_LINE 300
-static char autotype_line[L_LINE+1];
+static THREAD_LOCAL char autotype_line[L_LINE+1];
 
 /* Called here every 50th of a second */
 void kbd_periodic (void)
@@ -1115,7 +1177,7 @@ void kbd_term(void)
 
 char * ListModifiers (void)
 	{
-	static char sMods[31];
+	static THREAD_LOCAL char sMods[31];
 	sMods[0] =  '\0';
 	if ( kbd_mods == 0 ) strcpy (sMods, " None");
 	if ( kbd_mods & MKY_LSHIFT )  strcat (sMods, " LS");
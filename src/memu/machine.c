@@ -0,0 +1,262 @@
+/*
+
+machine.c - Several emulated machines within one process
+
+A machine's thread runs memu_init, then waits for requests to run the
+Z80 for a number of clocks, or to call a function in the context of
+the machine. When the machine terminates, because the emulated program
+exits, a fatal error, or machine_destroy, terminate() tidies up as it
+does for the whole program, and calls machine_exit to end the thread.
+
+*/
+
+#ifdef MEMU_MULTI
+
+/*...sincludes:0:*/
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "types.h"
+#include "common.h"
+#include "diag.h"
+#include "memu.h"
+#include "dirmap.h"
+#include "machine.h"
+
+/*...vtypes\46\h:0:*/
+/*...vcommon\46\h:0:*/
+/*...vdiag\46\h:0:*/
+/*...vmemu\46\h:0:*/
+/*...vmachine\46\h:0:*/
+/*...e*/
+
+typedef enum { mcNone, mcInit, mcRun, mcCall, mcQuit } MCMD;
+
+struct s_machine
+    {
+    pthread_t           thread;
+    pthread_mutex_t     mtx;
+    pthread_cond_t      cond;
+    MCMD                cmd;            /* Request, mcNone once done */
+    BOOLEAN             bExited;        /* Thread has terminated */
+    int                 status;         /* Exit status, once terminated */
+    int                 argc;
+    char                **argv;         /* Copy, memu keeps pointers into it */
+#ifdef MAP_PATH
+    char                *roots[pmapCount];
+#endif
+    unsigned long long  clocks;         /* For mcRun */
+    void                (*func)(void *);    /* For mcCall */
+    void                *arg;
+    Z80                 *z80;
+    };
+
+static THREAD_LOCAL MACHINE *machine_self = NULL;
+
+/*...smachine_roots:0:*/
+#ifdef MAP_PATH
+/* A machine sees the same path roots as the thread which created it.
+   Any not set there are defaulted as main() would. */
+static void machine_roots (MACHINE *m)
+    {
+    int pmap;
+    for ( pmap = 0; pmap < pmapCount; ++pmap )
+        {
+        const char *psDir = PMapRoot ((PMapMode) pmap);
+        m->roots[pmap] = ( psDir != NULL ) ? estrdup (psDir) : NULL;
+        }
+    if ( ( m->roots[pmapHome] == NULL ) && ( getenv ("HOME") != NULL ) )
+        m->roots[pmapHome] = estrdup (getenv ("HOME"));
+    if ( m->roots[pmapExe] == NULL )
+        m->roots[pmapExe] = estrdup (".");
+    if ( m->roots[pmapWork] == NULL )
+        m->roots[pmapWork] = getcwd (NULL, 0);
+    }
+#endif
+/*...e*/
+/*...smachine_thread:0:*/
+static void *machine_thread (void *pv)
+    {
+    MACHINE *m = (MACHINE *) pv;
+    MCMD cmd;
+    machine_self = m;
+#ifdef MAP_PATH
+    int pmap;
+    for ( pmap = 0; pmap < pmapCount; ++pmap )
+        if ( m->roots[pmap] != NULL )
+            PMapRootDir ((PMapMode) pmap, m->roots[pmap], TRUE);
+#endif
+    memu_init (m->argc, (const char **) m->argv);
+    m->z80 = get_Z80_regs ();
+    pthread_mutex_lock (&m->mtx);
+    while (TRUE)
+        {
+        m->cmd = mcNone;
+        pthread_cond_broadcast (&m->cond);
+        while ( m->cmd == mcNone )
+            pthread_cond_wait (&m->cond, &m->mtx);
+        cmd = m->cmd;
+        pthread_mutex_unlock (&m->mtx);
+        switch (cmd)
+            {
+            case mcRun:
+                {
+                unsigned long long now = get_Z80_clocks ();
+                if ( m->clocks >= ELAPSED_NEVER - now )
+                    memu_run (ELAPSED_NEVER);
+                else
+                    memu_run (now + m->clocks);
+                break;
+                }
+            case mcCall:
+                m->func (m->arg);
+                break;
+            case mcQuit:
+                terminate (NULL);   /* Does not return */
+                break;
+            default:
+                break;
+            }
+        pthread_mutex_lock (&m->mtx);
+        }
+    return NULL;
+    }
+/*...e*/
+/*...smachine_command:0:*/
+/* Pass a request to the machine's thread (unless mcNone), and wait for
+   it to be done. Returns FALSE if the machine has terminated. */
+static BOOLEAN machine_command (MACHINE *m, MCMD cmd)
+    {
+    BOOLEAN bRun;
+    pthread_mutex_lock (&m->mtx);
+    if ( ( cmd != mcNone ) && ( ! m->bExited ) )
+        {
+        m->cmd = cmd;
+        pthread_cond_broadcast (&m->cond);
+        }
+    while ( ( m->cmd != mcNone ) && ( ! m->bExited ) )
+        pthread_cond_wait (&m->cond, &m->mtx);
+    bRun = ! m->bExited;
+    pthread_mutex_unlock (&m->mtx);
+    return bRun;
+    }
+/*...e*/
+/*...smachine_free:0:*/
+static void machine_free (MACHINE *m)
+    {
+    int i;
+    pthread_cond_destroy (&m->cond);
+    pthread_mutex_destroy (&m->mtx);
+    for ( i = 0; i < m->argc; ++i )
+        free (m->argv[i]);
+    free (m->argv);
+#ifdef MAP_PATH
+    for ( i = 0; i < pmapCount; ++i )
+        free (m->roots[i]);
+#endif
+    free (m);
+    }
+/*...e*/
+
+/*...smachine_create:0:*/
+/* Start a machine, configured from command line style arguments.
+   Returns NULL if the arguments are invalid or the machine terminates
+   while starting. */
+MACHINE *machine_create (int argc, const char *argv[])
+    {
+    MACHINE *m = (MACHINE *) emalloc (sizeof (MACHINE));
+    int i;
+    memset (m, 0, sizeof (MACHINE));
+    m->argc = argc;
+    m->argv = (char **) emalloc ((argc + 1) * sizeof (char *));
+    for ( i = 0; i < argc; ++i )
+        m->argv[i] = estrdup (argv[i]);
+    m->argv[argc] = NULL;
+#ifdef MAP_PATH
+    machine_roots (m);
+#endif
+    pthread_mutex_init (&m->mtx, NULL);
+    pthread_cond_init (&m->cond, NULL);
+    m->cmd = mcInit;
+    if ( pthread_create (&m->thread, NULL, machine_thread, m) != 0 )
+        {
+        diag_message (DIAG_ALWAYS, "Unable to create a thread for a machine");
+        machine_free (m);
+        return NULL;
+        }
+    if ( ! machine_command (m, mcNone) )
+        {
+        pthread_join (m->thread, NULL);
+        machine_free (m);
+        return NULL;
+        }
+    return m;
+    }
+/*...e*/
+/*...smachine_run:0:*/
+/* Run the machine for (at least) the given number of Z80 clocks.
+   Returns FALSE once the machine has terminated. */
+BOOLEAN machine_run (MACHINE *m, unsigned long long clocks)
+    {
+    m->clocks = clocks;
+    return machine_command (m, mcRun);
+    }
+/*...e*/
+/*...smachine_call:0:*/
+/* Call a function on the machine's thread, so that it may use any of
+   the emulator's functions (mem_read_byte, vid_vram_read, etc.) on
+   this machine. Returns FALSE, without calling it, if the machine has
+   terminated. */
+BOOLEAN machine_call (MACHINE *m, void (*func)(void *), void *arg)
+    {
+    m->func = func;
+    m->arg = arg;
+    return machine_command (m, mcCall);
+    }
+/*...e*/
+/*...smachine_z80:0:*/
+/* The registers may be examined or changed while the machine isn't running */
+Z80 *machine_z80 (MACHINE *m)
+    {
+    return m->bExited ? NULL : m->z80;
+    }
+/*...e*/
+/*...smachine_status:0:*/
+/* -1 while running, otherwise the exit status */
+int machine_status (MACHINE *m)
+    {
+    int status;
+    pthread_mutex_lock (&m->mtx);
+    status = m->bExited ? m->status : -1;
+    pthread_mutex_unlock (&m->mtx);
+    return status;
+    }
+/*...e*/
+/*...smachine_destroy:0:*/
+void machine_destroy (MACHINE *m)
+    {
+    machine_command (m, mcQuit);
+    pthread_join (m->thread, NULL);
+    machine_free (m);
+    }
+/*...e*/
+
+/*...smachine_exit:0:*/
+/* Called in place of exit(), ends the current machine's thread */
+void machine_exit (int status)
+    {
+    MACHINE *m = machine_self;
+    if ( m == NULL )
+        exit (status);
+    pthread_mutex_lock (&m->mtx);
+    m->bExited = TRUE;
+    m->status = status;
+    m->cmd = mcNone;
+    pthread_cond_broadcast (&m->cond);
+    pthread_mutex_unlock (&m->mtx);
+    pthread_exit (NULL);
+    }
+/*...e*/
+
+#endif
@@ -0,0 +1,48 @@
+/*
+
+machine.h - Several emulated machines within one process
+
+Built with MEMU_MULTI. Each machine runs on a thread of its own, which
+holds all of its state (see THREAD_LOCAL in types.h), so a new machine
+always starts from the same state as a new process. The functions here
+may be called from any thread, but only one thread at a time should
+drive a given machine.
+
+Machines are normally headless, for example :-
+
+	-mon-console-nokey -fast prog.com
+
+*/
+
+#ifndef MACHINE_H
+#define	MACHINE_H
+
+/*...sincludes:0:*/
+#include "types.h"
+#include "Z80.h"
+
+/*...vtypes\46\h:0:*/
+/*...vZ80\46\h:0:*/
+/*...e*/
+
+typedef struct s_machine MACHINE;
+
+#ifdef __cplusplus
+extern "C"
+    {
+#endif
+
+extern MACHINE *machine_create (int argc, const char *argv[]);
+extern BOOLEAN machine_run (MACHINE *m, unsigned long long clocks);
+extern BOOLEAN machine_call (MACHINE *m, void (*func)(void *), void *arg);
+extern Z80 *machine_z80 (MACHINE *m);
+extern int machine_status (MACHINE *m);
+extern void machine_destroy (MACHINE *m);
+
+extern void machine_exit (int status);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
@@ -13,6 +13,9 @@
   This version has changes by Bill Brendling, allowing larger memory sizes,
   and selective enabling of ROMs.
 
+  ROM subpages are only allocated when first paged in. With -rom-mmap,
+  ROM files are mapped rather than read, so the host loads them on demand.
+
   It implements the memory map rules, as documented in the manual,
   as implemented correctly by MTX500 and MTX512, and REMEMOTECH.
   However, the 512KB extra memory on certain SDXs is known to fail to
@@ -24,6 +27,13 @@
 /*...sincludes:0:*/
 #include "ff_stdio.h"
 #include <string.h>
+#if defined(UNIX) && ! defined(SMALL_MEM)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define MEM_MMAP
+#endif
 
 #include "types.h"
 #include "diag.h"
@@ -49,35 +59,80 @@ extern BOOLEAN dis_instruction(word *a, char *s);
 
 #ifdef SMALL_MEM
 #define MAX_SUBPAGES    1
-static byte *mem_high = NULL;
-static byte *mem_vapour = NULL;
-static const byte *mem_rom_os;
-static const byte *mem_subpages[8][MAX_SUBPAGES];
+static THREAD_LOCAL byte *mem_high = NULL;
+static THREAD_LOCAL byte *mem_vapour = NULL;
+static THREAD_LOCAL const byte *mem_rom_os;
+static THREAD_LOCAL const byte *mem_subpages[8][MAX_SUBPAGES];
 #else
 #define MAX_SUBPAGES    256
-static byte mem_high[ROM_SIZE]; /* Read this when no chip selected (all 1's) */
-static byte mem_vapour[ROM_SIZE]; /* Write here when no chip, or ROM selected */
-static byte mem_rom_os[ROM_SIZE]; /* Monitor ROM */
-static byte *mem_subpages[8][MAX_SUBPAGES];
-#endif
-static int mem_n_subpages[8] = { 0,0,0,0,0,0,0,0 };
-static byte *mem_ram[MAX_BLOCKS];
-static const byte *mem_read[8]; /* Read through these */
-static byte *mem_write[8]; /* Write through these */
-static byte *mem_update[8]; /* Allow emulator to update ROMS */
-static byte mem_iobyte; /* IOBYTE */
-static byte mem_subpage = 0x00;
-static int mem_blocks;
+static THREAD_LOCAL byte mem_high[ROM_SIZE]; /* Read this when no chip selected (all 1's) */
+static THREAD_LOCAL byte mem_vapour[ROM_SIZE]; /* Write here when no chip, or ROM selected */
+static THREAD_LOCAL byte mem_rom_os[ROM_SIZE]; /* Monitor ROM */
+static THREAD_LOCAL byte *mem_subpages[8][MAX_SUBPAGES]; /* NULL until first paged in */
+#endif
+#ifdef MEM_MMAP
+/* ROM files mapped, one for each ROM and one for -largerom */
+#define MEM_MAP_LARGEROM 8
+static THREAD_LOCAL struct
+    {
+    byte *base;
+    size_t len;
+    struct stat st;     /* The file mapped, for mem_hash_roms */
+    } mem_maps[9];
+static THREAD_LOCAL BOOLEAN mem_rom_mmap = FALSE;
+#endif
+static THREAD_LOCAL int mem_n_subpages[8] = { 0,0,0,0,0,0,0,0 };
+static THREAD_LOCAL byte *mem_ram[MAX_BLOCKS];
+THREAD_LOCAL const byte *mem_read[8]; /* Read through these */
+static THREAD_LOCAL byte *mem_write[8]; /* Write through these */
+THREAD_LOCAL byte *mem_z80_write[8]; /* Z80 writes through these, or WrZ80 if NULL */
+static THREAD_LOCAL byte *mem_update[8]; /* Allow emulator to update ROMS */
+THREAD_LOCAL byte *mem_z80_dirty[8]; /* Dirty bits of the RAM in each page */
+static THREAD_LOCAL byte mem_dirty[2*MAX_BLOCKS]; /* MEM_DIRTY_ bits, per 8KB of RAM */
+static THREAD_LOCAL byte mem_dirty_sink; /* Dirty bits for pages without RAM */
+static THREAD_LOCAL MEM_PAGE_DESC mem_desc[8]; /* What each page holds */
+static THREAD_LOCAL byte mem_iobyte; /* IOBYTE */
+static THREAD_LOCAL byte mem_subpage = 0x00;
+static THREAD_LOCAL int mem_blocks;
 #ifdef HAVE_VDEB
-static BOOLEAN bWrChk = FALSE;
+static THREAD_LOCAL byte mem_wrchk_pages = 0; /* Bit for each page with write watch points */
 #endif
+static THREAD_LOCAL BOOLEAN bWrWatch = FALSE;    /* Note original value of memory written by Z80 */
+#define WR_WATCH_MAX    32
+static THREAD_LOCAL int nWrWatch = 0;
+static THREAD_LOCAL struct
+    {
+    byte *pb;
+    byte old;
+    } wr_watch[WR_WATCH_MAX];
 
-/* If enabled, you can snapshot RAM, and query from it */
-static byte *mem_ram_snapshot[MAX_BLOCKS];
-static int mem_blocks_snapshot;
+/* If enabled, you can snapshot RAM, and query from it.
+   A snapshot is a table of versions of each 8KB page of RAM, and a
+   version is shared by all the snapshots in which the page is the same.
+   So taking a snapshot only copies the pages written since the last. */
+#ifndef SMALL_MEM
+typedef struct mem_pver_struct
+    {
+    struct mem_pver_struct *next; /* When on the free list */
+    int refs; /* Number of snapshots sharing this version */
+    int owner; /* Sequence number of the snapshot which copied it */
+    byte data[ROM_SIZE];
+    } MEM_PVER;
+typedef struct
+    {
+    int seq;
+    MEM_PVER *pages[2*MAX_BLOCKS];
+    } MEM_SNAP;
+static THREAD_LOCAL MEM_SNAP *mem_snaps = NULL; /* Ring of snapshots */
+static THREAD_LOCAL int mem_n_snaps = 1; /* Size of the ring */
+static THREAD_LOCAL int mem_snap_count = 0; /* Snapshots in the ring */
+static THREAD_LOCAL int mem_snap_seq = 0; /* Snapshots taken */
+static THREAD_LOCAL MEM_PVER *mem_pver_free = NULL;
+#endif
+static THREAD_LOCAL int mem_blocks_snapshot;
 
 #ifdef DYNAMIC_ROMS
-static int rom_enable = 0xff;
+static THREAD_LOCAL int rom_enable = 0xff;
 
 /*...smem_get_rom_enable:0:*/
 int mem_get_rom_enable (void)
@@ -102,25 +157,152 @@ int mem_get_alloc (void)
 /*...e*/
 #endif
 
+/*...smem_set_z80_write:0:*/
+/* Writes the Z80 can make directly, without the checks in WrZ80 */
+static void mem_set_z80_write(void)
+    {
+    int i;
+    for ( i = 0; i < 8; ++i )
+        mem_z80_write[i] = mem_write[i];
+    if ( ( mem_iobyte & 0x80 ) == 0 )
+        mem_z80_write[0] = NULL;
 #ifdef HAVE_VDEB
-void mem_wrchk (BOOLEAN bChk)
+    for ( i = 0; i < 8; ++i )
+        if ( mem_wrchk_pages & ( 0x01 << i ) )
+            mem_z80_write[i] = NULL;
+#endif
+    if ( bWrWatch && ( nWrWatch <= WR_WATCH_MAX ) )
+        for ( i = 0; i < 8; ++i )
+            mem_z80_write[i] = NULL;
+    }
+/*...e*/
+
+/*...smem_watch:0:*/
+/* While watching, mem_changed reports whether Z80 writes have left
+   memory different to how it was when it was last called. Memory which
+   is written but ends up back as it was (such as the stack) doesn't count.
+   Only a few locations are tracked, writing more counts as a change, and
+   writes are then left at full speed until mem_changed is next called. */
+void mem_watch (BOOLEAN bWatch)
     {
-    bWrChk = bChk;
+    bWrWatch = bWatch;
+    nWrWatch = 0;
+    mem_set_z80_write();
+    }
+
+BOOLEAN mem_changed (void)
+    {
+    BOOLEAN bChanged = ( nWrWatch > WR_WATCH_MAX );
+    int i;
+    if ( bChanged )
+        {
+        nWrWatch = 0;
+        mem_set_z80_write();
+        return TRUE;
+        }
+    for ( i = 0; i < nWrWatch; ++i )
+        if ( *wr_watch[i].pb != wr_watch[i].old )
+            {
+            bChanged = TRUE;
+            break;
+            }
+    nWrWatch = 0;
+    return bChanged;
+    }
+
+static void mem_watch_write (byte *pb)
+    {
+    int i;
+    if ( nWrWatch > WR_WATCH_MAX ) return;
+    for ( i = 0; i < nWrWatch; ++i )
+        if ( wr_watch[i].pb == pb ) return;
+    if ( nWrWatch < WR_WATCH_MAX )
+        {
+        wr_watch[nWrWatch].pb = pb;
+        wr_watch[nWrWatch].old = *pb;
+        ++nWrWatch;
+        }
+    else
+        {
+        nWrWatch = WR_WATCH_MAX + 1;
+        mem_set_z80_write();
+        }
+    }
+/*...e*/
+
+#ifdef HAVE_VDEB
+/* Only writes to the pages given, as a bit for each 8KB page of the
+   current mapping, go through WrZ80 to be checked by vdeb_mwrite */
+void mem_wrchk (byte pages)
+    {
+    mem_wrchk_pages = pages;
+    mem_set_z80_write();
     }
 #endif
 
 #ifndef SMALL_MEM
+/*...smem_subpage_mapped:0:*/
+/* Is the subpage part of a mapped file, rather than allocated */
+static BOOLEAN mem_subpage_mapped(const byte *p)
+    {
+#ifdef MEM_MMAP
+    int i;
+    for ( i = 0; i < 9; ++i )
+        if ( p >= mem_maps[i].base && p < mem_maps[i].base + mem_maps[i].len )
+            return TRUE;
+#endif
+    return FALSE;
+    }
+/*...e*/
+#ifdef MEM_MMAP
+/*...smem_unmap:0:*/
+/* Forget a mapped file, and any subpages within it */
+static void mem_unmap(int imap)
+    {
+    byte *base = mem_maps[imap].base;
+    int rom, i;
+    if ( base == NULL )
+        return;
+    for ( rom = 0; rom < 8; ++rom )
+        for ( i = 0; i < mem_n_subpages[rom]; ++i )
+            if ( mem_subpages[rom][i] >= base && mem_subpages[rom][i] < base + mem_maps[imap].len )
+                mem_subpages[rom][i] = NULL;
+    munmap(base, mem_maps[imap].len);
+    mem_maps[imap].base = NULL;
+    mem_maps[imap].len = 0;
+    }
+/*...e*/
+#endif
+/*...smem_subpage_free:0:*/
+static void mem_subpage_free(int rom, int subpage)
+    {
+    if ( ! mem_subpage_mapped(mem_subpages[rom][subpage]) )
+        free(mem_subpages[rom][subpage]);
+    mem_subpages[rom][subpage] = NULL;
+    }
+/*...e*/
+/*...smem_subpage_get:0:*/
+/* The subpage, allocating it (as all 1's) if this is its first use */
+static byte *mem_subpage_get(int rom, int subpage)
+    {
+    byte *p = mem_subpages[rom][subpage];
+    if ( p == NULL )
+        {
+        p = (byte *) emalloc(ROM_SIZE);
+        memset(p, 0xff, ROM_SIZE);
+        mem_subpages[rom][subpage] = p;
+        }
+    return p;
+    }
+/*...e*/
 /*...smem_set_n_subpages:0:*/
 void mem_set_n_subpages(int rom, int n_subpages)
     {
     int i;
     for ( i = mem_n_subpages[rom]; i < n_subpages; i++ )
-        {
-        mem_subpages[rom][i] = (byte *) emalloc(ROM_SIZE);
-        memset(mem_subpages[rom][i], 0xff, ROM_SIZE);
-        }
+        mem_subpages[rom][i] = NULL;
     for ( ; i < mem_n_subpages[rom]; i++ )
-        free(mem_subpages[rom][i]);
+        mem_subpage_free(rom, i);
     mem_n_subpages[rom] = n_subpages;
     }
 /*...e*/
@@ -160,9 +342,11 @@ void WrZ80(word addr, byte value)
     if ( (addr>>13) != 0 || (mem_iobyte&0x80) != 0 )
         {
         /* Normal write */
+        if ( bWrWatch ) mem_watch_write (&mem_write[addr>>13][addr&0x1fff]);
         mem_write[addr>>13][addr&0x1fff] = value;
+        *mem_z80_dirty[addr>>13] = MEM_DIRTY_ALL;
 #ifdef HAVE_VDEB
-        if ( bWrChk ) vdeb_mwrite (mem_iobyte, addr);
+        if ( mem_wrchk_pages & ( 0x01 << (addr>>13) ) ) vdeb_mwrite (mem_iobyte, addr);
 #endif
         }
     else
@@ -202,21 +386,62 @@ void mem_write_byte(word addr, byte value)
     if ( mem_update[addr>>13] == NULL ) return;
 #endif
     mem_update[addr>>13][addr&0x1fff] = value;
+    *mem_z80_dirty[addr>>13] = MEM_DIRTY_ALL;
+    }
+/*...e*/
+/*...smem_read_span:0:*/
+/* Direct access to the memory read by mem_read_byte, from addr to the
+   end of its 8KB page. *plen is set to the number of bytes to the end
+   of the page. Returns NULL if there is no memory there. */
+const byte *mem_read_span(word addr, word *plen)
+    {
+    const byte *p = mem_read[addr>>13];
+    *plen = (word) ( ROM_SIZE - ( addr & (ROM_SIZE - 1) ) );
+    return ( p != NULL ) ? p + ( addr & (ROM_SIZE - 1) ) : NULL;
+    }
+/*...e*/
+/*...smem_update_span:0:*/
+/* As mem_read_span, but the memory written by mem_write_byte.
+   The page is marked dirty, as the caller is expected to write it. */
+byte *mem_update_span(word addr, word *plen)
+    {
+    byte *p = mem_update[addr>>13];
+    *plen = (word) ( ROM_SIZE - ( addr & (ROM_SIZE - 1) ) );
+    *mem_z80_dirty[addr>>13] = MEM_DIRTY_ALL;
+    return ( p != NULL ) ? p + ( addr & (ROM_SIZE - 1) ) : NULL;
     }
 /*...e*/
 /*...smem_read_block:0:*/
+/* A page at a time, wrapping at 0xffff as mem_read_byte would */
 void mem_read_block(word addr, word len, byte *buf)
     {
-    while ( len-- )
-        *buf++ = mem_read_byte(addr++);
+    while ( len > 0 )
+        {
+        word n;
+        const byte *p = mem_read_span(addr, &n);
+        if ( n > len ) n = len;
+        if ( p != NULL ) memcpy(buf, p, n);
+        else memset(buf, 0xFF, n);
+        addr += n;
+        buf += n;
+        len -= n;
+        }
     }
 /*...e*/
 /*...smem_write_block:0:*/
 void mem_write_block(word addr, word len, const byte *buf)
     {
     // diag_message (DIAG_INIT, "mem_write_block: addr = 0x%04X, ptr = %p", addr, mem_read[addr>>13]);
-    while ( len-- )
-        mem_write_byte(addr++, *buf++);
+    while ( len > 0 )
+        {
+        word n;
+        byte *p = mem_update_span(addr, &n);
+        if ( n > len ) n = len;
+        if ( p != NULL ) memcpy(p, buf, n);
+        addr += n;
+        buf += n;
+        len -= n;
+        }
     }
 /*...e*/
 
@@ -234,6 +459,24 @@ void mem_write_block(word addr, word len, const byte *buf)
 */
 
 
+/*...smem_set_desc:0:*/
+static void mem_set_desc(int ipage, int type, int rom, int subpage)
+    {
+    mem_desc[ipage].type = type;
+    mem_desc[ipage].ram_page = -1;
+    mem_desc[ipage].rom = rom;
+    mem_desc[ipage].subpage = subpage;
+    }
+/*...e*/
+/*...smem_set_desc_ram:0:*/
+static void mem_set_desc_ram(int ipage, int ram_page)
+    {
+    mem_desc[ipage].type = MEMT_RAM_NO_SNAPSHOT;
+    mem_desc[ipage].ram_page = ram_page;
+    mem_desc[ipage].rom = -1;
+    mem_desc[ipage].subpage = 0;
+    }
+/*...e*/
 /*...smem_set_iobyte_ram:0:*/
 static void mem_set_iobyte_ram(int ipage, int iblock)
     {
@@ -245,6 +488,10 @@ static void mem_set_iobyte_ram(int ipage, int iblock)
         mem_read  [2*ipage+1] = mem_ram[iblock]+ROM_SIZE;
         mem_write [2*ipage+1] = mem_ram[iblock]+ROM_SIZE;
         mem_update[2*ipage+1] = mem_ram[iblock]+ROM_SIZE;
+        mem_z80_dirty[2*ipage  ] = &mem_dirty[2*iblock  ];
+        mem_z80_dirty[2*ipage+1] = &mem_dirty[2*iblock+1];
+        mem_set_desc_ram(2*ipage  , 2*iblock  );
+        mem_set_desc_ram(2*ipage+1, 2*iblock+1);
         }
     else
         {
@@ -254,6 +501,10 @@ static void mem_set_iobyte_ram(int ipage, int iblock)
         mem_read  [2*ipage+1] = mem_high ;
         mem_write [2*ipage+1] = mem_vapour;
         mem_update[2*ipage+1] = mem_vapour;
+        mem_z80_dirty[2*ipage  ] = &mem_dirty_sink;
+        mem_z80_dirty[2*ipage+1] = &mem_dirty_sink;
+        mem_set_desc(2*ipage  , MEMT_VOID, 0, 0);
+        mem_set_desc(2*ipage+1, MEMT_VOID, 0, 0);
         }
     }
 /*...e*/
@@ -273,6 +524,10 @@ void mem_set_iobyte(byte val)
 #endif
     mem_read[7] = mem_write[7] = mem_update[7] = mem_ram[0] + ROM_SIZE;
     mem_read[6] = mem_write[6] = mem_update[6] = mem_ram[0];
+    mem_z80_dirty[7] = &mem_dirty[1];
+    mem_z80_dirty[6] = &mem_dirty[0];
+    mem_set_desc_ram(7, 1);
+    mem_set_desc_ram(6, 0);
     if ( mem_iobyte & 0x80 )
         {
         iblock = 3 * ( mem_iobyte & 0x0f ) + 1;
@@ -287,6 +542,9 @@ void mem_set_iobyte(byte val)
         {
         mem_read[0] = mem_rom_os;
         mem_write[0] = mem_vapour;
+        mem_z80_dirty[0] = &mem_dirty_sink;
+        mem_z80_dirty[1] = &mem_dirty_sink;
+        mem_set_desc(0, MEMT_ROM, -1, 0);
 #ifdef SMALL_MEM
         mem_update[0] = NULL;
 #else
@@ -302,6 +560,7 @@ void mem_set_iobyte(byte val)
 #else
             mem_update[1] = mem_vapour;
 #endif
+            mem_set_desc(1, MEMT_VOID, 0, 0);
             /*
               diag_message (DIAG_INIT, "iobyte = 0x%02X, rom_enable = 0x%02X,  ROM Disabled, ptr = %p",
               mem_iobyte, rom_enable, mem_read[1]);
@@ -311,11 +570,12 @@ void mem_set_iobyte(byte val)
 #endif
             {
             int mask = mem_n_subpages[irom]-1;
+            mem_set_desc(1, MEMT_ROM, irom, mem_subpage&mask);
 #ifdef SMALL_MEM
             mem_read[1] = mem_subpages[irom][mem_subpage&mask];
             mem_update[1] = NULL;
 #else
-            mem_update[1] = mem_subpages[irom][mem_subpage&mask];
+            mem_update[1] = mem_subpage_get(irom, mem_subpage&mask);
             mem_read[1] = mem_update[1];
 #endif
             /*
@@ -336,8 +596,13 @@ void mem_set_iobyte(byte val)
             mem_write[3] = mem_vapour;
             mem_update[2] = mem_vapour;
             mem_update[3] = mem_vapour;
+            mem_z80_dirty[2] = &mem_dirty_sink;
+            mem_z80_dirty[3] = &mem_dirty_sink;
+            mem_set_desc(2, MEMT_VOID, 0, 0);
+            mem_set_desc(3, MEMT_VOID, 0, 0);
             }
         }
+    mem_set_z80_write();
     /*
     for ( int i = 0; i < 8; ++i )
         {
@@ -387,69 +652,333 @@ void mem_alloc(int nblocks)
     mem_blocks = nblocks;
     for ( i = 0; i < nblocks; ++i )
         if ( mem_ram[i] == NULL )
+            {
             mem_ram[i] = (byte *) emalloc(0x4000);
+            mem_dirty[2*i  ] = MEM_DIRTY_ALL;
+            mem_dirty[2*i+1] = MEM_DIRTY_ALL;
+            }
     mem_set_iobyte(mem_iobyte); /* Recalculate page visibility */
     }
 /*...e*/
 
+/*...smem_get_dirty:0:*/
+/* Dirty bits are kept for each 8KB page of RAM, numbered from 0 to
+   2 * mem_get_alloc() - 1, the RAM of block n being pages 2n and 2n+1.
+   Every write to the page sets all the bits, and each user of them
+   clears its own bit once it has dealt with the page. */
+byte mem_get_dirty(int ipage)
+    {
+    return mem_dirty[ipage];
+    }
+/*...e*/
+/*...smem_clear_dirty:0:*/
+void mem_clear_dirty(int ipage, byte bits)
+    {
+    mem_dirty[ipage] &= ~bits;
+    }
+/*...e*/
+/*...smem_ram_page:0:*/
+/* The RAM of a page, for reading. Write through mem_write_byte or
+   mem_update_span, so that the write is noted. */
+const byte *mem_ram_page(int ipage)
+    {
+    return mem_ram[ipage/2] + (ipage&1) * ROM_SIZE;
+    }
+/*...e*/
+
 #ifndef SMALL_MEM
+/*...smem_save_state:0:*/
+/* The memory part of a save-state (see state.c). ROMs are not saved,
+   they come from the configuration. */
+void mem_save_state(STATE *st)
+    {
+    int i;
+    state_put_byte(st, mem_iobyte);
+    state_put_byte(st, mem_subpage);
+#ifdef DYNAMIC_ROMS
+    state_put_byte(st, (byte) rom_enable);
+#else
+    state_put_byte(st, 0xff);
+#endif
+    state_put_byte(st, (byte) mem_blocks);
+    for ( i = 0; i < mem_blocks; ++i )
+        state_put_block(st, mem_ram[i], 0x4000);
+    }
+/*...e*/
+/*...smem_load_state:0:*/
+void mem_load_state(STATE *st, int version)
+    {
+    byte iobyte = state_get_byte(st);
+    byte subpage = state_get_byte(st);
+    byte ren = state_get_byte(st);
+    int nblocks = state_get_byte(st);
+    int i;
+    if ( nblocks < 2 || nblocks > MAX_BLOCKS )
+        {
+        st->bad = TRUE;
+        return;
+        }
+    if ( nblocks != mem_blocks )
+        mem_alloc(nblocks);
+    for ( i = 0; i < nblocks; ++i )
+        {
+        state_get_block(st, mem_ram[i], 0x4000);
+        mem_dirty[2*i  ] = MEM_DIRTY_ALL;
+        mem_dirty[2*i+1] = MEM_DIRTY_ALL;
+        }
+#ifdef DYNAMIC_ROMS
+    rom_enable = ren;
+#else
+    (void) ren;
+#endif
+    mem_subpage = subpage;
+    mem_set_iobyte(iobyte);
+    }
+/*...e*/
+/*...smem_check_state:0:*/
+/* Whether a memory chunk can be loaded, without loading it */
+BOOLEAN mem_check_state(STATE *st, int version)
+    {
+    int nblocks;
+    state_get_byte(st);
+    state_get_byte(st);
+    state_get_byte(st);
+    nblocks = state_get_byte(st);
+    if ( st->bad || nblocks < 2 || nblocks > MAX_BLOCKS )
+        return FALSE;
+    return ( st->len - st->pos >= (size_t) nblocks * 0x4000 );
+    }
+/*...e*/
+/*...smem_hash_roms:0:*/
+#ifdef MEM_MMAP
+/* Continue hash h over which file a mapped subpage comes from, rather
+   than its contents, so the file isn't all read in. Any patches made
+   to it follow from the options, which are hashed as well. FALSE if
+   the subpage isn't mapped. */
+static BOOLEAN mem_hash_mapped(unsigned long long *h, const byte *p)
+    {
+    int imap;
+    for ( imap = 0; imap < 9; ++imap )
+        if ( mem_maps[imap].base != NULL && p >= mem_maps[imap].base
+            && p < mem_maps[imap].base + mem_maps[imap].len )
+            {
+            const struct stat *st = &mem_maps[imap].st;
+            unsigned long long id[5];
+            id[0] = (unsigned long long) st->st_dev;
+            id[1] = (unsigned long long) st->st_ino;
+            id[2] = (unsigned long long) st->st_size;
+            id[3] = (unsigned long long) st->st_mtime;
+            id[4] = (unsigned long long) ( p - mem_maps[imap].base );
+            *h = state_hash(*h, id, sizeof(id));
+            return TRUE;
+            }
+    return FALSE;
+    }
+#endif
+
+/* Continue hash h over the contents of the ROMs, as they are now,
+   without allocating the subpages which haven't been used, or
+   touching those mapped from files */
+unsigned long long mem_hash_roms(unsigned long long h)
+    {
+    static const byte absent = 0;
+    int rom, i;
+    h = state_hash(h, mem_rom_os, ROM_SIZE);
+    for ( rom = 0; rom < 8; ++rom )
+        {
+        h = state_hash(h, &mem_n_subpages[rom], sizeof(mem_n_subpages[rom]));
+        for ( i = 0; i < mem_n_subpages[rom]; ++i )
+            if ( mem_subpages[rom][i] == NULL )
+                h = state_hash(h, &absent, 1);
+#ifdef MEM_MMAP
+            else if ( mem_hash_mapped(&h, mem_subpages[rom][i]) )
+                ;
+#endif
+            else
+                h = state_hash(h, mem_subpages[rom][i], ROM_SIZE);
+        }
+    return h;
+    }
+/*...e*/
+#endif
+
+/*...smem_term:0:*/
+/* Release the RAM and ROM images, so a machine started within a
+   longer running process (see machine.h) doesn't leave them behind */
+void mem_term (void)
+    {
+    int i;
+    for ( i = 0; i < MAX_BLOCKS; ++i )
+        {
+        free (mem_ram[i]);
+        mem_ram[i] = NULL;
+        }
+    mem_blocks = 0;
+    mem_blocks_snapshot = 0;
+    memset (mem_dirty, 0, sizeof (mem_dirty));
+#ifndef SMALL_MEM
+    mem_set_n_snapshots (1);
+    while ( mem_pver_free != NULL )
+        {
+        MEM_PVER *v = mem_pver_free;
+        mem_pver_free = v->next;
+        free (v);
+        }
+    for ( i = 0; i < 8; ++i )
+        mem_set_n_subpages (i, 0);
+#endif
+#ifdef MEM_MMAP
+    for ( i = 0; i < 9; ++i )
+        mem_unmap (i);
+#endif
+    }
+/*...e*/
+
+#ifndef SMALL_MEM
+/*...smem_pver_release:0:*/
+static void mem_pver_release(MEM_PVER *v)
+    {
+    if ( v != NULL && --v->refs == 0 )
+        {
+        v->next = mem_pver_free;
+        mem_pver_free = v;
+        }
+    }
+/*...e*/
+/*...smem_set_n_snapshots:0:*/
+/* Set how many snapshots are kept, discarding any already taken */
+void mem_set_n_snapshots(int n)
+    {
+    int i, j;
+    if ( n < 1 )
+        fatal("invalid number of snapshots");
+    if ( mem_snaps != NULL )
+        {
+        for ( i = 0; i < mem_n_snaps; ++i )
+            for ( j = 0; j < 2*MAX_BLOCKS; ++j )
+                mem_pver_release(mem_snaps[i].pages[j]);
+        free(mem_snaps);
+        mem_snaps = NULL;
+        }
+    mem_n_snaps = n;
+    mem_snap_count = 0;
+    mem_snap_seq = 0;
+    }
+/*...e*/
 /*...smem_alloc_snapshot:0:*/
 void mem_alloc_snapshot(int nblocks)
     {
-    int i;
     if ( ( nblocks < 0 ) || ( nblocks > MAX_BLOCKS ) )
         fatal("invalid amount of snapshot memory");
     mem_blocks_snapshot = nblocks;
-    for ( i = 0; i < nblocks; ++i )
-        if ( mem_ram_snapshot[i] == NULL )
-            mem_ram_snapshot[i] = (byte *) emalloc(0x4000);
     }
 /*...e*/
 /*...smem_snapshot:0:*/
+/* Take a snapshot, replacing the oldest once the ring is full.
+   Pages not written since the last snapshot share its version. */
 void mem_snapshot(void)
     {
+    int npages = 2 * ( ( mem_blocks < mem_blocks_snapshot ) ? mem_blocks : mem_blocks_snapshot );
+    const MEM_SNAP *prev;
+    MEM_SNAP *snap;
     int i;
-    for ( i = 0; i < mem_blocks && i < mem_blocks_snapshot; i++ )
-        memcpy(mem_ram_snapshot[i], mem_ram[i], 0x4000);
+    if ( npages == 0 )
+        return;
+    if ( mem_snaps == NULL )
+        {
+        mem_snaps = (MEM_SNAP *) emalloc(mem_n_snaps * sizeof(MEM_SNAP));
+        memset(mem_snaps, 0, mem_n_snaps * sizeof(MEM_SNAP));
+        }
+    prev = ( mem_snap_count > 0 ) ? &mem_snaps[(mem_snap_seq-1) % mem_n_snaps] : NULL;
+    snap = &mem_snaps[mem_snap_seq % mem_n_snaps];
+    /* prev and snap are the same when only one snapshot is kept,
+       so take a reference to the new version before releasing the old */
+    for ( i = 0; i < 2*MAX_BLOCKS; ++i )
+        {
+        MEM_PVER *v = NULL;
+        if ( i < npages )
+            {
+            if ( prev != NULL && prev->pages[i] != NULL && ( mem_dirty[i] & MEM_DIRTY_SNAPSHOT ) == 0 )
+                v = prev->pages[i];
+            else
+                {
+                if ( (v = mem_pver_free) != NULL )
+                    mem_pver_free = v->next;
+                else
+                    v = (MEM_PVER *) emalloc(sizeof(MEM_PVER));
+                v->refs = 0;
+                v->owner = mem_snap_seq;
+                memcpy(v->data, mem_ram_page(i), ROM_SIZE);
+                mem_dirty[i] &= ~MEM_DIRTY_SNAPSHOT;
+                }
+            ++v->refs;
+            }
+        mem_pver_release(snap->pages[i]);
+        snap->pages[i] = v;
+        }
+    snap->seq = mem_snap_seq++;
+    if ( mem_snap_count < mem_n_snaps )
+        ++mem_snap_count;
+    }
+/*...e*/
+/*...smem_snapshot_count:0:*/
+int mem_snapshot_count(void)
+    {
+    return mem_snap_count;
+    }
+/*...e*/
+/*...smem_snapshot_page:0:*/
+/* The version of the RAM at addr in a snapshot, age 0 being the latest,
+   or NULL if it isn't in the snapshot */
+static const MEM_PVER *mem_snapshot_page(int age, word addr)
+    {
+    int ram_page = mem_desc[addr>>13].ram_page;
+    if ( age < 0 || age >= mem_snap_count || ram_page < 0 )
+        return NULL;
+    return mem_snaps[(mem_snap_seq-1-age) % mem_n_snaps].pages[ram_page];
+    }
+/*...e*/
+/*...smem_snapshot_owner:0:*/
+/* The sequence number of the snapshot which copied the page holding addr,
+   for the snapshot of a given age. -1 if the page isn't in it. */
+int mem_snapshot_owner(int age, word addr)
+    {
+    const MEM_PVER *v = mem_snapshot_page(age, addr);
+    return ( v != NULL ) ? v->owner : -1;
+    }
+/*...e*/
+/*...smem_read_byte_snapshot_age:0:*/
+byte mem_read_byte_snapshot_age(int age, word addr)
+    {
+    const MEM_PVER *v = mem_snapshot_page(age, addr);
+    return ( v != NULL ) ? v->data[addr&0x1fff] : mem_read_byte(addr);
     }
 /*...e*/
 /*...smem_read_byte_snapshot:0:*/
 byte mem_read_byte_snapshot(word addr)
     {
-    const byte *p = mem_read[addr>>13];
-    int i;
-    for ( i = 0; i < mem_blocks && i < mem_blocks_snapshot; i++ )
-        if ( p >= mem_ram[i] && p < mem_ram[i]+0x4000 )
-            {
-            p = p - mem_ram[i] + mem_ram_snapshot[i];
-            break;
-            }
-    return p[addr&0x1fff];
+    return mem_read_byte_snapshot_age(0, addr);
     }
 /*...e*/
 
 /*...smem_type_at_address:0:*/
 int mem_type_at_address(word addr)
     {
-    const byte *p = mem_read[addr>>13];
-    int i, j;
-    for ( i = 0; i < mem_blocks && i < mem_blocks_snapshot; i++ )
-        if ( p >= mem_ram[i] && p < mem_ram[i]+0x4000 )
-            return MEMT_RAM_SNAPSHOT;
-    for ( ; i < mem_blocks ; i++ )
-        if ( p >= mem_ram[i] && p < mem_ram[i]+0x4000 )
-            return MEMT_RAM_NO_SNAPSHOT;
-    if ( p >= mem_rom_os && p < mem_rom_os+ROM_SIZE )
-        return MEMT_ROM;
-    for ( i = 0; i < 8; i++ )	
-        for ( j = 0; j < mem_n_subpages[i]; j++ )
-            if ( p >= mem_subpages[i][j] && p < mem_subpages[i][j]+ROM_SIZE )
-                return MEMT_ROM;
-    return MEMT_VOID;
+    const MEM_PAGE_DESC *desc = &mem_desc[addr>>13];
+    if ( desc->type == MEMT_RAM_NO_SNAPSHOT && desc->ram_page < 2 * mem_blocks_snapshot )
+        return MEMT_RAM_SNAPSHOT;
+    return desc->type;
     }
 /*...e*/
 #endif
 
+/*...smem_get_page_desc:0:*/
+const MEM_PAGE_DESC *mem_get_page_desc(word addr)
+    {
+    return &mem_desc[addr>>13];
+    }
+/*...e*/
+
 /*...smem_init_mtx:0:*/
 void mem_init_mtx(void)
     {
@@ -458,7 +987,6 @@ void mem_init_mtx(void)
     for ( i = 0; i < MAX_BLOCKS; ++i )
         {
         mem_ram         [i] = NULL;
-        mem_ram_snapshot[i] = NULL;
         }
 #ifndef SMALL_MEM
     memset(mem_high, 0xff, ROM_SIZE);
@@ -471,8 +999,8 @@ void mem_init_mtx(void)
     mem_set_n_subpages(6,  1);
     mem_set_n_subpages(7,  1);
     memcpy(mem_rom_os        , rom_os   , ROM_SIZE);
-    memcpy(mem_subpages[0][0], rom_basic, ROM_SIZE);
-    memcpy(mem_subpages[1][0], rom_assem, ROM_SIZE);
+    memcpy(mem_subpage_get(0, 0), rom_basic, ROM_SIZE);
+    memcpy(mem_subpage_get(1, 0), rom_assem, ROM_SIZE);
     mem_alloc_snapshot(0);
 #else
     /*
@@ -525,15 +1053,82 @@ void mem_dump(void)
 byte *mem_rom_ptr(int rom)
     {
     int mask = mem_n_subpages[rom]-1;
-    return mem_subpages[rom][mem_subpage&mask];
+    return mem_subpage_get(rom, mem_subpage&mask);
+    }
+/*...e*/
+
+#ifdef MEM_MMAP
+/*...smem_set_rom_mmap:0:*/
+void mem_set_rom_mmap(BOOLEAN bMap)
+    {
+    mem_rom_mmap = bMap;
+    }
+/*...e*/
+/*...smem_map:0:*/
+/* Map a ROM file, copy on write so it may still be patched.
+   NULL if it can't, or the file is shorter than min_len,
+   leaving the caller to read it in the usual way. */
+static byte *mem_map(int imap, const char *fname, size_t min_len, size_t *plen)
+    {
+    int fd = open(fname, O_RDONLY);
+    struct stat st;
+    byte *base;
+    if ( fd < 0 )
+        return NULL;
+    if ( fstat(fd, &st) < 0 || st.st_size == 0 || (size_t) st.st_size < min_len )
+        {
+        close(fd);
+        return NULL;
+        }
+    base = (byte *) mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( base == (byte *) MAP_FAILED )
+        return NULL;
+    mem_unmap(imap);
+    mem_maps[imap].base = base;
+    mem_maps[imap].len = st.st_size;
+    mem_maps[imap].st = st;
+    *plen = st.st_size;
+    return base;
+    }
+/*...e*/
+/*...smem_map_rom:0:*/
+/* Use a mapped ROM file, if it is a whole number of subpages
+   which all fit, otherwise the file is read as before */
+static BOOLEAN mem_map_rom(int rom, const char *fname)
+    {
+    byte *base;
+    size_t len;
+    int i, n;
+    if ( (base = mem_map(rom, fname, 0, &len)) == NULL )
+        return FALSE;
+    n = (int) ( len / ROM_SIZE );
+    if ( len % ROM_SIZE != 0 || n > mem_n_subpages[rom] )
+        {
+        mem_unmap(rom);
+        return FALSE;
+        }
+    for ( i = 0; i < n; ++i )
+        {
+        mem_subpage_free(rom, i);
+        mem_subpages[rom][i] = base + i * ROM_SIZE;
+        }
+    diag_message (DIAG_INIT, "load_rom: Mapped %d sub-pages from %s into ROM %d", n, fname, rom);
+    mem_set_iobyte(mem_iobyte);
+    return TRUE;
     }
 /*...e*/
+#endif
 
 void load_rom (int rom, const char *fname)
     {
     fname = PMapPath (fname);
     if ( rom < 0 || rom > 7 )
         fatal("ROM must be between 0 and 7");
+#ifdef MEM_MMAP
+    if ( mem_rom_mmap && mem_map_rom(rom, fname) )
+        return;
+#endif
 #ifdef SMALL_MEM
     FILE *fp = efopen(fname, "rb");;
     size_t size;
@@ -630,6 +1225,30 @@ void load_rompair (int rom, const char *fname)
 void load_largerom (const char *psFlags, const char *psFile)
     {
     psFile = PMapPath (psFile);
+#ifdef MEM_MMAP
+    size_t len;
+    byte *base;
+    if ( mem_rom_mmap && (base = mem_map(MEM_MAP_LARGEROM, psFile, 16 * ROM_SIZE, &len)) != NULL )
+        {
+        for ( ; *psFlags; ++psFlags )
+            {
+            int rom = *psFlags;
+            if (( rom == 'S' ) || ( rom == 's' ))
+                memcpy (mem_rom_os, base, ROM_SIZE);
+            else if (( rom >= '0' ) && ( rom <= '7' ))
+                {
+                rom -= '0';
+                mem_subpage_free(rom, 0);
+                mem_subpages[rom][0] = base + ROM_SIZE * ( 2 * rom + 1 );
+                }
+            else
+                fatal ("Invalid ROM selector");
+            }
+        diag_message (DIAG_INIT, "load_largerom: Mapped ROMs from %s", psFile);
+        mem_set_iobyte(mem_iobyte);
+        return;
+        }
+#endif
     FILE *pf = efopen (psFile, "rb");
     while ( *psFlags )
         {
@@ -644,7 +1263,7 @@ void load_largerom (const char *psFlags, const char *psFile)
             {
             rom -= '0';
             fseek (pf, ROM_SIZE * ( 2 * rom + 1 ), SEEK_SET);
-            if ( fread (mem_subpages[rom][0], 1, ROM_SIZE, pf) != ROM_SIZE ) fatal ("Error loading ROM");
+            if ( fread (mem_subpage_get(rom, 0), 1, ROM_SIZE, pf) != ROM_SIZE ) fatal ("Error loading ROM");
             diag_message (DIAG_INIT, "load_largerom: Loaded ROM %d from %s", rom, psFile);
             }
         else
@@ -659,14 +1278,7 @@ void load_largerom (const char *psFlags, const char *psFile)
 #ifdef SMALL_MEM
 byte *mem_ram_ptr (word addr, word *psize)
     {
-    byte *ptr = mem_update[addr>>13];
-    if ( ptr == NULL ) *psize = 0;
-    else
-        {
-        int ofs = addr & (ROM_SIZE - 1);
-        ptr += ofs;
-        *psize = ROM_SIZE - ofs;
-        }
+    byte *ptr = mem_update_span(addr, psize);
     // printf ("mem_ram_ptr(0x%04X): ptr = %p, size = %d\n", addr, ptr, *psize);
     if ( ptr == NULL ) fatal ("No memory");
     return ptr;
@@ -679,6 +1291,7 @@ int mem_file_load (FILE *f, word addr, word len)
         {
         byte *ptr = mem_update[addr>>13];
         if ( ptr == NULL ) fatal ("attempt to load file into read-only memory");
+        *mem_z80_dirty[addr>>13] = MEM_DIRTY_ALL;
         int ofs = addr & (ROM_SIZE - 1);
         ptr += ofs;
         int blen = ROM_SIZE - ofs;
@@ -24,6 +24,16 @@ mem.h - MTX memory
 #define	MEMT_RAM_SNAPSHOT    2
 #define	MEMT_RAM_NO_SNAPSHOT 3
 
+/* What is visible in an 8KB page of the Z80 address space,
+   as set by mem_set_iobyte and mem_set_rom_subpage */
+typedef struct
+    {
+    int type;       /* MEMT_VOID, MEMT_ROM or MEMT_RAM_NO_SNAPSHOT for any RAM */
+    int ram_page;   /* RAM: its 8KB page, as numbered for mem_get_dirty */
+    int rom;        /* ROM: which, or -1 for the OS ROM */
+    int subpage;    /* ROM: its subpage */
+    } MEM_PAGE_DESC;
+
 extern void mem_set_n_subpages(int rom, int n_subpages);
 extern int  mem_get_n_subpages(int rom);
 
@@ -57,30 +67,84 @@ extern int mem_get_alloc (void);
 extern byte RdZ80(word addr);
 extern void WrZ80(word addr, byte value);
 
+/* Page tables, exposed so that the Z80 core can access memory inline.
+   mem_z80_write[page] is NULL when a write must go through WrZ80:
+   the RELCPMH=0 sub-page select, write watchpoints, or no memory.
+   mem_z80_dirty[page] points to the dirty bits of the RAM in the page,
+   all of which are set by any write (see mem_get_dirty). */
+extern THREAD_LOCAL const byte *mem_read[8];
+extern THREAD_LOCAL byte *mem_z80_write[8];
+extern THREAD_LOCAL byte *mem_z80_dirty[8];
+
+/* Users of the dirty bits, each having one of them */
+#define MEM_DIRTY_SNAPSHOT  0x01
+#define MEM_DIRTY_ALL       0xff
+
+static inline byte mem_z80_rd(word addr)
+    {
+#ifdef SMALL_MEM
+    if ( mem_read[addr>>13] == NULL ) return 0xFF;
+#endif
+    return mem_read[addr>>13][addr&0x1fff];
+    }
+
+static inline void mem_z80_wr(word addr, byte value)
+    {
+    byte *p = mem_z80_write[addr>>13];
+    if ( p != NULL )
+        {
+        p[addr&0x1fff] = value;
+        *mem_z80_dirty[addr>>13] = MEM_DIRTY_ALL;
+        }
+    else
+        WrZ80(addr, value);
+    }
+
 extern byte mem_read_byte(word addr);
 extern void mem_write_byte(word addr, byte value);
 extern void mem_read_block(word addr, word len, byte *buf);
 extern void mem_write_block(word addr, word len, const byte *buf);
+extern const byte *mem_read_span(word addr, word *plen);
+extern byte *mem_update_span(word addr, word *plen);
 extern void mem_set_iobyte(byte val);
 extern byte mem_get_iobyte(void);
 extern byte mem_get_rom_subpage(void);
 extern void mem_set_rom_subpage(byte subpage);
 extern void mem_out0(byte val);
-extern void mem_wrchk (BOOLEAN bChk);
+extern void mem_wrchk (byte pages);
+extern void mem_watch (BOOLEAN bWatch);
+extern BOOLEAN mem_changed (void);
 
 extern void mem_alloc(int nblocks);
+extern byte mem_get_dirty(int ipage);
+extern void mem_clear_dirty(int ipage, byte bits);
+extern const byte *mem_ram_page(int ipage);
+#ifndef SMALL_MEM
+#include "state.h"
+extern void mem_save_state(STATE *st);
+extern void mem_load_state(STATE *st, int version);
+extern BOOLEAN mem_check_state(STATE *st, int version);
+extern unsigned long long mem_hash_roms(unsigned long long h);
+#endif
+extern void mem_term (void);
 
+extern void mem_set_n_snapshots(int n);
 extern void mem_alloc_snapshot(int nblocks);
 extern void mem_snapshot();
+extern int mem_snapshot_count(void);
+extern int mem_snapshot_owner(int age, word addr);
+extern byte mem_read_byte_snapshot_age(int age, word addr);
 extern byte mem_read_byte_snapshot(word addr);
 
 /* Return MEMT_ value for address */
 extern int mem_type_at_address(word addr);
+extern const MEM_PAGE_DESC *mem_get_page_desc(word addr);
 
 extern void mem_init_mtx(void);
 extern void mem_dump(void);
 
 extern byte *mem_rom_ptr(int rom);
+extern void mem_set_rom_mmap(BOOLEAN bMap);
 extern void load_rom (int rom, const char *fname);
 extern void load_rompair (int rom, const char *fname);
 extern void load_largerom (const char *psFlags, const char *psFile);
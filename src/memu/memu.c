@@ -59,6 +59,11 @@ memu.c - Memotech Emulator
 #include "sid.h"
 #endif
 #include "printer.h"
+#include "trace.h"
+#include "bench.h"
+#include "state.h"
+#include "rewind.h"
+#include "replay.h"
 #ifdef HAVE_SPEC
 #include "spec.h"
 #endif
@@ -90,6 +95,9 @@ memu.c - Memotech Emulator
 #endif
 #include "nfx.h"
 #include "dirmap.h"
+#ifdef MEMU_MULTI
+#include "machine.h"
+#endif
 
 /*...vZ80\46\h:0:*/
 /*...vtypes\46\h:0:*/
@@ -108,6 +116,11 @@ memu.c - Memotech Emulator
 /*...vsdxfdc\46\h:0:*/
 /*...vsid\46\h:0:*/
 /*...vprinter\46\h:0:*/
+/*...vtrace\46\h:0:*/
+/*...vbench\46\h:0:*/
+/*...vstate\46\h:0:*/
+/*...vrewind\46\h:0:*/
+/*...vreplay\46\h:0:*/
 /*...vspec\46\h:0:*/
 /*...vcpm\46\h:0:*/
 /*...vdis\46\h:0:*/
@@ -124,7 +137,7 @@ extern void ALT_USAGE (void);
 extern void ALT_EXIT (int reason);
 #endif
 
-const char *psExe = "memu";
+THREAD_LOCAL const char *psExe = "memu";
 
 void usage(const char *psErr, ...)
 	{
@@ -144,10 +157,13 @@ void usage(const char *psErr, ...)
 	fprintf(stderr, "       -mem file            load file at address\n");
 	fprintf(stderr, "       -mem-blocks n        number of 16KB memory blocks (default 4)\n");
 	fprintf(stderr, "       -mem-mtx500          equivelent to -mem-blocks 2\n");
+	fprintf(stderr, "       -mem-blocks-snapshot n  number of 16KB memory blocks in RAM snapshots\n");
+	fprintf(stderr, "       -mem-snapshots n     number of RAM snapshots kept (default 1)\n");
 #ifndef SMALL_MEM
 	fprintf(stderr, "       -n-subpages rom n    set number of subpages\n");
 	fprintf(stderr, "       -romX file           load ROM X from file\n");
 	fprintf(stderr, "       -rompairX file       load ROM X and X+1 from file\n");
+	fprintf(stderr, "       -rom-mmap            map subsequent ROM files, rather than reading them\n");
 	fprintf(stderr, "       -largerom roms file  load roms (S,0-7) from single file\n");
 #endif
 	fprintf(stderr, "       -vid-win             emulate VDP and TV using a graphical window\n");
@@ -157,6 +173,7 @@ void usage(const char *psErr, ...)
 	fprintf(stderr, "       -vid-win-title       set title for VDP window\n");
 	fprintf(stderr, "       -vid-win-display     set display to use for VDP window\n");
 	fprintf(stderr, "       -vid-ntsc            refresh at 60Hz (instead of 50Hz)\n");
+	fprintf(stderr, "       -vid-scanline        draw VDP picture a line at a time as it is displayed\n");
 	fprintf(stderr, "       -snd-portaudio,-s    emulate sound chip using portaudio\n");
 	fprintf(stderr, "       -snd-latency value   instruct portaudio to use a given latency\n");
 	fprintf(stderr, "       -mon-win             emulate 80 column card using a graphical window\n");
@@ -247,6 +264,25 @@ void usage(const char *psErr, ...)
 #endif
 	fprintf(stderr, "       -speed hz            set CPU speed (default is 4000000, ie: 4MHz)\n");
 	fprintf(stderr, "       -fast                don't limit speed, run as fast as possible\n");
+	fprintf(stderr, "       -idle-loop addr      also skip repeats of idle loop with head at addr\n");
+	fprintf(stderr, "       -no-idle             don't skip over HALT or idle loops\n");
+	fprintf(stderr, "       -trace n             record the last n instructions executed\n");
+	fprintf(stderr, "       -trace-file file     file for -trace (default is memu.trc)\n");
+	fprintf(stderr, "       -bench file          append a performance report to file on exit\n");
+	fprintf(stderr, "       -run-clocks n        exit after running for n Z80 clock cycles\n");
+	fprintf(stderr, "       -state-file file     save-state file (default is memu.mst)\n");
+	fprintf(stderr, "       -state-load          start from the save-state file\n");
+	fprintf(stderr, "       -state-checkpoint s  save state every s seconds of emulated time\n");
+	fprintf(stderr, "       -boot-cache file     start from the state at the prompt, cached in file\n");
+	fprintf(stderr, "       -rewind n            keep the state every n frames, to allow rewinding\n");
+	fprintf(stderr, "       -rewind-kb kb        memory for -rewind (default is 8192KB)\n");
+	fprintf(stderr, "       -record file         record the inputs from outside the machine\n");
+	fprintf(stderr, "       -replay file         replay the inputs recorded by -record\n");
+	fprintf(stderr, "       -replay-headless     with -replay, no windows, as fast as possible\n");
+	fprintf(stderr, "       -timing mode         fast (default), or accurate to add wait states\n");
+	fprintf(stderr, "       -wait-m1 n           wait states on each M1 cycle (implies -timing accurate)\n");
+	fprintf(stderr, "       -wait-io port n      wait states on each access to port (implies -timing accurate)\n");
+	fprintf(stderr, "       -wait-mem page n     wait states on each access to 8KB page 0-7 (implies -timing accurate)\n");
 	fprintf(stderr, "       -run-no-interrupts   disable interrupts loading RUN files from command line\n");
 	/*
 	fprintf(stderr, "       -ui-mem-title        set title for memory window\n");
@@ -271,14 +307,16 @@ void usage(const char *psErr, ...)
         va_end (va);
         fprintf (stderr, "\n");
         }
-#ifdef ALT_EXIT
+#if defined(ALT_EXIT)
 	ALT_EXIT(2);
+#elif defined(MEMU_MULTI)
+	machine_exit(2);
 #else
 	exit(2);
 #endif
 	}
 /*...e*/
-static BOOLEAN bIgnore = FALSE;
+static THREAD_LOCAL BOOLEAN bIgnore = FALSE;
 
 void unimplemented (const char *psErr)
     {
@@ -354,34 +392,58 @@ static void put_word(byte *p, word w)
 /*...e*/
 
 /*...svars:0:*/
-CFG cfg;
+THREAD_LOCAL CFG cfg;
 
-static Z80 z80;
-static BOOLEAN moderate_speed = TRUE;
+static THREAD_LOCAL Z80 z80;
+static THREAD_LOCAL BOOLEAN moderate_speed = TRUE;
+/* Wait states charged with -timing accurate. By default, one on each M1
+   cycle, and one on each access to the VDP ports. */
+static THREAD_LOCAL BOOLEAN timing_accurate = FALSE;
+static THREAD_LOCAL Z80Waits z80_waits = { 1, { 0 }, { [0x01] = 1, [0x02] = 1 } };
+static THREAD_LOCAL int trace_nrec = 0;
+static THREAD_LOCAL const char *fn_trace = NULL;
+static THREAD_LOCAL const char *fn_bench = NULL;
+static THREAD_LOCAL unsigned long long run_clocks = 0;	/* Or 0 to run until told to stop */
+#ifndef SMALL_MEM
+static THREAD_LOCAL const char *fn_state = "memu.mst";
+static THREAD_LOCAL BOOLEAN state_load_at_start = FALSE;
+static THREAD_LOCAL int state_checkpoint_secs = 0;
+static THREAD_LOCAL unsigned long long state_checkpoint = 0;	/* T-states between saves, or 0 */
+static THREAD_LOCAL unsigned long long elapsed_next_checkpoint = 0;
+static THREAD_LOCAL int rewind_frames = 0;
+static THREAD_LOCAL int rewind_kb = 8192;
+static THREAD_LOCAL const char *fn_record = NULL;
+static THREAD_LOCAL const char *fn_replay = NULL;
+static THREAD_LOCAL BOOLEAN replay_headless = FALSE;
+static THREAD_LOCAL const char *fn_boot_cache = NULL;
+static THREAD_LOCAL unsigned long long boot_hash;	/* Of the ROMs and options */
+static THREAD_LOCAL BOOLEAN boot_capture = FALSE;	/* Save the cache at the prompt */
+static THREAD_LOCAL BOOLEAN boot_ready = FALSE;		/* At the prompt, set by idle_check */
+#endif
 // static BOOLEAN panel_hack = FALSE;
 
-static byte run_cmd[] = "USER RUN \"????????.RUN\"\r";
-static byte *run_buf = NULL;
-static word run_hdr_base;
-static word run_hdr_length;
-static BOOLEAN run_no_int = FALSE;
+static THREAD_LOCAL byte run_cmd[] = "USER RUN \"????????.RUN\"\r";
+static THREAD_LOCAL byte *run_buf = NULL;
+static THREAD_LOCAL word run_hdr_base;
+static THREAD_LOCAL word run_hdr_length;
+static THREAD_LOCAL BOOLEAN run_no_int = FALSE;
 
 #ifdef SMALL_MEM
-FILE *fp_tape = NULL;
-static byte tape_buf[512];
+THREAD_LOCAL FILE *fp_tape = NULL;
+static THREAD_LOCAL byte tape_buf[512];
 #else
-static byte tape_buf[0xfff0];
+static THREAD_LOCAL byte tape_buf[0xfff0];
 #endif
-static word tape_len;
+static THREAD_LOCAL word tape_len;
 
-static byte last_trace = TRUE;
-static byte no_trace[0x10000>>3] = { 0 };
+static THREAD_LOCAL byte last_trace = TRUE;
+static THREAD_LOCAL byte no_trace[0x10000>>3] = { 0 };
 
-static BOOLEAN loadmtx_hack = FALSE;
+static THREAD_LOCAL BOOLEAN loadmtx_hack = FALSE;
 /*...e*/
 
 #ifdef SMALL_MEM
-static BOOLEAN bTapePatch = TRUE;
+static THREAD_LOCAL BOOLEAN bTapePatch = TRUE;
 #endif
 
 void tape_patch (BOOLEAN bPatch)
@@ -451,8 +513,8 @@ static const char *get_tape_name(word addr, const char *fn_prefix, char *fn_buf)
 /*...e*/
 
 #define	MAX_TAPE_PREFIX 300
-static char tape_name_fn_buf[MAX_TAPE_PREFIX+15+1+3+1];
-static const char *tape_name_fn;
+static THREAD_LOCAL char tape_name_fn_buf[MAX_TAPE_PREFIX+15+1+3+1];
+static THREAD_LOCAL const char *tape_name_fn;
 
 void hexdump (byte *ptr, int n);
 
@@ -569,13 +631,19 @@ static void mtx_tape(Z80 *r)
 			r->PC.W = 0x0adb;
 		else
 			{
-			int i;
-			for ( i = 0; i < length; i++ )
-				if ( tape_buf[i] != mem_read_byte(base+i) )
+			word i = 0;
+			while ( i < length )
+				{
+				word n;
+				const byte *p = mem_read_span((word) (base+i), &n);
+				if ( n > length - i ) n = length - i;
+				if ( p == NULL || memcmp(tape_buf+i, p, n) )
 					{
 					r->PC.W = 0x0adb;
 					break;
 					}
+				i += n;
+				}
 			tape_len -= length;
 			memmove(tape_buf, tape_buf+length, tape_len);
 			}
@@ -638,8 +706,8 @@ static void mtx_tape(Z80 *r)
 
 #define	MAX_TAP_LENGTH 0xc000
 
-static const char *tap_fn = "memu.tap";
-static long tap_ptr = 0L;
+static THREAD_LOCAL const char *tap_fn = "memu.tap";
+static THREAD_LOCAL long tap_ptr = 0L;
 
 /*...sxor_buf:0:*/
 static byte xor_buf(const byte *b, int len)
@@ -861,7 +929,7 @@ static void tap_rewind(void)
 #define	SNA_DUMP 0xc000
 #define	SNA_SIZE (SNA_HEADER+SNA_DUMP)
 
-static const char *sna_fn = "memu.sna";
+static THREAD_LOCAL const char *sna_fn = "memu.sna";
 
 static void sna_load(Z80 *r)
 	{
@@ -991,7 +1059,7 @@ static void sna_save(Z80 *r)
 /*...e*/
 #endif  // HAVE_SPEC
 
-static BOOLEAN sdx_emulate = FALSE;
+static THREAD_LOCAL BOOLEAN sdx_emulate = FALSE;
 #ifdef HAVE_OSFS
 /*...ssetup_sdx:0:*/
 
@@ -1071,12 +1139,12 @@ static void setup_sdx(int rom)
 #if defined(BEMEMU)
 
 #if defined(UNIX)
-static char fn_be_in[100+1];
-static char fn_be_out[100+1];
-static int fd_be_in  = -1;
-static int fd_be_out = -1;
+static THREAD_LOCAL char fn_be_in[100+1];
+static THREAD_LOCAL char fn_be_out[100+1];
+static THREAD_LOCAL int fd_be_in  = -1;
+static THREAD_LOCAL int fd_be_out = -1;
 #elif defined(WIN32)
-static HANDLE hf_be = INVALID_HANDLE_VALUE;
+static THREAD_LOCAL HANDLE hf_be = INVALID_HANDLE_VALUE;
 #endif
 
 /*...svdp_read\47\write:0:*/
@@ -1325,9 +1393,269 @@ void bememu_term(void)
 #endif
 /*...e*/
 
+/*...sidle:0:*/
+/* Fast-forward through idle time.
+
+   When HALTed, or going round a known idle loop (such as waiting for a
+   key at the BASIC prompt), the Z80 repeats exactly the same work until
+   the next hardware event. Rather than executing every pass, the clock
+   is advanced by a whole number of passes to just short of the next
+   video frame, Z80Step deadline, or other clock LoopZ80 acts on (such
+   as a recorded input), so the CTC and tape see the event at exactly
+   the same point as if every pass had been executed. ICount is left
+   where it would have been too, so LoopZ80 is next called at the same
+   clock.
+
+   An idle loop is identified by the address of its head. A pass is only
+   taken as idle if, from one visit of the head to the next, no memory
+   was changed, there was no interrupt, the same values were read from
+   the same ports in the same order, and the registers, IOBYTE and ROM
+   sub-page are all the same. */
+
+#define	IDLE_MTX_KBD	0x0274		/* MTX ROM, waiting for a key */
+
+#define	IDLE_MAX_STEPS	1024		/* Instructions in a pass */
+#define	IDLE_MAX_IN	64		/* Port reads in a pass */
+
+static THREAD_LOCAL BOOLEAN idle_skip = TRUE;
+static THREAD_LOCAL byte idle_head[0x10000>>3] = { 0 };
+static THREAD_LOCAL BOOLEAN idle_armed = FALSE;
+static THREAD_LOCAL unsigned long long idle_elapsed;
+static THREAD_LOCAL unsigned long long idle_horizon = 0;	/* Set by LoopZ80 */
+static THREAD_LOCAL int idle_n_steps = 0;
+static THREAD_LOCAL unsigned idle_steps[IDLE_MAX_STEPS];	/* Where each instruction of the pass ended */
+static THREAD_LOCAL int idle_n_in = 0;
+static THREAD_LOCAL word idle_in_port[IDLE_MAX_IN];
+static THREAD_LOCAL byte idle_in_value[IDLE_MAX_IN];
+
+typedef struct
+	{
+	word af, bc, de, hl, ix, iy, sp, af1, bc1, de1, hl1;
+	byte iff, i, iobyte, subpage;
+	int n_in;			/* More than IDLE_MAX_IN if too many to keep */
+	word in_port[IDLE_MAX_IN];
+	byte in_value[IDLE_MAX_IN];
+	} IDLE_STATE;
+
+static THREAD_LOCAL IDLE_STATE idle_last;
+
+static void idle_set_head (word addr)
+	{
+	idle_head[addr>>3] |= (0x01<<(addr&7));
+	}
+
+static void idle_get_state (Z80 *r, IDLE_STATE *ps)
+	{
+	FlagsZ80 (r);
+	ps->af  = r->AF.W;
+	ps->bc  = r->BC.W;
+	ps->de  = r->DE.W;
+	ps->hl  = r->HL.W;
+	ps->ix  = r->IX.W;
+	ps->iy  = r->IY.W;
+	ps->sp  = r->SP.W;
+	ps->af1 = r->AF1.W;
+	ps->bc1 = r->BC1.W;
+	ps->de1 = r->DE1.W;
+	ps->hl1 = r->HL1.W;
+	ps->iff = r->IFF;
+	ps->i   = r->I;
+	ps->iobyte  = mem_get_iobyte ();
+	ps->subpage = mem_get_rom_subpage ();
+	ps->n_in = idle_n_in;
+	if ( idle_n_in <= IDLE_MAX_IN )
+		{
+		memcpy (ps->in_port, idle_in_port, idle_n_in * sizeof (idle_in_port[0]));
+		memcpy (ps->in_value, idle_in_value, idle_n_in);
+		}
+	}
+
+static BOOLEAN idle_same_state (const IDLE_STATE *ps1, const IDLE_STATE *ps2)
+	{
+	return ( ps1->af == ps2->af ) && ( ps1->bc == ps2->bc ) && ( ps1->de == ps2->de )
+		&& ( ps1->hl == ps2->hl ) && ( ps1->ix == ps2->ix ) && ( ps1->iy == ps2->iy )
+		&& ( ps1->sp == ps2->sp ) && ( ps1->af1 == ps2->af1 ) && ( ps1->bc1 == ps2->bc1 )
+		&& ( ps1->de1 == ps2->de1 ) && ( ps1->hl1 == ps2->hl1 )
+		&& ( ps1->iff == ps2->iff )
+		&& ( ps1->i == ps2->i ) && ( ps1->iobyte == ps2->iobyte )
+		&& ( ps1->subpage == ps2->subpage )
+		&& ( ps1->n_in <= IDLE_MAX_IN ) && ( ps1->n_in == ps2->n_in )
+		&& ( ! memcmp (ps1->in_port, ps2->in_port, ps1->n_in * sizeof (ps1->in_port[0])) )
+		&& ( ! memcmp (ps1->in_value, ps2->in_value, ps1->n_in) );
+	}
+
+/* Forget any pass in progress, something has happened */
+static void idle_disarm (void)
+	{
+	if ( idle_armed )
+		{
+		mem_watch (FALSE);
+		idle_armed = FALSE;
+		}
+	}
+
+/* Note port reads, as a pass that reads something different is not idle */
+static void idle_in (word port, byte value)
+	{
+	if ( idle_armed )
+		{
+		if ( idle_n_in < IDLE_MAX_IN )
+			{
+			idle_in_port[idle_n_in]  = port;
+			idle_in_value[idle_n_in] = value;
+			}
+		if ( idle_n_in <= IDLE_MAX_IN )
+			++idle_n_in;
+		}
+	}
+
+/* Note where in the pass each instruction starts (so the last one
+   ended), called before every instruction while a pass is watched */
+static void idle_step (Z80 *r)
+	{
+	if ( idle_n_steps < IDLE_MAX_STEPS )
+		idle_steps[idle_n_steps] = (unsigned) ( r->IElapsed - idle_elapsed );
+	if ( idle_n_steps <= IDLE_MAX_STEPS )
+		++idle_n_steps;
+	}
+
+/* Skip as many passes of the given length as will complete before
+   the next event. Called before the first instruction of a pass.
+   Without skipping, LoopZ80 would be called at the end of the first
+   instruction to take ICount to zero or below, and then ICount is
+   reset to IPeriod. Those calls in the time skipped have nothing to do,
+   as the skip stops before the next event, but they move the point at
+   which the following calls come. So they are worked out from the
+   steps[] at which the instructions of a pass end, and ICount left as
+   it would have been, so a run is the same with or without skipping. */
+static void idle_forward (Z80 *r, int pass, const unsigned *steps, int n_steps)
+	{
+	unsigned long long next = r->IStepNext;
+	unsigned long long skip;
+	unsigned long long due;		/* From now, when ICount reaches zero */
+	int count;
+	if ( ( r->IntCont != 0 ) || ( r->IFF & IFF_IENX ) || ( pass <= 0 )
+		|| ( n_steps <= 0 ) || ( n_steps > IDLE_MAX_STEPS ) ) return;
+	if ( idle_horizon < next ) next = idle_horizon;
+	if ( next <= r->IElapsed + pass ) return;
+	skip = ( ( next - r->IElapsed - 1 ) / pass ) * pass;
+	due = ( r->ICount > 0 ) ? (unsigned long long) r->ICount : 0;
+	while ( due <= skip )
+		{
+		/* LoopZ80 is called where the instruction then running ends */
+		unsigned long long call = due - due % pass;
+		if ( due % pass != 0 )
+			{
+			/* Find the first instruction to end at or after due */
+			int lo = 0, hi = n_steps - 1;
+			while ( lo < hi )
+				{
+				int mid = ( lo + hi ) / 2;
+				if ( steps[mid] < due % pass )
+					lo = mid + 1;
+				else
+					hi = mid;
+				}
+			call += steps[lo];
+			}
+		if ( call >= skip )
+			{
+			/* Leave the passes from the call on to be run */
+			skip -= pass;
+			if ( skip == 0 ) return;
+			break;
+			}
+		due = call + r->IPeriod;
+		}
+	count = (int) ( due - skip );
+	if ( bench_on )
+		bench_instructions += skip / pass * n_steps;
+	r->ICntLast += count - r->ICount;
+	r->ICount    = count;
+	r->IElapsed += skip;
+	}
+
+/* Called when HALTed or at the head of an idle loop, when skipping
+   idle time or looking for the prompt for the boot cache.
+   Not static, so that it is not inlined into DebugZ80 */
+void idle_check (Z80 *r)
+	{
+	if ( r->IFF & IFF_HALT )
+		{
+		/* Executing HALT over and over, 4 clocks each time */
+		static const unsigned halt_steps[] = { 4 };
+		if ( idle_skip )
+			idle_forward (r, 4, halt_steps, 1);
+		}
+	else
+		{
+		IDLE_STATE state;
+		idle_get_state (r, &state);
+		if ( ! idle_armed )
+			{
+			mem_watch (TRUE);
+			idle_armed = TRUE;
+			}
+		else if ( ( ! mem_changed () ) && idle_same_state (&state, &idle_last) )
+			{
+#ifndef SMALL_MEM
+			/* Waiting for a key, so this is the prompt */
+			if ( boot_capture )
+				boot_ready = TRUE;
+#endif
+			if ( idle_skip )
+				idle_forward (r, (int) ( r->IElapsed - idle_elapsed ), idle_steps, idle_n_steps);
+			}
+		idle_last = state;
+		idle_elapsed = r->IElapsed;
+		idle_n_in = 0;
+		idle_n_steps = 0;
+		}
+	}
+
+#ifndef SMALL_MEM
+/* Whether CP/M is waiting for a key, as the PC is at the CONIN entry of
+   the BIOS jump table. The CP/M console doesn't wait in an idle loop
+   which is known in advance, so this finds the prompt for the boot
+   cache whether or not idle time is skipped. */
+static BOOLEAN boot_cpm_conin (Z80 *r)
+	{
+	word wboot;
+	if ( ( mem_get_iobyte () & 0x80 ) == 0 || mem_read_byte (0x0000) != 0xc3 )
+		return FALSE;
+	/* 0x0000 jumps to WBOOT, BIOS+3, and CONIN is BIOS+9 */
+	wboot = (word) ( mem_read_byte (0x0001) | ( mem_read_byte (0x0002) << 8 ) );
+	return ( r->PC.W == (word) ( wboot + 6 ) );
+	}
+
+#define	IDLE_LOOK	( idle_skip || boot_capture )
+#else
+#define	IDLE_LOOK	idle_skip
+#endif
+/*...e*/
+
+/*...sZ80Sync:0:*/
+/* The high speed hardware is only stepped when Z80Step is due (see below).
+   Before the Z80 can see or change that hardware, bring it up to the
+   start of the current instruction, which is where it would be if it
+   were stepped after every instruction. */
+static void Z80Sync (Z80 *r)
+	{
+	unsigned long long now = r->IElapsed - ( r->ICntLast - r->ICount );
+	if ( now > r->IStepLast )
+		{
+		ctc_advance ((int) ( now - r->IStepLast ));
+		tape_advance ((int) ( now - r->IStepLast ));
+		r->IStepLast = now;
+		}
+	r->IStepNext = 0;
+	}
+/*...e*/
+
 /*...sPatchZ80:0:*/
 void PatchZ80(Z80 *r)
 	{
+	Z80Sync (r);
 #ifdef SMALL_MEM
     if (( (mem_get_iobyte() & 0x80) == 0 ) && ( r->PC.W-2 == 0x0AAE ))
         {
@@ -1450,11 +1778,16 @@ void PatchZ80(Z80 *r)
 
 */
 
-/* High speed hardware updating */
+/* High speed hardware updating.
+   Rather than being called after every instruction, this asks to be
+   called again when the next CTC interrupt or tape edge is due. */
+#define	STEP_MAX	0x10000
+
 void Z80Step (Z80 *r, unsigned int uStep)
 	{
 	ctc_advance ((int) uStep);
 	tape_advance ((int) uStep);
+	r->IStepNext = r->IElapsed + tape_next (ctc_next (STEP_MAX));
 	}
 
 void RaiseInt (const char *psSource)
@@ -1466,6 +1799,7 @@ void RaiseInt (const char *psSource)
 /*...sRetiZ80:0:*/
 void RetiZ80(Z80 *R)
 	{
+	Z80Sync (R);
 	if ( ctc_reti () ) return;
 #ifdef HAVE_DART
     dart_reti ();
@@ -1475,6 +1809,8 @@ void RetiZ80(Z80 *R)
 /*...sIntAckZ80:0:*/
 BOOLEAN Z80IntAck (Z80 *r, word *pvec)
 	{
+	Z80Sync (r);
+	idle_disarm ();
     if ( ctc_int_ack (pvec) )
         {
         diag_message (DIAG_Z80_INTERRUPTS, "CTC Interrupt vector: 0x%02X", *pvec);
@@ -1488,30 +1824,102 @@ BOOLEAN Z80IntAck (Z80 *r, word *pvec)
 	}
 /*...e*/
 
-static unsigned long long clock_speed = 4000000;
+static THREAD_LOCAL unsigned long long clock_speed = 4000000;
+static THREAD_LOCAL unsigned long long elapsed_stop = ELAPSED_NEVER;	/* Set by memu_run */
 #ifdef __Pico__
 word LoopZ80(Z80 *r)
     {
+    Z80Sync (r);
     win_handle_events ();
 	display_wait_for_frame ();
     vid_set_int ();
     ctc_trigger (0);
+    idle_horizon = r->IElapsed + r->IPeriod;
     return INT_NONE;
     }
 #else
-static long long ms_last_win_handle_events = 0;
-static long long ms_last_mon_refresh_blink = 0;
-static long long ms_last_moderate = 0;
-static long long ms_last_speed_check = 0;
-static unsigned long long elapsed_now = 0;
-static unsigned long long elapsed_last_vid_refresh = 0;
+static THREAD_LOCAL long long ms_last_win_handle_events = 0;
+static THREAD_LOCAL long long ms_last_mon_refresh_blink = 0;
+static THREAD_LOCAL long long ms_last_moderate = 0;
+static THREAD_LOCAL long long ms_last_speed_check = 0;
+static THREAD_LOCAL unsigned long long elapsed_now = 0;
+static THREAD_LOCAL unsigned long long elapsed_last_vid_refresh = 0;
 #ifdef HAVE_DART
-static unsigned long long elapsed_last_dart = 0;
+static THREAD_LOCAL unsigned long long elapsed_last_dart = 0;
+#endif
+static THREAD_LOCAL unsigned long long elapsed_last_moderate = 0;
+static THREAD_LOCAL unsigned long long elapsed_last_speed_check = 0;
+static THREAD_LOCAL BOOLEAN force_moderate = FALSE;
+static THREAD_LOCAL BOOLEAN nmi_next_time = TRUE;
+
+#ifndef SMALL_MEM
+/*...smemu_save_state:0:*/
+/* The Z80 part of a save-state (see state.c) */
+void memu_save_state(STATE *st)
+	{
+	FlagsZ80 (&z80);
+	state_put_word(st, z80.AF.W);
+	state_put_word(st, z80.BC.W);
+	state_put_word(st, z80.DE.W);
+	state_put_word(st, z80.HL.W);
+	state_put_word(st, z80.IX.W);
+	state_put_word(st, z80.IY.W);
+	state_put_word(st, z80.PC.W);
+	state_put_word(st, z80.SP.W);
+	state_put_word(st, z80.AF1.W);
+	state_put_word(st, z80.BC1.W);
+	state_put_word(st, z80.DE1.W);
+	state_put_word(st, z80.HL1.W);
+	state_put_byte(st, z80.IFF);
+	state_put_byte(st, z80.I);
+	state_put_byte(st, z80.IntCont);
+	state_put_word(st, z80.IRequest);
+	state_put_int(st, (unsigned int) z80.ICount);
+	state_put_int(st, (unsigned int) z80.ICntLast);
+	state_put_quad(st, z80.IElapsed);
+	state_put_quad(st, z80.IStepLast);
+	}
+/*...e*/
+/*...smemu_load_state:0:*/
+void memu_load_state(STATE *st, int version)
+	{
+	z80.AF.W = state_get_word(st);
+	z80.BC.W = state_get_word(st);
+	z80.DE.W = state_get_word(st);
+	z80.HL.W = state_get_word(st);
+	z80.IX.W = state_get_word(st);
+	z80.IY.W = state_get_word(st);
+	z80.PC.W = state_get_word(st);
+	z80.SP.W = state_get_word(st);
+	z80.AF1.W = state_get_word(st);
+	z80.BC1.W = state_get_word(st);
+	z80.DE1.W = state_get_word(st);
+	z80.HL1.W = state_get_word(st);
+	z80.IFF = state_get_byte(st);
+	z80.I = state_get_byte(st);
+	z80.IntCont = state_get_byte(st);
+	z80.IRequest = state_get_word(st);
+	z80.ICount = (int) state_get_int(st);
+	z80.ICntLast = (int) state_get_int(st);
+	z80.IElapsed = state_get_quad(st);
+	z80.IStepLast = state_get_quad(st);
+	z80.IStepNext = 0;
+#ifdef Z80_LAZY_FLAGS
+	z80.FlagOp = 0;
+#endif
+	/* Time restarts from when the state was saved */
+	elapsed_now = z80.IElapsed;
+	elapsed_last_vid_refresh = z80.IElapsed;
+#ifdef HAVE_DART
+	elapsed_last_dart = z80.IElapsed;
+#endif
+	elapsed_last_moderate = z80.IElapsed;
+	elapsed_last_speed_check = z80.IElapsed;
+	elapsed_next_checkpoint = z80.IElapsed + state_checkpoint;
+	idle_armed = FALSE;
+	}
+/*...e*/
 #endif
-static unsigned long long elapsed_last_moderate = 0;
-static unsigned long long elapsed_last_speed_check = 0;
-static BOOLEAN force_moderate = FALSE;
-static BOOLEAN nmi_next_time = TRUE;
 
 word LoopZ80(Z80 *r)
 	{
@@ -1519,6 +1927,8 @@ word LoopZ80(Z80 *r)
 	int periph_int = -1;
 	BOOLEAN vid_int_pending_before;
 
+	Z80Sync (r);
+
 #if defined(BEMEMU)
 	be_poll();
 #endif
@@ -1571,7 +1981,44 @@ word LoopZ80(Z80 *r)
 		tap_rewind();
 		diag_flags[DIAG_ACT_TAP_REWIND] = FALSE;
 		}
+	if ( diag_flags[DIAG_ACT_TRACE_DUMP] )
+		{
+		trace_dump();
+		diag_flags[DIAG_ACT_TRACE_DUMP] = FALSE;
+		}
+#ifndef SMALL_MEM
+	if ( diag_flags[DIAG_ACT_STATE_SAVE] ||
+	     ( state_checkpoint != 0 && r->IElapsed >= elapsed_next_checkpoint ) )
+		{
+		state_save(fn_state);
+		elapsed_next_checkpoint = r->IElapsed + state_checkpoint;
+		diag_flags[DIAG_ACT_STATE_SAVE] = FALSE;
+		}
+	if ( diag_flags[DIAG_ACT_STATE_LOAD] )
+		{
+		state_load(fn_state);
+		diag_flags[DIAG_ACT_STATE_LOAD] = FALSE;
+		}
+	if ( diag_flags[DIAG_ACT_REWIND] )
+		{
+		if ( rewind_on )
+			rewind_step();
+		diag_flags[DIAG_ACT_REWIND] = FALSE;
+		}
+	if ( boot_ready )
+		{
+		state_boot_save(fn_boot_cache, boot_hash);
+		boot_capture = FALSE;
+		boot_ready = FALSE;
+		}
+#endif
 	
+#ifndef SMALL_MEM
+	/* Before win_handle_events, where the recorded changes were made */
+	if ( replay_mode == REPLAY_PLAY )
+		replay_periodic();
+#endif
+
 	/* Ensure XWindows is kept happy */
 	if ( ms_now - ms_last_win_handle_events > 10 )
 		{
@@ -1623,6 +2070,10 @@ word LoopZ80(Z80 *r)
 		elapsed_last_speed_check = elapsed_now;
 		}
 
+#ifndef SMALL_MEM
+	vid_scanline(elapsed_now);
+		/* Draw the lines of the VDP picture passed by now. */
+#endif
 	vid_int_pending_before = vid_int_pending();
 	
 	if ( elapsed_now - elapsed_last_vid_refresh > clock_speed / cfg.screen_refresh )
@@ -1647,11 +2098,30 @@ word LoopZ80(Z80 *r)
 #endif
 #ifdef HAVE_MFX
         if ( cfg.mfx_emu > 0 ) mfx_refresh ();
+#endif
+#ifndef SMALL_MEM
+		if ( rewind_on )
+			rewind_frame();
 #endif
 		}
 	else if ( elapsed_now - elapsed_last_vid_refresh > clock_speed / 300 )
 		vid_clear_int(); /* Ensure F bit is clear */
 
+	/* Idle skipping mustn't jump past the next frame, or F bit clearing */
+	if ( elapsed_now - elapsed_last_vid_refresh > clock_speed / 300 )
+		idle_horizon = elapsed_last_vid_refresh + clock_speed / cfg.screen_refresh;
+	else
+		idle_horizon = elapsed_last_vid_refresh + clock_speed / 300;
+	/* Nor past anything else LoopZ80 does at a given clock */
+	if ( elapsed_stop < idle_horizon )
+		idle_horizon = elapsed_stop;
+#ifndef SMALL_MEM
+	if ( state_checkpoint != 0 && elapsed_next_checkpoint < idle_horizon )
+		idle_horizon = elapsed_next_checkpoint;
+	if ( replay_mode == REPLAY_PLAY && replay_next () < idle_horizon )
+		idle_horizon = replay_next ();
+#endif
+
 	if ( !vid_int_pending_before && vid_int_pending() )
 		ctc_trigger(0);
 			/* As the CTC is typically configured with channel 0
@@ -1712,10 +2182,10 @@ word LoopZ80(Z80 *r)
 #endif
     
 	if ( periph_int == -1 )
-		return INT_NONE;
+		return ( elapsed_now >= elapsed_stop ) ? INT_QUIT : INT_NONE;
 	else if ( periph_int == -2 )
 		{
-		static unsigned long long elapsed_nmi;
+		static THREAD_LOCAL unsigned long long elapsed_nmi;
 		diag_message(DIAG_Z80_INTERRUPTS, "Z80 NMI interrupt, at elapsed=%llu elapsed_diff=%llu",
 			elapsed_now,
 			elapsed_now-elapsed_nmi
@@ -1725,7 +2195,7 @@ word LoopZ80(Z80 *r)
 		}
 	else
 		{
-		static long long elapsed_int[4];
+		static THREAD_LOCAL long long elapsed_int[4];
 		if ( diag_flags[DIAG_Z80_INTERRUPTS] )
 			{
 			int i = (periph_int>>1)&3;
@@ -1760,7 +2230,7 @@ word LoopZ80(Z80 *r)
 /*...sDebugZ80Instruction:0:*/
 /* Note: P and V flags are one and the same. */
 
-static unsigned long long elapsed_last_log = 0;
+static THREAD_LOCAL unsigned long long elapsed_last_log = 0;
 
 static void DebugZ80Instruction(Z80 *r, const char *instruction)
 	{
@@ -1806,28 +2276,54 @@ static void DebugZ80Instruction(Z80 *r, const char *instruction)
 	}
 /*...e*/
 
+/*...sDebugZ80Trace:0:*/
+/* Not static, so that it is not inlined into DebugZ80,
+   which is called for every instruction and must stay cheap */
+void DebugZ80Trace(Z80 *r)
+	{
+	word pc = r->PC.W;
+	FlagsZ80 (r);
+	if ( ( no_trace[pc>>3]&(0x01<<(pc&7)) ) == 0 )
+		{
+		char buf[500+1];
+		if ( diag_flags[DIAG_Z80_INSTRUCTIONS_NEW] )
+			no_trace[pc>>3] |= (0x01<<(pc&7));
+		dis_instruction(&pc, buf);
+		DebugZ80Instruction(r, buf);
+		last_trace = TRUE;
+		}
+	else if ( last_trace )
+		{
+		DebugZ80Instruction(r, "...");
+		last_trace = FALSE;
+		}
+	}
+/*...e*/
+
 byte DebugZ80(Z80 *r)
 	{
+	if ( trace_on )
+		trace_record (r);
+	if ( bench_on )
+		++bench_instructions;
 #ifdef HAVE_VDEB
     vdeb (r);
 #endif
+#ifndef SMALL_MEM
+	if ( boot_capture && boot_cpm_conin (r) )
+		boot_ready = TRUE;
+#endif
+	if ( idle_armed )
+		idle_step (r);
 	if ( diag_flags[DIAG_Z80_INSTRUCTIONS] )
+		DebugZ80Trace (r);
+	else if ( IDLE_LOOK && ( ( r->IFF & IFF_HALT )
+		|| ( idle_head[r->PC.W>>3] & (0x01<<(r->PC.W&7)) ) ) )
 		{
-		word pc = r->PC.W;
-		if ( ( no_trace[pc>>3]&(0x01<<(pc&7)) ) == 0 )
-			{
-			char buf[500+1];
-			if ( diag_flags[DIAG_Z80_INSTRUCTIONS_NEW] )
-				no_trace[pc>>3] |= (0x01<<(pc&7));
-			dis_instruction(&pc, buf);
-			DebugZ80Instruction(r, buf);
-			last_trace = TRUE;
-			}
-		else if ( last_trace )
-			{
-			DebugZ80Instruction(r, "...");
-			last_trace = FALSE;
-			}
+#ifdef HAVE_VDEB
+		if ( ! vdeb_active () )
+#endif
+			idle_check (r);
 		}
 	return 1;
 	}
@@ -1873,6 +2369,7 @@ BOOLEAN ALT_Z80_OUT (word, byte);
 
 void OutZ80(word port, byte value)
 	{
+	Z80Sync (&z80);
 #ifdef ALT_Z80_OUT
 	if ( ALT_Z80_OUT (port, value) ) return;
 #endif
@@ -2142,6 +2639,11 @@ void OutZ80(word port, byte value)
  		case NFX_BASE + 1:
  		case NFX_BASE + 2:
  		case NFX_BASE + 3:
+#ifndef SMALL_MEM
+		    /* Nothing reaches the network when replaying */
+		    if ( replay_mode == REPLAY_PLAY )
+		        break;
+#endif
 		    nfx_out(port & 0x03, value);
 		    break;
 #endif
@@ -2236,7 +2738,7 @@ byte InZ80_bad(const char *hardware, word port, BOOLEAN stop)
 BOOLEAN ALT_Z80_IN (word, byte *);
 #endif
 
-byte InZ80(word port)
+static byte InZ80_port(word port)
 	{
 #ifdef	ALT_Z80_IN
 	byte value;
@@ -2412,6 +2914,20 @@ byte InZ80(word port)
  		case NFX_BASE + 1:
  		case NFX_BASE + 2:
  		case NFX_BASE + 3:
+#ifndef SMALL_MEM
+		    if ( replay_mode == REPLAY_PLAY )
+		        {
+		        byte b;
+		        replay_byte(REPLAY_NFX, port & 0x03, &b);
+		        return b;
+		        }
+		    if ( replay_mode == REPLAY_RECORD )
+		        {
+		        byte b = nfx_in(port & 0x03);
+		        replay_note(REPLAY_NFX, port & 0x03, b);
+		        return b;
+		        }
+#endif
 		    return nfx_in(port & 0x03);
 #endif
 #ifdef HAVE_CFX2
@@ -2462,11 +2978,21 @@ byte InZ80(word port)
 			return InZ80_bad("unknown hardware", port, TRUE);
 		}
 	}
+
+byte InZ80(word port)
+	{
+	byte value;
+	Z80Sync (&z80);
+	value = InZ80_port (port);
+	idle_in (port, value);
+	return value;
+	}
 /*...e*/
 
 /*...smemu_reset:0:*/
 void memu_reset(void)
 	{
+	Z80Sync (&z80);
 #ifdef HAVE_VGA
     if ( cfg.bVGA ) vga_reset ();
 #endif
@@ -2503,6 +3029,27 @@ static int sdxcfg(int tracks)
 	}
 /*...e*/
 
+#ifndef SMALL_MEM
+/*...sboot_cache_hash:0:*/
+/* The boot cache may be used if the ROMs are the same, and so are the
+   options (after any -config-file has been read), other than the name
+   of the cache itself */
+static unsigned long long boot_cache_hash (int argc, const char *argv[])
+	{
+	unsigned long long h = STATE_HASH_INIT;
+	int i;
+	for ( i = 1; i < argc; ++i )
+		{
+		if ( !strcmp(argv[i], "-boot-cache") )
+			++i;
+		else
+			h = state_hash (h, argv[i], strlen (argv[i]) + 1);
+		}
+	return mem_hash_roms (h);
+	}
+/*...e*/
+#endif
+
 #ifdef ALT_OPTIONS
 extern BOOLEAN ALT_OPTIONS (int *pargc, const char ***pargv, int *pi);
 #endif
@@ -2511,7 +3058,8 @@ extern BOOLEAN ALT_OPTIONS (int *pargc, const char ***pargv, int *pi);
 extern void ALT_INIT (void);
 #endif
 
-int memu (int argc, const char *argv[])
+/*...smemu_init:0:*/
+int memu_init (int argc, const char *argv[])
 	{
 	int i;
 	unsigned addr = 0;
@@ -2531,6 +3079,7 @@ int memu (int argc, const char *argv[])
 	cfg.tracks_sdxfdc[0] = 80;
 	cfg.tracks_sdxfdc[1] = 80;
 	cfg.screen_refresh = 50;
+	idle_set_head (IDLE_MTX_KBD);
 
 	if ( argc == 1 )
 		usage(NULL);
@@ -2637,6 +3186,20 @@ int memu (int argc, const char *argv[])
 #else
             unimplemented (argv[i]);
             ++i;
+#endif
+			}
+		else if ( !strcmp(argv[i], "-mem-snapshots") )
+			{
+#ifndef SMALL_MEM
+			int nsnaps;
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			if ( sscanf(argv[i], "%i", &nsnaps) != 1 )
+				opterror (argv[i-1]);
+			mem_set_n_snapshots(nsnaps);
+#else
+            unimplemented (argv[i]);
+            ++i;
 #endif
 			}
 		else if ( !strcmp(argv[i], "-n-subpages") )
@@ -2667,6 +3230,14 @@ int memu (int argc, const char *argv[])
 #else
             unimplemented (argv[i]);
             i += 2;
+#endif
+			}
+		else if ( !strcmp(argv[i], "-rom-mmap") )
+			{
+#if defined(UNIX) && ! defined(SMALL_MEM)
+			mem_set_rom_mmap(TRUE);
+#else
+            unimplemented (argv[i]);
 #endif
 			}
 		else if ( !strncmp(argv[i], "-rompair", 8) )
@@ -2808,6 +3379,10 @@ int memu (int argc, const char *argv[])
 		else if ( !strcmp(argv[i], "-vid-ntsc") )
             {
 			cfg.screen_refresh = 60;
+            }
+		else if ( !strcmp(argv[i], "-vid-scanline") )
+            {
+			cfg.vid_emu |= (VIDEMU_WIN|VIDEMU_WIN_SCANLINE);
             }
 		else if ( !strcmp(argv[i], "-vid-time-check") )
 			{
@@ -2825,7 +3400,11 @@ int memu (int argc, const char *argv[])
 		else if ( !strcmp(argv[i], "-snd-portaudio") ||
 			  !strcmp(argv[i], "-s")             )
             {
+#ifdef MEMU_MULTI
+            unimplemented (argv[i]);
+#else
 			cfg.snd_emu |= SNDEMU_PORTAUDIO;
+#endif
             }
 		else if ( !strcmp(argv[i], "-snd-latency") )
 			{
@@ -3209,6 +3788,210 @@ int memu (int argc, const char *argv[])
             {
 			moderate_speed = FALSE;
             }
+		else if ( !strcmp(argv[i], "-idle-loop") )
+			{
+			int addr;
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			if ( sscanf(argv[i], "%i", &addr) != 1 )
+				opterror (argv[i-1]);
+			idle_set_head ((word) addr);
+			}
+		else if ( !strcmp(argv[i], "-no-idle") )
+			{
+			idle_skip = FALSE;
+			}
+		else if ( !strcmp(argv[i], "-trace") )
+			{
+#ifdef Z80_DEBUG
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			sscanf(argv[i], "%i", &trace_nrec);
+			if ( trace_nrec < 1 || trace_nrec > 0x4000000 )
+				fatal("trace must be between 1 and 67108864 instructions");
+#else
+			unimplemented (argv[i]);
+			++i;
+#endif
+			}
+		else if ( !strcmp(argv[i], "-trace-file") )
+			{
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			fn_trace = argv[i];
+			}
+		else if ( !strcmp(argv[i], "-state-file") )
+			{
+#ifndef SMALL_MEM
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			fn_state = argv[i];
+#else
+			unimplemented (argv[i]);
+			++i;
+#endif
+			}
+		else if ( !strcmp(argv[i], "-state-load") )
+			{
+#ifndef SMALL_MEM
+			state_load_at_start = TRUE;
+#else
+			unimplemented (argv[i]);
+#endif
+			}
+		else if ( !strcmp(argv[i], "-state-checkpoint") )
+			{
+#ifndef SMALL_MEM
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			state_checkpoint_secs = atoi(argv[i]);
+			if ( state_checkpoint_secs <= 0 )
+				fatal("-state-checkpoint must be a number of seconds");
+#else
+			unimplemented (argv[i]);
+			++i;
+#endif
+			}
+		else if ( !strcmp(argv[i], "-rewind") )
+			{
+#ifndef SMALL_MEM
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			rewind_frames = atoi(argv[i]);
+			if ( rewind_frames <= 0 )
+				fatal("-rewind must be a number of frames");
+#else
+			unimplemented (argv[i]);
+			++i;
+#endif
+			}
+		else if ( !strcmp(argv[i], "-boot-cache") )
+			{
+#ifndef SMALL_MEM
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			fn_boot_cache = argv[i];
+#else
+			unimplemented (argv[i]);
+			++i;
+#endif
+			}
+		else if ( !strcmp(argv[i], "-rewind-kb") )
+			{
+#ifndef SMALL_MEM
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			rewind_kb = atoi(argv[i]);
+			if ( rewind_kb < 256 )
+				fatal("-rewind-kb must be at least 256");
+#else
+			unimplemented (argv[i]);
+			++i;
+#endif
+			}
+		else if ( !strcmp(argv[i], "-record") )
+			{
+#ifndef SMALL_MEM
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			fn_record = argv[i];
+#else
+			unimplemented (argv[i]);
+			++i;
+#endif
+			}
+		else if ( !strcmp(argv[i], "-replay") )
+			{
+#ifndef SMALL_MEM
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			fn_replay = argv[i];
+#else
+			unimplemented (argv[i]);
+			++i;
+#endif
+			}
+		else if ( !strcmp(argv[i], "-replay-headless") )
+			{
+#ifndef SMALL_MEM
+			replay_headless = TRUE;
+#else
+			unimplemented (argv[i]);
+#endif
+			}
+		else if ( !strcmp(argv[i], "-bench") )
+			{
+#ifndef SMALL_MEM
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			fn_bench = argv[i];
+#else
+			unimplemented (argv[i]);
+			++i;
+#endif
+			}
+		else if ( !strcmp(argv[i], "-run-clocks") )
+			{
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			if ( sscanf(argv[i], "%llu", &run_clocks) != 1 )
+				opterror (argv[i-1]);
+			}
+		else if ( !strcmp(argv[i], "-timing") )
+			{
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			if ( !strcmp(argv[i], "fast") )
+				timing_accurate = FALSE;
+			else if ( !strcmp(argv[i], "accurate") )
+				timing_accurate = TRUE;
+			else
+				fatal("timing must be fast or accurate");
+			}
+		else if ( !strcmp(argv[i], "-wait-m1") )
+			{
+			int n;
+			if ( ++i == argc )
+				opterror (argv[i-1]);
+			if ( sscanf(argv[i], "%i", &n) != 1 )
+				opterror (argv[i-1]);
+			if ( n < 0 || n > 255 )
+				fatal("wait states must be between 0 and 255");
+			z80_waits.M1 = (byte) n;
+			timing_accurate = TRUE;
+			}
+		else if ( !strcmp(argv[i], "-wait-io") )
+			{
+			int port, n;
+			if ( i + 2 >= argc )
+				opterror (argv[i]);
+			if ( sscanf(argv[i+1], "%i", &port) != 1 ||
+			     sscanf(argv[i+2], "%i", &n) != 1 )
+				opterror (argv[i]);
+			i += 2;
+			if ( port < 0 || port > 0xff )
+				fatal("port must be between 0x00 and 0xff");
+			if ( n < 0 || n > 255 )
+				fatal("wait states must be between 0 and 255");
+			z80_waits.IO[port] = (byte) n;
+			timing_accurate = TRUE;
+			}
+		else if ( !strcmp(argv[i], "-wait-mem") )
+			{
+			int page, n;
+			if ( i + 2 >= argc )
+				opterror (argv[i]);
+			if ( sscanf(argv[i+1], "%i", &page) != 1 ||
+			     sscanf(argv[i+2], "%i", &n) != 1 )
+				opterror (argv[i]);
+			i += 2;
+			if ( page < 0 || page > 7 )
+				fatal("page must be between 0 and 7");
+			if ( n < 0 || n > 255 )
+				fatal("wait states must be between 0 and 255");
+			z80_waits.Mem[page] = (byte) n;
+			timing_accurate = TRUE;
+			}
 		else if ( !strcmp(argv[i], "-run-no-interrupts") )
             {
 			run_no_int = TRUE;
@@ -3617,6 +4400,22 @@ int memu (int argc, const char *argv[])
 	if ( i != argc )
 		usage ("Unrecognised command %s", argv[i]);
 
+#ifndef SMALL_MEM
+	if ( fn_record != NULL && fn_replay != NULL )
+		fatal("can't both -record and -replay");
+	if ( replay_headless )
+		{
+		if ( fn_replay == NULL )
+			fatal("-replay-headless needs -replay");
+		/* The 80 column card is still there, but writes to the console */
+		cfg.vid_emu &= ~(VIDEMU_WIN|VIDEMU_WIN_HW_PALETTE|VIDEMU_WIN_SCANLINE|VIDEMU_WIN_MAX);
+		if ( cfg.mon_emu & (MONEMU_WIN|MONEMU_WIN_MONO|MONEMU_WIN_MAX|MONEMU_TH) )
+			cfg.mon_emu = ( cfg.mon_emu & ~(MONEMU_WIN|MONEMU_WIN_MONO|MONEMU_WIN_MAX|MONEMU_TH) )
+				| MONEMU_CONSOLE | MONEMU_CONSOLE_NOKEY;
+		moderate_speed = FALSE;
+		}
+#endif
+
     /* Test for no display - missing config file ? */
 
     if ( ( cfg.vid_emu == 0 ) && ( ( cfg.mon_emu & ~MONEMU_IGNORE_INIT ) == 0 )
@@ -3625,6 +4424,9 @@ int memu (int argc, const char *argv[])
 #endif
 #ifdef HAVE_MFX
         && ( cfg.mfx_emu <= 0 )
+#endif
+#ifndef SMALL_MEM
+        && ( ! replay_headless )
 #endif
         )
         fatal ("No display specified");
@@ -3656,6 +4458,9 @@ int memu (int argc, const char *argv[])
 	ctc_init();
     diag_message (DIAG_INIT, "vid_init (0x%02X, %d, %d)",
         cfg.vid_emu, cfg.vid_width_scale, cfg.vid_height_scale);
+#ifndef SMALL_MEM
+	vid_setup_frame(clock_speed, cfg.screen_refresh);
+#endif
 	vid_init(cfg.vid_emu, cfg.vid_width_scale, cfg.vid_height_scale);
     diag_message (DIAG_INIT, "vid_init");
 	kbd_init(cfg.kbd_emu);
@@ -3739,6 +4544,12 @@ int memu (int argc, const char *argv[])
 
 	if ( !cfg.tape_disable ) tape_patch (TRUE);
 
+	if ( trace_nrec > 0 )
+		{
+		diag_message (DIAG_INIT, "trace_init");
+		trace_init(trace_nrec, fn_trace);
+		}
+
 #ifdef HAVE_UI
     diag_message (DIAG_INIT, "ui_init");
 	ui_init(cfg.ui_opts);
@@ -3762,10 +4573,63 @@ int memu (int argc, const char *argv[])
 	z80.PC.W = (word) addr;
 	z80.Trace = 1;
 	z80.IPeriod = cfg.iperiod;
+	z80.Waits = &z80_waits;
+
+#ifndef SMALL_MEM
+	state_checkpoint = (unsigned long long) state_checkpoint_secs * clock_speed;
+	if ( state_load_at_start && ! state_load(fn_state) )
+		fatal("can't start from save-state file %s", fn_state);
+	else if ( fn_boot_cache != NULL )
+		{
+		diag_message (DIAG_INIT, "boot cache");
+		boot_hash = boot_cache_hash (argc, argv);
+		boot_capture = ! state_boot_load(fn_boot_cache, boot_hash);
+		}
+	elapsed_next_checkpoint = z80.IElapsed + state_checkpoint;
+	if ( rewind_frames > 0 )
+		{
+		diag_message (DIAG_INIT, "rewind_init");
+		rewind_init(rewind_frames, rewind_kb);
+		}
+	if ( fn_record != NULL )
+		replay_record(fn_record);
+	if ( fn_replay != NULL )
+		replay_play(fn_replay, replay_headless);
+	if ( fn_bench != NULL )
+		bench_init(fn_bench, argc, argv);
+#endif
+
+	return 0;
+	}
+/*...e*/
+
+/*...smemu_run:0:*/
+/* Run the Z80 until it has executed for the given number of clocks in
+   total. LoopZ80 checks this, so the Z80 may overrun it by up to IPeriod,
+   or by longer when an interrupt is due at that time. */
+void memu_run (unsigned long long elapsed)
+	{
+	elapsed_stop = elapsed;
     diag_message (DIAG_INIT, "Z80Run");
-	Z80Run (&z80); // RunZ80(&z80);
+	if ( timing_accurate )
+		Z80RunWait (&z80);
+	else
+		Z80Run (&z80); // RunZ80(&z80);
     diag_message (DIAG_INIT, "Z80Run Terminated");
+	}
+/*...e*/
 
+/*...smemu:0:*/
+int memu (int argc, const char *argv[])
+	{
+	memu_init (argc, argv);
+	if ( run_clocks != 0 )
+		{
+		/* Counted from the start, which may be a boot cache */
+		memu_run (get_Z80_clocks () + run_clocks);
+		terminate ("-run-clocks reached");
+		}
+	memu_run (ELAPSED_NEVER);
 	return 0;
 	}
 /*...e*/
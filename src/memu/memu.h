@@ -83,7 +83,10 @@ typedef struct s_cfg
 #endif
 	} CFG;
 
-extern CFG cfg;
+extern THREAD_LOCAL CFG cfg;
+
+/* memu_run argument to run until the machine terminates */
+#define ELAPSED_NEVER   (~0ULL)
 
 #ifdef __cplusplus
 extern "C"
@@ -91,6 +94,8 @@ extern "C"
 #endif
 
 extern int memu (int argc, const char *argv[]);
+extern int memu_init (int argc, const char *argv[]);
+extern void memu_run (unsigned long long elapsed);
 extern void OutZ80_bad(const char *hardware, word port, byte value, BOOLEAN stop);
 extern byte InZ80_bad(const char *hardware, word port, BOOLEAN stop);
 extern void memu_reset(void);
@@ -106,6 +111,12 @@ extern void show_instruction (void);
 #include "Z80.h"
 extern Z80 *get_Z80_regs (void);
 
+#ifndef SMALL_MEM
+#include "state.h"
+extern void memu_save_state(STATE *st);
+extern void memu_load_state(STATE *st, int version);
+#endif
+
 #ifdef __cplusplus
     }
 #endif
@@ -26,10 +26,10 @@
 #define GROWS       ( HEIGHT / GHEIGHT )
 #define GCOLS       ( WIDTH / GWIDTH )
 
-static WIN *mfx_win = NULL;
+static THREAD_LOCAL WIN *mfx_win = NULL;
 
 #define N_CLR_MFX  256
-static COL mfx_pal[N_CLR_MFX] = {
+static THREAD_LOCAL COL mfx_pal[N_CLR_MFX] = {
     {0x00, 0x00, 0x00},
     {0x00, 0x00, 0x00},
     {0x00, 0x00, 0x00},
@@ -287,34 +287,33 @@ static COL mfx_pal[N_CLR_MFX] = {
     {0xAA, 0xAA, 0xAA},
     {0xEE, 0xEE, 0xEE}};
 
-static byte *vram = NULL;
+static THREAD_LOCAL byte *vram = NULL;
 typedef byte FONT[0x100][THEIGHT];
-static FONT *font = NULL;
+static THREAD_LOCAL FONT *font = NULL;
 
-static int mfx_emu = 0;
-static int mfx_ver = 0;
-static byte page = 0;
-static byte palidx = 0;
-static byte raddr = 0;
-static byte treg[32];
-static byte chr = 0;
-static byte atr1 = 0;
-static byte atr2 = 0;
-static BOOLEAN blink = FALSE;
-static BOOLEAN changed = FALSE;
-static word taddr = 0;
-static int iSer = 0;
+static THREAD_LOCAL int mfx_emu = 0;
+static THREAD_LOCAL int mfx_ver = 0;
+static THREAD_LOCAL byte page = 0;
+static THREAD_LOCAL byte palidx = 0;
+static THREAD_LOCAL byte raddr = 0;
+static THREAD_LOCAL byte treg[32];
+static THREAD_LOCAL byte chr = 0;
+static THREAD_LOCAL byte atr1 = 0;
+static THREAD_LOCAL byte atr2 = 0;
+static THREAD_LOCAL BOOLEAN blink = FALSE;
+static THREAD_LOCAL BOOLEAN changed = FALSE;
+static THREAD_LOCAL word taddr = 0;
+static THREAD_LOCAL int iSer = 0;
 static const char sSer[] = "ME\01\03\00\02\01x";
-static byte fontidx = 0;
-static byte fontrow = 0;
-static byte byFPGA = 0;
-static word vaddr = 0;
-static byte vincr = 1;
-static word caddr = 0;
-static word ccntr = 0;
+static THREAD_LOCAL byte fontidx = 0;
+static THREAD_LOCAL byte fontrow = 0;
+static THREAD_LOCAL byte byFPGA = 0;
+static THREAD_LOCAL word vaddr = 0;
+static THREAD_LOCAL byte vincr = 1;
+static THREAD_LOCAL word caddr = 0;
+static THREAD_LOCAL word ccntr = 0;
 
-static VDP mfxvdp;
-static byte *vdppix = NULL;
+static THREAD_LOCAL VDP mfxvdp;
 
 void mfx_init (int emu)
     {
@@ -338,9 +337,7 @@ void mfx_init (int emu)
     memset (vram, 0, VSIZE);
     if ( font == NULL ) font = (FONT *) emalloc (sizeof (FONT));
     memcpy (font, mon_alpha_prom, sizeof (FONT));
-    if ( vdppix == NULL ) vdppix = (byte *) emalloc (VDP_WIDTH * VDP_HEIGHT);
     mfxvdp.ram = &vram[VADDR(0x4000)];
-    mfxvdp.pix = vdppix;
     mfx_win = win_create(
         WIDTH, HEIGHT,
         mfx_emu, mfx_emu,
@@ -361,11 +358,6 @@ void mfx_term (void)
         win_delete (mfx_win);
         mfx_win = NULL;
         }
-    if (vdppix != NULL)
-        {
-        free (vdppix);
-        vdppix = NULL;
-        }
     if (font != NULL)
         {
         free (font);
@@ -1042,32 +1034,19 @@ void mfx_refresh (void)
         if ( mfxvdp.changed )
             {
             // diag_message (DIAG_MFX, "MFX refresh in VDP mode");
-            vdp_refresh (&mfxvdp);
             byte pal = 0xC0 | (byFPGA & 0x20);
-            byte *vdp_data = vdppix;
+            byte cols[16];
+            for ( int i = 0; i < 16; ++i ) cols[i] = pal | i;
             memset (mfx_win->data, pal, WIDTH * VDP_YORG);
             byte *mfx_data = mfx_win->data + WIDTH * VDP_YORG;
-            for ( int i = 0; i < VDP_HEIGHT; ++i )
+            for ( int i = 0; i < 2 * VDP_HEIGHT; ++i )
                 {
                 memset (mfx_data, pal, VDP_XORG);
-                mfx_data += VDP_XORG;
-                for ( int j = 0; j < VDP_WIDTH; ++j )
-                    {
-                    byte pix = pal | (*vdp_data);
-                    *mfx_data = pix;
-                    *(mfx_data + WIDTH) = pix;
-                    ++mfx_data;
-                    *mfx_data = pix;
-                    *(mfx_data + WIDTH) = pix;
-                    ++mfx_data;
-                    ++vdp_data;
-                    }
-                memset (mfx_data, pal, WIDTH - VDP_XORG - 2 * VDP_WIDTH);
-                mfx_data += WIDTH - VDP_XORG - 2 * VDP_WIDTH;
-                memcpy (mfx_data, mfx_data - WIDTH, WIDTH);
+                memset (mfx_data + VDP_XORG + 2 * VDP_WIDTH, pal, WIDTH - VDP_XORG - 2 * VDP_WIDTH);
                 mfx_data += WIDTH;
                 }
             memset (mfx_data, pal, (HEIGHT - VDP_YORG - 2 * VDP_HEIGHT) * WIDTH);
+            vdp_refresh (&mfxvdp, mfx_win->data + WIDTH * VDP_YORG + VDP_XORG, WIDTH, 2, cols);
             }
         }
     else if (changed)
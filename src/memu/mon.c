@@ -53,6 +53,7 @@ http://www.tinyvga.com/6845 describes the chip used.
 #include "kbd.h"
 #include "monprom.h"
 #include "mon.h"
+#include "replay.h"
 #ifdef HAVE_CONFIG
 #include "config.h"
 #endif
@@ -64,24 +65,25 @@ http://www.tinyvga.com/6845 describes the chip used.
 /*...vkbd\46\h:0:*/
 /*...vmonprom\46\h:0:*/
 /*...vmon\46\h:0:*/
+/*...vreplay\46\h:0:*/
 /*...e*/
 
 /*...svars:0:*/
-static int mon_emu = MONEMU_IGNORE_INIT;
+static THREAD_LOCAL int mon_emu = MONEMU_IGNORE_INIT;
 
 #define	ROWS         24
 #define	COLUMNS      80
 
-static const char *mon_title = NULL;
-static const char *mon_display = NULL;
+static THREAD_LOCAL const char *mon_title = NULL;
+static THREAD_LOCAL const char *mon_display = NULL;
 
 /* The hardware level emulation state */
 
-static byte mon_adr_lo;
-static byte mon_adr_hi;
-static byte mon_ascd;
-static byte mon_atrd;
-static byte mon_crtc_address;
+static THREAD_LOCAL byte mon_adr_lo;
+static THREAD_LOCAL byte mon_adr_hi;
+static THREAD_LOCAL byte mon_ascd;
+static THREAD_LOCAL byte mon_atrd;
+static THREAD_LOCAL byte mon_crtc_address;
 
 /* The driver emulation state */
 
@@ -103,23 +105,23 @@ static byte mon_crtc_address;
 
 #define	SCREEN_RAM      2048
 
-static WIN *mon_win;
-static TXTBUF *mon_tbuf;
-static int mon_x, mon_y;
-static byte mon_print_attr;
-static byte mon_non_print_attr;
-static BOOLEAN mon_cursor_on;
-static BOOLEAN mon_scroll;
-static BOOLEAN mon_scrolled = FALSE;
-static byte mon_write_mask;
+static THREAD_LOCAL WIN *mon_win;
+static THREAD_LOCAL TXTBUF *mon_tbuf;
+static THREAD_LOCAL int mon_x, mon_y;
+static THREAD_LOCAL byte mon_print_attr;
+static THREAD_LOCAL byte mon_non_print_attr;
+static THREAD_LOCAL BOOLEAN mon_cursor_on;
+static THREAD_LOCAL BOOLEAN mon_scroll;
+static THREAD_LOCAL BOOLEAN mon_scrolled = FALSE;
+static THREAD_LOCAL byte mon_write_mask;
 
-static BOOLEAN mon_ascrt_no_colour;
+static THREAD_LOCAL BOOLEAN mon_ascrt_no_colour;
 
 /* How to map characters to glyphs */
 #define	MODE_STANDARD  0
 #define	MODE_ALTERNATE 1
 #define	MODE_GRAPHIC   2
-static int mon_mode;
+static THREAD_LOCAL int mon_mode;
 
 /* State names reflect what we expect next */
 #define	STATE_NORMAL    0
@@ -141,14 +143,14 @@ static int mon_mode;
 #define	STATE_ESC_P_N  16
 #define	STATE_ESC_N_N  17
 #define	STATE_ESC_B_N  18
-static int mon_state;
+static THREAD_LOCAL int mon_state;
 
-static BOOLEAN mon_win_changed;
+static THREAD_LOCAL BOOLEAN mon_win_changed;
 #ifdef HAVE_TH
-static BOOLEAN mon_th_changed;
+static THREAD_LOCAL BOOLEAN mon_th_changed;
 #endif
-static BOOLEAN mon_blink_blank;
-static BOOLEAN mon_kbd_pressed;
+static THREAD_LOCAL BOOLEAN mon_blink_blank;
+static THREAD_LOCAL BOOLEAN mon_kbd_pressed;
 /*...e*/
 
 #ifdef __Pico__
@@ -1117,7 +1119,7 @@ void mon_refresh_vdeb (void)
    a control character, or escape sequence, and now we must accumulate more
    input before actually performing an action. */
 
-static int mon_x1, mon_y1, mon_x2, mon_y2;
+static THREAD_LOCAL int mon_x1, mon_y1, mon_x2, mon_y2;
 
 static void mon_write_model(char c)
 	{
@@ -1347,18 +1349,94 @@ static int mon_kbd_map_th(int k)
 	}
 #endif
 /*...e*/
+/*...smon_kbd_record:0:*/
+#ifndef SMALL_MEM
+/* With -record, each key is recorded when the Z80 is first told of it.
+   mon_kbd_status may be told of one before it is read, which is kept
+   here. Host events are only handled in LoopZ80, so the keys come from
+   those already pressed, except when the Z80 must wait for one. */
+static THREAD_LOCAL int mon_kbd_seen = 0;
+
+static int mon_kbd_note(int ch)
+	{
+	if ( replay_mode == REPLAY_RECORD )
+		replay_note(REPLAY_MON, 0, (word) ch);
+	return ch;
+	}
+#define	MON_KBD_NOTE(ch)	mon_kbd_note(ch)
+
+/* A key already pressed, without handling host events */
+static int mon_kbd_take(void)
+	{
+	int ch = 0;
+	if ( mon_emu & MONEMU_WIN )
+		{
+		int wk = twin_kbd_take (mon_win);
+		if ( wk >= 0 )
+			ch = mon_map_wk (wk);
+		mon_refresh_blink();
+		}
+#ifdef HAVE_TH
+	if ( ch == 0 && ( mon_emu & MONEMU_TH ) && th_key_status() != 0 )
+		ch = mon_kbd_map_th(th_key_read());
+#endif
+	return ( ch != 0 ) ? mon_kbd_note(ch) : 0;
+	}
+
+/* With -replay, the keys come from the recording instead. When the Z80
+   waits for a key, one was recorded at this point, after any changes to
+   the keyboard matrix made while the host waited. If it isn't there,
+   the replay is out of step, and the host gives the keys from now on. */
+static BOOLEAN mon_kbd_replay(BOOLEAN wait, int *ch)
+	{
+	byte b;
+	if ( replay_mode != REPLAY_PLAY )
+		return FALSE;
+	if ( wait )
+		replay_periodic();
+	if ( replay_mode == REPLAY_PLAY && replay_byte(REPLAY_MON, 0, &b) )
+		{
+		*ch = b;
+		return TRUE;
+		}
+	if ( ! wait )
+		{
+		*ch = 0;
+		return TRUE;
+		}
+	if ( replay_mode == REPLAY_PLAY )
+		replay_stop("is out of step");
+	return FALSE;
+	}
+#else
+#define	MON_KBD_NOTE(ch)	(ch)
+#endif
+/*...e*/
 /*...smon_kbd_read:0:*/
 /* This emulation is used by the CP/M emulation.
    Its allowed to suspend the emulation. */
 
 int mon_kbd_read(void)
 	{
+#ifndef SMALL_MEM
+	int ch;
+#endif
 #ifdef HAVE_TH
 	if ( (mon_emu & (MONEMU_CONSOLE|MONEMU_WIN|MONEMU_TH)) == 0 )
 #else
 	if ( (mon_emu & (MONEMU_CONSOLE|MONEMU_WIN)) == 0 )
 #endif
 		fatal("blocking keyboard read attempted with no monitor keyboard device");
+#ifndef SMALL_MEM
+	if ( mon_kbd_seen != 0 )
+		{
+		ch = mon_kbd_seen;
+		mon_kbd_seen = 0;
+		return ch;
+		}
+	if ( mon_kbd_replay(TRUE, &ch) )
+		return ch;
+#endif
 #ifdef HAVE_CONSOLE
 	if ( mon_emu & MONEMU_CONSOLE )
 		/* This will suspend the emulation,
@@ -1370,7 +1448,7 @@ int mon_kbd_read(void)
 		int ch = fgetc(stdin);
 		if ( ch == '\n' )
 			ch = '\r';
-		return ch;
+		return MON_KBD_NOTE(ch);
 		}
 #endif
 #ifdef HAVE_TH
@@ -1381,9 +1459,10 @@ int mon_kbd_read(void)
 		mon_refresh_blink(); /* Make sure screen is correct before suspending */
 		k = th_key_read();
 		ch = mon_kbd_map_th(k);
-		return ch;
+		return MON_KBD_NOTE(ch);
 		}
 #endif
+	/* Waiting, so host events must be handled here, even with -record */
 	for ( ;; )
 		{
 		if ( mon_emu & MONEMU_WIN )
@@ -1393,7 +1472,7 @@ int mon_kbd_read(void)
                 {
                 int ch = mon_map_wk (wk);
                 if ( ch != 0 )
-                    return ch;
+                    return MON_KBD_NOTE(ch);
                 }
 			}
 #ifdef HAVE_TH
@@ -1404,7 +1483,7 @@ int mon_kbd_read(void)
 				int k = th_key_read();
 				int ch = mon_kbd_map_th(k);
 				if ( ch != 0 )
-					return ch;
+					return MON_KBD_NOTE(ch);
 				}
 			}
 #endif
@@ -1429,14 +1508,24 @@ int mon_kbd_read_non_wait(void)
 		   and any flashing graphics and cursor won't update. */
 		mon_kbd_pressed = !mon_kbd_pressed;
 		if ( mon_kbd_pressed )
+			return mon_kbd_read();
+		else
+			return 0;
+		}
+#endif
+#ifndef SMALL_MEM
+	if ( replay_mode != REPLAY_OFF )
+		{
+		int ch;
+		if ( mon_kbd_seen != 0 )
 			{
-			int ch = fgetc(stdin);
-			if ( ch == '\n' )
-				ch = '\r';
+			ch = mon_kbd_seen;
+			mon_kbd_seen = 0;
 			return ch;
 			}
-		else
-			return 0;
+		if ( mon_kbd_replay(FALSE, &ch) )
+			return ch;
+		return mon_kbd_take();
 		}
 #endif
 	if ( mon_emu & MONEMU_WIN )
@@ -1479,6 +1568,19 @@ BOOLEAN mon_kbd_status(void)
 		   to try to read the key, and thus suspend */
 		return TRUE;
 		}
+#endif
+#ifndef SMALL_MEM
+	if ( replay_mode == REPLAY_PLAY )
+		{
+		mon_refresh_blink();
+		return replay_ready(REPLAY_MON, 0);
+		}
+	if ( replay_mode == REPLAY_RECORD )
+		{
+		if ( mon_kbd_seen == 0 )
+			mon_kbd_seen = mon_kbd_take();
+		return mon_kbd_seen != 0;
+		}
 #endif
 	if ( mon_emu & MONEMU_WIN )
 		{
@@ -18,7 +18,7 @@ I don't have access to a real FDX or a image of its character generator PROM.
 
 #define	ROW(b7,b6,b5,b4,b3,b2,b1,b0) ( ((b7)<<7) | ((b6)<<6) | ((b5)<<5) | ((b4)<<4) | ((b3)<<3) | ((b2)<<2) | ((b1)<<1) | (b0))
 
-byte mon_alpha_prom[0x100][GLYPH_HEIGHT] =
+THREAD_LOCAL byte mon_alpha_prom[0x100][GLYPH_HEIGHT] =
 	{
 	/* graphics set 1 */
 
@@ -3359,9 +3359,9 @@ byte mon_alpha_prom[0x100][GLYPH_HEIGHT] =
 
 	};
 
-byte mon_graphic_prom[0x100][GLYPH_HEIGHT];
+THREAD_LOCAL byte mon_graphic_prom[0x100][GLYPH_HEIGHT];
 
-byte mon_blank_prom[GLYPH_HEIGHT] =
+THREAD_LOCAL byte mon_blank_prom[GLYPH_HEIGHT] =
 	{ /* blank */
 	ROW(0,0,0,0,0,0,0,0),
 	ROW(0,0,0,0,0,0,0,0),
@@ -17,9 +17,9 @@ monprom.h - Character generator PROM
 #define	GLYPH_WIDTH   8
 #define	GLYPH_HEIGHT 10
 
-extern byte mon_alpha_prom[0x100][GLYPH_HEIGHT];
-extern byte mon_graphic_prom[0x100][GLYPH_HEIGHT];
-extern byte mon_blank_prom[GLYPH_HEIGHT];
+extern THREAD_LOCAL byte mon_alpha_prom[0x100][GLYPH_HEIGHT];
+extern THREAD_LOCAL byte mon_graphic_prom[0x100][GLYPH_HEIGHT];
+extern THREAD_LOCAL byte mon_blank_prom[GLYPH_HEIGHT];
 
 extern void mon_init_prom(void);
 
@@ -278,15 +278,15 @@ static const char *psProto[] = { "Closed", "TCP", "UDP", "Raw IP", "Raw MAC", "P
 #define SOCK_MACRAW         0x42
 #define SOCK_PPPoE          0x5F
 
-static BOOLEAN nfx_init = FALSE;
-static byte nfx_reg[NFX_MEM];
-static word nfx_addr;
-static int  nfx_offset = 0;
-static byte nfx_data[0x2000];
+static THREAD_LOCAL BOOLEAN nfx_init = FALSE;
+static THREAD_LOCAL byte nfx_reg[NFX_MEM];
+static THREAD_LOCAL word nfx_addr;
+static THREAD_LOCAL int  nfx_offset = 0;
+static THREAD_LOCAL byte nfx_data[0x2000];
 
 #define nfx_sock_reg(skt, addr) nfx_reg[0x400 + 0x100 * skt + addr]
 
-static struct   // Linux connection per TCP port
+static THREAD_LOCAL struct   // Linux connection per TCP port
     {
     int ncon;       // Number of NFX sockets for this port
     int proto;      // Protocol for the connection
@@ -295,7 +295,7 @@ static struct   // Linux connection per TCP port
     }
     nfx_conn[NFX_NSOCK];
 
-static struct   // Data for each NFX socket
+static THREAD_LOCAL struct   // Data for each NFX socket
     {
     int icon;       // Linux connection number for this NFX socket
     SOCKET iskt;    // Socket stream number for established connection
@@ -318,7 +318,7 @@ typedef struct
     const char *ps;
     } reg_desc;
 
-reg_desc comm_desc[] = {
+THREAD_LOCAL reg_desc comm_desc[] = {
     { 0x00, "Mode" },
     { 0x01, "Gateway address %d" },
     { 0x05, "Subnet mask %d" },
@@ -339,7 +339,7 @@ reg_desc comm_desc[] = {
     { 0x2E, "Unreachable port %d" },
     { 0x30, "" }};
 
-reg_desc sock_desc[] = {
+THREAD_LOCAL reg_desc sock_desc[] = {
     { S_MR, "mode" },
     { S_CR, "command" },
     { S_IR, "interrupt" },
@@ -372,7 +372,7 @@ int info_index (reg_desc *desc, word addr)
 
 const char *reg_info (word addr)
     {
-    static char sDesc[256];
+    static THREAD_LOCAL char sDesc[256];
     if ( addr < 0x30 )
         {
         int idx = info_index (comm_desc, addr);
@@ -411,7 +411,7 @@ const char *reg_info (word addr)
 
 static void nfx_show_data (byte *pdata, int ndata)
     {
-    static char sLine[80];
+    static THREAD_LOCAL char sLine[80];
     int addr = 0;
     while ( ndata > 0 )
         {
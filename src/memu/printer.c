@@ -30,9 +30,9 @@ CP/M related stuff moved to CP/M emulation.
 #define	PRN_SLCT  0x08				/* Select */
 #define	PRN_READY ( PRN_NERR | PRN_SLCT )	/* Printer ready */
 
-static FILE *fp_print = NULL;
-static byte output_byte;
-static BOOLEAN strobe = FALSE;
+static THREAD_LOCAL FILE *fp_print = NULL;
+static THREAD_LOCAL byte output_byte;
+static THREAD_LOCAL BOOLEAN strobe = FALSE;
 /*...e*/
 
 /*...sprint_byte:0:*/
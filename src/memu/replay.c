@@ -0,0 +1,230 @@
+/*
+
+replay.c - Record and replay the inputs from outside the machine
+
+A recording is a header followed by fixed size records, each giving
+the Z80 clock, what the input was, and its value. The Z80 clock is
+only looked at between instructions, so inputs recorded when the host
+got round to them are replayed at the same point in the emulation,
+however fast or slow the host is this time.
+
+Changes to the keyboard matrix are replayed from LoopZ80, at the point
+win_handle_events would have made them. Bytes for the DART and NFX, and
+keys from the monitor keyboard, are taken from the recording where they
+would have been read.
+
+*/
+
+/*...sincludes:0:*/
+#include "ff_stdio.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "diag.h"
+#include "common.h"
+#include "memu.h"
+#include "kbd.h"
+#include "replay.h"
+
+/*...vtypes\46\h:0:*/
+/*...vdiag\46\h:0:*/
+/*...vcommon\46\h:0:*/
+/*...vmemu\46\h:0:*/
+/*...vkbd\46\h:0:*/
+/*...vreplay\46\h:0:*/
+/*...e*/
+
+/*...svars:0:*/
+THREAD_LOCAL int replay_mode = REPLAY_OFF;
+
+#ifndef SMALL_MEM
+#define	REPLAY_MAGIC	"MEMUINP1"
+#define	L_MAGIC		8
+#define	L_REC		12	/* Clock (8), type, index, value (2) */
+
+static THREAD_LOCAL FILE *replay_fp = NULL;
+static THREAD_LOCAL const char *replay_fn;
+static THREAD_LOCAL byte *replay_buf = NULL;	/* Whole recording, when playing */
+static THREAD_LOCAL size_t replay_len;
+static THREAD_LOCAL size_t replay_pos;		/* Next record to give */
+static THREAD_LOCAL BOOLEAN replay_headless = FALSE;
+#endif
+/*...e*/
+
+#ifndef SMALL_MEM
+/*...sreplay_head:0:*/
+/* The next record, if it is due by now */
+static const byte *replay_head(unsigned long long *elapsed)
+	{
+	const byte *p;
+	int i;
+	if ( replay_pos + L_REC > replay_len )
+		return NULL;
+	p = replay_buf + replay_pos;
+	*elapsed = 0;
+	for ( i = 7; i >= 0; --i )
+		*elapsed = ( *elapsed << 8 ) | p[i];
+	if ( *elapsed > get_Z80_clocks() )
+		return NULL;
+	return p;
+	}
+/*...e*/
+/*...sreplay_stop:0:*/
+/* Hand back to the host, or finish if there isn't one */
+void replay_stop(const char *why)
+	{
+	diag_message(DIAG_ALWAYS, "replay of %s %s at clock %llu", replay_fn, why, get_Z80_clocks());
+	free(replay_buf);
+	replay_buf = NULL;
+	replay_mode = REPLAY_OFF;
+	if ( replay_headless )
+		terminate("replay finished");
+	}
+/*...e*/
+
+/*...sreplay_record:0:*/
+void replay_record(const char *fn)
+	{
+	if ( (replay_fp = fopen(fn, "wb")) == NULL )
+		fatal("can't create recording file %s", fn);
+	fwrite(REPLAY_MAGIC, 1, L_MAGIC, replay_fp);
+	replay_fn = fn;
+	replay_mode = REPLAY_RECORD;
+	}
+/*...e*/
+/*...sreplay_play:0:*/
+void replay_play(const char *fn, BOOLEAN headless)
+	{
+	FILE *fp;
+	long size;
+	if ( (fp = fopen(fn, "rb")) == NULL )
+		fatal("can't open recording file %s", fn);
+	fseek(fp, 0L, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0L, SEEK_SET);
+	if ( size < L_MAGIC )
+		fatal("%s is not a recording file", fn);
+	replay_buf = (byte *) emalloc((size_t) size);
+	replay_len = fread(replay_buf, 1, (size_t) size, fp);
+	fclose(fp);
+	if ( replay_len != (size_t) size || memcmp(replay_buf, REPLAY_MAGIC, L_MAGIC) )
+		fatal("%s is not a recording file", fn);
+	replay_pos = L_MAGIC;
+	replay_fn = fn;
+	replay_headless = headless;
+	replay_mode = REPLAY_PLAY;
+	}
+/*...e*/
+/*...sreplay_note:0:*/
+/* An input from outside, to be recorded if recording */
+void replay_note(int type, int index, word value)
+	{
+	unsigned long long elapsed = get_Z80_clocks();
+	byte rec[L_REC];
+	int i;
+	if ( replay_mode != REPLAY_RECORD )
+		return;
+	for ( i = 0; i < 8; ++i, elapsed >>= 8 )
+		rec[i] = (byte) elapsed;
+	rec[8]  = (byte) type;
+	rec[9]  = (byte) index;
+	rec[10] = (byte) value;
+	rec[11] = (byte) ( value >> 8 );
+	fwrite(rec, 1, L_REC, replay_fp);
+	}
+/*...e*/
+/*...sreplay_byte:0:*/
+/* The byte recorded for this input, if it was recorded by now */
+BOOLEAN replay_byte(int type, int index, byte *value)
+	{
+	unsigned long long elapsed;
+	const byte *p = replay_head(&elapsed);
+	if ( p == NULL || p[8] != type || p[9] != index )
+		{
+		/* The DART is polled, it needn't have had a byte. The NFX
+		   has to be read in the same order as it was recorded. */
+		if ( type == REPLAY_NFX )
+			{
+			replay_stop("is out of step");
+			*value = 0xff;
+			return TRUE;
+			}
+		return FALSE;
+		}
+	*value = p[10];
+	replay_pos += L_REC;
+	return TRUE;
+	}
+/*...e*/
+/*...sreplay_ready:0:*/
+/* Whether the next record is this input, and due by now */
+BOOLEAN replay_ready(int type, int index)
+	{
+	unsigned long long elapsed;
+	const byte *p = replay_head(&elapsed);
+	return p != NULL && p[8] == type && p[9] == index;
+	}
+/*...e*/
+/*...sreplay_periodic:0:*/
+/* Give the keyboard and joystick changes due by now */
+void replay_periodic(void)
+	{
+	unsigned long long elapsed;
+	const byte *p;
+	while ( (p = replay_head(&elapsed)) != NULL )
+		{
+		switch ( p[8] )
+			{
+			case REPLAY_KBD:
+			case REPLAY_JOY:
+				kbd_replay_sense(p[8] == REPLAY_JOY, p[9], (word) ( p[10] | ( p[11] << 8 ) ));
+				break;
+			case REPLAY_RESET:
+				replay_pos += L_REC;
+				memu_reset();
+				continue;
+			case REPLAY_END:
+				replay_stop("finished");
+				return;
+			default:
+				/* Wait for it to be read */
+				return;
+			}
+		replay_pos += L_REC;
+		}
+	if ( replay_pos + L_REC > replay_len )
+		replay_stop("ended early");
+	}
+/*...e*/
+/*...sreplay_next:0:*/
+/* When the next record is due, so idle skipping stops short of it */
+unsigned long long replay_next(void)
+	{
+	const byte *p;
+	unsigned long long elapsed = 0;
+	int i;
+	if ( replay_mode != REPLAY_PLAY || replay_pos + L_REC > replay_len )
+		return ~0ULL;
+	p = replay_buf + replay_pos;
+	for ( i = 7; i >= 0; --i )
+		elapsed = ( elapsed << 8 ) | p[i];
+	return elapsed;
+	}
+/*...e*/
+/*...sreplay_term:0:*/
+void replay_term(void)
+	{
+	if ( replay_mode == REPLAY_RECORD )
+		{
+		replay_note(REPLAY_END, 0, 0);
+		if ( fclose(replay_fp) != 0 )
+			diag_message(DIAG_ALWAYS, "can't write recording file %s", replay_fn);
+		replay_fp = NULL;
+		}
+	free(replay_buf);
+	replay_buf = NULL;
+	replay_mode = REPLAY_OFF;
+	}
+/*...e*/
+#endif
@@ -0,0 +1,49 @@
+/*
+
+replay.h - Record and replay the inputs from outside the machine
+
+With -record file, every input which doesn't come from the emulation
+itself (changes to the keyboard matrix from the host keyboard and
+joystick, bytes received by the DART, reads from the NFX, keys given
+by the monitor keyboard to the CP/M emulation) is written
+to the file, stamped with the Z80 clock. With -replay file, those
+inputs are ignored, and the ones recorded are given instead, at the
+same Z80 clock, so the run is repeated exactly. The same options must
+be given for both.
+
+*/
+
+#ifndef REPLAY_H
+#define	REPLAY_H
+
+/*...sincludes:0:*/
+#include "types.h"
+
+/*...vtypes\46\h:0:*/
+/*...e*/
+
+#define	REPLAY_OFF	0
+#define	REPLAY_RECORD	1
+#define	REPLAY_PLAY	2
+
+#define	REPLAY_KBD	1	/* Keyboard matrix row index becomes value */
+#define	REPLAY_JOY	2	/* Joystick matrix row index becomes value */
+#define	REPLAY_DART	3	/* Byte value received on DART channel index */
+#define	REPLAY_NFX	4	/* Byte value read from NFX port index */
+#define	REPLAY_RESET	5	/* Reset key combination released */
+#define	REPLAY_MON	6	/* Byte value from the monitor keyboard */
+#define	REPLAY_END	0xff	/* End of the recording */
+
+extern THREAD_LOCAL int replay_mode;
+
+extern void replay_record(const char *fn);
+extern void replay_play(const char *fn, BOOLEAN headless);
+extern void replay_note(int type, int index, word value);
+extern BOOLEAN replay_byte(int type, int index, byte *value);
+extern BOOLEAN replay_ready(int type, int index);
+extern void replay_periodic(void);
+extern unsigned long long replay_next(void);
+extern void replay_stop(const char *why);
+extern void replay_term(void);
+
+#endif
@@ -0,0 +1,290 @@
+/*
+
+rewind.c - Step back in time
+
+The latest capture is kept whole, as built by state_build. Each older
+capture is kept as the XOR with the one after it, run length encoded,
+so the RAM and VRAM which haven't changed cost next to nothing. The
+oldest captures are dropped to keep within the memory allowed.
+
+*/
+
+/*...sincludes:0:*/
+#include "ff_stdio.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "diag.h"
+#include "common.h"
+#include "state.h"
+#include "rewind.h"
+
+/*...vtypes\46\h:0:*/
+/*...vdiag\46\h:0:*/
+/*...vcommon\46\h:0:*/
+/*...vstate\46\h:0:*/
+/*...vrewind\46\h:0:*/
+/*...e*/
+
+/*...svars:0:*/
+THREAD_LOCAL BOOLEAN rewind_on = FALSE;
+
+#ifndef SMALL_MEM
+/* Runs of fewer zeros than this are left in with the literal bytes */
+#define	REWIND_MIN_RUN	4
+
+typedef struct
+	{
+	byte *data;		/* Encoded XOR with the capture after it */
+	size_t len;		/* Length of data */
+	size_t older_len;	/* Length of this capture, once decoded */
+	} REWIND_DELTA;
+
+static THREAD_LOCAL REWIND_DELTA *rewind_ring = NULL;
+static THREAD_LOCAL unsigned int rewind_mask;		/* Ring size - 1 */
+static THREAD_LOCAL unsigned int rewind_first;		/* Oldest delta */
+static THREAD_LOCAL unsigned int rewind_count;		/* Deltas in the ring */
+static THREAD_LOCAL size_t rewind_bytes;		/* Held by the deltas */
+static THREAD_LOCAL size_t rewind_budget;
+static THREAD_LOCAL int rewind_frames;			/* Frames between captures */
+static THREAD_LOCAL int rewind_frames_since;		/* Since the latest capture */
+static THREAD_LOCAL STATE rewind_cur;			/* The latest capture */
+static THREAD_LOCAL STATE rewind_new;			/* Being captured */
+static THREAD_LOCAL byte *rewind_enc = NULL;
+static THREAD_LOCAL size_t rewind_enc_size = 0;
+#endif
+/*...e*/
+
+#ifndef SMALL_MEM
+/*...srewind_put_len:0:*/
+/* 7 bits at a time, least significant first */
+static byte *rewind_put_len(byte *p, size_t n)
+	{
+	while ( n >= 0x80 )
+		{
+		*p++ = (byte) ( n | 0x80 );
+		n >>= 7;
+		}
+	*p++ = (byte) n;
+	return p;
+	}
+/*...e*/
+/*...srewind_get_len:0:*/
+static const byte *rewind_get_len(const byte *p, size_t *n)
+	{
+	int shift = 0;
+	*n = 0;
+	do
+		{
+		*n |= (size_t) ( *p & 0x7f ) << shift;
+		shift += 7;
+		}
+	while ( *p++ & 0x80 );
+	return p;
+	}
+/*...e*/
+/*...srewind_encode:0:*/
+#define	REWIND_XOR(i)	( ( (i) < newer->len ? newer->buf[i] : 0 ) ^ ( (i) < older->len ? older->buf[i] : 0 ) )
+
+/* The XOR of newer and older (the shorter taken as padded with zeros),
+   as pairs of a run of zeros and some literal bytes, into rewind_enc.
+   Returns the length of the encoding. */
+static size_t rewind_encode(const STATE *newer, const STATE *older)
+	{
+	size_t n = ( newer->len > older->len ) ? newer->len : older->len;
+	size_t common = ( newer->len < older->len ) ? newer->len : older->len;
+	size_t i = 0;
+	byte *p;
+	/* Each pair ends with at least one byte, or REWIND_MIN_RUN zeros */
+	if ( rewind_enc_size < 3 * n + 16 )
+		{
+		free(rewind_enc);
+		rewind_enc_size = 3 * n + 16;
+		rewind_enc = (byte *) emalloc(rewind_enc_size);
+		}
+	p = rewind_enc;
+	for ( ;; )
+		{
+		size_t start = i;
+		size_t lit;
+		size_t run = 0;
+		/* Most of memory won't have changed */
+		while ( i + 64 <= common && !memcmp(newer->buf+i, older->buf+i, 64) )
+			i += 64;
+		while ( i < n && REWIND_XOR(i) == 0 )
+			++i;
+		if ( i == n )
+			break; /* Trailing zeros needn't be given */
+		lit = i;
+		while ( i < n && run < REWIND_MIN_RUN )
+			{
+			run = ( REWIND_XOR(i) == 0 ) ? run + 1 : 0;
+			++i;
+			}
+		i -= run;
+		p = rewind_put_len(p, lit - start);
+		p = rewind_put_len(p, i - lit);
+		for ( ; lit < i; ++lit )
+			*p++ = REWIND_XOR(lit);
+		}
+	return (size_t) ( p - rewind_enc );
+	}
+/*...e*/
+/*...srewind_decode:0:*/
+/* Turn rewind_cur back into the capture before it */
+static void rewind_decode(const REWIND_DELTA *d)
+	{
+	const byte *p = d->data;
+	const byte *end = d->data + d->len;
+	byte *q = rewind_cur.buf;
+	if ( d->older_len > rewind_cur.size )
+		{
+		byte *buf = (byte *) emalloc(d->older_len);
+		memcpy(buf, rewind_cur.buf, rewind_cur.len);
+		free(rewind_cur.buf);
+		rewind_cur.buf = buf;
+		rewind_cur.size = d->older_len;
+		q = buf;
+		}
+	if ( d->older_len > rewind_cur.len )
+		memset(rewind_cur.buf + rewind_cur.len, 0, d->older_len - rewind_cur.len);
+	while ( p < end )
+		{
+		size_t zeros;
+		size_t lit;
+		p = rewind_get_len(p, &zeros);
+		p = rewind_get_len(p, &lit);
+		q += zeros;
+		while ( lit-- > 0 )
+			*q++ ^= *p++;
+		}
+	rewind_cur.len = d->older_len;
+	}
+/*...e*/
+/*...srewind_drop_oldest:0:*/
+static void rewind_drop_oldest(void)
+	{
+	REWIND_DELTA *d = &rewind_ring[rewind_first];
+	rewind_bytes -= d->len;
+	free(d->data);
+	d->data = NULL;
+	rewind_first = ( rewind_first + 1 ) & rewind_mask;
+	--rewind_count;
+	}
+/*...e*/
+/*...srewind_push:0:*/
+static void rewind_push(size_t len, size_t older_len)
+	{
+	REWIND_DELTA *d;
+	if ( rewind_count == rewind_mask + 1 )
+		{
+		/* Double the ring, keeping the deltas in order */
+		unsigned int size = rewind_mask + 1;
+		REWIND_DELTA *ring = (REWIND_DELTA *) emalloc(2 * size * sizeof(REWIND_DELTA));
+		unsigned int i;
+		for ( i = 0; i < size; ++i )
+			ring[i] = rewind_ring[( rewind_first + i ) & rewind_mask];
+		free(rewind_ring);
+		rewind_ring = ring;
+		rewind_first = 0;
+		rewind_mask = 2 * size - 1;
+		}
+	d = &rewind_ring[( rewind_first + rewind_count ) & rewind_mask];
+	d->data = (byte *) emalloc(len);
+	memcpy(d->data, rewind_enc, len);
+	d->len = len;
+	d->older_len = older_len;
+	++rewind_count;
+	rewind_bytes += len;
+	while ( rewind_count > 0 && rewind_bytes + rewind_cur.size > rewind_budget )
+		rewind_drop_oldest();
+	}
+/*...e*/
+
+/*...srewind_capture:0:*/
+static void rewind_capture(void)
+	{
+	STATE st;
+	state_build(&rewind_new);
+	if ( rewind_cur.len > 0 )
+		rewind_push(rewind_encode(&rewind_new, &rewind_cur), rewind_cur.len);
+	st = rewind_cur;
+	rewind_cur = rewind_new;
+	rewind_new = st;
+	rewind_frames_since = 0;
+	}
+/*...e*/
+/*...srewind_frame:0:*/
+/* Called as each frame is displayed */
+void rewind_frame(void)
+	{
+	if ( ++rewind_frames_since >= rewind_frames )
+		rewind_capture();
+	}
+/*...e*/
+/*...srewind_step:0:*/
+/* Back to the latest capture, unless it was only just made, in which
+   case back to the one before it */
+BOOLEAN rewind_step(void)
+	{
+	if ( rewind_cur.len == 0 )
+		return FALSE;
+	if ( rewind_frames_since == 0 )
+		{
+		REWIND_DELTA *d;
+		if ( rewind_count == 0 )
+			{
+			diag_message(DIAG_ALWAYS, "can't rewind any further");
+			return FALSE;
+			}
+		d = &rewind_ring[( rewind_first + --rewind_count ) & rewind_mask];
+		rewind_decode(d);
+		rewind_bytes -= d->len;
+		free(d->data);
+		d->data = NULL;
+		}
+	rewind_frames_since = 0;
+	return state_restore(rewind_cur.buf, rewind_cur.len, "rewind");
+	}
+/*...e*/
+
+/*...srewind_init:0:*/
+/* Capture every frames frames, keeping within kb KB */
+void rewind_init(int frames, int kb)
+	{
+	rewind_frames = frames;
+	rewind_budget = (size_t) kb * 1024;
+	rewind_ring = (REWIND_DELTA *) emalloc(16 * sizeof(REWIND_DELTA));
+	rewind_mask = 15;
+	rewind_first = 0;
+	rewind_count = 0;
+	rewind_bytes = 0;
+	rewind_cur.buf = NULL;
+	rewind_cur.len = 0;
+	rewind_new.buf = NULL;
+	rewind_new.len = 0;
+	rewind_frames_since = 0;
+	rewind_on = TRUE;
+	}
+/*...e*/
+/*...srewind_term:0:*/
+void rewind_term(void)
+	{
+	if ( ! rewind_on )
+		return;
+	while ( rewind_count > 0 )
+		rewind_drop_oldest();
+	free(rewind_ring);
+	rewind_ring = NULL;
+	free(rewind_cur.buf);
+	rewind_cur.buf = NULL;
+	free(rewind_new.buf);
+	rewind_new.buf = NULL;
+	free(rewind_enc);
+	rewind_enc = NULL;
+	rewind_enc_size = 0;
+	rewind_on = FALSE;
+	}
+/*...e*/
+#endif
@@ -0,0 +1,28 @@
+/*
+
+rewind.h - Step back in time
+
+With -rewind n, the state of the machine is captured every n frames
+into a ring in memory, each capture being kept as the difference from
+the one after it. F9+e, or rewind_step, goes back to the last capture,
+and then the one before that, and so on.
+
+*/
+
+#ifndef REWIND_H
+#define	REWIND_H
+
+/*...sincludes:0:*/
+#include "types.h"
+
+/*...vtypes\46\h:0:*/
+/*...e*/
+
+extern THREAD_LOCAL BOOLEAN rewind_on;
+
+extern void rewind_init(int frames, int kb);
+extern void rewind_frame(void);
+extern BOOLEAN rewind_step(void);
+extern void rewind_term(void);
+
+#endif
@@ -24,23 +24,23 @@
 #define LEN_RESP        6                   // Length of responses
 #define LEN_BLK         512                 // Length of data block
 
-static int nImage = 0;
-static const char *psImage[NSDPART] = { NULL };
-static FILE *pfImage[NSDPART] = { NULL };
-static int ncbt = 0;
-static byte sd_cfg;
-static byte cmdbuf[LEN_CMD];
-static byte crc = 0;
-static bool bAppCmd = false;
-static byte respbuf[LEN_RESP];
-static byte sd_stat[2] = {0, 0};
-static int nrbt = 0;
-static enum {ctSDv1, ctSDv2, ctSDHC} cdtyp = ctSDHC;
-static enum {st_idle, st_r1, st_r2, st_r3, st_r7, st_rd_ack, st_rm_ack, st_wr_ack,
+static THREAD_LOCAL int nImage = 0;
+static THREAD_LOCAL const char *psImage[NSDPART] = { NULL };
+static THREAD_LOCAL FILE *pfImage[NSDPART] = { NULL };
+static THREAD_LOCAL int ncbt = 0;
+static THREAD_LOCAL byte sd_cfg;
+static THREAD_LOCAL byte cmdbuf[LEN_CMD];
+static THREAD_LOCAL byte crc = 0;
+static THREAD_LOCAL bool bAppCmd = false;
+static THREAD_LOCAL byte respbuf[LEN_RESP];
+static THREAD_LOCAL byte sd_stat[2] = {0, 0};
+static THREAD_LOCAL int nrbt = 0;
+static THREAD_LOCAL enum {ctSDv1, ctSDv2, ctSDHC} cdtyp = ctSDHC;
+static THREAD_LOCAL enum {st_idle, st_r1, st_r2, st_r3, st_r7, st_rd_ack, st_rm_ack, st_wr_ack,
     st_read, st_rmrd, st_rmnxt, st_wr_wait, st_write} sd_state = st_idle;
-static bool bSDHC = false;
-static byte databuf[LEN_BLK];
-static FILE *pf = NULL;
+static THREAD_LOCAL bool bSDHC = false;
+static THREAD_LOCAL byte databuf[LEN_BLK];
+static THREAD_LOCAL FILE *pf = NULL;
 
 int sdcard_set_type (const char *psType)
     {
@@ -426,6 +426,59 @@ byte sdcard_in (byte port)
     return b;
     }
 
+#ifndef SMALL_MEM
+// The SD card part of a save-state (see state.c). The images come from the
+// configuration, only the position within the current one is saved.
+void sdcard_save_state (STATE *st)
+    {
+    int iImage;
+    long iPos = -1;
+    for ( iImage = 0; iImage < nImage; ++iImage )
+        {
+        if (( pf != NULL ) && ( pf == pfImage[iImage] ))
+            {
+            iPos = iImage * SD_PART_SIZE + ftell (pf);
+            break;
+            }
+        }
+    state_put_int (st, (unsigned int) ncbt);
+    state_put_byte (st, sd_cfg);
+    state_put_block (st, cmdbuf, LEN_CMD);
+    state_put_byte (st, crc);
+    state_put_byte (st, (byte) bAppCmd);
+    state_put_block (st, respbuf, LEN_RESP);
+    state_put_block (st, sd_stat, sizeof (sd_stat));
+    state_put_int (st, (unsigned int) nrbt);
+    state_put_byte (st, (byte) cdtyp);
+    state_put_byte (st, (byte) sd_state);
+    state_put_byte (st, (byte) bSDHC);
+    state_put_block (st, databuf, LEN_BLK);
+    state_put_int (st, (unsigned int) iPos);
+    }
+
+void sdcard_load_state (STATE *st, int version)
+    {
+    int iPos;
+    ncbt = (int) state_get_int (st);
+    sd_cfg = state_get_byte (st);
+    state_get_block (st, cmdbuf, LEN_CMD);
+    crc = state_get_byte (st);
+    bAppCmd = state_get_byte (st);
+    state_get_block (st, respbuf, LEN_RESP);
+    state_get_block (st, sd_stat, sizeof (sd_stat));
+    nrbt = (int) state_get_int (st);
+    cdtyp = state_get_byte (st);
+    sd_state = state_get_byte (st);
+    bSDHC = state_get_byte (st);
+    state_get_block (st, databuf, LEN_BLK);
+    iPos = (int) state_get_int (st);
+    if (( ncbt < 0 ) || ( ncbt > LEN_BLK + 2 )) ncbt = 0;
+    if (( nrbt < -2 ) || ( nrbt > LEN_BLK + 2 )) nrbt = -2;
+    if ( nImage <= 1 ) iPos %= SD_PART_SIZE;
+    pf = ( iPos >= 0 ) ? sd_seek (iPos) : NULL;
+    }
+#endif
+
 void sdcard_set_image (int iImage, const char *psFile)
     {
     if (( iImage < 0 ) || ( iImage >= NSDPART ))
@@ -22,6 +22,11 @@ void sdcard_out (byte port, byte value);
 byte sdcard_in (byte port);
 void sdcard_set_image (int iImage, const char *psFile);
 const char * sdcard_get_image (int iImage);
+#ifndef SMALL_MEM
+#include "state.h"
+void sdcard_save_state (STATE *st);
+void sdcard_load_state (STATE *st, int version);
+#endif
 #endif
 
 #endif
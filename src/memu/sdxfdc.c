@@ -33,7 +33,7 @@ AK    01/04/13 Support 40 track media in 80 track drive.
 #define  FDCS_LOST_DATA    0x04
 #define  FDCS_DATA         0x02
 #define  FDCS_BUSY         0x01
-static byte fdc_status = 0;
+static THREAD_LOCAL byte fdc_status = 0;
 #define  FDCC_SIDE         0x02
 #define  FDCC_MULTI        0x10
 #define  FDCC_MASK         0xe0
@@ -42,46 +42,46 @@ static byte fdc_status = 0;
 #define  FDCC_READ         0x80
 #define  FDCC_WRITE        0xa0
 #define  FDCC_WRITE_TRACK  0xf0
-static byte fdc_command = 0;
-static byte fdc_track = 0;
-static byte fdc_sector = 0;
-static byte fdc_data = 0;
+static THREAD_LOCAL byte fdc_command = 0;
+static THREAD_LOCAL byte fdc_track = 0;
+static THREAD_LOCAL byte fdc_sector = 0;
+static THREAD_LOCAL byte fdc_data = 0;
 
 #define  SDX_DRIVES              2
-static int  drv_no   =  0;
+static THREAD_LOCAL int  drv_no   =  0;
 
 #define  DRVS_CFG          0x1f
 #define  DRVS_READY        0x20
 #define  DRVS_INT          0x40
 #define  DRVS_DRQ          0x80
-static byte drv_cfg[SDX_DRIVES]  =
+static THREAD_LOCAL byte drv_cfg[SDX_DRIVES]  =
    {
    DRVS_DOUBLE_SIDED | DRVS_80TRACK | DRVS_1_DRIVE,
    DRVS_DOUBLE_SIDED | DRVS_80TRACK | DRVS_1_DRIVE
    };
-static byte drv_status  =  0;
+static THREAD_LOCAL byte drv_status  =  0;
 #define  DRVC_DRIVE           0x01
 #define  DRVC_SIDE            0x02
 #define  DRVC_MOTOR_ON        0x04
 #define  DRVC_MOTOR_READY     0x08
 #define  DRVC_DOUBLE_DENSITY  0x10
-static byte drv_control             =  0;
-static byte drv_track[SDX_DRIVES]   =  { 0, 0 };
-static BOOLEAN drv_stout            =  FALSE;
+static THREAD_LOCAL byte drv_control             =  0;
+static THREAD_LOCAL byte drv_track[SDX_DRIVES]   =  { 0, 0 };
+static THREAD_LOCAL BOOLEAN drv_stout            =  FALSE;
 
-static FILE *fdc_fd[SDX_DRIVES]     =  {NULL, NULL};
-static long media_len[SDX_DRIVES];
+static THREAD_LOCAL FILE *fdc_fd[SDX_DRIVES]     =  {NULL, NULL};
+static THREAD_LOCAL long media_len[SDX_DRIVES];
 
 #define  SDX_SECTOR_SD           128
 #define  SDX_SECTOR_DD           256
 #define  SDX_SECTORS_PER_TRACK   16
 #define  SDX_HEADS               2
-static byte drv_data[SDX_SECTOR_DD];
-static int sect_len[SDX_DRIVES]  =  { SDX_SECTOR_DD, SDX_SECTOR_DD };
-static int sect_pos  =  0;
+static THREAD_LOCAL byte drv_data[SDX_SECTOR_DD];
+static THREAD_LOCAL int sect_len[SDX_DRIVES]  =  { SDX_SECTOR_DD, SDX_SECTOR_DD };
+static THREAD_LOCAL int sect_pos  =  0;
 
-static enum { wtk_init, wtk_addr, wtk_skip, wtk_data } wtk_state  =  wtk_init;
-static int wtk_numsec;
+static THREAD_LOCAL enum { wtk_init, wtk_addr, wtk_skip, wtk_data } wtk_state  =  wtk_init;
+static THREAD_LOCAL int wtk_numsec;
 
 void sdxfdc_fdcsta (void)
    {
@@ -654,6 +654,62 @@ void sdxfdc_term (void)
       }
    }
 
+#ifndef SMALL_MEM
+/* The controller part of a save-state (see state.c).
+   The discs are the files given in the configuration. */
+void sdxfdc_save_state (STATE *st)
+   {
+   int   i;
+   state_put_byte (st, fdc_status);
+   state_put_byte (st, fdc_command);
+   state_put_byte (st, fdc_track);
+   state_put_byte (st, fdc_sector);
+   state_put_byte (st, fdc_data);
+   state_put_byte (st, (byte) drv_no);
+   state_put_byte (st, drv_status);
+   state_put_byte (st, drv_control);
+   state_put_byte (st, (byte) drv_stout);
+   for ( i = 0; i < SDX_DRIVES; ++i )
+      {
+      state_put_byte (st, drv_track[i]);
+      state_put_word (st, (word) sect_len[i]);
+      }
+   state_put_block (st, drv_data, sizeof (drv_data));
+   state_put_word (st, (word) sect_pos);
+   state_put_byte (st, (byte) wtk_state);
+   state_put_word (st, (word) wtk_numsec);
+   /* Where a sector transfer in progress will read or write */
+   state_put_int (st, ( fdc_fd[drv_no] != NULL ) ? (unsigned int) ftell (fdc_fd[drv_no]) : 0);
+   }
+
+void sdxfdc_load_state (STATE *st, int version)
+   {
+   int   i;
+   long  pos;
+   fdc_status  =  state_get_byte (st);
+   fdc_command =  state_get_byte (st);
+   fdc_track   =  state_get_byte (st);
+   fdc_sector  =  state_get_byte (st);
+   fdc_data    =  state_get_byte (st);
+   drv_no      =  state_get_byte (st) & ( SDX_DRIVES - 1 );
+   drv_status  =  state_get_byte (st);
+   drv_control =  state_get_byte (st);
+   drv_stout   =  state_get_byte (st);
+   for ( i = 0; i < SDX_DRIVES; ++i )
+      {
+      drv_track[i]   =  state_get_byte (st);
+      sect_len[i]    =  ( state_get_word (st) == SDX_SECTOR_SD ) ? SDX_SECTOR_SD : SDX_SECTOR_DD;
+      }
+   state_get_block (st, drv_data, sizeof (drv_data));
+   sect_pos    =  state_get_word (st) % SDX_SECTOR_DD;
+   wtk_state   =  state_get_byte (st);
+   wtk_numsec  =  state_get_word (st);
+   pos         =  (long) state_get_int (st);
+   if ( fdc_fd[drv_no] != NULL )
+      fseek (fdc_fd[drv_no], pos, SEEK_SET);
+   }
+#endif
+
 void sdxfdc_drvcfg (int drive, byte cfg)
    {
    if ( ( drive < 0 ) || ( drive >= SDX_DRIVES ) )
@@ -34,5 +34,10 @@ extern byte sdxfdc_in(word port);
 extern void sdxfdc_init(int drive, const char *psFile);
 extern void sdxfdc_term(void);
 extern void sdxfdc_drvcfg(int drive, byte cfg);
+#ifndef SMALL_MEM
+#include "state.h"
+extern void sdxfdc_save_state(STATE *st);
+extern void sdxfdc_load_state(STATE *st, int version);
+#endif
 
 #endif
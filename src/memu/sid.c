@@ -40,7 +40,7 @@ Changing the content would not be detected, and corruption would result.
 /*...e*/
 
 /*...svars:0:*/
-static int sid_emu;
+static THREAD_LOCAL int sid_emu;
 
 #ifdef SMALL_MEM
 #define BUFF_SID(emu)   1
@@ -52,7 +52,7 @@ static int sid_emu;
 
 #define	SIDISC_SIZE (8*1024*1024)
 
-static byte *memory[N_SIDISC] =
+static THREAD_LOCAL byte *memory[N_SIDISC] =
 	{
 	NULL,
 	NULL,
@@ -60,7 +60,7 @@ static byte *memory[N_SIDISC] =
 	NULL
 	};
 
-static const char *fns[N_SIDISC] =
+static THREAD_LOCAL const char *fns[N_SIDISC] =
 	{
 	NULL,
 	NULL,
@@ -68,7 +68,7 @@ static const char *fns[N_SIDISC] =
 	NULL
 	};
 
-static unsigned ptr[N_SIDISC] =
+static THREAD_LOCAL unsigned ptr[N_SIDISC] =
 	{
 	0,
 	0,
@@ -76,7 +76,7 @@ static unsigned ptr[N_SIDISC] =
 	0
 	};
 
-static size_t size[N_SIDISC] =
+static THREAD_LOCAL size_t size[N_SIDISC] =
 	{
 	SIDISC_SIZE,
 	SIDISC_SIZE,
@@ -84,7 +84,7 @@ static size_t size[N_SIDISC] =
 	SIDISC_SIZE
 	};
 
-static unsigned base[N_SIDISC] =
+static THREAD_LOCAL unsigned base[N_SIDISC] =
     {
     0,
     0,
@@ -100,7 +100,7 @@ static unsigned active[N_SIDISC] =
     0
     };
 */
-static FILE *fp[N_SIDISC] =
+static THREAD_LOCAL FILE *fp[N_SIDISC] =
     {
     NULL,
     NULL,
@@ -31,7 +31,7 @@
 /*...svars:0:*/
 #define FREQ 44100
 
-static int snd_emu = 0;
+static THREAD_LOCAL int snd_emu = 0;
 
 typedef struct
     {
@@ -40,14 +40,14 @@ typedef struct
     float phase;
     } CHANNEL;
 
-static CHANNEL snd_channels[3];
-static int snd_channel;
-static byte snd_noise_ctrl;
-static byte snd_noise_atten;
-static float snd_noise_phase;
-static word snd_noise_shifter;
-static int snd_noise_bit;
-static float snd_lastvol;
+static THREAD_LOCAL CHANNEL snd_channels[3];
+static THREAD_LOCAL int snd_channel;
+static THREAD_LOCAL byte snd_noise_ctrl;
+static THREAD_LOCAL byte snd_noise_atten;
+static THREAD_LOCAL float snd_noise_phase;
+static THREAD_LOCAL word snd_noise_shifter;
+static THREAD_LOCAL int snd_noise_bit;
+static THREAD_LOCAL float snd_lastvol;
 
 #ifdef __circle__
 #include "kfuncs.h"
@@ -124,6 +124,64 @@ void snd_out6(byte val)
         snd_set_tone_freq_high(val);
     }
 /*...e*/
+#ifndef SMALL_MEM
+/*...ssnd_save_state:0:*/
+/* The sound chip part of a save-state (see state.c). Version 2 adds the
+   phases of the generators, so the output carries on as it was. */
+#define	L_SND_STATE1	15
+#define	L_SND_STATE2	( L_SND_STATE1 + 5 * 4 )
+
+void snd_save_state(STATE *st)
+    {
+    int i;
+    for ( i = 0; i < 3; i++ )
+        {
+        state_put_word(st, snd_channels[i].freq);
+        state_put_byte(st, snd_channels[i].atten);
+        }
+    state_put_byte(st, (byte) snd_channel);
+    state_put_byte(st, snd_noise_ctrl);
+    state_put_byte(st, snd_noise_atten);
+    state_put_word(st, snd_noise_shifter);
+    state_put_byte(st, (byte) snd_noise_bit);
+    for ( i = 0; i < 3; i++ )
+        state_put_float(st, snd_channels[i].phase);
+    state_put_float(st, snd_noise_phase);
+    state_put_float(st, snd_lastvol);
+    }
+/*...e*/
+/*...ssnd_load_state:0:*/
+void snd_load_state(STATE *st, int version)
+    {
+    int i;
+    for ( i = 0; i < 3; i++ )
+        {
+        snd_channels[i].freq  = state_get_word(st) & 0x3ff;
+        snd_channels[i].atten = state_get_byte(st) & 0x0f;
+        }
+    snd_channel = state_get_byte(st) % 3;
+    snd_noise_ctrl = state_get_byte(st) & 0x07;
+    snd_noise_atten = state_get_byte(st) & 0x0f;
+    snd_noise_shifter = state_get_word(st);
+    snd_noise_bit = state_get_byte(st);
+    if ( version >= 2 )
+        {
+        for ( i = 0; i < 3; i++ )
+            snd_channels[i].phase = (float) fmod(state_get_float(st), 2.0);
+        snd_noise_phase = (float) fmod(state_get_float(st), 2.0);
+        snd_lastvol = state_get_float(st);
+        }
+    }
+/*...e*/
+/*...ssnd_check_state:0:*/
+BOOLEAN snd_check_state(STATE *st, int version)
+    {
+    size_t len = ( version >= 2 ) ? L_SND_STATE2 : L_SND_STATE1;
+    return ( st->len - st->pos >= len );
+    }
+/*...e*/
+#endif
+
 /*...ssnd_in3:0:*/
 /* There is no data returned by sound hardware when inputing from port 3.
    So we return the most recent value fetched over the bus.
@@ -280,6 +338,11 @@ int snd_callback (short *outputBuffer, unsigned long framesPerBuffer)
         PaDeviceIndex paDevice;
         const PaDeviceInfo *paDeviceInfo;
         PaTime paLatency;
+#ifdef MEMU_MULTI
+        /* PortAudio calls snd_callback on a thread of its own, which
+           cannot see the machine's THREAD_LOCAL sound chip */
+        emu &= ~SNDEMU_PORTAUDIO;
+#endif
         snd_emu = emu;
         for ( i = 0; i < 3; i++ )
             {
@@ -26,6 +26,13 @@ extern byte snd_in3(void);
 extern void snd_init(int emu, double latency);
 extern void snd_term(void);
 
+#ifndef SMALL_MEM
+#include "state.h"
+extern void snd_save_state(STATE *st);
+extern void snd_load_state(STATE *st, int version);
+extern BOOLEAN snd_check_state(STATE *st, int version);
+#endif
+
 #ifdef __circle__
 int snd_callback (short *outputBuffer, unsigned long framesPerBuffer);
 #endif
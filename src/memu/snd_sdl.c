@@ -120,6 +120,64 @@ void snd_out6(byte val)
         snd_set_tone_freq_high(val);
     }
 /*...e*/
+#ifndef SMALL_MEM
+/*...ssnd_save_state:0:*/
+/* The sound chip part of a save-state (see state.c). Version 2 adds the
+   phases of the generators, so the output carries on as it was. */
+#define	L_SND_STATE1	15
+#define	L_SND_STATE2	( L_SND_STATE1 + 5 * 4 )
+
+void snd_save_state(STATE *st)
+    {
+    int i;
+    for ( i = 0; i < 3; i++ )
+        {
+        state_put_word(st, snd_channels[i].freq);
+        state_put_byte(st, snd_channels[i].atten);
+        }
+    state_put_byte(st, (byte) snd_channel);
+    state_put_byte(st, snd_noise_ctrl);
+    state_put_byte(st, snd_noise_atten);
+    state_put_word(st, snd_noise_shifter);
+    state_put_byte(st, (byte) snd_noise_bit);
+    for ( i = 0; i < 3; i++ )
+        state_put_float(st, snd_channels[i].phase);
+    state_put_float(st, snd_noise_phase);
+    state_put_float(st, snd_lastvol);
+    }
+/*...e*/
+/*...ssnd_load_state:0:*/
+void snd_load_state(STATE *st, int version)
+    {
+    int i;
+    for ( i = 0; i < 3; i++ )
+        {
+        snd_channels[i].freq  = state_get_word(st) & 0x3ff;
+        snd_channels[i].atten = state_get_byte(st) & 0x0f;
+        }
+    snd_channel = state_get_byte(st) % 3;
+    snd_noise_ctrl = state_get_byte(st) & 0x07;
+    snd_noise_atten = state_get_byte(st) & 0x0f;
+    snd_noise_shifter = state_get_word(st);
+    snd_noise_bit = state_get_byte(st);
+    if ( version >= 2 )
+        {
+        for ( i = 0; i < 3; i++ )
+            snd_channels[i].phase = (float) fmod(state_get_float(st), 2.0);
+        snd_noise_phase = (float) fmod(state_get_float(st), 2.0);
+        snd_lastvol = state_get_float(st);
+        }
+    }
+/*...e*/
+/*...ssnd_check_state:0:*/
+BOOLEAN snd_check_state(STATE *st, int version)
+    {
+    size_t len = ( version >= 2 ) ? L_SND_STATE2 : L_SND_STATE1;
+    return ( st->len - st->pos >= len );
+    }
+/*...e*/
+#endif
+
 /*...ssnd_in3:0:*/
 /* There is no data returned by sound hardware when inputing from port 3.
    So we return the most recent value fetched over the bus.
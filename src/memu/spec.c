@@ -32,13 +32,13 @@ test as much, much like the Tatung Einstein version didn't.
 /*...e*/
 
 /*...svars:0:*/
-static byte spec_kempston = 0xff;
-static byte spec_fuller = 0x00;
-static byte spec_printer = 0x40;
-static byte spec_border = 0xff;
-static byte spec_rows[8] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+static THREAD_LOCAL byte spec_kempston = 0xff;
+static THREAD_LOCAL byte spec_fuller = 0x00;
+static THREAD_LOCAL byte spec_printer = 0x40;
+static THREAD_LOCAL byte spec_border = 0xff;
+static THREAD_LOCAL byte spec_rows[8] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
 
-static byte spec_nmi = 0x00;
+static THREAD_LOCAL byte spec_nmi = 0x00;
 /*...e*/
 
 /*...sspec_out1F:0:*/
@@ -0,0 +1,515 @@
+/*
+
+state.c - Save and restore the state of the whole machine
+
+Each part of the machine saves its own chunk, into a buffer which is
+written in one go, and loads it again from the file read in one go.
+The state is saved and loaded between instructions, from LoopZ80, or
+before the Z80 is started.
+
+*/
+
+/*...sincludes:0:*/
+#include "ff_stdio.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "diag.h"
+#include "common.h"
+#include "memu.h"
+#include "mem.h"
+#include "vid.h"
+#include "ctc.h"
+#include "snd.h"
+#include "sdxfdc.h"
+#include "kbd.h"
+#ifdef HAVE_DART
+#include "dart.h"
+#endif
+#ifdef HAVE_CFX2
+#include "cfx2.h"
+#endif
+#include "sdcard.h"
+#include "state.h"
+
+/*...vtypes\46\h:0:*/
+/*...vdiag\46\h:0:*/
+/*...vcommon\46\h:0:*/
+/*...vmemu\46\h:0:*/
+/*...vmem\46\h:0:*/
+/*...vvid\46\h:0:*/
+/*...vctc\46\h:0:*/
+/*...vsnd\46\h:0:*/
+/*...vsdxfdc\46\h:0:*/
+/*...vkbd\46\h:0:*/
+/*...vstate\46\h:0:*/
+/*...e*/
+
+#ifndef SMALL_MEM
+/*...svars:0:*/
+#define	L_MAGIC		8
+#define	L_CHUNK_HDR	(4+2+4)
+#define	BOOT_MAGIC	"MEMUBOO1"
+#define	L_BOOT_HDR	(L_MAGIC+8)	/* Magic, hash of the ROMs and options */
+
+typedef struct
+	{
+	char id[4+1];
+	int version;		/* Latest version of the chunk */
+	void (*save)(STATE *st);
+	void (*load)(STATE *st, int version);
+	BOOLEAN (*check)(STATE *st, int version);
+	} STATE_PART;
+
+/* In the order they are loaded, the Z80 and memory first.
+   A part with no check function always saves the same number of bytes,
+   and a chunk is only loaded if it has at least that many. A part whose
+   chunk varies in length, or has grown in a later version, checks it. */
+static const STATE_PART state_parts[] =
+	{
+	{ "Z80 ", 1, memu_save_state,   memu_load_state,   NULL            },
+	{ "MEM ", 1, mem_save_state,    mem_load_state,    mem_check_state },
+	{ "VDP ", 1, vid_save_state,    vid_load_state,    NULL            },
+	{ "CTC ", 1, ctc_save_state,    ctc_load_state,    NULL            },
+#ifdef HAVE_DART
+	{ "DART", 1, dart_save_state,   dart_load_state,   NULL            },
+#endif
+	{ "SND ", 2, snd_save_state,    snd_load_state,    snd_check_state },
+	{ "FDC ", 1, sdxfdc_save_state, sdxfdc_load_state, NULL            },
+#ifdef HAVE_CFX2
+	{ "CFX2", 1, cfx2_save_state,   cfx2_load_state,   NULL            },
+#endif
+#ifdef HAVE_SD_CARD
+	{ "SDC ", 1, sdcard_save_state, sdcard_load_state, NULL            },
+#endif
+	{ "KBD ", 1, kbd_save_state,    kbd_load_state,    NULL            },
+	};
+
+#define	N_PARTS	( sizeof(state_parts) / sizeof(state_parts[0]) )
+
+/* The length of the chunk each part saves, found when first needed */
+static THREAD_LOCAL size_t state_part_len[N_PARTS];
+/*...e*/
+
+/*...sstate_put_\42\:0:*/
+/*...sstate_room:0:*/
+static byte *state_room(STATE *st, size_t n)
+	{
+	byte *p;
+	if ( st->len + n > st->size )
+		{
+		size_t size = st->size * 2;
+		byte *buf;
+		while ( st->len + n > size )
+			size *= 2;
+		buf = (byte *) emalloc(size);
+		memcpy(buf, st->buf, st->len);
+		free(st->buf);
+		st->buf = buf;
+		st->size = size;
+		}
+	p = st->buf + st->len;
+	st->len += n;
+	return p;
+	}
+/*...e*/
+
+void state_put_byte(STATE *st, byte b)
+	{
+	*state_room(st, 1) = b;
+	}
+
+void state_put_word(STATE *st, word w)
+	{
+	byte *p = state_room(st, 2);
+	p[0] = (byte)   w;
+	p[1] = (byte) ( w >> 8 );
+	}
+
+void state_put_int(STATE *st, unsigned int n)
+	{
+	byte *p = state_room(st, 4);
+	int i;
+	for ( i = 0; i < 4; ++i, n >>= 8 )
+		p[i] = (byte) n;
+	}
+
+void state_put_quad(STATE *st, unsigned long long n)
+	{
+	byte *p = state_room(st, 8);
+	int i;
+	for ( i = 0; i < 8; ++i, n >>= 8 )
+		p[i] = (byte) n;
+	}
+
+void state_put_block(STATE *st, const void *p, size_t n)
+	{
+	memcpy(state_room(st, n), p, n);
+	}
+
+/* Saved as its bits, so it is restored exactly */
+void state_put_float(STATE *st, float f)
+	{
+	unsigned int n;
+	memcpy(&n, &f, sizeof(n));
+	state_put_int(st, n);
+	}
+/*...e*/
+/*...sstate_get_\42\:0:*/
+/*...sstate_take:0:*/
+/* The next n bytes of the chunk, or NULL if there aren't that many */
+static const byte *state_take(STATE *st, size_t n)
+	{
+	const byte *p;
+	if ( st->pos + n > st->len )
+		{
+		st->bad = TRUE;
+		st->pos = st->len;
+		return NULL;
+		}
+	p = st->buf + st->pos;
+	st->pos += n;
+	return p;
+	}
+/*...e*/
+
+byte state_get_byte(STATE *st)
+	{
+	const byte *p = state_take(st, 1);
+	return ( p != NULL ) ? p[0] : 0;
+	}
+
+word state_get_word(STATE *st)
+	{
+	const byte *p = state_take(st, 2);
+	return ( p != NULL ) ? (word) ( p[0] | ( p[1] << 8 ) ) : 0;
+	}
+
+unsigned int state_get_int(STATE *st)
+	{
+	const byte *p = state_take(st, 4);
+	unsigned int n = 0;
+	int i;
+	if ( p != NULL )
+		for ( i = 3; i >= 0; --i )
+			n = ( n << 8 ) | p[i];
+	return n;
+	}
+
+unsigned long long state_get_quad(STATE *st)
+	{
+	const byte *p = state_take(st, 8);
+	unsigned long long n = 0;
+	int i;
+	if ( p != NULL )
+		for ( i = 7; i >= 0; --i )
+			n = ( n << 8 ) | p[i];
+	return n;
+	}
+
+void state_get_block(STATE *st, void *p, size_t n)
+	{
+	const byte *q = state_take(st, n);
+	if ( q != NULL )
+		memcpy(p, q, n);
+	else
+		memset(p, 0, n);
+	}
+
+float state_get_float(STATE *st)
+	{
+	unsigned int n = state_get_int(st);
+	float f;
+	memcpy(&f, &n, sizeof(f));
+	return ( f == f ) ? f : 0.0f;
+	}
+/*...e*/
+
+/*...sstate_build:0:*/
+/* The state of the machine, into st->buf, which grows as needed.
+   st->buf may be kept for next time, to save allocating it again. */
+void state_build(STATE *st)
+	{
+	size_t i;
+	if ( st->buf == NULL )
+		{
+		st->size = 0x10000;
+		st->buf = (byte *) emalloc(st->size);
+		}
+	st->len = 0;
+	state_put_block(st, STATE_MAGIC, L_MAGIC);
+	for ( i = 0; i < N_PARTS; ++i )
+		{
+		state_put_block(st, state_parts[i].id, 4);
+		state_put_word(st, (word) state_parts[i].version);
+		st->chunk = st->len;
+		state_put_int(st, 0);
+		state_parts[i].save(st);
+		st->buf[st->chunk  ] = (byte)   ( st->len - st->chunk - 4 );
+		st->buf[st->chunk+1] = (byte) ( ( st->len - st->chunk - 4 ) >>  8 );
+		st->buf[st->chunk+2] = (byte) ( ( st->len - st->chunk - 4 ) >> 16 );
+		st->buf[st->chunk+3] = (byte) ( ( st->len - st->chunk - 4 ) >> 24 );
+		}
+	}
+/*...e*/
+/*...sstate_save:0:*/
+BOOLEAN state_save(const char *fn)
+	{
+	STATE st;
+	FILE *fp;
+	BOOLEAN ok;
+	st.buf = NULL;
+	state_build(&st);
+	if ( (fp = fopen(fn, "wb")) == NULL )
+		{
+		free(st.buf);
+		diag_message(DIAG_ALWAYS, "can't create save-state file %s", fn);
+		return FALSE;
+		}
+	ok = ( fwrite(st.buf, 1, st.len, fp) == st.len );
+	if ( fclose(fp) != 0 )
+		ok = FALSE;
+	free(st.buf);
+	if ( ! ok )
+		{
+		remove(fn);
+		diag_message(DIAG_ALWAYS, "can't write save-state file %s", fn);
+		return FALSE;
+		}
+	diag_message(DIAG_ALWAYS, "state saved to %s", fn);
+	return TRUE;
+	}
+/*...e*/
+/*...sstate_find:0:*/
+static const STATE_PART *state_find(const byte *id)
+	{
+	size_t i;
+	for ( i = 0; i < N_PARTS; ++i )
+		if ( !memcmp(state_parts[i].id, id, 4) )
+			return &state_parts[i];
+	return NULL;
+	}
+/*...e*/
+/*...sstate_part_len:0:*/
+/* The length of the chunk this part saves, which doesn't vary */
+static size_t state_measure(const STATE_PART *part)
+	{
+	size_t i = part - state_parts;
+	if ( state_part_len[i] == 0 )
+		{
+		STATE st;
+		st.size = 0x100;
+		st.buf = (byte *) emalloc(st.size);
+		st.len = 0;
+		part->save(&st);
+		state_part_len[i] = st.len;
+		free(st.buf);
+		}
+	return state_part_len[i];
+	}
+/*...e*/
+/*...sstate_check:0:*/
+/* Whether the chunk from st->pos to st->len can be loaded */
+static BOOLEAN state_check(const STATE_PART *part, STATE *st, int version)
+	{
+	BOOLEAN ok;
+	size_t pos = st->pos;
+	if ( part->check == NULL )
+		return ( st->len - st->pos >= state_measure(part) );
+	ok = part->check(st, version) && ! st->bad;
+	st->pos = pos;
+	return ok;
+	}
+/*...e*/
+/*...sstate_restore:0:*/
+/* The whole buffer is checked before any of it is loaded, so the machine
+   is left as it was if the buffer can't be used */
+BOOLEAN state_restore(const byte *buf, size_t len, const char *fn)
+	{
+	STATE st;
+	size_t end;
+	int pass;
+	if ( len < L_MAGIC || memcmp(buf, STATE_MAGIC, L_MAGIC) )
+		{
+		diag_message(DIAG_ALWAYS, "%s is not a save-state file", fn);
+		return FALSE;
+		}
+	st.buf = (byte *) buf;
+	st.size = len;
+	for ( pass = 0; pass < 2; ++pass )
+		{
+		st.pos = L_MAGIC;
+		while ( st.pos < st.size )
+			{
+			const STATE_PART *part;
+			const byte *id;
+			int version;
+			st.len = st.size;
+			st.bad = FALSE;
+			id = state_take(&st, 4);
+			version = state_get_word(&st);
+			end = state_get_int(&st);
+			if ( st.bad || end > st.size - st.pos )
+				{
+				diag_message(DIAG_ALWAYS, "save-state file %s is truncated", fn);
+				return FALSE;
+				}
+			end += st.pos;
+			st.len = end;
+			part = state_find(id);
+			if ( part == NULL )
+				{
+				if ( pass == 0 )
+					diag_message(DIAG_ALWAYS, "save-state file %s has an unknown %.4s chunk, ignored", fn, id);
+				}
+			else if ( pass == 0 )
+				{
+				if ( version > part->version )
+					{
+					diag_message(DIAG_ALWAYS, "save-state file %s needs a later version of MEMU", fn);
+					return FALSE;
+					}
+				if ( ! state_check(part, &st, version) )
+					{
+					diag_message(DIAG_ALWAYS, "save-state file %s has a bad %.4s chunk", fn, id);
+					return FALSE;
+					}
+				}
+			else
+				{
+				part->load(&st, version);
+				if ( st.bad )
+					{
+					/* Pass 0 should have found this */
+					diag_message(DIAG_ALWAYS, "save-state file %s has a short %.4s chunk", fn, id);
+					return FALSE;
+					}
+				}
+			st.pos = end;
+			}
+		}
+	return TRUE;
+	}
+/*...e*/
+/*...sstate_read:0:*/
+/* The whole of a file, or NULL if it can't be read */
+static byte *state_read(const char *fn, const char *what, size_t *len)
+	{
+	FILE *fp;
+	long size;
+	byte *buf;
+	if ( (fp = fopen(fn, "rb")) == NULL )
+		{
+		diag_message(DIAG_ALWAYS, "can't open %s file %s", what, fn);
+		return NULL;
+		}
+	fseek(fp, 0L, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0L, SEEK_SET);
+	if ( size < L_MAGIC )
+		{
+		fclose(fp);
+		diag_message(DIAG_ALWAYS, "%s is not a %s file", fn, what);
+		return NULL;
+		}
+	buf = (byte *) emalloc((size_t) size);
+	if ( fread(buf, 1, (size_t) size, fp) != (size_t) size )
+		{
+		fclose(fp);
+		free(buf);
+		diag_message(DIAG_ALWAYS, "can't read %s file %s", what, fn);
+		return NULL;
+		}
+	fclose(fp);
+	*len = (size_t) size;
+	return buf;
+	}
+/*...e*/
+/*...sstate_load:0:*/
+BOOLEAN state_load(const char *fn)
+	{
+	size_t len;
+	byte *buf;
+	BOOLEAN ok;
+	if ( (buf = state_read(fn, "save-state", &len)) == NULL )
+		return FALSE;
+	ok = state_restore(buf, len, fn);
+	free(buf);
+	if ( ok )
+		diag_message(DIAG_ALWAYS, "state loaded from %s", fn);
+	return ok;
+	}
+/*...e*/
+
+/*...sstate_hash:0:*/
+/* FNV-1a, started from STATE_HASH_INIT, and continued by passing the
+   hash so far */
+unsigned long long state_hash(unsigned long long h, const void *p, size_t n)
+	{
+	const byte *q = (const byte *) p;
+	while ( n-- > 0 )
+		h = ( h ^ *q++ ) * 0x100000001b3ULL;
+	return h;
+	}
+/*...e*/
+/*...sstate_boot_load:0:*/
+/* Start from the boot cache, if it was made by the same ROMs and options,
+   as given by hash. Otherwise the machine is left as it was. */
+BOOLEAN state_boot_load(const char *fn, unsigned long long hash)
+	{
+	size_t len;
+	byte *buf;
+	BOOLEAN ok;
+	int i;
+	if ( (buf = state_read(fn, "boot cache", &len)) == NULL )
+		return FALSE;
+	ok = ( len >= L_BOOT_HDR && !memcmp(buf, BOOT_MAGIC, L_MAGIC) );
+	for ( i = 0; ok && i < 8; ++i )
+		ok = ( buf[L_MAGIC+i] == (byte) ( hash >> ( 8 * i ) ) );
+	if ( ! ok )
+		diag_message(DIAG_ALWAYS, "boot cache %s is for other ROMs or options", fn);
+	else
+		ok = state_restore(buf + L_BOOT_HDR, len - L_BOOT_HDR, fn);
+	free(buf);
+	if ( ok )
+		diag_message(DIAG_ALWAYS, "started from boot cache %s", fn);
+	return ok;
+	}
+/*...e*/
+/*...sstate_boot_save:0:*/
+/* The state of the machine, for state_boot_load to check against hash */
+BOOLEAN state_boot_save(const char *fn, unsigned long long hash)
+	{
+	STATE st;
+	FILE *fp;
+	byte hdr[L_BOOT_HDR];
+	BOOLEAN ok;
+	int i;
+	memcpy(hdr, BOOT_MAGIC, L_MAGIC);
+	for ( i = 0; i < 8; ++i )
+		hdr[L_MAGIC+i] = (byte) ( hash >> ( 8 * i ) );
+	st.buf = NULL;
+	state_build(&st);
+	if ( (fp = fopen(fn, "wb")) == NULL )
+		{
+		free(st.buf);
+		diag_message(DIAG_ALWAYS, "can't create boot cache %s", fn);
+		return FALSE;
+		}
+	ok = ( fwrite(hdr, 1, L_BOOT_HDR, fp) == L_BOOT_HDR &&
+	       fwrite(st.buf, 1, st.len, fp) == st.len );
+	if ( fclose(fp) != 0 )
+		ok = FALSE;
+	free(st.buf);
+	if ( ! ok )
+		{
+		remove(fn);
+		diag_message(DIAG_ALWAYS, "can't write boot cache %s", fn);
+		return FALSE;
+		}
+	diag_message(DIAG_ALWAYS, "boot cache saved to %s", fn);
+	return TRUE;
+	}
+/*...e*/
+#endif
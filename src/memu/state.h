@@ -0,0 +1,60 @@
+/*
+
+state.h - Save and restore the state of the whole machine
+
+A save-state file is a header followed by a chunk for each part of
+the emulated machine. Each chunk has an identifier, a version and a
+length, so a part may add to its chunk in a later version, and chunks
+which aren't recognised are skipped. Values are stored least
+significant byte first, so files may be moved between hosts.
+
+*/
+
+#ifndef STATE_H
+#define	STATE_H
+
+/*...sincludes:0:*/
+#include <stddef.h>
+#include "types.h"
+
+/*...vtypes\46\h:0:*/
+/*...e*/
+
+#define	STATE_MAGIC	"MEMUSTA1"
+#define	STATE_HASH_INIT	0xcbf29ce484222325ULL
+
+typedef struct
+	{
+	byte *buf;
+	size_t len;		/* Bytes written, or end of the chunk being read */
+	size_t size;		/* Bytes allocated */
+	size_t pos;		/* Read position */
+	size_t chunk;		/* Start of the chunk being written */
+	BOOLEAN bad;		/* Attempted to read past the end of the chunk */
+	} STATE;
+
+extern void state_put_byte(STATE *st, byte b);
+extern void state_put_word(STATE *st, word w);
+extern void state_put_int(STATE *st, unsigned int n);
+extern void state_put_quad(STATE *st, unsigned long long n);
+extern void state_put_block(STATE *st, const void *p, size_t n);
+extern void state_put_float(STATE *st, float f);
+
+extern byte state_get_byte(STATE *st);
+extern word state_get_word(STATE *st);
+extern unsigned int state_get_int(STATE *st);
+extern unsigned long long state_get_quad(STATE *st);
+extern void state_get_block(STATE *st, void *p, size_t n);
+extern float state_get_float(STATE *st);
+
+extern void state_build(STATE *st);
+extern BOOLEAN state_restore(const byte *buf, size_t len, const char *fn);
+
+extern BOOLEAN state_save(const char *fn);
+extern BOOLEAN state_load(const char *fn);
+
+extern unsigned long long state_hash(unsigned long long h, const void *p, size_t n);
+extern BOOLEAN state_boot_load(const char *fn, unsigned long long hash);
+extern BOOLEAN state_boot_save(const char *fn, unsigned long long hash);
+
+#endif
@@ -19,38 +19,38 @@
 typedef enum { fmtUnk, fmtMTX, fmtCAS, fmtWAV, fmtW08, fmtW16, fmtW32 } TapeFmt;
 typedef enum { stgPre, stgWait, stgData } MTXStages;
 
-static BOOLEAN bTapeRun = FALSE;        /* Tape running */
+static THREAD_LOCAL BOOLEAN bTapeRun = FALSE;        /* Tape running */
 
-static const char *psTapeIn = NULL;     /* Input file name */
-static TapeFmt fmtIn = fmtUnk;          /* Input file format */
-static FILE *pfTapeIn = NULL;           /* Input file stream */
-static long long cTapeNext = 0;             /* Z80 clocks until next interrupt */
-static MTXStages stgIn = stgPre;        /* Stages of loading an MTX tape file */
-static int nCycleIn;                    /* Number of half cycles in tape preamble */
-static BOOLEAN bMTXFirst;               /* First half cycle of an MTX tape bit */
-static int nMTXBitsIn;                  /* Number of bits remaining in MTX tape byte */
-static int nMTXBytesIn;                 /* Number of bytes loaded in a stage */
-static byte byMTXIn;                    /* MTX tape byte */
-static unsigned long long cRes = 0;         /* Z80 clocks remaining from last tape advance */
-static word nChan;                      /* Number of channels in WAV file */
-static unsigned int nRateIn;            /* WAV file sample rate */
-static float fTapeLast;                 /* Last value read from tape */
-static int nPulse;                      /* Number of CTC trigger pulses since tape last started */
+static THREAD_LOCAL const char *psTapeIn = NULL;     /* Input file name */
+static THREAD_LOCAL TapeFmt fmtIn = fmtUnk;          /* Input file format */
+static THREAD_LOCAL FILE *pfTapeIn = NULL;           /* Input file stream */
+static THREAD_LOCAL long long cTapeNext = 0;             /* Z80 clocks until next interrupt */
+static THREAD_LOCAL MTXStages stgIn = stgPre;        /* Stages of loading an MTX tape file */
+static THREAD_LOCAL int nCycleIn;                    /* Number of half cycles in tape preamble */
+static THREAD_LOCAL BOOLEAN bMTXFirst;               /* First half cycle of an MTX tape bit */
+static THREAD_LOCAL int nMTXBitsIn;                  /* Number of bits remaining in MTX tape byte */
+static THREAD_LOCAL int nMTXBytesIn;                 /* Number of bytes loaded in a stage */
+static THREAD_LOCAL byte byMTXIn;                    /* MTX tape byte */
+static THREAD_LOCAL unsigned long long cRes = 0;         /* Z80 clocks remaining from last tape advance */
+static THREAD_LOCAL word nChan;                      /* Number of channels in WAV file */
+static THREAD_LOCAL unsigned int nRateIn;            /* WAV file sample rate */
+static THREAD_LOCAL float fTapeLast;                 /* Last value read from tape */
+static THREAD_LOCAL int nPulse;                      /* Number of CTC trigger pulses since tape last started */
 
-static const char *psTapeOut = NULL;    /* Output filename */
-static TapeFmt fmtOut = fmtUnk;         /* Output file format */
-static FILE *pfTapeOut = NULL;          /* Output file stream */
-static byte byTapeOut = 0;              /* Last value output to tape */
-static unsigned long long cTapeLast = 0;        /* Z80 clock at last tape output */
-static MTXStages stgOut = stgPre;       /* Stages of saving an MTX tape file */
-static int nMTXBitsOut;                 /* Number of bits in MTX tape byte */
-static int nMTXBytesOut;                /* Number of bytes saved to an MTX tape file */
-static int nMTXBlock;                   /* Number of blocks saved to an MTX tape file */
-static byte byMTXOut;                   /* MTX tape output byte */
-static byte nCycleOut;                  /* Number of preamble cycles output */
-static int nRateOut = 4800;             /* WAV output file sample rate */
+static THREAD_LOCAL const char *psTapeOut = NULL;    /* Output filename */
+static THREAD_LOCAL TapeFmt fmtOut = fmtUnk;         /* Output file format */
+static THREAD_LOCAL FILE *pfTapeOut = NULL;          /* Output file stream */
+static THREAD_LOCAL byte byTapeOut = 0;              /* Last value output to tape */
+static THREAD_LOCAL unsigned long long cTapeLast = 0;        /* Z80 clock at last tape output */
+static THREAD_LOCAL MTXStages stgOut = stgPre;       /* Stages of saving an MTX tape file */
+static THREAD_LOCAL int nMTXBitsOut;                 /* Number of bits in MTX tape byte */
+static THREAD_LOCAL int nMTXBytesOut;                /* Number of bytes saved to an MTX tape file */
+static THREAD_LOCAL int nMTXBlock;                   /* Number of blocks saved to an MTX tape file */
+static THREAD_LOCAL byte byMTXOut;                   /* MTX tape output byte */
+static THREAD_LOCAL byte nCycleOut;                  /* Number of preamble cycles output */
+static THREAD_LOCAL int nRateOut = 4800;             /* WAV output file sample rate */
 
-extern CFG cfg;
+extern THREAD_LOCAL CFG cfg;
 
 static TapeFmt tape_identify (const char *psFile)
     {
@@ -358,9 +358,21 @@ void tape_advance (int clks)
         }
     }
 
+/* Z80 clocks until tape_advance next has something to do.
+   WAV input merges all the edges in one advance, so it is stepped
+   every instruction. */
+int tape_next (int limit)
+    {
+    if ( ( ! bTapeRun ) || ( pfTapeIn == NULL ) ) return limit;
+    if ( ( fmtIn != fmtMTX ) && ( fmtIn != fmtCAS ) ) return 0;
+    if ( cTapeNext <= 0 ) return 0;
+    if ( cTapeNext < limit ) return (int) cTapeNext;
+    return limit;
+    }
+
 void tape_out1F (byte value)
     {
-    static int  isave;
+    static THREAD_LOCAL int  isave;
     Z80 *r = get_Z80_regs ();
     switch ( value )
         {
@@ -13,6 +13,7 @@ extern void tape_out3 (byte value);
 extern void tape_out1F (byte value);
 extern void tape_play (void);
 extern void tape_advance (int clks);
+extern int tape_next (int limit);
 extern void tape_term (void);
 
 #endif
@@ -0,0 +1,160 @@
+/*
+
+trace.c - Binary execution trace
+
+DebugZ80 calls trace_record for every instruction while tracing. It
+only copies the registers and the bytes at PC into the next slot of
+the ring, all formatting being left to memu-trace (see trace_dis.c).
+
+*/
+
+/*...sincludes:0:*/
+#include "ff_stdio.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef UNIX
+#include <signal.h>
+#endif
+
+#include "types.h"
+#include "diag.h"
+#include "common.h"
+#include "mem.h"
+#include "trace.h"
+
+/*...vtypes\46\h:0:*/
+/*...vdiag\46\h:0:*/
+/*...vcommon\46\h:0:*/
+/*...vmem\46\h:0:*/
+/*...vtrace\46\h:0:*/
+/*...e*/
+
+/*...svars:0:*/
+THREAD_LOCAL BOOLEAN trace_on = FALSE;
+
+static THREAD_LOCAL TRACE_REC *trace_ring = NULL;
+static THREAD_LOCAL unsigned int trace_mask;		/* Ring size - 1 */
+static THREAD_LOCAL unsigned long long trace_next;	/* Records made so far */
+static THREAD_LOCAL const char *trace_fn = "memu.trc";
+/*...e*/
+
+/*...strace_record:0:*/
+void trace_record(Z80 *r)
+	{
+	TRACE_REC *p = &trace_ring[(unsigned int) trace_next & trace_mask];
+	word pc = r->PC.W;
+	FlagsZ80 (r);
+	p->elapsed = r->IElapsed;
+	p->pc = pc;
+	p->af = r->AF.W;
+	p->bc = r->BC.W;
+	p->de = r->DE.W;
+	p->hl = r->HL.W;
+	p->ix = r->IX.W;
+	p->iy = r->IY.W;
+	p->sp = r->SP.W;
+#ifndef SMALL_MEM
+	if ( ( pc & 0x1fff ) <= 0x1ffc )
+		memcpy(p->op, &mem_read[pc>>13][pc&0x1fff], sizeof(p->op));
+	else
+#endif
+		{
+		p->op[0] = mem_z80_rd(pc);
+		p->op[1] = mem_z80_rd((word) (pc+1));
+		p->op[2] = mem_z80_rd((word) (pc+2));
+		p->op[3] = mem_z80_rd((word) (pc+3));
+		}
+	p->iobyte = mem_get_iobyte();
+	p->i = r->I;
+	p->iff = r->IFF;
+	p->pad = 0;
+	++trace_next;
+	}
+/*...e*/
+/*...strace_dump:0:*/
+/* Write the ring, oldest record first */
+void trace_dump(void)
+	{
+	FILE *fp;
+	TRACE_HDR hdr;
+	unsigned int size = trace_mask + 1;
+	unsigned int first;
+	unsigned int n;
+	if ( trace_ring == NULL )
+		return;
+	memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+	hdr.rec_size = sizeof(TRACE_REC);
+	if ( trace_next < size )
+		{
+		hdr.count = (unsigned int) trace_next;
+		first = 0;
+		}
+	else
+		{
+		/* Leave out the oldest, trace_crash may have interrupted
+		   its replacement */
+		hdr.count = size - 1;
+		first = (unsigned int) ( trace_next + 1 ) & trace_mask;
+		}
+	if ( (fp = fopen(trace_fn, "wb")) == NULL )
+		{
+		diag_message(DIAG_ALWAYS, "can't create trace file %s", trace_fn);
+		return;
+		}
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	n = size - first;
+	if ( n > hdr.count )
+		n = hdr.count;
+	fwrite(trace_ring+first, sizeof(TRACE_REC), n, fp);
+	fwrite(trace_ring, sizeof(TRACE_REC), hdr.count-n, fp);
+	fclose(fp);
+	diag_message(DIAG_ALWAYS, "%u instructions traced to %s", hdr.count, trace_fn);
+	}
+/*...e*/
+
+/*...strace_crash:0:*/
+#ifdef UNIX
+/* Best effort, the state of the process is unknown by now */
+static void trace_crash(int sig)
+	{
+	signal(sig, SIG_DFL);
+	trace_dump();
+	raise(sig);
+	}
+#endif
+/*...e*/
+
+/*...strace_init:0:*/
+/* The ring keeps at least the last nrec records */
+void trace_init(int nrec, const char *fn)
+	{
+	unsigned int size = 2;
+	while ( size <= (unsigned int) nrec && size < 0x80000000 )
+		size <<= 1;
+	trace_ring = (TRACE_REC *) emalloc(size * sizeof(TRACE_REC));
+	trace_mask = size - 1;
+	trace_next = 0;
+	if ( fn != NULL )
+		trace_fn = fn;
+	trace_on = TRUE;
+#ifdef UNIX
+	signal(SIGSEGV, trace_crash);
+	signal(SIGBUS, trace_crash);
+	signal(SIGFPE, trace_crash);
+	signal(SIGILL, trace_crash);
+	signal(SIGABRT, trace_crash);
+#endif
+	}
+/*...e*/
+/*...strace_term:0:*/
+void trace_term(void)
+	{
+	if ( trace_ring != NULL )
+		{
+		trace_dump();
+		free(trace_ring);
+		trace_ring = NULL;
+		}
+	trace_on = FALSE;
+	}
+/*...e*/
@@ -0,0 +1,52 @@
+/*
+
+trace.h - Binary execution trace
+
+A ring buffer holding the most recent instructions executed, at a
+fixed size per instruction, so that long runs may be traced at close
+to full speed. The ring is written to a file on demand, and when MEMU
+terminates or crashes. memu-trace turns the file into text.
+
+*/
+
+#ifndef TRACE_H
+#define	TRACE_H
+
+/*...sincludes:0:*/
+#include "types.h"
+#include "Z80.h"
+
+/*...vtypes\46\h:0:*/
+/*...vZ80\46\h:0:*/
+/*...e*/
+
+/* The file is a TRACE_HDR followed by count records, oldest first,
+   all in the byte order of the machine which wrote it */
+#define	TRACE_MAGIC	"MEMUTRC1"
+
+typedef struct
+	{
+	char magic[8];
+	unsigned int rec_size;
+	unsigned int count;
+	} TRACE_HDR;
+
+typedef struct
+	{
+	unsigned long long elapsed;		/* T-states at start of instruction */
+	word pc, af, bc, de, hl, ix, iy, sp;
+	byte op[4];				/* Bytes at PC, an instruction is at most 4 */
+	byte iobyte;
+	byte i;
+	byte iff;
+	byte pad;
+	} TRACE_REC;
+
+extern THREAD_LOCAL BOOLEAN trace_on;
+
+extern void trace_record(Z80 *r);
+extern void trace_dump(void);
+extern void trace_init(int nrec, const char *fn);
+extern void trace_term(void);
+
+#endif
@@ -0,0 +1,113 @@
+/*
+
+trace_dis.c - memu-trace, list a binary execution trace as text
+
+Usage: memu-trace [-no-opcodes] [file.trc]
+
+Each record is disassembled by dis.c, which is given the bytes saved
+from PC in place of the memory of the emulated machine.
+
+*/
+
+/*...sincludes:0:*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "dis.h"
+#include "trace.h"
+
+/*...vtypes\46\h:0:*/
+/*...vdis\46\h:0:*/
+/*...vtrace\46\h:0:*/
+/*...e*/
+
+static TRACE_REC rec;
+
+/*...sRdZ80:0:*/
+/* Only called by dis.c, for the instruction at rec.pc */
+byte RdZ80(word addr)
+	{
+	word off = (word) ( addr - rec.pc );
+	return ( off < sizeof(rec.op) ) ? rec.op[off] : 0;
+	}
+/*...e*/
+
+/*...strace_list:0:*/
+static void trace_list(const TRACE_REC *p)
+	{
+	char buf[500+1];
+	word pc = p->pc;
+	dis_instruction(&pc, buf);
+	printf("%12lluT: a=%02x f=%c%c%c%c%c%c bc=%04x de=%04x hl=%04x ix=%04x iy=%04x sp=%04x pc=%04x i=%02x iff=%02x io=%02x  %s\n",
+		p->elapsed,
+		p->af >> 8,
+		(p->af & S_FLAG)!=0?'S':'.',
+		(p->af & Z_FLAG)!=0?'Z':'.',
+		(p->af & H_FLAG)!=0?'H':'.',
+		(p->af & P_FLAG)!=0?'P':'.',
+		(p->af & N_FLAG)!=0?'N':'.',
+		(p->af & C_FLAG)!=0?'C':'.',
+		p->bc,
+		p->de,
+		p->hl,
+		p->ix,
+		p->iy,
+		p->sp,
+		p->pc,
+		p->i,
+		p->iff,
+		p->iobyte,
+		buf
+		);
+	}
+/*...e*/
+
+/*...smain:0:*/
+int main(int argc, char *argv[])
+	{
+	const char *fn = "memu.trc";
+	FILE *fp;
+	TRACE_HDR hdr;
+	unsigned int n;
+	int i;
+	for ( i = 1; i < argc; ++i )
+		{
+		if ( !strcmp(argv[i], "-no-opcodes") )
+			show_opcode = FALSE;
+		else if ( argv[i][0] == '-' )
+			{
+			fprintf(stderr, "usage: memu-trace [-no-opcodes] [file.trc]\n");
+			return 1;
+			}
+		else
+			fn = argv[i];
+		}
+	if ( (fp = fopen(fn, "rb")) == NULL )
+		{
+		fprintf(stderr, "memu-trace: can't open %s\n", fn);
+		return 1;
+		}
+	if ( fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	     memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) ||
+	     hdr.rec_size != sizeof(TRACE_REC) )
+		{
+		fprintf(stderr, "memu-trace: %s is not a trace file from this type of machine\n", fn);
+		fclose(fp);
+		return 1;
+		}
+	dis_init();
+	for ( n = 0; n < hdr.count; ++n )
+		{
+		if ( fread(&rec, sizeof(rec), 1, fp) != 1 )
+			{
+			fprintf(stderr, "memu-trace: %s is truncated\n", fn);
+			break;
+			}
+		trace_list(&rec);
+		}
+	fclose(fp);
+	return 0;
+	}
+/*...e*/
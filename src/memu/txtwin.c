@@ -42,7 +42,7 @@ static uint8_t reg_init[NREG80C] =
 #define	TBUF_NCLR   8
 #define	TBUF_NMONO  4
 
-static COL tbuf_clr[TBUF_NCLR] =
+static THREAD_LOCAL COL tbuf_clr[TBUF_NCLR] =
 	{	/* normal colours */
 		{ 0x00,0x00,0x00 }, /* black */
 		{ 0xff,0x00,0x00 }, /* red */
@@ -54,7 +54,7 @@ static COL tbuf_clr[TBUF_NCLR] =
 		{ 0xff,0xff,0xff }, /* white */
 	};
 
-static COL tbuf_mono[TBUF_NMONO] =
+static THREAD_LOCAL COL tbuf_mono[TBUF_NMONO] =
 	{
 		{ 0x00,0x00,0x00 }, /* black */
 		{ 0x00,0x40,0x00 }, /* pale green */
@@ -62,7 +62,7 @@ static COL tbuf_mono[TBUF_NMONO] =
 		{ 0x00,0xff,0x00 }, /* bright green */
 	};
 
-static BOOLEAN  tw_blink = FALSE;
+static THREAD_LOCAL BOOLEAN  tw_blink = FALSE;
 
 TXTBUF *tbuf_create (BOOLEAN bMono)
     {
@@ -312,6 +312,21 @@ int twin_kbd_test (WIN *win)
     return wk;
     }
 
+/* As twin_kbd_test, but only a key already pressed, without handling
+   host events, which -record and -replay leave to LoopZ80 */
+int twin_kbd_take (WIN *win)
+    {
+    TXTBUF *tbuf = win->tbuf;
+    if ( tbuf == NULL ) return -1;
+#ifdef   ALT_KEYIN
+    if (tbuf->wk < 0 ) tbuf->wk =  ALT_KEYIN ();
+#endif
+    int wk = tbuf->wk;
+    tbuf->wk = -1;
+    diag_message (DIAG_KBD_WIN_KEY, "kbd_take = %d", wk);
+    return wk;
+    }
+
 int twin_kbd_in (WIN *win)
     {
     twin_refresh (win);
@@ -33,4 +33,15 @@ typedef int BOOLEAN;
 #define	FALSE 0
 #endif
 
+/* The state of the emulated machine is held in file scope variables.
+   When several machines share one process (see machine.h), each runs
+   on its own thread, and these variables are per thread. Static tables
+   which are never written after initialisation are left shared, as is
+   the PortAudio stream, which MEMU_MULTI builds never open. */
+#ifdef MEMU_MULTI
+#define THREAD_LOCAL    _Thread_local
+#else
+#define THREAD_LOCAL
+#endif
+
 #endif
@@ -43,7 +43,7 @@ ui.c - User Interface
 #define	COL_WHITE    7
 #define	N_COLS_POPUP 8
 
-static COL ui_cols[N_COLS_POPUP] =
+static THREAD_LOCAL COL ui_cols[N_COLS_POPUP] =
 	{
 		{    0,   0,   0 },	/* black */
 		{    0,   0, 255 },	/* blue */
@@ -55,14 +55,14 @@ static COL ui_cols[N_COLS_POPUP] =
 		{  255, 255, 255 },	/* white */
 	};
 
-static const char *ui_mem_title = NULL;
-static const char *ui_vram_title = NULL;
-static const char *ui_dis_title = NULL;
-static const char *ui_mem_display = NULL;
-static const char *ui_vram_display = NULL;
-static const char *ui_dis_display = NULL;
+static THREAD_LOCAL const char *ui_mem_title = NULL;
+static THREAD_LOCAL const char *ui_vram_title = NULL;
+static THREAD_LOCAL const char *ui_dis_title = NULL;
+static THREAD_LOCAL const char *ui_mem_display = NULL;
+static THREAD_LOCAL const char *ui_vram_display = NULL;
+static THREAD_LOCAL const char *ui_dis_display = NULL;
 
-static byte ui_refreshes = 0;
+static THREAD_LOCAL byte ui_refreshes = 0;
 #define	UI_FLASH 0x10
 /*...e*/
 
@@ -250,22 +250,23 @@ static BOOLEAN update_word(word *w, int *digit, int wk, BOOLEAN *next)
 #define	UI_MEM_WIDTH  ((4+1+UI_MEM_COLS*3+UI_MEM_COLS)*GLYPH_WIDTH)
 #define	UI_MEM_HEIGHT ((1+UI_MEM_ROWS)*GLYPH_HEIGHT)
 
-static WIN *ui_mem_win = NULL;
+static THREAD_LOCAL WIN *ui_mem_win = NULL;
 #define	UI_MEM_FOCUS_IOBYTE  0
 #define	UI_MEM_FOCUS_SUBPAGE 1
 #define	UI_MEM_FOCUS_START   2
 #define	UI_MEM_FOCUS_ADDR    3
 #define	UI_MEM_FOCUS_DATA    4
 #define	UI_MEM_FOCUS_COUNT   5
-static int ui_mem_focus = UI_MEM_FOCUS_IOBYTE;
-static byte ui_mem_iobyte = 0x00;
-static byte ui_mem_subpage = 0x00;
-static word ui_mem_start = 0x0000;
-static word ui_mem_addr = 0x0000;
-static int ui_mem_digit = 0;
-static BOOLEAN ui_mem_snapshot = FALSE;
+static THREAD_LOCAL int ui_mem_focus = UI_MEM_FOCUS_IOBYTE;
+static THREAD_LOCAL byte ui_mem_iobyte = 0x00;
+static THREAD_LOCAL byte ui_mem_subpage = 0x00;
+static THREAD_LOCAL word ui_mem_start = 0x0000;
+static THREAD_LOCAL word ui_mem_addr = 0x0000;
+static THREAD_LOCAL int ui_mem_digit = 0;
+static THREAD_LOCAL BOOLEAN ui_mem_snapshot = FALSE;
+static THREAD_LOCAL int ui_mem_snapshot_age = 0;
 
-static VIRTKBD ui_mem_vk;
+static THREAD_LOCAL VIRTKBD ui_mem_vk;
 
 /*...sui_mem_keypress:0:*/
 static void ui_mem_keypress(WIN *win, int wk)
@@ -307,6 +308,15 @@ static void ui_mem_key(int wk)
 			return;
 		case 'o':
 			mem_snapshot();
+			ui_mem_snapshot_age = 0;
+			return;
+		case ',':
+			if ( ui_mem_snapshot_age + 1 < mem_snapshot_count() )
+				++ui_mem_snapshot_age;
+			return;
+		case '.':
+			if ( ui_mem_snapshot_age > 0 )
+				--ui_mem_snapshot_age;
 			return;
 		case 'v':
 			ui_mem_snapshot ^= TRUE;
@@ -408,6 +418,7 @@ static void ui_mem_refresh(void)
 		{
 		word addr = ui_mem_start;
 		char s[100+1];
+		char snap[20+1];
 		byte iobyte_saved = mem_get_iobyte();
 		byte subpage_saved = mem_get_rom_subpage();
 		int x, y;
@@ -416,12 +427,16 @@ static void ui_mem_refresh(void)
 			ui_mem_key(wk);
 		mem_set_iobyte(ui_mem_iobyte);
 		mem_set_rom_subpage(ui_mem_subpage);
-		sprintf(s, "iobyte %02x subpage %02x start %04x address %04x %s",
+		if ( ui_mem_snapshot_age > 0 )
+			sprintf(snap, "%s-%d", ui_mem_snapshot ? "snapshot" : "        ", ui_mem_snapshot_age);
+		else
+			sprintf(snap, "%s", ui_mem_snapshot ? "snapshot" : "        ");
+		sprintf(s, "iobyte %02x subpage %02x start %04x address %04x %-11s",
 			ui_mem_iobyte,
 			ui_mem_subpage,
 			(unsigned) ui_mem_start,
 			(unsigned) ui_mem_addr,
-			ui_mem_snapshot ? "snapshot" : "        "
+			snap
 			);
 		ui_print_string(ui_mem_win,0,0, s, COL_YELLOW);
 		ui_highlight(ui_mem_win,40,0,4);
@@ -449,7 +464,7 @@ static void ui_mem_refresh(void)
 						break;
 					case MEMT_RAM_SNAPSHOT:
 						{
-						byte bs = mem_read_byte_snapshot(addr);
+						byte bs = mem_read_byte_snapshot_age(ui_mem_snapshot_age, addr);
 						if ( ui_mem_snapshot )
 							{
 							b = bs;
@@ -545,17 +560,17 @@ static void ui_mem_term(void)
 #define	UI_VRAM_WIDTH  ((4+1+UI_VRAM_COLS*3+UI_VRAM_COLS)*GLYPH_WIDTH)
 #define	UI_VRAM_HEIGHT ((1+UI_VRAM_ROWS)*GLYPH_HEIGHT)
 
-static WIN *ui_vram_win = NULL;
+static THREAD_LOCAL WIN *ui_vram_win = NULL;
 #define	UI_VRAM_FOCUS_START  0
 #define	UI_VRAM_FOCUS_ADDR   1
 #define	UI_VRAM_FOCUS_DATA   2
 #define	UI_VRAM_FOCUS_COUNT  3
-static int ui_vram_focus = UI_VRAM_FOCUS_START;
-static word ui_vram_start = 0x0000;
-static word ui_vram_addr = 0x0000;
-static int ui_vram_digit = 0;
+static THREAD_LOCAL int ui_vram_focus = UI_VRAM_FOCUS_START;
+static THREAD_LOCAL word ui_vram_start = 0x0000;
+static THREAD_LOCAL word ui_vram_addr = 0x0000;
+static THREAD_LOCAL int ui_vram_digit = 0;
 
-static VIRTKBD ui_vram_vk;
+static THREAD_LOCAL VIRTKBD ui_vram_vk;
 
 /*...sui_vram_keypress:0:*/
 static void ui_vram_keypress(WIN *win, int wk)
@@ -759,13 +774,13 @@ static void ui_vram_term(void)
 #define	UI_DIS_WIDTH  (UI_DIS_COLS*GLYPH_WIDTH)
 #define	UI_DIS_HEIGHT (UI_DIS_ROWS*GLYPH_HEIGHT)
 
-static WIN *ui_dis_win = NULL;
+static THREAD_LOCAL WIN *ui_dis_win = NULL;
 #define	UI_DIS_FOCUS_IOBYTE  0
 #define	UI_DIS_FOCUS_SUBPAGE 1
 #define	UI_DIS_FOCUS_START   2
 #define	UI_DIS_FOCUS_COUNT   3
-static int ui_dis_focus = UI_DIS_FOCUS_IOBYTE;
-static int ui_dis_digit = 0;
+static THREAD_LOCAL int ui_dis_focus = UI_DIS_FOCUS_IOBYTE;
+static THREAD_LOCAL int ui_dis_digit = 0;
 
 #define	N_DIS_HIST 10000
 
@@ -782,11 +797,11 @@ struct _DISCTX
 	int depth;
 	};
 
-static DISCTX *ui_dis_ctx;
+static THREAD_LOCAL DISCTX *ui_dis_ctx;
 
 #define	UI_DIS_MAX_DEPTH 20
 
-static VIRTKBD ui_dis_vk;
+static THREAD_LOCAL VIRTKBD ui_dis_vk;
 
 /*...sui_dis_keypress:0:*/
 static void ui_dis_keypress(WIN *win, int wk)
@@ -35,23 +35,23 @@
 #define ROW_PR          9
 #define ROW_DATA        11
 
-static WIN *vdeb_win    =  NULL;
-static WIN *run_win     =  NULL;
+static THREAD_LOCAL WIN *vdeb_win    =  NULL;
+static THREAD_LOCAL WIN *run_win     =  NULL;
 
-static enum { vm_dis, vm_stp, vm_trc, vm_run } vmode = vm_dis;  // Execution mode
-static BOOLEAN bFollow = TRUE;  // Listing follows PC
-static BOOLEAN bASCII = FALSE;  // Display bytes as ASCII
-static word ltop = 0;           // Top of listing
-static word dtop = 0;           // Top of data
-static word daddr = 0;          // Current data address
-static word taddr = 0;          // Stack address to halt trace
-static int  ireg = 0;           // Current register pair (0 = None)
+static THREAD_LOCAL enum { vm_dis, vm_stp, vm_trc, vm_run } vmode = vm_dis;  // Execution mode
+static THREAD_LOCAL BOOLEAN bFollow = TRUE;  // Listing follows PC
+static THREAD_LOCAL BOOLEAN bASCII = FALSE;  // Display bytes as ASCII
+static THREAD_LOCAL word ltop = 0;           // Top of listing
+static THREAD_LOCAL word dtop = 0;           // Top of data
+static THREAD_LOCAL word daddr = 0;          // Current data address
+static THREAD_LOCAL word taddr = 0;          // Stack address to halt trace
+static THREAD_LOCAL int  ireg = 0;           // Current register pair (0 = None)
 #ifdef HAVE_PROFILE
-static unsigned int nprofl = 0;     // Number of profiled steps
-static unsigned int *profl = NULL;  //  Profile of instruction execution
+static THREAD_LOCAL unsigned int nprofl = 0;     // Number of profiled steps
+static THREAD_LOCAL unsigned int *profl = NULL;  //  Profile of instruction execution
 #endif
 
-static BOOLEAN bDiag = FALSE;
+static THREAD_LOCAL BOOLEAN bDiag = FALSE;
 
 // Break point definition
 typedef struct st_brk
@@ -67,22 +67,18 @@ typedef struct st_brk
     } BREAK;
 
 // Linked list of break points
-BREAK   *pbrkFst = NULL;
-BREAK   *pbrkLst = NULL;
+THREAD_LOCAL BREAK   *pbrkFst = NULL;
+THREAD_LOCAL BREAK   *pbrkLst = NULL;
 
 // Watch address definitions
 
-#define NWPT_INI    5           // Initial watch point allocation
-BOOLEAN bWPt = FALSE;           // Watch point data initialised
-struct st_wpt
-    {
-    int nwpt;                   // Number of active watch points
-    int mwpt;                   // Size of watch point list
-    int *pwpt;                  // Pointer to list of watch addresses
-    };
-
-struct st_wpt   wpt_hi;         // Watch points in high memory
-struct st_wpt   wpt_pg[16];     // Watch points in paged memory
+THREAD_LOCAL BOOLEAN bWPt = FALSE;           // Watch point data initialised
+// A bit for each address watched, for each memory mapping (IOBYTE & 0x0F).
+// Watch points in high memory are set in all 16 mappings.
+THREAD_LOCAL byte wpt_map[16][0x10000 >> 3];
+// Number of watch points in each 8KB page of each mapping, so that
+// writes to pages without any need not be checked (see mem_wrchk)
+THREAD_LOCAL int wpt_npage[16][8];
 
 int vld_hex (int wk)
     {
@@ -399,8 +395,8 @@ void vdeb_init (void)
     {
     if ( ! bWPt )
         {
-        memset (&wpt_hi, 0, sizeof (wpt_hi));
-        memset (&wpt_pg, 0, sizeof (wpt_pg));
+        memset (wpt_map, 0, sizeof (wpt_map));
+        memset (wpt_npage, 0, sizeof (wpt_npage));
         bWPt = TRUE;
         }
     vdeb_win  =  twin_create (cfg.mon_width_scale, 2 * cfg.mon_width_scale,
@@ -419,6 +415,15 @@ void vdeb_break (void)
     vmode = vm_stp;
     }
 
+// Debugger needs to see every instruction executed
+BOOLEAN vdeb_active (void)
+    {
+#ifdef HAVE_PROFILE
+    if ( profl != NULL ) return TRUE;
+#endif
+    return ( vmode != vm_dis );
+    }
+
 void vdeb_term (void)
     {
     vmode = vm_dis;
@@ -429,90 +434,45 @@ void vdeb_term (void)
         }
     }
 
-void wpt_add (struct st_wpt *pwpt, word addr)
+void wpt_set (int map, word addr, BOOLEAN bSet)
     {
-    if ( pwpt->mwpt == 0 )
+    byte *pb = &wpt_map[map][addr >> 3];
+    byte mask = 0x01 << ( addr & 7 );
+    if ( bSet && ! ( *pb & mask ) )
         {
-        pwpt->pwpt = emalloc (NWPT_INI * sizeof (word));
-        pwpt->mwpt = NWPT_INI;
+        *pb |= mask;
+        ++wpt_npage[map][addr >> 13];
         }
-    else if ( pwpt->nwpt == pwpt->mwpt )
+    else if ( ! bSet && ( *pb & mask ) )
         {
-        pwpt->mwpt *= 2;
-        pwpt->pwpt = realloc (pwpt->pwpt, pwpt->mwpt * sizeof (word));
-        if ( pwpt->pwpt == NULL ) fatal ("Insufficient memory for watch point");
+        *pb &= ~mask;
+        --wpt_npage[map][addr >> 13];
         }
-    int i = pwpt->nwpt;
-    while ( --i >= 0 )
-        {
-        if ( addr > pwpt->pwpt[i] )
-            {
-            pwpt->pwpt[i+1] = addr;
-            ++pwpt->nwpt;
-            return;
-            }
-        else if ( addr == pwpt->pwpt[i] )
-            {
-            while ( ++i < pwpt->nwpt ) pwpt->pwpt[i] = pwpt->pwpt[i+1];
-            return;
-            }
-        else
-            {
-            pwpt->pwpt[i+1] = pwpt->pwpt[i];
-            }
-        }
-    pwpt->pwpt[0] = addr;
-    ++pwpt->nwpt;
     }
 
-void wpt_del (struct st_wpt *pwpt, word addr)
+void set_wpt (byte iob, int addr, BOOLEAN bSet)
     {
-    int i = 0;
-    while (( i < pwpt->nwpt ) && ( pwpt->pwpt[i] != addr )) ++i;
-    if ( i < pwpt->nwpt )
-        {
-        while ( ++i < pwpt->nwpt ) pwpt->pwpt[i-1] = pwpt->pwpt[i];
-        --pwpt->nwpt;
-        }
-    }
-
-BOOLEAN wpt_find (struct st_wpt *pwpt, word addr)
-    {
-    if ( pwpt->nwpt == 0 ) return FALSE;
-    int i1 = 0;
-    if ( pwpt->pwpt[i1] == addr ) return TRUE;
-    else if ( pwpt->pwpt[i1] > addr ) return FALSE;
-    if ( pwpt->nwpt == 1 ) return FALSE;
-    int i2 = pwpt->nwpt - 1;
-    if ( pwpt->pwpt[i2] == addr ) return TRUE;
-    else if ( pwpt->pwpt[i2] < addr ) return FALSE;
-    if ( pwpt->nwpt == 2 ) return FALSE;
-    while ( i2 - i1 > 1 )
+    int map;
+    if ( addr >= 0xC000 )
         {
-        int i3 = ( i1 + i2 ) / 2;
-        if ( pwpt->pwpt[i3] == addr ) return TRUE;
-        else if ( pwpt->pwpt[i3] > addr ) i2 = i3;
-        else i1 = i3;
+        for ( map = 0; map < 16; ++map ) wpt_set (map, (word) addr, bSet);
         }
-    return FALSE;
+    else wpt_set (iob & 0x0F, (word) addr, bSet);
     }
 
 void add_wpt (byte iob, int addr)
     {
-    if ( addr >= 0xC000 ) wpt_add (&wpt_hi, addr);
-    else wpt_add (&wpt_pg[iob & 0x0F], addr);
+    set_wpt (iob, addr, TRUE);
     }
 
 void del_wpt (byte iob, int addr)
     {
-    if ( addr >= 0xC000 ) wpt_del (&wpt_hi, addr);
-    else wpt_del (&wpt_pg[iob & 0x0F], addr);
+    set_wpt (iob, addr, FALSE);
     }
 
 BOOLEAN find_wpt (byte iob, int addr)
     {
-    if ( addr >= 0xC000 ) return wpt_find (&wpt_hi, addr);
-    else return wpt_find (&wpt_pg[iob & 0x0F], addr);
+    return ( wpt_map[iob & 0x0F][(word) addr >> 3] & ( 0x01 << ( addr & 7 ) ) ) != 0;
     }
 
 void vdeb_mwrite (byte iob, word addr)
@@ -527,13 +487,17 @@ void vdeb_iobyte (byte iob)
     {
     if ( vmode != vm_dis )
         {
-        mem_wrchk (wpt_hi.nwpt + wpt_pg[iob & 0x0F].nwpt > 0);
+        byte pages = 0;
+        int i;
+        for ( i = 0; i < 8; ++i )
+            if ( wpt_npage[iob & 0x0F][i] > 0 ) pages |= 0x01 << i;
+        mem_wrchk (pages);
         }
     }
 
 void vdeb_regs (Z80 *R)
     {
-    static char sFlag[] = "CNV3H5ZS";
+    static THREAD_LOCAL char sFlag[] = "CNV3H5ZS";
     char sReg[9];
     byte flags = R->AF.B.l;
     int n;
@@ -772,6 +736,9 @@ void vdeb (Z80 *R)
         ++profl[R->PC.W];
         }
 #endif
+    if ( vmode == vm_dis ) return;
+    // The debugger may show or change the flags
+    FlagsZ80 (R);
     // Test for entering VDEB display
     switch (vmode)
         {
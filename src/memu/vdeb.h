@@ -7,6 +7,7 @@
 
 extern void vdeb_break (void);      // Call in response to activation key press (e.g. from diag_control)
 extern void vdeb (Z80 *R);          // Call from DebugZ80(Z80 *R);
+extern BOOLEAN vdeb_active (void);  // Debugger must see every instruction
 extern void vdeb_term (void);       // Call from terminate();
 extern void vdeb_mwrite (byte iob, word addr);  // Called from WrZ80 if write checking requested
 extern void vdeb_iobyte (byte iob);  // Called from mem_set_iobyte when iobyte is changed
@@ -5,8 +5,10 @@ will not be updated when the Propeller is in Native mode.
 
 Also needed for MFX emulation, therefore separated out.
 
-What follows is a cut-down version of vid.c with sprite coincidence
-checks and timing checks removed.
+The drawing of the picture is shared by all three, see vdp_render_*.
+Each byte of pattern becomes its 8 pixels at once, by way of a table
+of masks, drawn straight into the window at its stride and scale.
+The VDP here has no status register or timing checks.
 
 */
 
@@ -31,8 +33,51 @@ checks and timing checks removed.
 /*...vmon\46\h:0:*/
 /*...e*/
 
+/*...svars:0:*/
 static byte vdp_regs_zeros[8] = { 0xfc,0x04,0xf0,0x00,0xf8,0x80,0xf8,0x00 };
 
+/* 8 pixels, each a byte */
+typedef unsigned long long VDP_ROW;
+#define	VDP_ONES 0x0101010101010101ULL
+
+/* The mask of the 8 pixels for each pattern byte, most significant bit
+   leftmost, and of the 8 pixels for each nibble when they are doubled */
+#define	VDP_BIT(b,m)	( ((b)&(m)) ? 0xff : 0x00 )
+#define	VDP_X1(b)	{ VDP_BIT(b,0x80), VDP_BIT(b,0x40), VDP_BIT(b,0x20), VDP_BIT(b,0x10), \
+			  VDP_BIT(b,0x08), VDP_BIT(b,0x04), VDP_BIT(b,0x02), VDP_BIT(b,0x01) }
+#define	VDP_X4(b)	VDP_X1(b), VDP_X1((b)+1), VDP_X1((b)+2), VDP_X1((b)+3)
+#define	VDP_X16(b)	VDP_X4(b), VDP_X4((b)+4), VDP_X4((b)+8), VDP_X4((b)+12)
+#define	VDP_X64(b)	VDP_X16(b), VDP_X16((b)+16), VDP_X16((b)+32), VDP_X16((b)+48)
+#define	VDP_X2(n)	{ VDP_BIT(n,8), VDP_BIT(n,8), VDP_BIT(n,4), VDP_BIT(n,4), \
+			  VDP_BIT(n,2), VDP_BIT(n,2), VDP_BIT(n,1), VDP_BIT(n,1) }
+
+static const byte vdp_expand1[256][8] =
+	{ VDP_X64(0), VDP_X64(64), VDP_X64(128), VDP_X64(192) };
+static const byte vdp_expand2[16][8] =
+	{
+	VDP_X2( 0), VDP_X2( 1), VDP_X2( 2), VDP_X2( 3), VDP_X2( 4), VDP_X2( 5), VDP_X2( 6), VDP_X2( 7),
+	VDP_X2( 8), VDP_X2( 9), VDP_X2(10), VDP_X2(11), VDP_X2(12), VDP_X2(13), VDP_X2(14), VDP_X2(15)
+	};
+
+/* Each byte of sprite pattern with its bits doubled, for magnification */
+#define	VDP_DBL(b,m,d)	( ((b)&(m)) ? (d) : 0 )
+#define	VDP_MAG(b)	( VDP_DBL(b,0x80,0xc000) | VDP_DBL(b,0x40,0x3000) | VDP_DBL(b,0x20,0x0c00) | VDP_DBL(b,0x10,0x0300) | \
+			  VDP_DBL(b,0x08,0x00c0) | VDP_DBL(b,0x04,0x0030) | VDP_DBL(b,0x02,0x000c) | VDP_DBL(b,0x01,0x0003) )
+#define	VDP_MAG4(b)	VDP_MAG(b), VDP_MAG((b)+1), VDP_MAG((b)+2), VDP_MAG((b)+3)
+#define	VDP_MAG16(b)	VDP_MAG4(b), VDP_MAG4((b)+4), VDP_MAG4((b)+8), VDP_MAG4((b)+12)
+#define	VDP_MAG64(b)	VDP_MAG16(b), VDP_MAG16((b)+16), VDP_MAG16((b)+32), VDP_MAG16((b)+48)
+
+static const word vdp_mag[256] =
+	{ VDP_MAG64(0), VDP_MAG64(64), VDP_MAG64(128), VDP_MAG64(192) };
+
+/* How many sprites are on each line (5 if more than 4), and the first 4 */
+static THREAD_LOCAL byte vdp_spr_lines[192];
+static THREAD_LOCAL byte vdp_spr_list[192][4];
+
+/* Where VDP pixel (x,y) of the picture, including the border, goes */
+#define	VDP_PIX(r,x,y)	( (r)->pix + (y)*(r)->scale*(r)->stride + (x)*(r)->scale )
+/*...e*/
+
 /*...svgavdp_reset:0:*/
 void vdp_reset (VDP *vdp)
 	{
@@ -97,347 +142,520 @@ void vdp_out2 (VDP *vdp, byte val)
 	}
 /*...e*/
 
-/*...svgavdp_refresh_blank:0:*/
-static void vdp_refresh_blank (VDP *vdp)
+/*...svdp_mode:0:*/
+/* The mode from the M1, M2 and M3 bits, or -1 if blanked */
+int vdp_mode (const byte *regs)
 	{
-	memset(vdp->pix, (vdp->regs[7]&0x0f), VDP_WIDTH*VDP_HEIGHT);
+	if ( (regs[1]&0x40) == 0 )
+		return -1;
+	return VDP_MODE( (regs[1]&0x10) != 0, (regs[1]&0x08) != 0, (regs[0]&0x02) != 0 );
 	}
 /*...e*/
-/*...svgavdp_refresh_sprites:0:*/
-/*...svgavdp_refresh_sprites_line_check:0:*/
-static BOOLEAN vdp_refresh_sprites_line_check (VDP *vdp, int scn_y, int sprite)
+/*...svdp_render_fill:0:*/
+static void vdp_render_fill (const VDP_RENDER *r, int x, int y, int w, int h, byte col)
 	{
-	if ( scn_y < 0 || scn_y >= 192 )
-		return FALSE;
-	if ( ++vdp->spr_lines[scn_y] <= 4 )
-		return TRUE;
-	return FALSE;
+	byte *d = VDP_PIX(r, x, y);
+	byte pix = r->cols[col];
+	for ( h *= r->scale; h > 0; h-- )
+		{
+		memset(d, pix, w*r->scale);
+		d += r->stride;
+		}
 	}
 /*...e*/
-/*...svgavdp_refresh_sprites_plot:0:*/
-static void vdp_refresh_sprites_plot (VDP *vdp, int scn_x, int scn_y, int spr_col)
+/*...svdp_render_blank:0:*/
+void vdp_render_blank (const VDP_RENDER *r)
 	{
-	if ( scn_x >= 0 && scn_x < 256 )
+	vdp_render_fill (r, 0, 0, VDP_WIDTH, VDP_HEIGHT, (r->regs[7]&0x0f));
+	}
+/*...e*/
+/*...svdp_render_border:0:*/
+/* Around the 192 lines of hborder to hborder+255 (or +239) */
+void vdp_render_border (const VDP_RENDER *r, int hborder)
+	{
+	byte col = (r->regs[7]&0x0f);
+	vdp_render_fill (r, 0, 0, VDP_WIDTH, VBORDER, col);
+	vdp_render_fill (r, 0, VBORDER, hborder, 192, col);
+	vdp_render_fill (r, VDP_WIDTH-hborder, VBORDER, hborder, 192, col);
+	vdp_render_fill (r, 0, VBORDER+192, VDP_WIDTH, VBORDER, col);
+	}
+/*...e*/
+/*...svdp_render_byte:0:*/
+/* The n (8 or 6) pixels of a line of pattern, fg where its bits are set
+   and bg where they are clear, with fg and bg repeated 8 times */
+static void vdp_render_byte (const VDP_RENDER *r, byte *d, byte gen, VDP_ROW fg, VDP_ROW bg, int n)
+	{
+	VDP_ROW m1, m2;
+	if ( r->scale == 1 )
 		{
-		if ( spr_col != 0 )
-			vdp->pix[(VBORDER+scn_y)*VDP_WIDTH+(HBORDER256+scn_x)] = spr_col;
+		memcpy(&m1, vdp_expand1[gen], sizeof(m1));
+		m1 = ( fg & m1 ) | ( bg & ~m1 );
+		memcpy(d, &m1, n);
+		}
+	else
+		{
+		memcpy(&m1, vdp_expand2[gen>>4], sizeof(m1));
+		memcpy(&m2, vdp_expand2[gen&15], sizeof(m2));
+		m1 = ( fg & m1 ) | ( bg & ~m1 );
+		m2 = ( fg & m2 ) | ( bg & ~m2 );
+		memcpy(d  , &m1, 8);
+		memcpy(d+8, &m2, 2*n-8);
+		memcpy(d+r->stride, d, 2*n);
 		}
 	}
 /*...e*/
-
-static void vdp_refresh_sprites (VDP *vdp)
+/*...svdp_render_colour:0:*/
+/* The pixel value of a colour, repeated 8 times.
+   Transparent is the backdrop colour. */
+static VDP_ROW vdp_render_colour (const VDP_RENDER *r, byte col)
 	{
-	byte size = ( (vdp->regs[1]&0x02) != 0 );
-	byte mag  = ( (vdp->regs[1]&0x01) != 0 );
-	word sprgen = ((word)(vdp->regs[6]&0x07)<<11);
-	word spratt = ((word)(vdp->regs[5]&0x7f)<<7);
-	int sprite, x, y, scn_x;
-	byte spr_pat_mask = size ? 0xfc : 0xff;
-	for ( sprite = 0; sprite < 32; sprite++ )
+	if ( col == 0 )
+		col = (r->regs[7]&0x0f);
+	return r->cols[col] * VDP_ONES;
+	}
+/*...e*/
+/*...svdp_render_graphics1:0:*/
+/* Only the cells already marked, or whose name, pattern or colour has
+   changed, are drawn, and those drawn are marked */
+void vdp_render_graphics1 (const VDP_RENDER *r)
+	{
+	word patnam = ( ((word)(r->regs[2]&0x0f)) << 10 );
+	word patgen = ( ((word)(r->regs[4]&0x07)) << 11 );
+	word patcol = ( ((word)(r->regs[3]&0xff)) <<  6 );
+	int line = r->stride * r->scale;
+	int row, x, y;
+	for ( row = 0; row < 24; row++ )
 		{
-		int spr_y     = (int) (unsigned) ((byte *)vdp->ram)[spratt++]; /* 0-255, partially signed */
-		int spr_x     = (int) (unsigned) ((byte *)vdp->ram)[spratt++]; /* 0-255 */
-		byte spr_pat  = ((byte *)vdp->ram)[spratt++] & spr_pat_mask;
-		word spr_addr = sprgen+((word)spr_pat<<3);
-		byte spr_flag = ((byte *)vdp->ram)[spratt++];
-		byte spr_col  = (spr_flag & 0x0f);
-		if ( spr_y == 0xd0 )
-			break;
-		if ( spr_y <= 192 )
-			++spr_y;
-		else
-			spr_y -= 255;
-		if ( spr_flag & 0x80 )
-			spr_x -= 32;
-		if ( size )
-			for ( y = 0; y < 16; y++ )
-				{
-				word bits = ((word)((byte *)vdp->ram)[spr_addr]<<8)|((word)((byte *)vdp->ram)[spr_addr+16]);
-				spr_addr++;
-				if ( mag )
-/*...sMAG\61\1\44\ SIZE\61\1:40:*/
-{
-int scn_y = spr_y+y*2;
-if ( vdp_refresh_sprites_line_check (vdp, scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 16; x++, scn_x+=2 )
-		if ( bits & (0x8000>>x) )
-			{
-			vdp_refresh_sprites_plot (vdp, scn_x  , scn_y, spr_col);
-			vdp_refresh_sprites_plot (vdp, scn_x+1, scn_y, spr_col);
-			}
-++scn_y;
-if ( vdp_refresh_sprites_line_check (vdp, scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 16; x++, scn_x+=2 )
-		if ( bits & (0x8000>>x) )
+		byte *d = VDP_PIX(r, HBORDER256, VBORDER+row*8);
+		for ( x = 0; x < 32; x++, patnam++, d += 8*r->scale )
 			{
-			vdp_refresh_sprites_plot (vdp, scn_x  , scn_y, spr_col);
-			vdp_refresh_sprites_plot (vdp, scn_x+1, scn_y, spr_col);
-			}
-}
-/*...e*/
-				else
-/*...sMAG\61\0\44\ SIZE\61\1:40:*/
-{
-int scn_y = spr_y+y;
-if ( vdp_refresh_sprites_line_check (vdp, scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 16; x++, scn_x++ )
-		if ( bits & (0x8000>>x) )
-			vdp_refresh_sprites_plot (vdp, scn_x, scn_y, spr_col);
-}
-/*...e*/
-				}
-		else
-			for ( y = 0; y < 8; y++ )
+			byte pat = r->ram[patnam];
+			word genptr = patgen + pat*8;
+			word colptr = patcol + pat/8;
+			if ( r->cells == NULL || r->cells[row][x] || VDP_DIRTY(r->dirty, patnam) ||
+			     VDP_DIRTY8(r->dirty, genptr) || VDP_DIRTY(r->dirty, colptr) )
 				{
-				byte bits = ((byte *)vdp->ram)[spr_addr++];
-				if ( mag )
-/*...sMAG\61\1\44\ SIZE\61\0:40:*/
-{
-int scn_y = spr_y+y*2;
-if ( vdp_refresh_sprites_line_check (vdp, scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 8; x++, scn_x+=2 )
-		if ( bits & (0x80>>x) )
-			{
-			vdp_refresh_sprites_plot (vdp, scn_x  , scn_y, spr_col);
-			vdp_refresh_sprites_plot (vdp, scn_x+1, scn_y, spr_col);
-			}
-++scn_y;
-if ( vdp_refresh_sprites_line_check (vdp, scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 8; x++, scn_x+=2 )
-		if ( bits & (0x80>>x) )
-			{
-			vdp_refresh_sprites_plot (vdp, scn_x  , scn_y, spr_col);
-			vdp_refresh_sprites_plot (vdp, scn_x+1, scn_y, spr_col);
-			}
-}
-/*...e*/
-				else
-/*...sMAG\61\0\44\ SIZE\61\0:40:*/
-{
-int scn_y = spr_y+y;
-if ( vdp_refresh_sprites_line_check (vdp, scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 8; x++, scn_x++ )
-		if ( bits & (0x80>>x) )
-			vdp_refresh_sprites_plot (vdp, scn_x, scn_y, spr_col);
-}
-/*...e*/
+				byte col = r->ram[colptr];
+				VDP_ROW fg = vdp_render_colour (r, col>>4);
+				VDP_ROW bg = vdp_render_colour (r, col&15);
+				byte *e = d;
+				for ( y = 0; y < 8; y++, e += line )
+					vdp_render_byte (r, e, r->ram[genptr++], fg, bg, 8);
+				if ( r->cells != NULL )
+					r->cells[row][x] = TRUE;
 				}
+			}
 		}
 	}
 /*...e*/
-/*...svgavdp_refresh_graphics1:0:*/
-static void vdp_refresh_graphics1_pat (VDP *vdp, 
-	byte pat,
-	word patgen,
-	word patcol,
-	byte *d
-	)
+/*...svdp_render_graphics2:0:*/
+/* According to spec, bits 1 and 0 of register 4 (patgen) should be set.
+   According to spec, bits 6 and 5 of register 3 (patcol) should be set.
+   Experimentally, we discovered undocumented features:
+   If bit 0 of register 4 is clear, 2nd third uses patgen from 1st third.
+   If bit 1 of register 4 is clear, 3rd third uses patgen from 1st third.
+   If bit 5 of register 3 is clear, 2nd third uses patcol from 1st third.
+   If bit 6 of register 3 is clear, 3rd third uses patcol from 1st third.
+   Maybe this is an attempt at saving VRAM.
+   Anyway, we support it in our emulation. */
+
+static void vdp_graphics2_tables (const byte *regs, int third, word *patgen, word *patcol)
 	{
-	word genptr = patgen + pat*8;
-	word colptr = patcol + pat/8;
-	byte col = ((byte *)vdp->ram)[colptr];
-	byte fg = (col>>4);
-	byte bg = (col&15);
-	int x, y;
-	if ( fg == 0 ) fg = (vdp->regs[7]&0x0f);
-	if ( bg == 0 ) bg = (vdp->regs[7]&0x0f);
-	for ( y = 0; y < 8; y++ )
+	*patgen = ( ((word)(regs[4]&0x04)) << 11 );
+	*patcol = ( ((word)(regs[3]&0x80)) <<  6 );
+	if ( third == 1 )
+		{
+		if ( regs[4]&0x01 ) *patgen += 0x0800;
+		if ( regs[3]&0x20 ) *patcol += 0x0800;
+		}
+	else if ( third == 2 )
 		{
-		byte gen = ((byte *)vdp->ram)[genptr++];
-		for ( x = 0; x < 8; x++ )
-			*d++ = ( gen & (0x80>>x) ) ? fg : bg;
-		d += ( -8 + VDP_WIDTH ); 
+		if ( regs[4]&0x02 ) *patgen += 0x1000;
+		if ( regs[3]&0x40 ) *patcol += 0x1000;
 		}
 	}
 
-static void vdp_refresh_graphics1_third (VDP *vdp, 
-	word patnam,
-	word patgen,
-	word patcol,
-	byte *d
-	)
+void vdp_render_graphics2 (const VDP_RENDER *r)
 	{
-	int x, y;
-	for ( y = 0; y < 8; y++ )
+	word patnam = ( ((word)(r->regs[2]&0x0f)) << 10 );
+	int line = r->stride * r->scale;
+	int row, x, y;
+	for ( row = 0; row < 24; row++ )
 		{
-		for ( x = 0; x < 32; x++ )
+		word patgen, patcol;
+		byte *d = VDP_PIX(r, HBORDER256, VBORDER+row*8);
+		vdp_graphics2_tables (r->regs, row/8, &patgen, &patcol);
+		for ( x = 0; x < 32; x++, patnam++, d += 8*r->scale )
 			{
-			byte pat = ((byte *)vdp->ram)[patnam++];
-			vdp_refresh_graphics1_pat (vdp, pat, patgen, patcol, d);
-			d += 8;
+			byte pat = r->ram[patnam];
+			word genptr = patgen + pat*8;
+			word colptr = patcol + pat*8;
+			if ( r->cells == NULL || r->cells[row][x] || VDP_DIRTY(r->dirty, patnam) ||
+			     VDP_DIRTY8(r->dirty, genptr) || VDP_DIRTY8(r->dirty, colptr) )
+				{
+				byte *e = d;
+				for ( y = 0; y < 8; y++, e += line )
+					{
+					byte col = r->ram[colptr++];
+					vdp_render_byte (r, e, r->ram[genptr++],
+						vdp_render_colour (r, col>>4), vdp_render_colour (r, col&15), 8);
+					}
+				if ( r->cells != NULL )
+					r->cells[row][x] = TRUE;
+				}
 			}
-		d += ( -32*8 + VDP_WIDTH*8 );
 		}
 	}
-
-static void vdp_refresh_graphics1 (VDP *vdp)
+/*...e*/
+/*...svdp_render_text:0:*/
+/* The colours are from register 7, or with M2 also set (as used by the
+   Propeller), from a table of a byte per character */
+void vdp_render_text (const VDP_RENDER *r)
 	{
-	word patnam = ( ((word)(vdp->regs[2]&0x0f)) << 10 );
-	word patgen = ( ((word)(vdp->regs[4]&0x07)) << 11 );
-	word patcol = ( ((word)(vdp->regs[3]&0xff)) <<  6 );
-	byte *d = vdp->pix + VDP_WIDTH*VBORDER + HBORDER256;
-
-	vdp_refresh_graphics1_third (vdp, patnam       , patgen, patcol, d           );
-	vdp_refresh_graphics1_third (vdp, patnam+0x0100, patgen, patcol, d+VDP_WIDTH* 8*8);
-	vdp_refresh_graphics1_third (vdp, patnam+0x0200, patgen, patcol, d+VDP_WIDTH*16*8);
-
-	vdp_refresh_sprites (vdp);
+	word patnam = ( ((word)(r->regs[2]&0x0f)) << 10 );
+	word patgen = ( ((word)(r->regs[4]&0x07)) << 11 );
+	word colptr = ( ((word)(r->regs[3]&0xf0)) <<  6 );
+	BOOLEAN coltab = ( (r->regs[1]&0x08) != 0 );
+	VDP_ROW fg = r->cols[r->regs[7]>>4] * VDP_ONES;
+	VDP_ROW bg = r->cols[r->regs[7]&15] * VDP_ONES;
+	int line = r->stride * r->scale;
+	int row, x, y;
+	for ( row = 0; row < 24; row++ )
+		{
+		byte *d = VDP_PIX(r, HBORDER240, VBORDER+row*8);
+		for ( x = 0; x < 40; x++, patnam++, colptr++, d += 6*r->scale )
+			{
+			byte pat = r->ram[patnam];
+			word genptr = patgen + pat*8;
+			if ( r->cells == NULL || r->cells[row][x] || VDP_DIRTY(r->dirty, patnam) ||
+			     VDP_DIRTY8(r->dirty, genptr) || ( coltab && VDP_DIRTY(r->dirty, colptr) ) )
+				{
+				byte *e = d;
+				if ( coltab )
+					{
+					fg = r->cols[r->ram[colptr]>>4] * VDP_ONES;
+					bg = r->cols[r->ram[colptr]&15] * VDP_ONES;
+					}
+				for ( y = 0; y < 8; y++, e += line )
+					vdp_render_byte (r, e, r->ram[genptr++], fg, bg, 6);
+				if ( r->cells != NULL )
+					r->cells[row][x] = TRUE;
+				}
+			}
+		}
 	}
 /*...e*/
-/*...svgavdp_refresh_graphics2:0:*/
-static void vdp_refresh_graphics2_pat (VDP *vdp, 
-	byte pat,
-	word patgen,
-	word patcol,
-	byte *d
-	)
+/*...svdp_render_sprites:0:*/
+/*...svdp_sprite_bits:0:*/
+/* The dots of a line of a sprite pattern, magnified if need be, as the
+   most significant bits, the leftmost dot being the top bit */
+static unsigned vdp_sprite_bits (const VDP_RENDER *r, word spr_addr, byte size, byte mag)
 	{
-	word genptr = patgen + pat*8;
-	word colptr = patcol + pat*8;
-	int x, y;
-	for ( y = 0; y < 8; y++ )
+	unsigned bits;
+	if ( mag )
+		{
+		bits = (unsigned) vdp_mag[r->ram[spr_addr]] << 16;
+		if ( size )
+			bits |= (unsigned) vdp_mag[r->ram[spr_addr+16]];
+		}
+	else
 		{
-		byte gen = ((byte *)vdp->ram)[genptr++];
-		byte col = ((byte *)vdp->ram)[colptr++];
-		byte fg = (col>>4);
-		byte bg = (col&15);
-		if ( fg == 0 ) fg = (vdp->regs[7]&0x0f);
-		if ( bg == 0 ) bg = (vdp->regs[7]&0x0f);
-		for ( x = 0; x < 8; x++ )
-			*d++ = ( gen & (0x80>>x) ) ? fg : bg;
-		d += ( -8 + VDP_WIDTH ); 
+		bits = (unsigned) r->ram[spr_addr] << 24;
+		if ( size )
+			bits |= (unsigned) r->ram[spr_addr+16] << 16;
 		}
+	return bits;
 	}
-
-static void vdp_refresh_graphics2_third (VDP *vdp, 
-	word patnam,
-	word patgen,
-	word patcol,
-	byte *d
-	)
+/*...e*/
+/*...svdp_render_sprites_row:0:*/
+/* Plot the dots of a sprite on line y of the 192. Where a higher
+   priority sprite has already put a dot in dots, this sets C. */
+static void vdp_render_sprites_row (const VDP_RENDER *r, int y, int spr_x, unsigned bits, byte spr_col, byte *dots, byte *status)
 	{
-	int x, y;
-	for ( y = 0; y < 8; y++ )
+	byte pix = r->cols[spr_col];
+	byte *d;
+	if ( spr_x <= -32 )
+		return;
+	if ( spr_x < 0 )
 		{
-		for ( x = 0; x < 32; x++ )
+		bits <<= -spr_x;
+		spr_x = 0;
+		}
+	d = VDP_PIX(r, HBORDER256+spr_x, VBORDER+y);
+	for ( ; bits != 0 && spr_x < 256; spr_x++, bits <<= 1, d += r->scale )
+		if ( bits & 0x80000000 )
 			{
-			byte pat = ((byte *)vdp->ram)[patnam++];
-			vdp_refresh_graphics2_pat (vdp, pat, patgen, patcol, d);
-			d += 8;
+			if ( dots[spr_x] )
+				*status |= 0x20; /* C */
+			else
+				{
+				dots[spr_x] = TRUE;
+				if ( spr_col != 0 )
+					{
+					d[0] = pix;
+					if ( r->scale == 2 )
+						{
+						d[1] = pix;
+						d[r->stride] = pix;
+						d[r->stride+1] = pix;
+						}
+					}
+				}
 			}
-		d += ( -32*8 + VDP_WIDTH*8 );
-		}
 	}
+/*...e*/
 
-/* According to spec, bits 1 and 0 of register 4 (patgen) should be set.
-   According to spec, bits 6 and 5 of register 3 (patcol) should be set.
-   Experimentally, we discovered undocumented features:
-   If bit 0 of register 4 is clear, 2nd third uses patgen from 1st third.
-   If bit 1 of register 4 is clear, 3rd third uses patgen from 1st third.
-   If bit 5 of register 3 is clear, 2nd third uses patcol from 1st third.
-   If bit 6 of register 3 is clear, 3rd third uses patcol from 1st third.
-   Maybe this is an attempt at saving VRAM.
-   Anyway, we support it in our emulation. */
-
-static void vdp_refresh_graphics2 (VDP *vdp)
+/* The lines each sprite is on are found in one pass over the attribute
+   table, giving a list of the (up to 4) sprites to show on each line.
+   Then each line is drawn from its list, highest priority first.
+   Returns the 5S, C and FSN bits of the status register. As the VDP
+   finds them a line at a time, FSN is the 5th sprite on the first line
+   which has one. */
+byte vdp_render_sprites (const VDP_RENDER *r)
 	{
-	word patnam  = ( ((word)(vdp->regs[2]&0x0f)) << 10 );
-	word patgen1 = ( ((word)(vdp->regs[4]&0x04)) << 11 );
-	word patcol1 = ( ((word)(vdp->regs[3]&0x80)) <<  6 );
-	word patgen2 = (vdp->regs[4]&0x01) ? patgen1+0x0800 : patgen1;
-	word patcol2 = (vdp->regs[3]&0x20) ? patcol1+0x0800 : patcol1;
-	word patgen3 = (vdp->regs[4]&0x02) ? patgen1+0x1000 : patgen1;
-	word patcol3 = (vdp->regs[3]&0x40) ? patcol1+0x1000 : patcol1;
-	byte *d = vdp->pix + VDP_WIDTH*VBORDER + HBORDER256;
-
-	vdp_refresh_graphics2_third (vdp, patnam        , patgen1, patcol1, d           );
-	vdp_refresh_graphics2_third (vdp, patnam+0x0100 , patgen2, patcol2, d+VDP_WIDTH* 8*8);
-	vdp_refresh_graphics2_third (vdp, patnam+0x0200 , patgen3, patcol3, d+VDP_WIDTH*16*8);
-
-	vdp_refresh_sprites (vdp);
+	byte size = ( (r->regs[1]&0x02) != 0 );
+	byte mag  = ( (r->regs[1]&0x01) != 0 );
+	word sprgen = ((word)(r->regs[6]&0x07)<<11);
+	word spratt = ((word)(r->regs[5]&0x7f)<<7);
+	byte spr_pat_mask = size ? 0xfc : 0xff;
+	int n = ( size ? 16 : 8 ) << mag;
+	int  spr_top[32];
+	int  spr_x[32];
+	word spr_addr[32];
+	byte spr_col[32];
+	int sprite, y, i;
+	int first5 = 192;
+	byte status = 0x00;
+	for ( sprite = 0; sprite < 32; sprite++, spratt += 4 )
+		{
+		int spr_y     = (int) (unsigned) r->ram[spratt]; /* 0-255, partially signed */
+		byte spr_flag = r->ram[spratt+3];
+		int y0, y1;
+		if ( spr_y == 0xd0 )
+			break;
+		if ( spr_y <= 192 )
+			++spr_y;
+		else
+			spr_y -= 255;
+		spr_top[sprite]  = spr_y;
+		spr_x[sprite]    = (int) (unsigned) r->ram[spratt+1] - ( (spr_flag & 0x80) ? 32 : 0 );
+		spr_addr[sprite] = sprgen+((word)(r->ram[spratt+2] & spr_pat_mask)<<3);
+		spr_col[sprite]  = (spr_flag & 0x0f);
+		y0 = ( spr_y < 0 ) ? 0 : spr_y;
+		y1 = ( spr_y+n > 192 ) ? 192 : spr_y+n;
+		for ( y = y0; y < y1; y++ )
+			if ( vdp_spr_lines[y] < 4 )
+				vdp_spr_list[y][vdp_spr_lines[y]++] = sprite;
+			else if ( vdp_spr_lines[y] == 4 )
+				{
+				vdp_spr_lines[y] = 5; /* Has a 5th sprite */
+				if ( y < first5 )
+					{
+					first5 = y;
+					status = (0x40|sprite); /* 5S and FSN */
+					}
+				}
+		}
+	for ( y = 0; y < 192; y++ )
+		if ( vdp_spr_lines[y] > 0 )
+			{
+			byte dots[256];
+			memset(dots, FALSE, sizeof(dots));
+			for ( i = 0; i < vdp_spr_lines[y] && i < 4; i++ )
+				{
+				sprite = vdp_spr_list[y][i];
+				vdp_render_sprites_row (r, y, spr_x[sprite],
+					vdp_sprite_bits (r, spr_addr[sprite]+((y-spr_top[sprite])>>mag), size, mag),
+					spr_col[sprite], dots, &status);
+				}
+			if ( vdp_spr_lines[y] > 4 && r->markers )
+				vdp_render_fill (r, HBORDER256+3, VBORDER+y, 3, 1, 0x0d); /* 5S MARKER */
+			vdp_spr_lines[y] = 0;
+			}
+	return status;
 	}
 /*...e*/
-/*...svgavdp_refresh_text:0:*/
-static void vdp_refresh_text_pat (VDP *vdp, 
-	byte pat,
-	byte col,
-	byte *d
-	)
+
+/*...svdp_render_line:0:*/
+/*...svdp_render_line_tiles:0:*/
+/* Line y of the 192 in graphics 1 or 2 mode */
+static void vdp_render_line_tiles (const VDP_RENDER *r, int mode, int y)
 	{
-	word patgen = ( ((word)(vdp->regs[4]&0x07)) << 11 );
-	word genptr = patgen + pat*8;
-	byte fg = (col>>4);
-	byte bg = (col&15);
-	int x, y;
-	for ( y = 0; y < 8; y++ )
+	word patnam = ( ((word)(r->regs[2]&0x0f)) << 10 ) + (y>>3)*32;
+	word patgen, patcol;
+	byte *d = VDP_PIX(r, HBORDER256, VBORDER+y);
+	int x;
+	if ( mode == VDP_MODE(0,0,0) )
+		{
+		patgen = ( ((word)(r->regs[4]&0x07)) << 11 ) + (y&7);
+		patcol = ( ((word)(r->regs[3]&0xff)) <<  6 );
+		for ( x = 0; x < 32; x++, d += 8*r->scale )
+			{
+			byte pat = r->ram[patnam+x];
+			byte col = r->ram[patcol+pat/8];
+			vdp_render_byte (r, d, r->ram[patgen+pat*8],
+				vdp_render_colour (r, col>>4), vdp_render_colour (r, col&15), 8);
+			}
+		}
+	else
 		{
-		byte gen = ((byte *)vdp->ram)[genptr++];
-		for ( x = 0; x < 6; x++ )
-			*d++ = ( gen & (0x80>>x) ) ? fg : bg;
-		d += ( -6 + VDP_WIDTH ); 
+		vdp_graphics2_tables (r->regs, y>>6, &patgen, &patcol);
+		patgen += (y&7);
+		patcol += (y&7);
+		for ( x = 0; x < 32; x++, d += 8*r->scale )
+			{
+			byte pat = r->ram[patnam+x];
+			byte col = r->ram[patcol+pat*8];
+			vdp_render_byte (r, d, r->ram[patgen+pat*8],
+				vdp_render_colour (r, col>>4), vdp_render_colour (r, col&15), 8);
+			}
 		}
 	}
-
-static void vdp_refresh_text (VDP *vdp)
+/*...e*/
+/*...svdp_render_line_text:0:*/
+static void vdp_render_line_text (const VDP_RENDER *r, int y)
 	{
-    word colptr = ((word)(vdp->regs[3] & 0xF0)) << 6;
-	byte col = vdp->regs[7];
-	word patnam = ( ((word)(vdp->regs[2]&0x0f)) << 10 );
-	byte *d = vdp->pix + VDP_WIDTH*VBORDER + HBORDER240;
-	int x, y;
-	for ( y = 0; y < 24; y++ )
+	word patnam = ( ((word)(r->regs[2]&0x0f)) << 10 ) + (y>>3)*40;
+	word patgen = ( ((word)(r->regs[4]&0x07)) << 11 ) + (y&7);
+	word colptr = ( ((word)(r->regs[3]&0xf0)) <<  6 ) + (y>>3)*40;
+	BOOLEAN coltab = ( (r->regs[1]&0x08) != 0 );
+	VDP_ROW fg = r->cols[r->regs[7]>>4] * VDP_ONES;
+	VDP_ROW bg = r->cols[r->regs[7]&15] * VDP_ONES;
+	byte *d = VDP_PIX(r, HBORDER240, VBORDER+y);
+	int x;
+	for ( x = 0; x < 40; x++, d += 6*r->scale )
 		{
-		for ( x = 0; x < 40; x++ )
+		if ( coltab )
 			{
-            if (vdp->regs[1] & 0x08) col = vdp->ram[colptr++];
-			byte pat = ((byte *)vdp->ram)[patnam++];
-			vdp_refresh_text_pat (vdp, pat, col, d);
-			d += 6;
+			fg = r->cols[r->ram[colptr+x]>>4] * VDP_ONES;
+			bg = r->cols[r->ram[colptr+x]&15] * VDP_ONES;
 			}
-		d += ( -40*6 + VDP_WIDTH*8 );
+		vdp_render_byte (r, d, r->ram[patgen+r->ram[patnam+x]*8], fg, bg, 6);
 		}
 	}
 /*...e*/
-/*...svgavdp_refresh:0:*/
-#define	MODE(m1,m2,m3) ( ((m1)<<2) | ((m2)<<1) | (m3) )
-
-void vdp_refresh (VDP *vdp)
+/*...svdp_render_line_sprites:0:*/
+/* The sprites on line y of the 192, as the VDP finds them. Only the
+   first 4 in the table are shown, and a 5th sets 5S. */
+static byte vdp_render_line_sprites (const VDP_RENDER *r, int y)
 	{
-	if ( (vdp->regs[1]&0x40) == 0 )
-		vdp_refresh_blank (vdp);
-	else
+	byte size = ( (r->regs[1]&0x02) != 0 );
+	byte mag  = ( (r->regs[1]&0x01) != 0 );
+	word sprgen = ((word)(r->regs[6]&0x07)<<11);
+	word spratt = ((word)(r->regs[5]&0x7f)<<7);
+	byte spr_pat_mask = size ? 0xfc : 0xff;
+	int n = ( size ? 16 : 8 ) << mag;
+	int sprite, count = 0;
+	byte dots[256];
+	byte status = 0x00;
+	for ( sprite = 0; sprite < 32; sprite++, spratt += 4 )
 		{
-		BOOLEAN m1 = ( (vdp->regs[1]&0x10) != 0 );
-		BOOLEAN m2 = ( (vdp->regs[1]&0x08) != 0 );
-		BOOLEAN m3 = ( (vdp->regs[0]&0x02) != 0 );
-		int mode = MODE(m1,m2,m3);
-		if ( vdp->pix[0] != (vdp->regs[7]&0x0f) ||
-		     mode != vdp->last_mode )
-			/* Ensure the border is redrawn.
-			   Perhaps could do this more efficiently.
-			   But it isn't going to happen very often. */
-			vdp_refresh_blank (vdp);
-		switch ( mode )
+		int spr_y     = (int) (unsigned) r->ram[spratt  ]; /* 0-255, partially signed */
+		int spr_x     = (int) (unsigned) r->ram[spratt+1]; /* 0-255 */
+		byte spr_pat  = r->ram[spratt+2] & spr_pat_mask;
+		byte spr_flag = r->ram[spratt+3];
+		int line;
+		if ( spr_y == 0xd0 )
+			break;
+		if ( spr_y <= 192 )
+			++spr_y;
+		else
+			spr_y -= 255;
+		line = y - spr_y;
+		if ( line < 0 || line >= n )
+			continue;
+		if ( ++count > 4 )
 			{
-			case MODE(0,0,0):
-				vdp_refresh_graphics1 (vdp);
-				break;
-			case MODE(0,0,1):
-				vdp_refresh_graphics2 (vdp);
-				break;
-			case MODE(0,1,0):
-                /* Should really be Multicolour mode */
-				vdp_refresh_blank (vdp);
-				break;
-			case MODE(1,0,0):
-            case MODE(1,1,0):
-				vdp_refresh_text (vdp);
-				break;
-			default:
-				vdp_refresh_blank (vdp);
-				break;
+			status |= (0x40|sprite); /* 5S and FSN */
+			if ( r->markers )
+				vdp_render_fill (r, HBORDER256+3, VBORDER+y, 3, 1, 0x0d); /* 5S MARKER */
+			break;
 			}
-		vdp->last_mode = mode;
+		if ( count == 1 )
+			memset(dots, FALSE, sizeof(dots));
+		if ( spr_flag & 0x80 )
+			spr_x -= 32;
+		vdp_render_sprites_row (r, y, spr_x,
+			vdp_sprite_bits (r, sprgen+((word)spr_pat<<3)+(line>>mag), size, mag),
+			(spr_flag & 0x0f), dots, &status);
+		}
+	return status;
+	}
+/*...e*/
+
+/* Line y of the picture (0 to VDP_HEIGHT-1, including the border), in
+   the mode the registers are in now. Returns the 5S, C and FSN bits of
+   the status register given by the sprites on it. */
+byte vdp_render_line (const VDP_RENDER *r, int y)
+	{
+	int mode = vdp_mode (r->regs);
+	byte col = (r->regs[7]&0x0f);
+	int hborder = HBORDER256;
+	byte status = 0x00;
+	if ( y < VBORDER || y >= VBORDER+192 )
+		{
+		vdp_render_fill (r, 0, y, VDP_WIDTH, 1, col);
+		return 0x00;
+		}
+	switch ( mode )
+		{
+		case VDP_MODE(0,0,0):
+		case VDP_MODE(0,0,1):
+			vdp_render_line_tiles (r, mode, y-VBORDER);
+			status = vdp_render_line_sprites (r, y-VBORDER);
+			break;
+		case VDP_MODE(1,0,0):
+		case VDP_MODE(1,1,0):
+			hborder = HBORDER240;
+			vdp_render_line_text (r, y-VBORDER);
+			break;
+		default:
+			/* Blanked, or multicolour (which should really be drawn) */
+			vdp_render_fill (r, 0, y, VDP_WIDTH, 1, col);
+			return 0x00;
+		}
+	vdp_render_fill (r, 0, y, hborder, 1, col);
+	vdp_render_fill (r, VDP_WIDTH-hborder, y, hborder, 1, col);
+	return status;
+	}
+/*...e*/
+
+/*...svgavdp_refresh:0:*/
+/* Draw the picture at pix, which is stride bytes per line,
+   each pixel being scale by scale pixels of value cols[colour] */
+void vdp_refresh (VDP *vdp, byte *pix, int stride, int scale, const byte *cols)
+	{
+	VDP_RENDER r;
+	r.ram     = vdp->ram;
+	r.regs    = vdp->regs;
+	r.pix     = pix;
+	r.stride  = stride;
+	r.scale   = scale;
+	r.cols    = cols;
+	r.cells   = NULL;
+	r.dirty   = NULL;
+	r.markers = FALSE;
+	switch ( vdp_mode (vdp->regs) )
+		{
+		case VDP_MODE(0,0,0):
+			vdp_render_border (&r, HBORDER256);
+			vdp_render_graphics1 (&r);
+			vdp_render_sprites (&r);
+			break;
+		case VDP_MODE(0,0,1):
+			vdp_render_border (&r, HBORDER256);
+			vdp_render_graphics2 (&r);
+			vdp_render_sprites (&r);
+			break;
+		case VDP_MODE(1,0,0):
+		case VDP_MODE(1,1,0):
+			vdp_render_border (&r, HBORDER240);
+			vdp_render_text (&r);
+			break;
+		default:
+			/* Blanked, or multicolour (which should really be drawn) */
+			vdp_render_blank (&r);
+			break;
 		}
     vdp->changed = FALSE;
 	}
@@ -450,8 +668,6 @@ void vdp_init (VDP *vdp)
     vdp->changed = FALSE;
 	vdp->addr    = 0x0000;
 	vdp->read_mode = FALSE;
-	vdp->last_mode = -1; /* None of the valid modes */
     vdp->latched = FALSE;
     vdp->latch = 0;
-	memset(vdp->spr_lines, FALSE, sizeof(vdp->spr_lines));
 	}
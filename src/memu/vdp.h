@@ -1,5 +1,10 @@
 // vdp.h - Emulation of the VDP wrapped within a struct for use in multiple display drivers
 
+#ifndef VDP_H
+#define	VDP_H
+
+#include "types.h"
+
 #define	VDP_MEMORY_SIZE 0x4000
 #define	VBORDER 8
 #define	HBORDER256 8
@@ -7,22 +12,58 @@
 #define	VDP_WIDTH  (HBORDER256+256+HBORDER256)
 #define	VDP_HEIGHT (VBORDER   +192+   VBORDER)
 
+/* The 8 pixel high rows of 8 (or 6) pixel wide cells */
+#define	VDP_ROWS 24
+#define	VDP_COLS 40
+
+#define	VDP_MODE(m1,m2,m3) ( ((m1)<<2) | ((m2)<<1) | (m3) )
+
+/* A bit for each byte of VRAM which has changed */
+#define	VDP_DIRTY(d,a)	( (d)[(a)>>3] & (0x01<<((a)&7)) )
+#define	VDP_DIRTY8(d,a)	( (d)[(a)>>3] ) /* a is a multiple of 8 */
+
 typedef struct
     {
     BOOLEAN changed;
     byte    regs[8];
-    byte    spr_lines[192];
     word    addr;
     BOOLEAN read_mode;
-    int     last_mode;
     BOOLEAN latched;
     byte    latch;
     byte *  ram;
-    byte *  pix;
     } VDP;
 
+/* Where and how the picture is to be drawn. Each VDP pixel becomes
+   scale by scale pixels of value cols[colour], starting at pix, which
+   is the top left of the border. If cells is not NULL, only the cells
+   already marked in it, or using VRAM marked in dirty, are drawn, and
+   those drawn are marked. */
+typedef struct
+    {
+    const byte *ram;
+    const byte *regs;
+    byte *pix;
+    int stride;
+    int scale;          /* 1 or 2 */
+    const byte *cols;
+    byte (*cells)[VDP_COLS];
+    const byte *dirty;
+    BOOLEAN markers;    /* Show where sprites were lost */
+    } VDP_RENDER;
+
+int vdp_mode (const byte *regs);
+void vdp_render_blank (const VDP_RENDER *r);
+void vdp_render_border (const VDP_RENDER *r, int hborder);
+void vdp_render_graphics1 (const VDP_RENDER *r);
+void vdp_render_graphics2 (const VDP_RENDER *r);
+void vdp_render_text (const VDP_RENDER *r);
+byte vdp_render_sprites (const VDP_RENDER *r);
+byte vdp_render_line (const VDP_RENDER *r, int y);
+
 void vdp_init (VDP *vdp);
 void vdp_reset (VDP *vdp);
-void vdp_refresh (VDP *vdp);
+void vdp_refresh (VDP *vdp, byte *pix, int stride, int scale, const byte *cols);
 void vdp_out1 (VDP *, byte val);
 void vdp_out2 (VDP *vdp, byte val);
+
+#endif
@@ -50,11 +50,11 @@
 #define wmChar      1
 #define wmAttr      2
 
-static WIN *vga_win = NULL;
-static unsigned int btop = 0;
-static unsigned int *buffer = NULL;
-static unsigned int iTime = 0;
-static enum s_state {
+static THREAD_LOCAL WIN *vga_win = NULL;
+static THREAD_LOCAL unsigned int btop = 0;
+static THREAD_LOCAL unsigned int *buffer = NULL;
+static THREAD_LOCAL unsigned int iTime = 0;
+static THREAD_LOCAL enum s_state {
     stNormal,   //  Normal character state
     stXPos,     //  Next byte defines X position
     stYPos,     //  Next byte defines Y position
@@ -112,7 +112,7 @@ static const char *psState[] = {
     "stCopy"      //  Copy characters
     };
 
-static byte mode = mdCompat;
+static THREAD_LOCAL byte mode = mdCompat;
 
 struct s_vscr               // Virtual screen properties
     {
@@ -132,32 +132,32 @@ struct s_vscr               // Virtual screen properties
     byte            vs;     // Virtual screen number
     };
 
-static struct s_vscr vs[N_VS];
+static THREAD_LOCAL struct s_vscr vs[N_VS];
 static struct s_vscr vs_def =
     { 0x00002000, 0x00002000, COLS, ROWS, 0, 0, 1, 0, 0, 1, 0, csNormal, wmBoth, 0 };
-static struct s_vscr *active = &vs[0];
+static THREAD_LOCAL struct s_vscr *active = NULL;    // Set by vga_reset
 #define NREG    28
 
 #define NPARAM  20
-static byte par[NPARAM];
-static unsigned int pcntr;
-static unsigned int pdata;
+static THREAD_LOCAL byte par[NPARAM];
+static THREAD_LOCAL unsigned int pcntr;
+static THREAD_LOCAL unsigned int pdata;
 
 #define NGLYPH  256
 #define NGRAPH  256
 #define NFONT   ( NGLYPH + NGRAPH )
-static byte (*vga_font)[THEIGHT] = NULL;
+static THREAD_LOCAL byte (*vga_font)[THEIGHT] = NULL;
 
 static byte vdpclr[16] =
     { 0x00, 0x00, 0x09, 0x0E, 0x30, 0x38, 0x02, 0x3D,
       0x03, 0x07, 0x1B, 0x1F, 0x04, 0x22, 0x26, 0x3F };
 
-static enum { rbZero, rbText, rbGraph, rbReg, rbFont, rbVDPRAM, rbVDPReg } rbmode = rbZero;
-static unsigned int rrow = 0;
-static unsigned int rcol = 0;
-static unsigned int raddr = 0;
-static unsigned int nwait = NRESET;
-static byte bout = 0;
+static THREAD_LOCAL enum { rbZero, rbText, rbGraph, rbReg, rbFont, rbVDPRAM, rbVDPReg } rbmode = rbZero;
+static THREAD_LOCAL unsigned int rrow = 0;
+static THREAD_LOCAL unsigned int rcol = 0;
+static THREAD_LOCAL unsigned int raddr = 0;
+static THREAD_LOCAL unsigned int nwait = NRESET;
+static THREAD_LOCAL byte bout = 0;
 
 #ifndef WIN32
 #define min(x,y)    ( x < y ? x : y )
@@ -186,8 +186,7 @@ static byte bit_reverse[256] =
 
 /*...svars:0:*/
 
-static VDP vgavdp;
-static byte *vgavdp_pix = NULL;
+static THREAD_LOCAL VDP vgavdp;
 
 void vga_reset (void)
     {
@@ -870,10 +869,8 @@ static void vga_set_mode (int md)
         raddr = 0;
         bout = 0x61;
         nwait = NRESET;
-        if ( vgavdp_pix == NULL ) vgavdp_pix = (byte *) emalloc (VDP_WIDTH * VDP_HEIGHT);
         vgavdp.ram = (byte *) buffer;
-        vgavdp.pix = vgavdp_pix;
-        // diag_message (DIAG_VGA_MODE, "vgavdp = %p, vgavdp.ram = %p, vgavdp.pix = %p", &vgavdp, vgavdp.ram, vgavdp.pix);
+        // diag_message (DIAG_VGA_MODE, "vgavdp = %p, vgavdp.ram = %p", &vgavdp, vgavdp.ram);
         vdp_init (&vgavdp);
         vga_out2 (0x08);
         vga_out2 (0x87);
@@ -904,7 +901,7 @@ static void vga_set_mode (int md)
     
 void vga_out60 (byte chr)
     {
-    static unsigned int addr = 0;
+    static THREAD_LOCAL unsigned int addr = 0;
     unsigned int attr;
     diag_message(DIAG_VGA_PORT, "VGA write to port 0x60: 0x%02X ('%c'), state = %s",
         chr, (((chr >= 0x20) && (chr < 0x7F))? chr : '.'), psState[state]);
@@ -1759,25 +1756,9 @@ void vga_refresh (void)
     diag_message(DIAG_VGA_REFRESH, "VGA refresh: mode = %d", mode);
     if ( mode == mdVDP )
         {
-        unsigned int i, j;
-        byte *vdp_data = vgavdp_pix;
         diag_message(DIAG_VGA_REFRESH, "VGA echo VDP");
-        vdp_refresh (&vgavdp);
-        for ( i = 0; i < VDP_HEIGHT; ++i )
-            {
-            byte *vga_data = vga_win->data + WIDTH * ( 2 * i + VDP_YORG ) + VDP_XORG;
-            for ( j = 0; j < VDP_WIDTH; ++j )
-                {
-                byte pix = vdpclr[*vdp_data];
-                *vga_data = pix;
-                *(vga_data + WIDTH) = pix;
-                ++vga_data;
-                *vga_data = pix;
-                *(vga_data + WIDTH) = pix;
-                ++vga_data;
-                ++vdp_data;
-                }
-            }
+        if ( vgavdp.changed )
+            vdp_refresh (&vgavdp, vga_win->data + WIDTH * VDP_YORG + VDP_XORG, WIDTH, 2, vdpclr);
         }
     else if ( mode != mdGraph )
         {
@@ -20,6 +20,7 @@ If we don't display it, the VDP status register won't get updated.
 #include "common.h"
 #include "win.h"
 #include "vid.h"
+#include "vdp.h"
 #include "kbd.h"
 #include "mon.h"
 // #include "console.h"
@@ -30,27 +31,25 @@ If we don't display it, the VDP status register won't get updated.
 /*...vcommon\46\h:0:*/
 /*...vwin\46\h:0:*/
 /*...vvid\46\h:0:*/
+/*...vvdp\46\h:0:*/
 /*...vkbd\46\h:0:*/
 /*...vmon\46\h:0:*/
 /*...e*/
 
 /*...svars:0:*/
-static int vid_emu = 0;
-static const char *vid_title = NULL;
-static const char *vid_display = NULL;
+static THREAD_LOCAL int vid_emu = 0;
+static THREAD_LOCAL const char *vid_title = NULL;
+static THREAD_LOCAL const char *vid_display = NULL;
 
-#define	VBORDER 8
-#define	HBORDER256 8
-#define	HBORDER240 16
-#define	WIDTH  (HBORDER256+256+HBORDER256)
-#define	HEIGHT (VBORDER   +192+   VBORDER)
+#define	WIDTH  VDP_WIDTH
+#define	HEIGHT VDP_HEIGHT
 
 #define	N_COLS_VID 16
 
 #define EXTRA_TIME_CHECK    0
 
 /* These look realistic and reflect what I remember */
-static COL vid_cols_rfd[N_COLS_VID] =
+static THREAD_LOCAL COL vid_cols_rfd[N_COLS_VID] =
 	{
 		{    0,   0,   0 },	/* transparent */
 		{    0,   0,   0 },	/* black */
@@ -71,7 +70,7 @@ static COL vid_cols_rfd[N_COLS_VID] =
 	};
 
 /* But these look richer and are said to align with the hardware */
-static COL vid_cols_mf_mdk[N_COLS_VID] =
+static THREAD_LOCAL COL vid_cols_mf_mdk[N_COLS_VID] =
 	{
 		{    0,   0,   0 },	/* transparent */
 		{    0,   0,   0 },	/* black */
@@ -91,36 +90,59 @@ static COL vid_cols_mf_mdk[N_COLS_VID] =
 		{  224, 224, 224 },	/* white */
 	};
 
-static COL *vid_cols; /* One of the above */
+static THREAD_LOCAL COL *vid_cols; /* One of the above */
 
 /* See http://users.stargate.net/~drushel/pub/coleco/twwmca/wk970202.html */
 
-static WIN *vid_win = NULL;
+static THREAD_LOCAL WIN *vid_win = NULL;
 
-static byte vid_regs[8];
+static THREAD_LOCAL byte vid_regs[8];
 static byte vid_regs_zeros[8] = { 0xfc,0x04,0xf0,0x00,0xf8,0x80,0xf8,0x00 };
-static byte vid_status = 0x00;
-static byte vid_memory[VID_MEMORY_SIZE];
-static byte vid_spr_lines[192];
-static byte vid_spr_coincidence[192][256];
-static word vid_addr;
-static BOOLEAN vid_read_mode;
-static int vid_last_mode;
-
-static BOOLEAN vid_latched = FALSE;
-static byte vid_latch = 0;
+static THREAD_LOCAL byte vid_status = 0x00;
+static THREAD_LOCAL byte vid_memory[VID_MEMORY_SIZE];
+static THREAD_LOCAL word vid_addr;
+static THREAD_LOCAL BOOLEAN vid_read_mode;
+static THREAD_LOCAL int vid_last_mode;
+
+/* What has changed since the picture was last drawn. A bit for each
+   byte of VRAM, so each pattern and colour entry is one byte of this.
+   A change to any register redraws everything. */
+static THREAD_LOCAL byte vid_dirty[VID_MEMORY_SIZE>>3];
+static THREAD_LOCAL BOOLEAN vid_any_dirty = FALSE;
+static THREAD_LOCAL BOOLEAN vid_all_dirty = TRUE;
+#define	VID_DIRTY8(a)	VDP_DIRTY8(vid_dirty, a)
+#define	VID_MARK_DIRTY(a) { vid_dirty[(a)>>3] |= (0x01<<((a)&7)); vid_any_dirty = TRUE; }
+
+/* The cells to be redrawn */
+static THREAD_LOCAL byte vid_cell_dirty[VDP_ROWS][VDP_COLS];
+/* The cells the sprites were drawn over, and the status they gave */
+static THREAD_LOCAL byte vid_spr_cells[VDP_ROWS][VDP_COLS];
+static THREAD_LOCAL byte vid_spr_status = 0x00;
+
+/* With VIDEMU_WIN_SCANLINE, the lines of the picture drawn so far this
+   frame, and those of them given to the window */
+static THREAD_LOCAL unsigned long long vid_elapsed_frame = 0;
+static THREAD_LOCAL int vid_line = 0;
+static THREAD_LOCAL int vid_line_shown = 0;
+
+/* The window has a palette entry for each VDP colour */
+static const byte vid_pix_cols[16] = { 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15 };
+
+static THREAD_LOCAL BOOLEAN vid_latched = FALSE;
+static THREAD_LOCAL byte vid_latch = 0;
 
 typedef enum {timNone, timRead, timWrite, timAddr} TimMode;
-static TimMode timLast = timNone;
-static unsigned long long vid_elapsed_refresh = 0;
-static unsigned long long vid_elapsed_last_data = 0;
-static unsigned long long vid_elapsed_last_addr = 0;
-
-/* These numbers are for 4MHz Z80, 50Hz refresh, PAL */
-static unsigned vid_t_2us   =  8;
-static unsigned vid_t_8us   = 32;
-static unsigned vid_t_blank = 30769; /* (312-192)/312 scan lines */
-static unsigned vid_t_frame = 80000;
+static THREAD_LOCAL TimMode timLast = timNone;
+static THREAD_LOCAL unsigned long long vid_elapsed_refresh = 0;
+static THREAD_LOCAL unsigned long long vid_elapsed_last_data = 0;
+static THREAD_LOCAL unsigned long long vid_elapsed_last_addr = 0;
+
+/* These numbers are for 4MHz Z80, 50Hz refresh, PAL, until vid_setup_frame */
+static THREAD_LOCAL unsigned vid_t_2us   =  8;
+static THREAD_LOCAL unsigned vid_t_8us   = 32;
+static THREAD_LOCAL unsigned vid_t_blank = 30769; /* (312-192)/312 scan lines */
+static THREAD_LOCAL unsigned vid_t_frame = 80000;
+static THREAD_LOCAL BOOLEAN vid_t_given = FALSE;  /* By -vid-time-check */
 
 static char *vid_colour_names[] =
 	{
@@ -144,10 +166,10 @@ static char *vid_colour_names[] =
 
 BOOLEAN vid_dump (void);
 
-static int vid_dump_vdp_number = 0;
+static THREAD_LOCAL int vid_dump_vdp_number = 0;
 // static BOOLEAN vid_auto_dump_vdp_enabled = FALSE;
 
-static int vid_snapshot_number = 0;
+static THREAD_LOCAL int vid_snapshot_number = 0;
 // static BOOLEAN vid_auto_snapshot_enabled = FALSE; // WJB - Never used.
 /*...e*/
 
@@ -297,6 +319,22 @@ void vid_setup_timing_check(unsigned t_2us, unsigned t_8us, unsigned t_blank)
 	vid_t_2us   = t_2us;
 	vid_t_8us   = t_8us;
 	vid_t_blank = t_blank;
+	vid_t_given = TRUE;
+	}
+/*...e*/
+/*...svid_setup_frame:0:*/
+/* The length of a frame, from the Z80 clock speed and the refresh rate,
+   with 312 scan lines at 50Hz (PAL) or 262 at 60Hz (NTSC) */
+void vid_setup_frame(unsigned long long clock_speed, int refresh)
+	{
+	unsigned lines = ( refresh == 60 ) ? 262 : 312;
+	vid_t_frame = (unsigned) ( clock_speed / refresh );
+	if ( ! vid_t_given )
+		{
+		vid_t_2us   = (unsigned) ( clock_speed * 2 / 1000000 );
+		vid_t_8us   = (unsigned) ( clock_speed * 8 / 1000000 );
+		vid_t_blank = (unsigned) ( (unsigned long long) vid_t_frame * ( lines - 192 ) / lines );
+		}
 	}
 /*...e*/
 /*...svid_timing_checks:0:*/
@@ -345,7 +383,7 @@ static BOOLEAN vid_timing_checks(unsigned long long elapsed, TimMode tim)
 /*...e*/
 
 #if EXTRA_TIME_CHECK == 2
-unsigned long long io_last = 0;
+THREAD_LOCAL unsigned long long io_last = 0;
 #endif
 
 /*...svid_out1 \45\ data write:0:*/
@@ -357,6 +395,7 @@ void vid_out1(byte val, unsigned long long elapsed)
         gap < vid_t_2us ? "****" : gap < vid_t_8us ? "**" : "");
     io_last = elapsed;
 #endif
+	vid_scanline(elapsed); /* Lines before this write are drawn without it */
 	// diag_message (DIAG_ALWAYS,"Out 0x01: 0x%02X", val);
 	if ( vid_read_mode )
 		/* VDEB.COM can do this, so don't consider it fatal */
@@ -367,6 +406,7 @@ void vid_out1(byte val, unsigned long long elapsed)
 	if ( vid_timing_checks(elapsed, timWrite) )
 		{
 		vid_memory[vid_addr] = val;
+		VID_MARK_DIRTY(vid_addr)
 		if ( diag_flags[DIAG_VID_DATA] )
 			vid_data_xfer("output", vid_addr, val);
 		vid_addr = ( (vid_addr+1) & (VID_MEMORY_SIZE-1) );
@@ -377,13 +417,14 @@ void vid_out1(byte val, unsigned long long elapsed)
 /*...svid_out2 \45\ latch value\44\ then act:0:*/
 void vid_out2(byte val, unsigned long long elapsed)
 	{
-    static word vid_addr_old;
+    static THREAD_LOCAL word vid_addr_old;
 #if EXTRA_TIME_CHECK == 2
     unsigned long long gap = elapsed - io_last;
     diag_message (DIAG_VID_TIME_CHECK, "out2 (0x%02X) elapsed = %lld, gap = %lld %s", val, elapsed,  gap,
         gap < vid_t_2us ? "****" : gap < vid_t_8us ? "**" : "");
     io_last = elapsed;
 #endif
+	vid_scanline(elapsed); /* Lines before this write are drawn without it */
 	// diag_message (DIAG_ALWAYS,"Out 0x02: 0x%02X", val);
 	if ( !vid_latched )
 		/* First write to port 2, record the value */
@@ -422,6 +463,8 @@ void vid_out2(byte val, unsigned long long elapsed)
 				val &= 7;
 				if ( (vid_latch & vid_regs_zeros[val]) != 0x00 )
 					diag_message(DIAG_VID_REGISTERS, "VDP error, attempt to set VDP register %d to 0x%02x", val, vid_latch);
+				if ( vid_regs[val] != vid_latch )
+					vid_all_dirty = TRUE;
 				vid_regs[val] = vid_latch;
 				diag_message(DIAG_VID_REGISTERS, "VDP register %d set to 0x%02x", val, vid_latch);
 				break;
@@ -474,6 +517,7 @@ byte vid_in1(unsigned long long elapsed)
 byte vid_in2(unsigned long long elapsed)
 	{
 	// diag_message (DIAG_ALWAYS,"In  0x02");
+	vid_scanline(elapsed); /* With the status of the lines sent so far */
 	byte value = vid_status;
 	diag_message(DIAG_VID_STATUS, "VDP status register read 0x%02x", value);
 	vid_status = 0; /* Clear F, C, 5S, FSN, for subsequent reads */
@@ -486,425 +530,299 @@ byte vid_in2(unsigned long long elapsed)
 	}
 /*...e*/
 
-/*...svid_refresh_win_blank:0:*/
-static void vid_refresh_win_blank(void)
+/*...svid_refresh_win_smooth:0:*/
+/* This is a diagnostic simply to allow me to see on
+   the screen how smoothly simulated time is progressing. */
+
+static THREAD_LOCAL int vid_ymarker = 0;
+
+static void vid_refresh_win_smooth(int hborder)
 	{
-	memset(vid_win->data, (vid_regs[7]&0x0f), WIDTH*HEIGHT);
+	if ( diag_flags[DIAG_VID_MARKERS] )
+		{
+		memset(vid_win->data + WIDTH*(VBORDER+vid_ymarker)+hborder, 0x0f, 3);
+		if ( ++vid_ymarker == 192 ) vid_ymarker = 0;
+		}
 	}
 /*...e*/
-/*...svid_refresh_win_sprites:0:*/
-/*...svid_refresh_win_sprites_line_check:0:*/
-static BOOLEAN vid_refresh_win_sprites_line_check(int scn_y, int sprite)
+/*...svid_refresh_win_multicolour:0:*/
+static void vid_refresh_win_multicolour(void)
 	{
-	if ( scn_y < 0 || scn_y >= 192 )
-		return FALSE;
-	if ( ++vid_spr_lines[scn_y] <= 4 )
-		return TRUE;
-	else
-		{
-		if ( (vid_status & 0x40) == 0 )
-			vid_status |= (0x40|sprite); /* 5S and FSN */
-		if ( diag_flags[DIAG_VID_MARKERS] )
-			memset(vid_win->data+(VBORDER+scn_y)*WIDTH+HBORDER256+3, 0x0d, 3); /* 5S MARKER */
-		return FALSE;
-		}
+	fatal("VDP multicolour mode not yet implemented");
 	}
 /*...e*/
-/*...svid_refresh_win_sprites_plot:0:*/
-static void vid_refresh_win_sprites_plot(int scn_x, int scn_y, int spr_col)
+/*...svid_sprites_dirty:0:*/
+/* Whether the sprite attributes or patterns have changed */
+static BOOLEAN vid_sprites_dirty(void)
 	{
-	if ( scn_x >= 0 && scn_x < 256 )
-		{
-		if ( vid_spr_coincidence[scn_y][scn_x] )
-			/* Already a dot from a higher priority sprite at this point */
-			vid_status |= 0x20; /* C */
-		else
-			{
-			if ( spr_col != 0 )
-				vid_win->data[(VBORDER+scn_y)*WIDTH+(HBORDER256+scn_x)] = spr_col;
-			vid_spr_coincidence[scn_y][scn_x] = TRUE;
-			}
-		}
+	word sprgen = ((word)(vid_regs[6]&0x07)<<11);
+	word spratt = ((word)(vid_regs[5]&0x7f)<<7);
+	int i;
+	for ( i = 0; i < 32*4; i += 8 )
+		if ( VID_DIRTY8(spratt+i) )
+			return TRUE;
+	for ( i = 0; i < 256*8; i += 8 )
+		if ( VID_DIRTY8(sprgen+i) )
+			return TRUE;
+	return FALSE;
 	}
 /*...e*/
-
-static void vid_refresh_win_sprites(void)
+/*...svid_sprite_cells:0:*/
+/* Mark the cells which the box of each sprite is over.
+   This errs on the side of marking too many, as a sprite may be
+   transparent, or not drawn on some lines, being the 5th on them. */
+static void vid_sprite_cells(byte cells[VDP_ROWS][VDP_COLS])
 	{
 	byte size = ( (vid_regs[1]&0x02) != 0 );
 	byte mag  = ( (vid_regs[1]&0x01) != 0 );
-	word sprgen = ((word)(vid_regs[6]&0x07)<<11);
 	word spratt = ((word)(vid_regs[5]&0x7f)<<7);
-	int sprite, x, y, scn_x;
-	byte spr_pat_mask = size ? 0xfc : 0xff;
-	for ( sprite = 0; sprite < 32; sprite++ )
+	int n = ( size ? 16 : 8 ) << mag;
+	int sprite, x, y;
+	memset(cells, FALSE, VDP_ROWS*VDP_COLS);
+	for ( sprite = 0; sprite < 32; sprite++, spratt += 4 )
 		{
-		int spr_y     = (int) (unsigned) vid_memory[spratt++]; /* 0-255, partially signed */
-		int spr_x     = (int) (unsigned) vid_memory[spratt++]; /* 0-255 */
-		byte spr_pat  = vid_memory[spratt++] & spr_pat_mask;
-		word spr_addr = sprgen+((word)spr_pat<<3);
-		byte spr_flag = vid_memory[spratt++];
-		byte spr_col  = (spr_flag & 0x0f);
+		int spr_y = (int) (unsigned) vid_memory[spratt  ];
+		int spr_x = (int) (unsigned) vid_memory[spratt+1];
+		int y0, y1, x0, x1;
 		if ( spr_y == 0xd0 )
 			break;
 		if ( spr_y <= 192 )
 			++spr_y;
 		else
 			spr_y -= 255;
-		if ( spr_flag & 0x80 )
+		if ( vid_memory[spratt+3] & 0x80 )
 			spr_x -= 32;
-		if ( size )
-			for ( y = 0; y < 16; y++ )
-				{
-				word bits = ((word)vid_memory[spr_addr]<<8)|((word)vid_memory[spr_addr+16]);
-				spr_addr++;
-				if ( mag )
-/*...sMAG\61\1\44\ SIZE\61\1:40:*/
-{
-int scn_y = spr_y+y*2;
-if ( vid_refresh_win_sprites_line_check(scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 16; x++, scn_x+=2 )
-		if ( bits & (0x8000>>x) )
-			{
-			vid_refresh_win_sprites_plot(scn_x  , scn_y, spr_col);
-			vid_refresh_win_sprites_plot(scn_x+1, scn_y, spr_col);
-			}
-++scn_y;
-if ( vid_refresh_win_sprites_line_check(scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 16; x++, scn_x+=2 )
-		if ( bits & (0x8000>>x) )
-			{
-			vid_refresh_win_sprites_plot(scn_x  , scn_y, spr_col);
-			vid_refresh_win_sprites_plot(scn_x+1, scn_y, spr_col);
-			}
-}
-/*...e*/
-				else
-/*...sMAG\61\0\44\ SIZE\61\1:40:*/
-{
-int scn_y = spr_y+y;
-if ( vid_refresh_win_sprites_line_check(scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 16; x++, scn_x++ )
-		if ( bits & (0x8000>>x) )
-			vid_refresh_win_sprites_plot(scn_x, scn_y, spr_col);
-}
+		y0 = ( spr_y < 0 ) ? 0 : spr_y;
+		y1 = ( spr_y+n > 192 ) ? 192 : spr_y+n;
+		x0 = ( spr_x < 0 ) ? 0 : spr_x;
+		x1 = ( spr_x+n > 256 ) ? 256 : spr_x+n;
+		for ( y = y0>>3; y < (y1+7)>>3; y++ )
+			for ( x = x0>>3; x < (x1+7)>>3; x++ )
+				cells[y][x] = TRUE;
+		}
+	}
 /*...e*/
-				}
-		else
-			for ( y = 0; y < 8; y++ )
-				{
-				byte bits = vid_memory[spr_addr++];
-				if ( mag )
-/*...sMAG\61\1\44\ SIZE\61\0:40:*/
-{
-int scn_y = spr_y+y*2;
-if ( vid_refresh_win_sprites_line_check(scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 8; x++, scn_x+=2 )
-		if ( bits & (0x80>>x) )
-			{
-			vid_refresh_win_sprites_plot(scn_x  , scn_y, spr_col);
-			vid_refresh_win_sprites_plot(scn_x+1, scn_y, spr_col);
-			}
-++scn_y;
-if ( vid_refresh_win_sprites_line_check(scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 8; x++, scn_x+=2 )
-		if ( bits & (0x80>>x) )
+/*...svid_refresh_win_cells:0:*/
+/* Tell the window which cells have been drawn, as a rectangle for each
+   run of rows in which the same span of cells was drawn */
+static void vid_refresh_win_cells(int n_cols, int cell_width, int hborder)
+	{
+	int row, row0 = 0, x0 = -1, x1 = -1;
+	for ( row = 0; row <= VDP_ROWS; row++ )
+		{
+		int l = -1, r = -1, x;
+		if ( row < VDP_ROWS )
+			for ( x = 0; x < n_cols; x++ )
+				if ( vid_cell_dirty[row][x] )
+					{
+					if ( l < 0 ) l = x;
+					r = x;
+					}
+		if ( l != x0 || r != x1 )
 			{
-			vid_refresh_win_sprites_plot(scn_x  , scn_y, spr_col);
-			vid_refresh_win_sprites_plot(scn_x+1, scn_y, spr_col);
+			if ( x0 >= 0 )
+				win_refresh_rect(vid_win,
+					hborder+x0*cell_width, VBORDER+row0*8,
+					(x1-x0+1)*cell_width, (row-row0)*8);
+			row0 = row;
+			x0 = l;
+			x1 = r;
 			}
-}
-/*...e*/
-				else
-/*...sMAG\61\0\44\ SIZE\61\0:40:*/
-{
-int scn_y = spr_y+y;
-if ( vid_refresh_win_sprites_line_check(scn_y, sprite) )
-	for ( x = 0, scn_x = spr_x; x < 8; x++, scn_x++ )
-		if ( bits & (0x80>>x) )
-			vid_refresh_win_sprites_plot(scn_x, scn_y, spr_col);
-}
-/*...e*/
-				}
 		}
-
-	/* Wipe out the coincidence buffer for next time.
-	   We can do it quickly now, as we know which lines
-	   we have written to */
-	for ( y = 0; y < 192; y++ )
-		if ( vid_spr_lines[y] > 0 )
-			{
-			vid_spr_lines[y] = 0;
-			memset(vid_spr_coincidence[y], FALSE, 256);
-			}
 	}
 /*...e*/
-/*...svid_refresh_win_smooth:0:*/
-/* This is a diagnostic simply to allow me to see on
-   the screen how smoothly simulated time is progressing. */
-
-static int vid_ymarker = 0;
-
-static void vid_refresh_win_smooth(int hborder)
+/*...svid_render_setup:0:*/
+static void vid_render_setup(VDP_RENDER *r)
 	{
-	if ( diag_flags[DIAG_VID_MARKERS] )
-		{
-		memset(vid_win->data + WIDTH*(VBORDER+vid_ymarker)+hborder, 0x0f, 3);
-		if ( ++vid_ymarker == 192 ) vid_ymarker = 0;
-		}
+	r->ram     = vid_memory;
+	r->regs    = vid_regs;
+	r->pix     = vid_win->data;
+	r->stride  = WIDTH;
+	r->scale   = 1;
+	r->cols    = vid_pix_cols;
+	r->cells   = vid_cell_dirty;
+	r->dirty   = vid_dirty;
+	r->markers = diag_flags[DIAG_VID_MARKERS];
 	}
 /*...e*/
-/*...svid_refresh_win_graphics1:0:*/
-static void vid_refresh_win_graphics1_pat(
-	byte pat,
-	word patgen,
-	word patcol,
-	byte *d
-	)
+/*...svid_refresh_win:0:*/
+/* Only the cells which have changed since last time are drawn, and the
+   sprites if they have changed or are over any of those cells. If
+   nothing has changed, the picture and the sprite status are as before. */
+static void vid_refresh_win(void)
 	{
-	word genptr = patgen + pat*8;
-	word colptr = patcol + pat/8;
-	byte col = vid_memory[colptr];
-	byte fg = (col>>4);
-	byte bg = (col&15);
-	int x, y;
-	if ( fg == 0 ) fg = (vid_regs[7]&0x0f);
-	if ( bg == 0 ) bg = (vid_regs[7]&0x0f);
-	for ( y = 0; y < 8; y++ )
+	int mode = vdp_mode(vid_regs);
+	BOOLEAN all, sprites;
+	VDP_RENDER r;
+	vid_render_setup(&r);
+        // diag_message(DIAG_VID_REFRESH, "VDP mode %d", mode);
+	all = ( vid_all_dirty ||
+		mode != vid_last_mode ||
+		vid_win->data[0] != (vid_regs[7]&0x0f) ||
+		diag_flags[DIAG_VID_MARKERS] );
+	if ( all )
 		{
-		byte gen = vid_memory[genptr++];
-		for ( x = 0; x < 8; x++ )
-			*d++ = ( gen & (0x80>>x) ) ? fg : bg;
-		d += ( -8 + WIDTH ); 
+		/* Ensure the border is redrawn */
+		vdp_render_blank(&r);
+		memset(vid_cell_dirty, TRUE, sizeof(vid_cell_dirty));
+		sprites = TRUE;
 		}
-	}
-
-static void vid_refresh_win_graphics1_third(
-	word patnam,
-	word patgen,
-	word patcol,
-	byte *d
-	)
-	{
-	int x, y;
-	for ( y = 0; y < 8; y++ )
+	else if ( ! vid_any_dirty )
 		{
-		for ( x = 0; x < 32; x++ )
-			{
-			byte pat = vid_memory[patnam++];
-			vid_refresh_win_graphics1_pat(pat, patgen, patcol, d);
-			d += 8;
-			}
-		d += ( -32*8 + WIDTH*8 );
+		vid_status |= vid_spr_status;
+		return;
 		}
-	}
-
-static void vid_refresh_win_graphics1(void)
-	{
-	word patnam = ( ((word)(vid_regs[2]&0x0f)) << 10 );
-	word patgen = ( ((word)(vid_regs[4]&0x07)) << 11 );
-	word patcol = ( ((word)(vid_regs[3]&0xff)) <<  6 );
-	byte *d = vid_win->data + WIDTH*VBORDER + HBORDER256;
-
-	vid_refresh_win_graphics1_third(patnam       , patgen, patcol, d           );
-	vid_refresh_win_graphics1_third(patnam+0x0100, patgen, patcol, d+WIDTH* 8*8);
-	vid_refresh_win_graphics1_third(patnam+0x0200, patgen, patcol, d+WIDTH*16*8);
-
-	vid_refresh_win_sprites();
-
-	vid_refresh_win_smooth(HBORDER256);
-	}
-/*...e*/
-/*...svid_refresh_win_graphics2:0:*/
-static void vid_refresh_win_graphics2_pat(
-	byte pat,
-	word patgen,
-	word patcol,
-	byte *d
-	)
-	{
-	word genptr = patgen + pat*8;
-	word colptr = patcol + pat*8;
-	int x, y;
-	for ( y = 0; y < 8; y++ )
+	else
 		{
-		byte gen = vid_memory[genptr++];
-		byte col = vid_memory[colptr++];
-		byte fg = (col>>4);
-		byte bg = (col&15);
-		if ( fg == 0 ) fg = (vid_regs[7]&0x0f);
-		if ( bg == 0 ) bg = (vid_regs[7]&0x0f);
-		for ( x = 0; x < 8; x++ )
-			*d++ = ( gen & (0x80>>x) ) ? fg : bg;
-		d += ( -8 + WIDTH ); 
+		/* Where the sprites were, if they have changed */
+		sprites = ( mode == VDP_MODE(0,0,0) || mode == VDP_MODE(0,0,1) ) && vid_sprites_dirty();
+		if ( sprites )
+			memcpy(vid_cell_dirty, vid_spr_cells, sizeof(vid_cell_dirty));
+		else
+			memset(vid_cell_dirty, FALSE, sizeof(vid_cell_dirty));
 		}
-	}
-
-static void vid_refresh_win_graphics2_third(
-	word patnam,
-	word patgen,
-	word patcol,
-	byte *d
-	)
-	{
-	int x, y;
-	for ( y = 0; y < 8; y++ )
+	switch ( mode )
+		{
+		case -1:
+			break;
+		case VDP_MODE(0,0,0):
+			vdp_render_graphics1(&r);
+			break;
+		case VDP_MODE(0,0,1):
+			/* There are other bits in register 3 which should be set. */
+			if ( (vid_regs[3]&0x1f) != 0x1f )
+				diag_message(DIAG_VID_REGISTERS, "VDP error, register 3 is 0x%02x and bottom 5 bits should be 1s", vid_regs[3]);
+			vdp_render_graphics2(&r);
+			break;
+		case VDP_MODE(0,1,0):
+			vid_refresh_win_multicolour();
+			break;
+		case VDP_MODE(1,0,0):
+			vdp_render_text(&r);
+			vid_refresh_win_smooth(HBORDER240);
+			break;
+		default:
+			/* I don't bomb at this point,
+			   although this is an invalid mode,
+			   as we may be half way through updating the
+			   VDP registers when we are called here */
+			break;
+		}
+	if ( mode == VDP_MODE(0,0,0) || mode == VDP_MODE(0,0,1) )
 		{
-		for ( x = 0; x < 32; x++ )
+		if ( ! sprites )
+			{
+			/* Any of the cells drawn may have had sprites over them */
+			int row, x;
+			for ( row = 0; row < VDP_ROWS && ! sprites; row++ )
+				for ( x = 0; x < 32; x++ )
+					if ( vid_cell_dirty[row][x] && vid_spr_cells[row][x] )
+						{
+						sprites = TRUE;
+						break;
+						}
+			}
+		if ( sprites )
 			{
-			byte pat = vid_memory[patnam++];
-			vid_refresh_win_graphics2_pat(pat, patgen, patcol, d);
-			d += 8;
+			int row, x;
+			vid_spr_status = vdp_render_sprites(&r);
+			vid_status |= vid_spr_status;
+			/* Redrawing the sprites where they haven't changed leaves the
+			   picture as it was, so only where they are new has changed */
+			vid_sprite_cells(vid_spr_cells);
+			for ( row = 0; row < VDP_ROWS; row++ )
+				for ( x = 0; x < 32; x++ )
+					vid_cell_dirty[row][x] |= vid_spr_cells[row][x];
 			}
-		d += ( -32*8 + WIDTH*8 );
+		else
+			vid_status |= vid_spr_status;
+		vid_refresh_win_smooth(HBORDER256);
+		}
+	else
+		{
+		vid_spr_status = 0x00;
+		memset(vid_spr_cells, FALSE, sizeof(vid_spr_cells));
 		}
+	if ( vid_any_dirty )
+		{
+		memset(vid_dirty, 0, sizeof(vid_dirty));
+		vid_any_dirty = FALSE;
+		}
+	vid_all_dirty = FALSE;
+	vid_last_mode = mode;
+	if ( all )
+		win_refresh(vid_win);
+	else if ( mode == VDP_MODE(1,0,0) )
+		vid_refresh_win_cells(40, 6, HBORDER240);
+	else
+		vid_refresh_win_cells(32, 8, HBORDER256);
 	}
 
-/* According to spec, bits 1 and 0 of register 4 (patgen) should be set.
-   According to spec, bits 6 and 5 of register 3 (patcol) should be set.
-   Experimentally, we discovered undocumented features:
-   If bit 0 of register 4 is clear, 2nd third uses patgen from 1st third.
-   If bit 1 of register 4 is clear, 3rd third uses patgen from 1st third.
-   If bit 5 of register 3 is clear, 2nd third uses patcol from 1st third.
-   If bit 6 of register 3 is clear, 3rd third uses patcol from 1st third.
-   Maybe this is an attempt at saving VRAM.
-   Anyway, we support it in our emulation. */
-
-static void vid_refresh_win_graphics2(void)
-	{
-	word patnam  = ( ((word)(vid_regs[2]&0x0f)) << 10 );
-	word patgen1 = ( ((word)(vid_regs[4]&0x04)) << 11 );
-	word patcol1 = ( ((word)(vid_regs[3]&0x80)) <<  6 );
-	word patgen2 = (vid_regs[4]&0x01) ? patgen1+0x0800 : patgen1;
-	word patcol2 = (vid_regs[3]&0x20) ? patcol1+0x0800 : patcol1;
-	word patgen3 = (vid_regs[4]&0x02) ? patgen1+0x1000 : patgen1;
-	word patcol3 = (vid_regs[3]&0x40) ? patcol1+0x1000 : patcol1;
-	byte *d = vid_win->data + WIDTH*VBORDER + HBORDER256;
-
-	/* There are other bits in register 3 which should be set. */
-	if ( (vid_regs[3]&0x1f) != 0x1f )
-		diag_message(DIAG_VID_REGISTERS, "VDP error, register 3 is 0x%02x and bottom 5 bits should be 1s", vid_regs[3]);
-
-	vid_refresh_win_graphics2_third(patnam        , patgen1, patcol1, d           );
-	vid_refresh_win_graphics2_third(patnam+0x0100 , patgen2, patcol2, d+WIDTH* 8*8);
-	vid_refresh_win_graphics2_third(patnam+0x0200 , patgen3, patcol3, d+WIDTH*16*8);
-
-	vid_refresh_win_sprites();
-
-	vid_refresh_win_smooth(HBORDER256);
-	}
-/*...e*/
-/*...svid_refresh_win_multicolour:0:*/
-static void vid_refresh_win_multicolour(void)
-	{
-	fatal("VDP multicolour mode not yet implemented");
-	}
 /*...e*/
-/*...svid_refresh_win_text:0:*/
-static void vid_refresh_win_text_pat(
-	byte pat,
-	word patgen,
-	byte *d
-	)
+/*...svid_scanline:0:*/
+/* Draw the lines of the picture up to (but not including) line to,
+   giving them to the window a band at a time */
+static void vid_scanline_draw(int to)
 	{
-	word genptr = patgen + pat*8;
-	byte col = vid_regs[7];
-	byte fg = (col>>4);
-	byte bg = (col&15);
-	int x, y;
-	for ( y = 0; y < 8; y++ )
+	VDP_RENDER r;
+	vid_render_setup(&r);
+	r.cells = NULL;
+	for ( ; vid_line < to; vid_line++ )
 		{
-		byte gen = vid_memory[genptr++];
-		for ( x = 0; x < 6; x++ )
-			*d++ = ( gen & (0x80>>x) ) ? fg : bg;
-		d += ( -6 + WIDTH ); 
+		byte status;
+		if ( vdp_mode(vid_regs) == VDP_MODE(0,1,0) )
+			vid_refresh_win_multicolour();
+		status = vdp_render_line(&r, vid_line);
+		vid_status |= ( status & 0x20 ); /* C */
+		if ( (vid_status & 0x40) == 0 )
+			vid_status |= ( status & 0x5f ); /* 5S and FSN of the first */
 		}
-	}
-
-static void vid_refresh_win_text_third(
-	word patnam,
-	word patgen,
-	byte *d
-	)
-	{
-	int x, y;
-	for ( y = 0; y < 8; y++ )
+	if ( vid_line - vid_line_shown >= 16 ||
+	     ( vid_line == HEIGHT && vid_line > vid_line_shown ) )
 		{
-		for ( x = 0; x < 40; x++ )
-			{
-			byte pat = vid_memory[patnam++];
-			vid_refresh_win_text_pat(pat, patgen, d);
-			d += 6;
-			}
-		d += ( -40*6 + WIDTH*8 );
+		win_refresh_rect(vid_win, 0, vid_line_shown, WIDTH, vid_line-vid_line_shown);
+		vid_line_shown = vid_line;
 		}
 	}
 
-static void vid_refresh_win_text(void)
+/* Called as the Z80 runs, to draw each line as it is sent to the TV.
+   The frame starts with the interrupt from the last one, and the active
+   display starts vid_t_blank later, with the lines of the border above
+   it before that. */
+void vid_scanline(unsigned long long elapsed)
 	{
-	word patnam = ( ((word)(vid_regs[2]&0x0f)) << 10 );
-	word patgen = ( ((word)(vid_regs[4]&0x07)) << 11 );
-	byte *d = vid_win->data + WIDTH*VBORDER + HBORDER240;
-
-	vid_refresh_win_text_third(patnam      , patgen, d           );
-	vid_refresh_win_text_third(patnam+ 8*40, patgen, d+WIDTH* 8*8);
-	vid_refresh_win_text_third(patnam+16*40, patgen, d+WIDTH*16*8);
-
-	vid_refresh_win_smooth(HBORDER240);
+	unsigned t_line = ( vid_t_frame > vid_t_blank + 192 ) ? ( vid_t_frame - vid_t_blank ) / 192 : 1;
+	unsigned long long origin = vid_elapsed_frame + vid_t_blank - VBORDER*t_line;
+	unsigned long long lines;
+	if ( (vid_emu & VIDEMU_WIN_SCANLINE) == 0 || elapsed < origin + t_line )
+		return;
+	lines = ( elapsed - origin ) / t_line;
+	vid_scanline_draw( lines < HEIGHT ? (int) lines : HEIGHT );
 	}
-/*...e*/
-/*...svid_refresh_win:0:*/
-#define	MODE(m1,m2,m3) ( ((m1)<<2) | ((m2)<<1) | (m3) )
 
-static void vid_refresh_win(void)
+/* At the end of the frame, finish it off, and start the next one */
+static void vid_scanline_frame(unsigned long long elapsed)
 	{
-	if ( (vid_regs[1]&0x40) == 0 )
-		vid_refresh_win_blank();
-	else
-		{
-		BOOLEAN m1 = ( (vid_regs[1]&0x10) != 0 );
-		BOOLEAN m2 = ( (vid_regs[1]&0x08) != 0 );
-		BOOLEAN m3 = ( (vid_regs[0]&0x02) != 0 );
-		int mode = MODE(m1,m2,m3);
-        // diag_message(DIAG_VID_REFRESH, "VDP mode %d", mode);
-		if ( vid_win->data[0] != (vid_regs[7]&0x0f) ||
-		     mode != vid_last_mode )
-			/* Ensure the border is redrawn.
-			   Perhaps could do this more efficiently.
-			   But it isn't going to happen very often. */
-			vid_refresh_win_blank();
-		switch ( mode )
-			{
-			case MODE(0,0,0):
-				vid_refresh_win_graphics1();
-				break;
-			case MODE(0,0,1):
-				vid_refresh_win_graphics2();
-				break;
-			case MODE(0,1,0):
-				vid_refresh_win_multicolour();
-				break;
-			case MODE(1,0,0):
-				vid_refresh_win_text();
-				break;
-			default:
-				/* I don't bomb at this point,
-				   although this is an invalid mode,
-				   as we may be half way through updating the
-				   VDP registers when we are called here */
-				vid_refresh_win_blank();
-				break;
-			}
-		vid_last_mode = mode;
-		}
-	win_refresh(vid_win);
+	vid_scanline_draw(HEIGHT);
+	vid_elapsed_frame = elapsed;
+	vid_line = 0;
+	vid_line_shown = 0;
 	}
+/*...e*/
 
 void vid_refresh_vdeb(void)
 	{
-	if ( vid_emu & VIDEMU_WIN )	vid_refresh_win();
+	if ( vid_emu & VIDEMU_WIN_SCANLINE )
+		{
+		/* Show the whole picture, as the registers and VRAM are now */
+		vid_line = 0;
+		vid_line_shown = 0;
+		vid_scanline_draw(HEIGHT);
+		}
+	else if ( vid_emu & VIDEMU_WIN )
+		vid_refresh_win();
     }
 
-/*...e*/
 /*...svid_refresh:0:*/
 /* This should happen once every 50th/60th of a second.
    Its as if the picture appears at the end of the "vertical active display".
@@ -914,10 +832,17 @@ void vid_refresh_vdeb(void)
 void vid_refresh(unsigned long long elapsed)
 	{
 	diag_message(DIAG_VID_REFRESH, "VDP refresh (elapsed=%lluT)", elapsed);
-	vid_status = 0x00;
+	if ( vid_emu & VIDEMU_WIN_SCANLINE )
+		/* The status has been built up as the lines were drawn */
+		vid_scanline_frame(elapsed);
+	else
+		{
+		vid_status = 0x00;
+		if ( vid_emu & VIDEMU_WIN )
+			vid_refresh_win();
+		}
 	if ( vid_emu & VIDEMU_WIN )
 		{
-		vid_refresh_win();
 		/* Now lets VRAM to a file, if required */
 		if ( diag_flags[DIAG_ACT_VID_DUMP_VDP] )
 			{
@@ -992,7 +917,9 @@ byte vid_vram_read(word addr)
 /*...svid_vram_write:0:*/
 void vid_vram_write(word addr, byte b)
 	{
-	vid_memory[addr%VID_MEMORY_SIZE] = b;
+	addr %= VID_MEMORY_SIZE;
+	vid_memory[addr] = b;
+	VID_MARK_DIRTY(addr)
 	}
 /*...e*/
 /*...svid_reg_read:0:*/
@@ -1005,6 +932,7 @@ byte vid_reg_read(int reg)
 void vid_reg_write(int reg, byte b)
 	{
 	vid_regs[reg] = b;
+	vid_all_dirty = TRUE;
 	}
 /*...e*/
 /*...svid_status_read:0:*/
@@ -1014,6 +942,46 @@ byte vid_status_read(void)
 	}
 /*...e*/
 
+#ifndef SMALL_MEM
+/*...svid_save_state:0:*/
+/* The VDP part of a save-state (see state.c) */
+void vid_save_state(STATE *st)
+	{
+	state_put_block(st, vid_regs, sizeof(vid_regs));
+	state_put_byte(st, vid_status);
+	state_put_block(st, vid_memory, VID_MEMORY_SIZE);
+	state_put_word(st, vid_addr);
+	state_put_byte(st, (byte) vid_read_mode);
+	state_put_byte(st, (byte) vid_latched);
+	state_put_byte(st, vid_latch);
+	state_put_quad(st, vid_elapsed_refresh);
+	state_put_quad(st, vid_elapsed_last_data);
+	state_put_quad(st, vid_elapsed_last_addr);
+	}
+/*...e*/
+/*...svid_load_state:0:*/
+void vid_load_state(STATE *st, int version)
+	{
+	state_get_block(st, vid_regs, sizeof(vid_regs));
+	vid_status = state_get_byte(st);
+	state_get_block(st, vid_memory, VID_MEMORY_SIZE);
+	vid_addr = state_get_word(st) % VID_MEMORY_SIZE;
+	vid_read_mode = state_get_byte(st);
+	vid_latched = state_get_byte(st);
+	vid_latch = state_get_byte(st);
+	vid_elapsed_refresh   = state_get_quad(st);
+	vid_elapsed_last_data = state_get_quad(st);
+	vid_elapsed_last_addr = state_get_quad(st);
+	vid_last_mode = -1; /* Redraw all of the screen */
+	vid_all_dirty = TRUE;
+	/* The frame being drawn by -vid-scanline started at the last refresh */
+	vid_elapsed_frame = vid_elapsed_refresh;
+	vid_line = 0;
+	vid_line_shown = 0;
+	}
+/*...e*/
+#endif
+
 /*...svid_init:0:*/
 
 void vid_init(int emu, int width_scale, int height_scale)
@@ -1026,9 +994,6 @@ void vid_init(int emu, int width_scale, int height_scale)
 	vid_read_mode = FALSE;
 	vid_last_mode = -1; /* None of the valid modes */
 
-	memset(vid_spr_lines, FALSE, sizeof(vid_spr_lines));
-	memset(vid_spr_coincidence, FALSE, sizeof(vid_spr_coincidence));
-
 	if ( vid_emu & VIDEMU_WIN )
 		{
 		vid_cols = ( emu & VIDEMU_WIN_HW_PALETTE )
@@ -15,18 +15,21 @@ vid.h - Video chip and TV
 
 #define	VIDEMU_WIN              0x01
 #define	VIDEMU_WIN_HW_PALETTE   0x02
+#define	VIDEMU_WIN_SCANLINE     0x04
 #define VIDEMU_WIN_MAX          0x80
 #define	VID_MEMORY_SIZE         0x4000
 
 extern void vid_reset(void);
 
 extern void vid_setup_timing_check(unsigned t_2us, unsigned t_8us, unsigned t_blank);
+extern void vid_setup_frame(unsigned long long clock_speed, int refresh);
 
 extern void vid_out1(byte val, unsigned long long elapsed);
 extern void vid_out2(byte val, unsigned long long elapsed);
 extern byte vid_in1(unsigned long long elapsed);
 extern byte vid_in2(unsigned long long elapsed);
 
+extern void vid_scanline(unsigned long long elapsed);
 extern void vid_refresh(unsigned long long elapsed);
 extern void vid_refresh_vdeb(void);
 
@@ -51,4 +54,10 @@ extern const char * vid_get_display (void);
 
 extern void vid_show (void);
 
+#ifndef SMALL_MEM
+#include "state.h"
+extern void vid_save_state(STATE *st);
+extern void vid_load_state(STATE *st, int version);
+#endif
+
 #endif
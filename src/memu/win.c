@@ -4,9 +4,9 @@
 #include "common.h"
 #include "diag.h"
 
-int n_wins = 0; 
-WIN *wins[MAX_WINS];
-WIN *active_win = NULL;
+THREAD_LOCAL int n_wins = 0; 
+THREAD_LOCAL WIN *wins[MAX_WINS];
+THREAD_LOCAL WIN *active_win = NULL;
 
 WIN *win_alloc (size_t win_size, size_t data_size)
     {
@@ -89,6 +89,7 @@ extern WIN *win_create(
 extern void win_delete (WIN *win);
 extern void win_colour (WIN *win, int idx, COL *clr);
 extern void win_refresh (WIN *win);
+extern void win_refresh_rect (WIN *win, int x, int y, int w, int h);
 extern int win_shifted_wk (int wk);
 extern void win_show (WIN *win);
 extern BOOLEAN win_active (WIN *win);
@@ -117,12 +118,13 @@ void twin_keypress (WIN *win, int wk);
 void twin_keyrelease (WIN *win, int wk);
 BOOLEAN twin_kbd_stat (WIN *win);
 int twin_kbd_test (WIN *win);
+int twin_kbd_take (WIN *win);
 int twin_kbd_in (WIN *win);
 int twin_edit (WIN *win, int iRow, int iCol, int nWth, int iSty, int nLen, char *psText, PVALID vld);
 
-extern int n_wins;
-extern WIN *wins[MAX_WINS];
-extern WIN *active_win;
+extern THREAD_LOCAL int n_wins;
+extern THREAD_LOCAL WIN *wins[MAX_WINS];
+extern THREAD_LOCAL WIN *active_win;
 
 #ifdef __cplusplus
 }
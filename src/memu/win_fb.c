@@ -344,6 +344,12 @@ void win_refresh(WIN *win_pub)
 //   diag_message (DIAG_WIN_HW, "Refresh complete");
 	}
 
+/* Only part has changed, but the whole window is redrawn */
+void win_refresh_rect (WIN *win, int x, int y, int w, int h)
+	{
+	win_refresh (win);
+	}
+
 void win_show (WIN *win_pub)
 	{
 	if ( active_win != win_pub )
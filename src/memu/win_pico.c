@@ -155,6 +155,10 @@ void win_refresh (WIN *win)
     {
     }
 
+void win_refresh_rect (WIN *win, int x, int y, int w, int h)
+    {
+    }
+
 void win_term (void)
     {
     }
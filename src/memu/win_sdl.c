@@ -164,6 +164,12 @@ void win_refresh (WIN *win_pub)
     SDL_UpdateWindowSurface (win->sdl_win);
     }
 
+/* Only part has changed, but the whole window is redrawn */
+void win_refresh_rect (WIN *win, int x, int y, int w, int h)
+    {
+    win_refresh (win);
+    }
+
 typedef struct s_kbd_map
     {
     int         keycode;
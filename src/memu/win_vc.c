@@ -382,6 +382,12 @@ void win_refresh (WIN *win_pub)
 //   diag_message (DIAG_WIN_HW, "Refresh complete");
 	}
 
+/* Only part has changed, but the whole window is redrawn */
+void win_refresh_rect (WIN *win, int x, int y, int w, int h)
+	{
+	win_refresh (win);
+	}
+
 void win_show (WIN *win_pub)
 	{
     WIN_PRIV *win = (WIN_PRIV *) win_pub;
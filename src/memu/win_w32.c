@@ -799,6 +799,12 @@ void win_refresh(WIN *win_pub)
     else
         ReleaseMutex(win->hmutex);
     }
+
+/* Only part has changed, but the whole window is redrawn */
+void win_refresh_rect (WIN *win, int x, int y, int w, int h)
+    {
+    win_refresh (win);
+    }
 /*...e*/
 
 void kbd_chk_leds (int *mods)
@@ -62,6 +62,9 @@ typedef struct
 	COL cols[N_COLS_MAX];
 	int n_pixs;
 	byte pix[N_COLS_MAX];
+	int bypp;
+	unsigned int xpix1[N_COLS_MAX];		/* Each colour as one XImage pixel */
+	unsigned long long xpix2[N_COLS_MAX];	/* And as two, side by side */
 	XImage *ximage;
     const char *title;
 	} WIN_PRIV;
@@ -103,8 +106,8 @@ static void dpy_delete(DPY *dpy)
 /*...e*/
 
 #define	MAX_DPYS 10
-static int n_dpys = 0;
-static DPY *dpys[MAX_DPYS];
+static THREAD_LOCAL int n_dpys = 0;
+static THREAD_LOCAL DPY *dpys[MAX_DPYS];
 
 /*...sdpy_connect:0:*/
 static DPY *dpy_connect(const char *display)
@@ -154,6 +157,34 @@ void win_max_size (const char *display, int *pWth, int *pHgt)
     dpy_disconnect (dpy);
     }
 
+/*...swin_set_xpix:0:*/
+/* Work out the XImage bytes for colour idx, once, rather than for every
+   pixel of every refresh. They are held in the order they go in the
+   XImage (LSBFirst), so they can be copied straight in. */
+static void win_set_xpix(WIN_PRIV *win, int idx)
+	{
+	const COL *c = &win->cols[idx];
+	byte b[8];
+	switch ( win->dpy->v->red_mask )
+		{
+		case 0xff0000:
+			b[0] = c->b; b[1] = c->g; b[2] = c->r; b[3] = 0;
+			break;
+		case 0x0000ff:
+			b[0] = c->r; b[1] = c->g; b[2] = c->b; b[3] = 0;
+			break;
+		case 0x00f800:
+			b[0] = ((c->g&0x1c)<<3) | (c->b>>3);
+			b[1] = (c->r&0xf8) | (c->g>>5);
+			b[2] = b[0];
+			b[3] = b[1];
+			break;
+		}
+	memcpy(b+4, b, 4);
+	memcpy(&win->xpix1[idx], b, sizeof(win->xpix1[idx]));
+	memcpy(&win->xpix2[idx], b, sizeof(win->xpix2[idx]));
+	}
+/*...e*/
 /*...swin_create:0:*/
 WIN *win_create(
 	int width, int height,
@@ -335,7 +366,9 @@ case DirectColor:
 		win->cols[i].r = cols[i].r;
 		win->cols[i].g = cols[i].g;
 		win->cols[i].b = cols[i].b;
+		win_set_xpix(win, i);
 		}
+	win->bypp = bypp;
 	int xstride = width*width_scale * bypp;
 	win->ximage = XCreateImage(
 		win->dpy->disp, win->dpy->v,	/* display and visual */
@@ -465,175 +498,62 @@ void win_colour (WIN *win_pub, int idx, COL *clr)
     win->cols[idx].r = clr->r;
     win->cols[idx].g = clr->g;
     win->cols[idx].b = clr->b;
+    if ( win->dpy->v->class == TrueColor || win->dpy->v->class == DirectColor )
+        win_set_xpix(win, idx);
     }
 
 /*...swin_refresh:0:*/
-void win_refresh(WIN *win_pub)
+/*...swin_convert_row:0:*/
+/* One row of the window data, each byte looked up in the tables made
+   by win_set_xpix and stored as width_scale whole pixels */
+static inline void win_convert_row(const WIN_PRIV *win, byte *dst, const byte *src, int w, int bypp)
+	{
+	int x, xdup;
+	if ( win->width_scale == 1 )
+		for ( x = 0; x < w; x++, dst += bypp )
+			memcpy(dst, &win->xpix1[src[x]], bypp);
+	else if ( win->width_scale == 2 )
+		for ( x = 0; x < w; x++, dst += 2*bypp )
+			memcpy(dst, &win->xpix2[src[x]], 2*bypp);
+	else
+		for ( x = 0; x < w; x++ )
+			{
+			const unsigned long long *p2 = &win->xpix2[src[x]];
+			for ( xdup = 0; xdup+1 < win->width_scale; xdup += 2, dst += 2*bypp )
+				memcpy(dst, p2, 2*bypp);
+			if ( xdup < win->width_scale )
+				{
+				memcpy(dst, p2, bypp);
+				dst += bypp;
+				}
+			}
+	}
+/*...e*/
+/*...swin_convert:0:*/
+/* Convert a rectangle of the window data into the XImage */
+static void win_convert(WIN_PRIV *win, int x0, int y0, int w, int h)
 	{
-	WIN_PRIV *win = (WIN_PRIV *) win_pub;
 	switch ( win->dpy->v->class )
 		{
 /*...sTrueColor\44\ DirectColor:16:*/
 case TrueColor:
 case DirectColor:
 	{
-	int bypp = ( win->dpy->v->red_mask == 0x00f800 ) ? 2 : 4;
+	int bypp = win->bypp;
 	int xstride = win->width*win->width_scale * bypp;
-	int x, y, xdup, ydup, w = win->width, h = win->height;
-	COL *cols = win->cols;
-	switch ( win->dpy->v->red_mask )
-		{
-/*...s0xff0000:32:*/
-case 0xff0000:
-	for ( y = 0; y < h; y++ )
+	int xpix = win->width_scale * bypp;
+	int y, ydup;
+	for ( y = y0; y < y0+h; y++ )
 		{
-		byte *src = win->data +                  y * w;
-		byte *dst = (byte *) win->ximage->data + y * xstride * win->height_scale;
-		if ( win->width_scale == 1 )
-			for ( x = 0; x < w; x++ )
-				{
-				byte p = *src++;
-				*dst++ = cols[p].b;
-				*dst++ = cols[p].g;
-				*dst++ = cols[p].r;
-				 dst++;
-				}
-		else if ( win->width_scale == 2 )
-			for ( x = 0; x < w; x++ )
-				{
-				byte p = *src++;
-				*dst++ = cols[p].b;
-				*dst++ = cols[p].g;
-				*dst++ = cols[p].r;
-				 dst++;
-				*dst++ = cols[p].b;
-				*dst++ = cols[p].g;
-				*dst++ = cols[p].r;
-				 dst++;
-				}
+		const byte *src = win->data + y * win->width + x0;
+		byte *row = (byte *) win->ximage->data + y * xstride * win->height_scale + x0 * xpix;
+		/* The constant bypp lets each be done with whole pixel stores */
+		if ( bypp == 4 )
+			win_convert_row(win, row, src, w, 4);
 		else
-			for ( x = 0; x < w; x++ )
-				{
-				byte p = *src++;
-				for ( xdup = 0; xdup < win->width_scale; xdup++ )
-					{
-					*dst++ = cols[p].b;
-					*dst++ = cols[p].g;
-					*dst++ = cols[p].r;
-					 dst++;
-					}
-				}
+			win_convert_row(win, row, src, w, 2);
 		for ( ydup = 1; ydup < win->height_scale; ydup++ )
-			{
-			memcpy(dst, dst-xstride, xstride);
-			dst += xstride;
-			}
-		}
-	break;
-/*...e*/
-/*...s0x0000ff:32:*/
-case 0x0000ff:
-	for ( y = 0; y < h; y++ )
-		{
-		byte *src = win->data +                  y * w;
-		byte *dst = (byte *) win->ximage->data + y * xstride * win->height_scale;
-		if ( win->width_scale == 1 )
-			for ( x = 0; x < w; x++ )
-				{
-				byte p = *src++;
-				*dst++ = cols[p].r;
-				*dst++ = cols[p].g;
-				*dst++ = cols[p].b;
-				 dst++;
-				}
-		else if ( win->width_scale == 2 )
-			for ( x = 0; x < w; x++ )
-				{
-				byte p = *src++;
-				*dst++ = cols[p].r;
-				*dst++ = cols[p].g;
-				*dst++ = cols[p].b;
-				 dst++;
-				*dst++ = cols[p].r;
-				*dst++ = cols[p].g;
-				*dst++ = cols[p].b;
-				 dst++;
-				}
-		else
-			for ( x = 0; x < w; x++ )
-				{
-				byte p = *src++;
-				for ( xdup = 0; xdup < win->width_scale; xdup++ )
-					{
-					*dst++ = cols[p].r;
-					*dst++ = cols[p].g;
-					*dst++ = cols[p].b;
-					 dst++;
-					}
-				}
-		for ( ydup = 1; ydup < win->height_scale; ydup++ )
-			{
-			memcpy(dst, dst-xstride, xstride);
-			dst += xstride;
-			}
-		}
-	break;
-/*...e*/
-/*...s0x00f800:32:*/
-case 0x00f800:
-	for ( y = 0; y < h; y++ )
-		{
-		byte *src = win->data +                  y * w;
-		byte *dst = (byte *) win->ximage->data + y * xstride * win->height_scale;
-		if ( win->width_scale == 1 )
-			for ( x = 0; x < w; x++ )
-				{
-				byte p = *src++;
-				byte r = cols[p].r;
-				byte g = cols[p].g;
-				byte b = cols[p].b;
-				byte rg = (r&0xf8) | (g>>5);
-				byte gb = ((g&0x1c)<<3) | (b>>3);
-				*dst++ = gb;
-				*dst++ = rg;
-				}
-		else if ( win->width_scale == 2 )
-			for ( x = 0; x < w; x++ )
-				{
-				byte p = *src++;
-				byte r = cols[p].r;
-				byte g = cols[p].g;
-				byte b = cols[p].b;
-				byte rg = (r&0xf8) | (g>>5);
-				byte gb = ((g&0x1c)<<3) | (b>>3);
-				*dst++ = gb;
-				*dst++ = rg;
-				*dst++ = gb;
-				*dst++ = rg;
-				}
-		else
-			for ( x = 0; x < w; x++ )
-				{
-				byte p = *src++;
-				byte r = cols[p].r;
-				byte g = cols[p].g;
-				byte b = cols[p].b;
-				byte rg = (r&0xf8) | (g>>5);
-				byte gb = ((g&0x1c)<<3) | (b>>3);
-				for ( xdup = 0; xdup < win->width_scale; xdup++ )
-					{
-					*dst++ = gb;
-					*dst++ = rg;
-					}
-				}
-		for ( ydup = 1; ydup < win->height_scale; ydup++ )
-			{
-			memcpy(dst, dst-xstride, xstride);
-			dst += xstride;
-			}
-		}
-	break;
-/*...e*/
+			memcpy(row + ydup * xstride, row, w * xpix);
 		}
 	}
 	break;
@@ -642,12 +562,14 @@ case 0x00f800:
 case PseudoColor:
 	{
 	int xstride = win->width*win->width_scale;
-	int x, y, xdup, ydup, w = win->width, h = win->height;
+	int xpix = win->width_scale;
+	int x, y, xdup, ydup;
 	byte *pix = win->pix;
-	for ( y = 0; y < h; y++ )
+	for ( y = y0; y < y0+h; y++ )
 		{
-		byte *src = win->data +                  y * w;
-		byte *dst = (byte *) win->ximage->data + y * xstride * win->height_scale;
+		byte *src = win->data + y * win->width + x0;
+		byte *row = (byte *) win->ximage->data + y * xstride * win->height_scale + x0 * xpix;
+		byte *dst = row;
 		if ( win->width_scale == 1 )
 			for ( x = 0; x < w; x++ )
 				*dst++ = pix[src[x]];
@@ -666,18 +588,39 @@ case PseudoColor:
 					*dst++ = p;
 				}
 		for ( ydup = 1; ydup < win->height_scale; ydup++ )
-			{
-			memcpy(dst, dst-xstride, xstride);
-			dst += xstride;
-			}
+			memcpy(row + ydup * xstride, row, w * xpix);
 		}
 	}
 	break;
 /*...e*/
 		}
+	}
+/*...e*/
+
+void win_refresh(WIN *win_pub)
+	{
+	WIN_PRIV *win = (WIN_PRIV *) win_pub;
+	win_convert(win, 0, 0, win->width, win->height);
 	XPutImage(win->dpy->disp, win->w_bitmap, win->gc, win->ximage,
 	          0, 0, 0, 0, win->width*win->width_scale, win->height*win->height_scale);
 	}
+
+/* Only the rectangle given has changed */
+void win_refresh_rect(WIN *win_pub, int x, int y, int w, int h)
+	{
+	WIN_PRIV *win = (WIN_PRIV *) win_pub;
+	if ( x < 0 ) { w += x; x = 0; }
+	if ( y < 0 ) { h += y; y = 0; }
+	if ( x+w > win->width  ) w = win->width  - x;
+	if ( y+h > win->height ) h = win->height - y;
+	if ( w <= 0 || h <= 0 )
+		return;
+	win_convert(win, x, y, w, h);
+	XPutImage(win->dpy->disp, win->w_bitmap, win->gc, win->ximage,
+	          x*win->width_scale, y*win->height_scale,
+	          x*win->width_scale, y*win->height_scale,
+	          w*win->width_scale, h*win->height_scale);
+	}
 /*...e*/
 
 /*...swin_map_key:0:*/
@@ -897,7 +840,7 @@ case ClientMessage:
 
 void win_kbd_leds (BOOLEAN bCaps, BOOLEAN bNum, BOOLEAN bScroll)
     {
-    static byte uLast = 0xFF;
+    static THREAD_LOCAL byte uLast = 0xFF;
     byte uLeds = 0;
     diag_message (DIAG_KBD_HW, "win_kbd_leds (%d, %d, %d)", bCaps, bNum, bScroll);
     if ( bCaps )    uLeds |= 1 << KEYB_LED_CAPS_LOCK;